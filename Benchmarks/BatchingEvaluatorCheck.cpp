@@ -0,0 +1,123 @@
+/*
+	Check that wlr::BatchingEvaluator gives every input the result of an unbatched EvaluateToOutputForm
+
+	usage: BatchingEvaluatorCheck <layout directory>
+
+	Prints what failed and exits with code 1 at the first failure:
+
+		results  - each input of a batch succeeds with the output EvaluateToOutputForm gives it, or fails where
+				   EvaluateToOutputForm returns an empty string
+		parsing  - an input that wlr_ParseExpression rejects fails on its own, and the inputs around it keep their
+				   results
+		messages - an input that issues a message still succeeds
+		sizes    - batches dispatched by the window and by maximumBatchSize, and a batch in which no input parses
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/BatchingEvaluator.h"
+#include "wlr/Evaluate.h"
+#include "wlr/ExpressionBuilder.h"
+#include "wlr/KernelExecutor.h"
+
+namespace
+{
+	/**
+		EvaluateToOutputForm of input on the kernel thread, or nothing if input does not parse
+	*/
+	std::optional<std::string> Unbatched(wlr::KernelExecutor& kernel, const std::string& input)
+	{
+		return kernel
+			.Submit([&input]() -> std::optional<std::string> {
+				if(wlr_ErrorQ(wlr_ParseExpression(wlr::ToExpression(input))))
+				{
+					return std::nullopt;
+				}
+
+				return wlr::EvaluateToOutputForm(input);
+			})
+			.get();
+	}
+
+	/**
+		Submit inputs together and require each result to match the unbatched evaluation of the same input
+	*/
+	void CheckBatch(wlr::KernelExecutor& kernel, wlr::BatchingEvaluator& batching,
+					const std::vector<std::string>& inputs, const char* what)
+	{
+		std::vector<std::future<wlr::EvaluationResult>> results;
+
+		for(const std::string& input : inputs)
+		{
+			results.push_back(batching.EvaluateToOutputForm(input));
+		}
+
+		for(std::size_t index = 0; index < inputs.size(); ++index)
+		{
+			const std::string& input = inputs[index];
+
+			const std::optional<std::string> expected = Unbatched(kernel, input);
+
+			const wlr::EvaluationResult result = results[index].get();
+
+			if(!expected || expected->empty())
+			{
+				benchmark::Require(result.status == wlr::EvaluationStatus::Failed && result.output.empty(), what);
+			}
+			else
+			{
+				benchmark::Require(result.status == wlr::EvaluationStatus::Success && result.output == *expected, what);
+			}
+		}
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if(argumentCount < 2)
+	{
+		std::fprintf(stderr, "usage: %s <layout directory>\n", arguments[0]);
+		return 1;
+	}
+
+	const std::string layoutDirectory = arguments[1];
+
+	wlr::KernelExecutor kernel([&layoutDirectory] {
+		return wlr_sdk_StartRuntime(WLR_EXECUTABLE, WLR_VERSION_1, WLR_LICENSE_OR_SIGNED_CODE_MODE,
+									layoutDirectory.c_str(), nullptr);
+	});
+
+	if(kernel.Started().get() != WLR_SUCCESS)
+	{
+		std::fprintf(stderr, "Failed to start kernel runtime.\n");
+		return 1;
+	}
+
+	wlr::BatchingOptions options;
+	options.maximumBatchSize = 4;
+	options.window = std::chrono::milliseconds(20);
+
+	wlr::BatchingEvaluator batching(kernel, options);
+
+	benchmark::Require(!Unbatched(kernel, "1 +") && Unbatched(kernel, "1 + 2") == std::string("3"),
+					   "parsing: wlr_ParseExpression rejects an incomplete input");
+
+	CheckBatch(kernel, batching, {"1 + 2"}, "results: a single input");
+	CheckBatch(kernel, batching, {"1 + 2", "2 * 3 + 1", "f[x, {1, 2}]"}, "results: a batch within the window");
+	CheckBatch(kernel, batching, {"1 + 2", "1 +", "\"text\"", "{1, 2} + 1", "f[", "x^2", "g[1, 2]"},
+			   "parsing: inputs that do not parse fail alone");
+	CheckBatch(kernel, batching, {"Message[MessageName[f, \"tag\"], 1]", "3 + 4"},
+			   "messages: an input that issues a message succeeds");
+	CheckBatch(kernel, batching, {"1 +", "f["}, "sizes: a batch in which no input parses");
+	CheckBatch(kernel, batching, {"1", "2", "3", "4", "5", "6", "7", "8", "9"}, "sizes: batches split by size");
+
+	std::printf("BatchingEvaluator checks passed\n");
+
+	return 0;
+}
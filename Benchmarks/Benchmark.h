@@ -0,0 +1,137 @@
+/*
+	Minimal timing harness shared by the micro-benchmarks in this folder
+
+	Each benchmark executable takes the Wolfram layout directory as its first argument, starts the runtime, and prints
+	one line per measurement. WriteJson writes a set of results in a stable format for comparing runs.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "WolframLanguageRuntimeV1SDK.h"
+
+namespace benchmark
+{
+	struct Result
+	{
+		std::string name;
+		std::size_t iterations;
+		double nanosecondsPerIteration;
+	};
+
+	/**
+		Run body iterations times and return the mean wall-clock time per iteration
+		@remarks body is called once before timing starts, so that first-call costs are not measured.
+	*/
+	template <typename Body>
+	Result Measure(const std::string& name, std::size_t iterations, Body&& body)
+	{
+		body();
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for(std::size_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			body();
+		}
+
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+
+		const double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+		return Result {name, iterations, nanoseconds / static_cast<double>(iterations)};
+	}
+
+	inline void Print(const Result& result)
+	{
+		std::printf("%-48s %12.1f ns/iter  (%zu iterations)\n", result.name.c_str(), result.nanosecondsPerIteration,
+					result.iterations);
+	}
+
+	/**
+		Exit with code 1 after printing what failed unless condition holds, so that a failing call is never timed
+	*/
+	inline void Require(bool condition, const char* what)
+	{
+		if(!condition)
+		{
+			std::fprintf(stderr, "Failed: %s.\n", what);
+			std::exit(1);
+		}
+	}
+
+	/**
+		Write results as a JSON document of the form {"suite": ..., "results": [{"name", "iterations", "nsPerIteration"}]}
+		@remarks Returns false if the file cannot be written.
+	*/
+	inline bool WriteJson(const char* fileName, const std::string& suite, const std::vector<Result>& results)
+	{
+		std::FILE* file = std::fopen(fileName, "w");
+
+		if(file == nullptr)
+		{
+			return false;
+		}
+
+		auto writeString = [file](const std::string& text) {
+			std::fputc('"', file);
+
+			for(char character : text)
+			{
+				if(character == '"' || character == '\\')
+				{
+					std::fputc('\\', file);
+				}
+
+				std::fputc(character, file);
+			}
+
+			std::fputc('"', file);
+		};
+
+		std::fputs("{\n  \"suite\": ", file);
+		writeString(suite);
+		std::fputs(",\n  \"results\": [", file);
+
+		for(std::size_t index = 0; index < results.size(); ++index)
+		{
+			std::fputs(index == 0 ? "\n    {\"name\": " : ",\n    {\"name\": ", file);
+			writeString(results[index].name);
+			std::fprintf(file, ", \"iterations\": %zu, \"nsPerIteration\": %.3f}", results[index].iterations,
+						 results[index].nanosecondsPerIteration);
+		}
+
+		std::fputs("\n  ]\n}\n", file);
+
+		return std::fclose(file) == 0;
+	}
+
+	/**
+		Start the runtime with the layout directory given as the first command-line argument
+	*/
+	inline bool StartRuntime(int argumentCount, char** arguments)
+	{
+		if(argumentCount < 2)
+		{
+			std::fprintf(stderr, "usage: %s <layout directory>\n", arguments[0]);
+			return false;
+		}
+
+		wlr_err_t result =
+			wlr_sdk_StartRuntime(WLR_EXECUTABLE, WLR_VERSION_1, WLR_LICENSE_OR_SIGNED_CODE_MODE, arguments[1], nullptr);
+
+		if(result != WLR_SUCCESS)
+		{
+			std::fprintf(stderr, "Failed to start kernel runtime.\n");
+			return false;
+		}
+
+		return true;
+	}
+}
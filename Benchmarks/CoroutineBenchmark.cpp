@@ -0,0 +1,236 @@
+/*
+	Compare keeping many kernel requests in flight from one reactor thread with the coroutines in wlr/Coroutine.h
+	against blocking one thread per request on KernelExecutor::Submit
+
+	usage: CoroutineBenchmark <layout directory> [results.json]
+
+	Requires C++20 (for example g++ -std=c++20). Each logical request makes four dependent evaluations on the kernel
+	thread. The coroutine measurements run every request on a single reactor thread; the thread measurements start one
+	std::thread per request, which is only done up to 1,024 requests. Results are reported per logical request, so the
+	difference is the cost of parking and waking a thread against suspending and resuming a coroutine.
+*/
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/Coroutine.h"
+
+#if !defined(__cpp_impl_coroutine)
+#error "CoroutineBenchmark requires C++20 coroutines"
+#endif
+
+namespace
+{
+	/**
+		Single-threaded executor that resumes posted coroutines in order until Stop is called
+	*/
+	class RunLoop
+	{
+	public:
+		void Post(std::coroutine_handle<> handle)
+		{
+			// Notify under the lock: the resumed coroutine may finish the run, and the loop may be destroyed, as soon
+			// as the lock is released
+			std::lock_guard<std::mutex> lock(mutex);
+
+			queue.push_back(handle);
+			condition.notify_one();
+		}
+
+		void Stop()
+		{
+			stopped = true;
+		}
+
+		void Run()
+		{
+			stopped = false;
+
+			while(!stopped)
+			{
+				std::coroutine_handle<> handle;
+
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					condition.wait(lock, [this] { return !queue.empty(); });
+
+					handle = queue.front();
+					queue.pop_front();
+				}
+
+				handle.resume();
+			}
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<std::coroutine_handle<>> queue;
+		bool stopped = false;
+	};
+
+	/**
+		Fire-and-forget coroutine; the frame is destroyed when the body finishes
+	*/
+	struct Task
+	{
+		struct promise_type
+		{
+			Task get_return_object()
+			{
+				return {};
+			}
+
+			std::suspend_never initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void return_void()
+			{
+			}
+
+			void unhandled_exception()
+			{
+				std::terminate();
+			}
+		};
+	};
+
+	constexpr int EvaluationsPerRequest = 4;
+
+	mint EvaluateStep(mint value)
+	{
+		mint result = 0;
+
+		wlr_IntegerData(wlr_Eval(wlr_E(wlr_Symbol("Plus"), wlr_Integer(value), wlr_Integer(1))), &result);
+
+		return result;
+	}
+
+	Task CoroutineRequest(wlr::KernelExecutor& kernel, RunLoop& loop, std::size_t& remaining)
+	{
+		mint value = 0;
+
+		for(int step = 0; step < EvaluationsPerRequest; ++step)
+		{
+			std::optional<mint> result = co_await wlr::Schedule(kernel, [value] { return EvaluateStep(value); }, loop);
+
+			value = *result;
+		}
+
+		if(--remaining == 0)
+		{
+			loop.Stop();
+		}
+	}
+
+	void RunCoroutines(wlr::KernelExecutor& kernel, RunLoop& loop, std::size_t requests)
+	{
+		std::size_t remaining = requests;
+
+		for(std::size_t request = 0; request < requests; ++request)
+		{
+			CoroutineRequest(kernel, loop, remaining);
+		}
+
+		loop.Run();
+	}
+
+	void RunThreads(wlr::KernelExecutor& kernel, std::size_t requests)
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(requests);
+
+		for(std::size_t request = 0; request < requests; ++request)
+		{
+			threads.emplace_back([&kernel] {
+				mint value = 0;
+
+				for(int step = 0; step < EvaluationsPerRequest; ++step)
+				{
+					value = kernel.Submit([value] { return EvaluateStep(value); }).get();
+				}
+			});
+		}
+
+		for(std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if(argumentCount < 2)
+	{
+		std::fprintf(stderr, "usage: %s <layout directory> [results.json]\n", arguments[0]);
+		return 1;
+	}
+
+	const std::string layoutDirectory = arguments[1];
+	const char* outputFile = argumentCount > 2 ? arguments[2] : "CoroutineBenchmark.json";
+
+	wlr::KernelExecutor kernel([&layoutDirectory] {
+		return wlr_sdk_StartRuntime(WLR_EXECUTABLE, WLR_VERSION_1, WLR_LICENSE_OR_SIGNED_CODE_MODE,
+									layoutDirectory.c_str(), nullptr);
+	});
+
+	if(kernel.Started().get() != WLR_SUCCESS)
+	{
+		std::fprintf(stderr, "Failed to start kernel runtime.\n");
+		return 1;
+	}
+
+	std::vector<benchmark::Result> results;
+
+	// Report per logical request rather than per batch
+	auto run = [&results](const std::string& name, std::size_t requests, std::size_t iterations, auto&& body) {
+		benchmark::Result result = benchmark::Measure(name, iterations, body);
+
+		result.iterations *= requests;
+		result.nanosecondsPerIteration /= static_cast<double>(requests);
+
+		results.push_back(result);
+		benchmark::Print(results.back());
+	};
+
+	RunLoop loop;
+
+	for(std::size_t requests : {16, 256, 1024, 16384})
+	{
+		const std::size_t iterations = requests >= 16384 ? 2 : 10;
+
+		run("coroutines/" + std::to_string(requests) + " in flight", requests, iterations,
+			[&] { RunCoroutines(kernel, loop, requests); });
+
+		if(requests <= 1024)
+		{
+			run("threads/" + std::to_string(requests) + " in flight", requests, iterations,
+				[&] { RunThreads(kernel, requests); });
+		}
+	}
+
+	if(!benchmark::WriteJson(outputFile, "CoroutineBenchmark", results))
+	{
+		std::fprintf(stderr, "Failed to write %s.\n", outputFile);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,153 @@
+using System;
+using System.Runtime.InteropServices;
+using System.Text;
+
+using BenchmarkDotNet.Attributes;
+using BenchmarkDotNet.Running;
+
+using WolframLanguageRuntime;
+
+/*
+	Compare EvaluateToOutputForm through the P/Invoke path in SampleProgram.cs with the single-call shim entry points
+	in WolframLanguageRuntimeShim.cs
+
+		dotnet run -c Release
+
+	Set WLR_LAYOUT_DIRECTORY to the Wolfram layout and, if WolframLanguageRuntimeShim.dll is not next to the
+	executable, WLR_SHIM_LIBRARY to its path. The P/Invoke path uses __arglist, which .NET only supports on Windows.
+*/
+
+[MemoryDiagnoser]
+public unsafe class ShimBenchmark
+{
+	private const int batchSize = 64;
+
+	private const string input = "2 + 2";
+
+	private readonly byte[] inputBytes = Encoding.UTF8.GetBytes(input);
+
+	private readonly byte[] outputBytes = new byte[4096];
+
+	private readonly char[] outputChars = new char[4096];
+
+	private byte[] batchInputs = Array.Empty<byte>();
+
+	private readonly nint[] batchInputOffsets = new nint[batchSize + 1];
+
+	private readonly nint[] batchOutputOffsets = new nint[batchSize + 1];
+
+	private readonly WLR.wlr_error_type[] batchStatuses = new WLR.wlr_error_type[batchSize];
+
+	[GlobalSetup]
+	public void Setup()
+	{
+		WLRShim.Load(Environment.GetEnvironmentVariable("WLR_SHIM_LIBRARY"));
+
+		string layoutDirectory = Environment.GetEnvironmentVariable("WLR_LAYOUT_DIRECTORY") ?? @"C:\Program Files\Wolfram Research\Wolfram\14.3";
+
+		if(WLRShim.StartRuntime(layoutDirectory) != WLR.wlr_error_type.WLR_SUCCESS)
+		{
+			throw new InvalidOperationException("Failed to start kernel runtime.");
+		}
+
+		var inputs = new StringBuilder();
+
+		for(int index = 0; index < batchSize; ++index)
+		{
+			batchInputOffsets[index] = Encoding.UTF8.GetByteCount(inputs.ToString());
+			inputs.Append(index).Append(" + 2");
+		}
+
+		batchInputs = Encoding.UTF8.GetBytes(inputs.ToString());
+		batchInputOffsets[batchSize] = batchInputs.Length;
+	}
+
+	[Benchmark(Baseline = true, Description = "P/Invoke per SDK call (SampleProgram.cs)")]
+	public string PInvoke()
+	{
+		return PInvokeEvaluateToOutputForm(input);
+	}
+
+	[Benchmark(Description = "Shim, string in and out")]
+	public string ShimString()
+	{
+		return WLRShim.EvaluateToOutputForm(input);
+	}
+
+	[Benchmark(Description = "Shim, UTF-8 spans")]
+	public int ShimSpan()
+	{
+		WLRShim.EvaluateToOutputForm(inputBytes, outputBytes, out int bytesWritten);
+
+		return bytesWritten;
+	}
+
+	[Benchmark(Description = "Shim, UTF-16 spans")]
+	public int ShimUtf16Span()
+	{
+		WLRShim.EvaluateToOutputForm(input.AsSpan(), outputChars, out int charsWritten);
+
+		return charsWritten;
+	}
+
+	[Benchmark(OperationsPerInvoke = batchSize, Description = "Shim, batch of 64, per input")]
+	public nint ShimBatch()
+	{
+		WLRShim.EvaluateBatchToOutputForm(batchInputs, batchInputOffsets, outputBytes, batchOutputOffsets, batchStatuses);
+
+		return batchOutputOffsets[batchSize];
+	}
+
+	// EvaluateToOutputForm from SampleProgram.cs, with its helpers inlined
+	private static string PInvokeEvaluateToOutputForm(string input)
+	{
+		WLR.Methods.wlr_CreateExpressionPool();
+
+		void* inputString;
+		void* toString;
+		void* outputForm;
+
+		fixed(byte* inputPointer = Encoding.UTF8.GetBytes(input))
+		{
+			inputString = WLR.Methods.wlr_String((sbyte*) inputPointer);
+		}
+
+		fixed(byte* toStringPointer = Encoding.UTF8.GetBytes("ToString"))
+		{
+			toString = WLR.Methods.wlr_Symbol((sbyte*) toStringPointer);
+		}
+
+		fixed(byte* outputFormPointer = Encoding.UTF8.GetBytes("OutputForm"))
+		{
+			outputForm = WLR.Methods.wlr_Symbol((sbyte*) outputFormPointer);
+		}
+
+		void* evaluatedExpression =
+			WLR.Methods.wlr_Eval(WLR.Methods.wlr_VariadicE(toString, 2, __arglist(WLR.Methods.wlr_ParseExpression(inputString), outputForm)));
+
+		sbyte* stringData;
+
+		nint stringDataLength;
+
+		string result = "";
+
+		if(WLR.Methods.wlr_StringData(evaluatedExpression, &stringData, &stringDataLength) == WLR.wlr_error_type.WLR_SUCCESS)
+		{
+			result = Encoding.UTF8.GetString((byte*) stringData, (int) stringDataLength);
+
+			WLR.Methods.wlr_Release(stringData);
+		}
+
+		WLR.Methods.wlr_ReleaseExpressionPool();
+
+		return result;
+	}
+}
+
+public static class Program
+{
+	public static void Main(string[] arguments)
+	{
+		BenchmarkSwitcher.FromAssembly(typeof(Program).Assembly).Run(arguments);
+	}
+}
@@ -0,0 +1,121 @@
+/*
+	Compare the wlr_List macros with the variadic builders in wlr/ExpressionBuilder.h for 3, 25 and 10,000 children
+
+	When every child is a native integer, wlr::List builds a packed List with one call, so the integer rows measure that
+	fast path; the mixed rows measure the general path, one call per child plus the expression bag. The macros stop at
+	25 children, so for 10,000 children the builders are compared with a hand-written wlr_ExpressionBag loop instead.
+
+	Before measuring, the run requires that only wlr::List packs, that wlr::Association gives an atomic association, and
+	that an unsigned value beyond the range of mint does not wrap around.
+*/
+
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/ExpressionBuilder.h"
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	wlr::RecyclingExpressionPool pool(1024);
+
+	benchmark::Require(wlr_ExpressionType(wlr::List(1, 2, 3)) == WLR_PACKED_ARRAY, "wlr::List of integers is packed");
+	benchmark::Require(wlr_ExpressionType(wlr::E(wlr::Symbol("f"), 1, 2, 3)) == WLR_NORMAL,
+					   "wlr::E of integers with a head other than List is not packed");
+
+	const std::vector<wlr_expr> rules {wlr::Rule("a", 1), wlr::Rule("b", 2)};
+
+	benchmark::Require(wlr_AssociationQ(wlr::Association(wlr::Rule("a", 1), wlr::Rule("b", 2))),
+					   "wlr::Association is an atomic association");
+	benchmark::Require(wlr_AssociationQ(wlr::Association(wlr::Splice(rules))),
+					   "wlr::Association of spliced rules is an atomic association");
+
+	const std::uint64_t beyondMint = std::numeric_limits<std::uint64_t>::max();
+	const wlr_expr big = wlr::ToExpression(beyondMint);
+
+	benchmark::Require(!wlr_ErrorQ(big) && !wlr_SameQ(big, wlr_Integer(-1)), "an unsigned value beyond mint does not wrap");
+	benchmark::Require(wlr_ExpressionType(wlr::List(1, beyondMint)) == WLR_NORMAL,
+					   "wlr::List does not pack a value beyond mint");
+	pool.EndRequest();
+
+	const std::size_t iterations = 100000;
+
+	benchmark::Print(benchmark::Measure("3 children, wlr_List macro", iterations, [&] {
+		wlr_List(wlr_Integer(1), wlr_Real(2.5), wlr_String("three"));
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("3 children, wlr::List", iterations, [&] {
+		wlr::List(1, 2.5, "three");
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("3 integer children, wlr::List (packed)", iterations, [&] {
+		wlr::List(1, 2, 3);
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("25 integer children, wlr_List macro", iterations, [&] {
+		wlr_List(wlr_Integer(1), wlr_Integer(2), wlr_Integer(3), wlr_Integer(4), wlr_Integer(5), wlr_Integer(6),
+				 wlr_Integer(7), wlr_Integer(8), wlr_Integer(9), wlr_Integer(10), wlr_Integer(11), wlr_Integer(12),
+				 wlr_Integer(13), wlr_Integer(14), wlr_Integer(15), wlr_Integer(16), wlr_Integer(17), wlr_Integer(18),
+				 wlr_Integer(19), wlr_Integer(20), wlr_Integer(21), wlr_Integer(22), wlr_Integer(23), wlr_Integer(24),
+				 wlr_Integer(25));
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("25 integer children, wlr::List (packed)", iterations, [&] {
+		wlr::List(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25);
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("25 mixed children, wlr_List macro", iterations, [&] {
+		wlr_List(wlr_Integer(1), wlr_Real(2.5), wlr_String("three"), wlr_Integer(4), wlr_Real(5.5), wlr_String("six"),
+				 wlr_Integer(7), wlr_Real(8.5), wlr_String("nine"), wlr_Integer(10), wlr_Real(11.5), wlr_String("twelve"),
+				 wlr_Integer(13), wlr_Real(14.5), wlr_String("fifteen"), wlr_Integer(16), wlr_Real(17.5),
+				 wlr_String("eighteen"), wlr_Integer(19), wlr_Real(20.5), wlr_String("twenty-one"), wlr_Integer(22),
+				 wlr_Real(23.5), wlr_String("twenty-four"), wlr_Integer(25));
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("25 mixed children, wlr::List", iterations, [&] {
+		wlr::List(1, 2.5, "three", 4, 5.5, "six", 7, 8.5, "nine", 10, 11.5, "twelve", 13, 14.5, "fifteen", 16, 17.5,
+				  "eighteen", 19, 20.5, "twenty-one", 22, 23.5, "twenty-four", 25);
+		pool.EndRequest();
+	}));
+
+	std::vector<mint> values(10000);
+	std::iota(values.begin(), values.end(), mint(1));
+
+	const std::size_t largeIterations = 1000;
+
+	benchmark::Print(benchmark::Measure("10000 children, wlr_ExpressionBag loop", largeIterations, [&] {
+		wlr_exprbag expressionBag = wlr_ExpressionBag();
+		for(mint value : values)
+		{
+			wlr_AddExpression(expressionBag, wlr_Integer(value));
+		}
+		wlr_ExpressionBagToExpression(expressionBag, wlr::Symbol(wlr::SystemSymbol::List));
+		wlr_ReleaseExpressionBag(expressionBag);
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("10000 children, wlr::List(wlr::Splice(...))", largeIterations, [&] {
+		wlr::List(wlr::Splice(values));
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("10000 children, packed wlr::ToExpression(...)", largeIterations, [&] {
+		wlr::ToExpression(values);
+		pool.EndRequest();
+	}));
+
+	return 0;
+}
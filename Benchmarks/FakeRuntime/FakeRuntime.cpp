@@ -0,0 +1,2796 @@
+/*
+	Stand-in implementation of the expression API in WolframLanguageRuntimeV1.h, for measuring host-side overhead
+
+	Link a benchmark against this file instead of StandaloneApplicationsSDK.lib to run it without a Wolfram installation
+	or license. It started from the minimal declaration set in SDK/test.h and covers every function the helpers in
+	Native/wlr/ and the benchmarks in this folder call.
+
+	Expressions are reference-counted trees. Pools, detaching, bags, packed arrays, numeric arrays and the buffers
+	returned by the *Data functions behave like their documented counterparts. Parsing understands the InputForm subset
+	used by the benchmarks (numbers, strings, symbols, f[...], {...}, #slots, ->, +, -, *, /, ^ and postfix &).
+	Evaluation is a toy: it adds and multiplies numbers, totals packed vectors, turns Association[{rules...}] into
+	Association[rules...], turns Normal[NumericArray[...]] into packed rows, unpacks with Developer`FromPackedArray,
+	formats ToString[expression, form], passes Print and Message[MessageName[...], ...] output to the registered
+	handlers, and runs BinarySerialize and BinaryDeserialize with the codec in wlr/Wxf.h (byte arrays are
+	UnsignedInteger8 NumericArrays); everything else evaluates to itself. The Function helpers that Native/wlr parses
+	from Wolfram Language source are recognized by their source and run natively: the string arena of wlr/Strings.h, the
+	packing function of wlr/Tensor.h, the batch function of wlr/BatchingEvaluator.h, and the ToTabular and
+	Tabular-reading functions of wlr/Tabular.h, which build and read a Tabular[<|name -> {...}, ...|>]. wlr_Abort, from
+	any thread, cuts the evaluation latency short and makes wlr_Eval return $Aborted until wlr_ClearAbort.
+
+	Set these environment variables to model the cost of crossing into the real runtime:
+
+		WLR_FAKE_CALL_LATENCY_NS   busy-wait added to every expression API call (default 0)
+		WLR_FAKE_EVAL_LATENCY_NS   extra busy-wait added to every wlr_Eval call (default 0)
+*/
+
+#define WLR_STATIC_LINKING
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "WolframLanguageRuntimeV1SDK.h"
+#include "wlr/NumericArrayConvert.h"
+#include "wlr/Tensor.h"
+#include "wlr/Wxf.h"
+
+struct st_MNumericArray
+{
+	numericarray_data_t type;
+	std::vector<mint> dimensions;
+	mint length;
+	std::vector<unsigned char> data;
+};
+
+namespace
+{
+	/* Latency model */
+
+	std::chrono::nanoseconds callLatency {0};
+	std::chrono::nanoseconds evalLatency {0};
+
+	std::atomic<bool> abortRequested {false};
+
+	void Spin(std::chrono::nanoseconds duration)
+	{
+		if(duration.count() <= 0)
+		{
+			return;
+		}
+
+		const auto end = std::chrono::steady_clock::now() + duration;
+
+		while(std::chrono::steady_clock::now() < end && !abortRequested.load(std::memory_order_relaxed))
+		{
+		}
+	}
+
+	inline void Call()
+	{
+		Spin(callLatency);
+	}
+
+	/* Expressions */
+
+	enum class Kind
+	{
+		Integer,
+		Real,
+		String,
+		Symbol,
+		Normal,
+		Error,
+		PackedInteger,
+		PackedReal,
+		NumericArray
+	};
+
+	/**
+		Wolfram Language function in Native/wlr that the fake runs natively instead of evaluating its body
+	*/
+	enum class Helper
+	{
+		None,
+		StringArena,
+		Pack,
+		Batch,
+		ToTabular,
+		FromTabular
+	};
+
+	std::int64_t bytesInUse = 0;
+
+	struct Node
+	{
+		Kind kind;
+		mint references = 1;
+		mint integer = 0;
+		mreal real = 0;
+		std::string text;
+		Node* head = nullptr;
+		std::vector<Node*> children;
+		std::vector<mint> integers;
+		std::vector<mreal> reals;
+		st_MNumericArray numericArray {};
+		Helper helper = Helper::None;
+
+		explicit Node(Kind kind) : kind(kind)
+		{
+			bytesInUse += sizeof(Node);
+		}
+
+		~Node();
+	};
+
+	void Retain(Node* node)
+	{
+		if(node != nullptr)
+		{
+			++node->references;
+		}
+	}
+
+	void Release(Node* node)
+	{
+		if(node != nullptr && --node->references == 0)
+		{
+			delete node;
+		}
+	}
+
+	Node::~Node()
+	{
+		bytesInUse -= sizeof(Node);
+
+		Release(head);
+
+		for(Node* child : children)
+		{
+			Release(child);
+		}
+	}
+
+	std::vector<std::vector<Node*>> pools(1);
+
+	/**
+		Add a new reference to node to the current pool and return it
+	*/
+	wlr_expr Pooled(Node* node)
+	{
+		pools.back().push_back(node);
+
+		return node;
+	}
+
+	wlr_expr Borrowed(Node* node)
+	{
+		Retain(node);
+
+		return Pooled(node);
+	}
+
+	Node* AsNode(wlr_expr expression)
+	{
+		return static_cast<Node*>(expression);
+	}
+
+	Node* ErrorNode(wlr_err_t type)
+	{
+		static Node* errors[WLR_RUNTIME_NOT_STARTED + 1] = {};
+
+		if(errors[type] == nullptr)
+		{
+			errors[type] = new Node(Kind::Error);
+			errors[type]->integer = type;
+		}
+
+		return errors[type];
+	}
+
+	wlr_expr Error(wlr_err_t type)
+	{
+		return ErrorNode(type);
+	}
+
+	Node* SymbolNode(std::string_view name)
+	{
+		static std::unordered_map<std::string, Node*> symbols;
+
+		std::string fullName(name);
+
+		if(fullName.find('`') == std::string::npos)
+		{
+			fullName = "System`" + fullName;
+		}
+
+		Node*& symbol = symbols[fullName];
+
+		if(symbol == nullptr)
+		{
+			symbol = new Node(Kind::Symbol);
+			symbol->text = fullName;
+		}
+
+		return symbol;
+	}
+
+	bool IsSymbol(const Node* node, std::string_view name)
+	{
+		return node != nullptr && node->kind == Kind::Symbol && node->text.size() == name.size() + 7 &&
+			   node->text.compare(0, 7, "System`") == 0 && std::string_view(node->text).substr(7) == name;
+	}
+
+	Node* NewInteger(mint value)
+	{
+		Node* node = new Node(Kind::Integer);
+		node->integer = value;
+		return node;
+	}
+
+	Node* NewReal(mreal value)
+	{
+		Node* node = new Node(Kind::Real);
+		node->real = value;
+		return node;
+	}
+
+	Node* NewString(std::string_view text)
+	{
+		Node* node = new Node(Kind::String);
+		node->text.assign(text.data(), text.size());
+		bytesInUse += static_cast<std::int64_t>(text.size());
+		return node;
+	}
+
+	/**
+		New Normal expression; takes new references to head and children
+	*/
+	Node* NewNormal(Node* head, std::vector<Node*> children)
+	{
+		Node* node = new Node(Kind::Normal);
+
+		Retain(head);
+		node->head = head;
+
+		for(Node* child : children)
+		{
+			Retain(child);
+		}
+
+		node->children = std::move(children);
+		bytesInUse += static_cast<std::int64_t>(node->children.size() * sizeof(Node*));
+
+		return node;
+	}
+
+	Node* Element(const Node* node, std::size_t index)
+	{
+		switch(node->kind)
+		{
+			case Kind::Normal:
+				Retain(node->children[index]);
+				return node->children[index];
+			case Kind::PackedInteger:
+				return NewInteger(node->integers[index]);
+			case Kind::PackedReal:
+				return NewReal(node->reals[index]);
+			default:
+				return nullptr;
+		}
+	}
+
+	std::size_t ElementCount(const Node* node)
+	{
+		switch(node->kind)
+		{
+			case Kind::Normal:
+				return node->children.size();
+			case Kind::PackedInteger:
+				return node->integers.size();
+			case Kind::PackedReal:
+				return node->reals.size();
+			case Kind::NumericArray:
+				return node->numericArray.dimensions.empty() ? 0
+															 : static_cast<std::size_t>(node->numericArray.dimensions[0]);
+			default:
+				return 0;
+		}
+	}
+
+	bool Same(const Node* first, const Node* second)
+	{
+		if(first == second)
+		{
+			return true;
+		}
+
+		if(first == nullptr || second == nullptr || first->kind != second->kind)
+		{
+			return false;
+		}
+
+		switch(first->kind)
+		{
+			case Kind::Integer:
+			case Kind::Error:
+				return first->integer == second->integer;
+			case Kind::Real:
+				return first->real == second->real;
+			case Kind::String:
+			case Kind::Symbol:
+				return first->text == second->text;
+			case Kind::PackedInteger:
+				return first->integers == second->integers;
+			case Kind::PackedReal:
+				return first->reals == second->reals;
+			case Kind::NumericArray:
+				return first->numericArray.type == second->numericArray.type &&
+					   first->numericArray.dimensions == second->numericArray.dimensions &&
+					   first->numericArray.data == second->numericArray.data;
+			case Kind::Normal:
+				if(!Same(first->head, second->head) || first->children.size() != second->children.size())
+				{
+					return false;
+				}
+
+				for(std::size_t index = 0; index < first->children.size(); ++index)
+				{
+					if(!Same(first->children[index], second->children[index]))
+					{
+						return false;
+					}
+				}
+
+				return true;
+		}
+
+		return false;
+	}
+
+	/* Printing */
+
+	void Print(const Node* node, bool inputForm, std::string& out)
+	{
+		char buffer[64];
+
+		switch(node->kind)
+		{
+			case Kind::Integer:
+				std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(node->integer));
+				out += buffer;
+				break;
+			case Kind::Real:
+				std::snprintf(buffer, sizeof(buffer), inputForm ? "%.17g" : "%.6g", node->real);
+				out += buffer;
+				if(std::strpbrk(buffer, ".einf") == nullptr)
+				{
+					out += '.';
+				}
+				break;
+			case Kind::String:
+				if(!inputForm)
+				{
+					out += node->text;
+					break;
+				}
+				out += '"';
+				for(char character : node->text)
+				{
+					if(character == '"' || character == '\\')
+					{
+						out += '\\';
+					}
+					out += character;
+				}
+				out += '"';
+				break;
+			case Kind::Symbol:
+				out += node->text.compare(0, 7, "System`") == 0 ? node->text.substr(7) : node->text;
+				break;
+			case Kind::Error:
+				out += "$Failed";
+				break;
+			case Kind::PackedInteger:
+			case Kind::PackedReal:
+			{
+				out += '{';
+				for(std::size_t index = 0; index < ElementCount(node); ++index)
+				{
+					Node* element = Element(node, index);
+					out += index == 0 ? "" : ", ";
+					Print(element, inputForm, out);
+					Release(element);
+				}
+				out += '}';
+				break;
+			}
+			case Kind::NumericArray:
+				std::snprintf(buffer, sizeof(buffer), "NumericArray[<%lld>]", static_cast<long long>(node->numericArray.length));
+				out += buffer;
+				break;
+			case Kind::Normal:
+			{
+				const bool list = IsSymbol(node->head, "List");
+				if(list)
+				{
+					out += '{';
+				}
+				else
+				{
+					Print(node->head, inputForm, out);
+					out += '[';
+				}
+				for(std::size_t index = 0; index < node->children.size(); ++index)
+				{
+					out += index == 0 ? "" : ", ";
+					Print(node->children[index], inputForm, out);
+				}
+				out += list ? '}' : ']';
+				break;
+			}
+		}
+	}
+
+	/* Parsing */
+
+	class Parser
+	{
+	public:
+		explicit Parser(std::string_view text) : text(text)
+		{
+		}
+
+		Node* ParseAll()
+		{
+			Node* result = ParseExpression(0);
+
+			SkipSpace();
+
+			if(result != nullptr && position != text.size())
+			{
+				Release(result);
+				return nullptr;
+			}
+
+			return result;
+		}
+
+	private:
+		static Node* Binary(const char* head, Node* first, Node* second)
+		{
+			Node* result = NewNormal(SymbolNode(head), {first, second});
+			Release(first);
+			Release(second);
+			return result;
+		}
+
+		Node* ParseExpression(int minimumPrecedence)
+		{
+			Node* left = ParseUnary();
+
+			while(left != nullptr)
+			{
+				SkipSpace();
+
+				if(position >= text.size())
+				{
+					break;
+				}
+
+				const std::string_view rest = text.substr(position);
+
+				int precedence;
+				const char* head;
+				std::size_t length = 1;
+				bool rightAssociative = false;
+
+				if(rest.compare(0, 2, "->") == 0)
+				{
+					precedence = 1, head = "Rule", length = 2, rightAssociative = true;
+				}
+				else if(rest[0] == '&')
+				{
+					if(minimumPrecedence > 0)
+					{
+						break;
+					}
+
+					++position;
+					Node* function = NewNormal(SymbolNode("Function"), {left});
+					Release(left);
+					left = function;
+					continue;
+				}
+				else if(rest[0] == '+' || rest[0] == '-')
+				{
+					precedence = 3, head = rest[0] == '+' ? "Plus" : "Subtract";
+				}
+				else if(rest[0] == '*' || rest[0] == '/')
+				{
+					precedence = 4, head = rest[0] == '*' ? "Times" : "Divide";
+				}
+				else if(rest[0] == '^')
+				{
+					precedence = 6, head = "Power", rightAssociative = true;
+				}
+				else
+				{
+					break;
+				}
+
+				if(precedence < minimumPrecedence)
+				{
+					break;
+				}
+
+				position += length;
+
+				Node* right = ParseExpression(rightAssociative ? precedence : precedence + 1);
+
+				if(right == nullptr)
+				{
+					Release(left);
+					return nullptr;
+				}
+
+				left = Binary(head, left, right);
+			}
+
+			return left;
+		}
+
+		Node* ParseUnary()
+		{
+			SkipSpace();
+
+			if(position < text.size() && text[position] == '-')
+			{
+				++position;
+
+				Node* operand = ParseExpression(5);
+
+				if(operand == nullptr)
+				{
+					return nullptr;
+				}
+
+				if(operand->kind == Kind::Integer || operand->kind == Kind::Real)
+				{
+					operand->integer = -operand->integer;
+					operand->real = -operand->real;
+					return operand;
+				}
+
+				return Binary("Times", NewInteger(-1), operand);
+			}
+
+			return ParsePostfix(ParsePrimary());
+		}
+
+		Node* ParsePostfix(Node* node)
+		{
+			while(node != nullptr)
+			{
+				SkipSpace();
+
+				if(position >= text.size() || text[position] != '[')
+				{
+					break;
+				}
+
+				++position;
+
+				std::vector<Node*> arguments;
+
+				if(!ParseSequence(']', arguments))
+				{
+					Release(node);
+					return nullptr;
+				}
+
+				Node* call = NewNormal(node, arguments);
+
+				Release(node);
+
+				for(Node* argument : arguments)
+				{
+					Release(argument);
+				}
+
+				node = call;
+			}
+
+			return node;
+		}
+
+		bool ParseSequence(char close, std::vector<Node*>& elements)
+		{
+			SkipSpace();
+
+			if(position < text.size() && text[position] == close)
+			{
+				++position;
+				return true;
+			}
+
+			for(;;)
+			{
+				Node* element = ParseExpression(0);
+
+				if(element == nullptr)
+				{
+					break;
+				}
+
+				elements.push_back(element);
+
+				SkipSpace();
+
+				if(position < text.size() && text[position] == ',')
+				{
+					++position;
+					continue;
+				}
+
+				if(position < text.size() && text[position] == close)
+				{
+					++position;
+					return true;
+				}
+
+				break;
+			}
+
+			for(Node* element : elements)
+			{
+				Release(element);
+			}
+
+			elements.clear();
+
+			return false;
+		}
+
+		Node* ParsePrimary()
+		{
+			SkipSpace();
+
+			if(position >= text.size())
+			{
+				return nullptr;
+			}
+
+			const char first = text[position];
+
+			if(IsDigit(first) || (first == '.' && position + 1 < text.size() && IsDigit(text[position + 1])))
+			{
+				return ParseNumber();
+			}
+
+			if(first == '"')
+			{
+				return ParseString();
+			}
+
+			if(IsSymbolStart(first))
+			{
+				const std::size_t begin = position;
+
+				while(position < text.size() && (IsSymbolStart(text[position]) || IsDigit(text[position])))
+				{
+					++position;
+				}
+
+				Node* symbol = SymbolNode(text.substr(begin, position - begin));
+				Retain(symbol);
+				return symbol;
+			}
+
+			if(first == '#')
+			{
+				++position;
+
+				const std::size_t begin = position;
+
+				while(position < text.size() && (IsSymbolStart(text[position]) || IsDigit(text[position])))
+				{
+					++position;
+				}
+
+				const std::string_view name = text.substr(begin, position - begin);
+
+				Node* argument = name.empty()				 ? NewInteger(1)
+								 : IsDigit(name.front()) ? NewInteger(std::atoll(std::string(name).c_str()))
+														 : NewString(name);
+
+				Node* slot = NewNormal(SymbolNode("Slot"), {argument});
+				Release(argument);
+				return slot;
+			}
+
+			if(first == '{')
+			{
+				++position;
+
+				std::vector<Node*> elements;
+
+				if(!ParseSequence('}', elements))
+				{
+					return nullptr;
+				}
+
+				Node* list = NewNormal(SymbolNode("List"), elements);
+
+				for(Node* element : elements)
+				{
+					Release(element);
+				}
+
+				return list;
+			}
+
+			if(first == '(')
+			{
+				++position;
+
+				Node* inner = ParseExpression(0);
+
+				SkipSpace();
+
+				if(inner == nullptr || position >= text.size() || text[position] != ')')
+				{
+					Release(inner);
+					return nullptr;
+				}
+
+				++position;
+				return inner;
+			}
+
+			return nullptr;
+		}
+
+		Node* ParseNumber()
+		{
+			const std::size_t begin = position;
+			bool real = false;
+
+			while(position < text.size() && (IsDigit(text[position]) || text[position] == '.'))
+			{
+				real = real || text[position] == '.';
+				++position;
+			}
+
+			const std::string digits(text.substr(begin, position - begin));
+
+			return real ? NewReal(std::strtod(digits.c_str(), nullptr)) : NewInteger(std::strtoll(digits.c_str(), nullptr, 10));
+		}
+
+		Node* ParseString()
+		{
+			std::string value;
+
+			for(++position; position < text.size(); ++position)
+			{
+				char character = text[position];
+
+				if(character == '"')
+				{
+					++position;
+					return NewString(value);
+				}
+
+				if(character == '\\' && position + 1 < text.size())
+				{
+					character = text[++position];
+					character = character == 'n' ? '\n' : character == 't' ? '\t' : character;
+				}
+
+				value += character;
+			}
+
+			return nullptr;
+		}
+
+		void SkipSpace()
+		{
+			while(position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' ||
+											  text[position] == '\r'))
+			{
+				++position;
+			}
+		}
+
+		static bool IsDigit(char character)
+		{
+			return character >= '0' && character <= '9';
+		}
+
+		static bool IsSymbolStart(char character)
+		{
+			return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') || character == '$' ||
+				   character == '`';
+		}
+
+		std::string_view text;
+		std::size_t position = 0;
+	};
+
+	/* Evaluation */
+
+	std::vector<std::pair<wlr_stdout_handler_t, void*>> stdoutHandlers;
+	std::vector<std::pair<wlr_message_handler_t, void*>> messageHandlers;
+
+	Node* Evaluate(Node* node);
+
+	Node* NewBytes(std::string_view bytes)
+	{
+		Node* node = new Node(Kind::NumericArray);
+		node->numericArray.type = MNumericArray_Type_UBit8;
+		node->numericArray.dimensions.assign(1, static_cast<mint>(bytes.size()));
+		node->numericArray.length = static_cast<mint>(bytes.size());
+		node->numericArray.data.assign(bytes.begin(), bytes.end());
+		bytesInUse += static_cast<std::int64_t>(bytes.size());
+		return node;
+	}
+
+	/* WXF, for BinarySerialize and BinaryDeserialize */
+
+	void WriteWxf(const Node* node, wlr::WxfWriter& writer)
+	{
+		switch(node->kind)
+		{
+			case Kind::Integer:
+				writer.Integer(node->integer);
+				break;
+			case Kind::Real:
+				writer.Real(node->real);
+				break;
+			case Kind::String:
+				writer.String(node->text);
+				break;
+			case Kind::Symbol:
+				writer.Symbol(node->text.compare(0, 7, "System`") == 0 ? std::string_view(node->text).substr(7)
+																	  : std::string_view(node->text));
+				break;
+			case Kind::Error:
+				writer.Symbol("$Failed");
+				break;
+			case Kind::PackedInteger:
+			case Kind::PackedReal:
+			{
+				const mint length = static_cast<mint>(ElementCount(node));
+
+				// Like the kernel, narrow packed integers to the smallest type that holds them
+				if(node->kind == Kind::PackedInteger)
+				{
+					writer.PackedIntegers(node->integers.data(), &length, 1);
+				}
+				else
+				{
+					writer.PackedArray(node->reals.data(), &length, 1);
+				}
+				break;
+			}
+			case Kind::NumericArray:
+				writer.NumericArray(const_cast<MNumericArray>(&node->numericArray));
+				break;
+			case Kind::Normal:
+			{
+				const bool association =
+					IsSymbol(node->head, "Association") &&
+					std::all_of(node->children.begin(), node->children.end(), [](const Node* child) {
+						return child->kind == Kind::Normal && child->children.size() == 2 &&
+							   (IsSymbol(child->head, "Rule") || IsSymbol(child->head, "RuleDelayed"));
+					});
+
+				if(association)
+				{
+					writer.Association(node->children.size());
+
+					for(const Node* rule : node->children)
+					{
+						IsSymbol(rule->head, "Rule") ? writer.Rule() : writer.RuleDelayed();
+						WriteWxf(rule->children[0], writer);
+						WriteWxf(rule->children[1], writer);
+					}
+				}
+				else
+				{
+					writer.Function(node->children.size());
+					WriteWxf(node->head, writer);
+
+					for(const Node* child : node->children)
+					{
+						WriteWxf(child, writer);
+					}
+				}
+				break;
+			}
+		}
+	}
+
+	/**
+		New expression for a decoded WXF node
+	*/
+	Node* ReadWxf(wlr::WxfView view)
+	{
+		std::vector<Node*> children;
+		Node* head = nullptr;
+
+		switch(view.Kind())
+		{
+			case wlr::WxfKind::Integer:
+				return NewInteger(view.Integer());
+			case wlr::WxfKind::Real:
+				return NewReal(view.Real());
+			case wlr::WxfKind::String:
+				return NewString(view.Text());
+			case wlr::WxfKind::Symbol:
+				head = SymbolNode(view.Text());
+				Retain(head);
+				return head;
+			case wlr::WxfKind::Binary:
+				return NewBytes(view.Text());
+			case wlr::WxfKind::PackedArray:
+				if(view.Rank() == 1 && view.ArrayType() <= wlr::WxfArrayType::Integer64)
+				{
+					Node* node = new Node(Kind::PackedInteger);
+					node->integers.resize(view.Length());
+					view.CopyArrayData(node->integers.data());
+					return node;
+				}
+
+				if(view.Rank() == 1 && view.ArrayType() == wlr::WxfArrayType::Real64)
+				{
+					Node* node = new Node(Kind::PackedReal);
+					node->reals.resize(view.Length());
+					view.CopyArrayData(node->reals.data());
+					return node;
+				}
+				[[fallthrough]];
+			case wlr::WxfKind::NumericArray:
+			{
+				Node* node = new Node(Kind::NumericArray);
+				node->numericArray.type = wlr::detail::NumericArrayTypeOf(view.ArrayType());
+				node->numericArray.dimensions.assign(view.Dimensions(), view.Dimensions() + view.Rank());
+				node->numericArray.length = static_cast<mint>(view.Length());
+				node->numericArray.data.assign(view.ArrayBytes().begin(), view.ArrayBytes().end());
+				return node;
+			}
+			case wlr::WxfKind::Function:
+				head = ReadWxf(view.Head());
+				break;
+			case wlr::WxfKind::Association:
+				head = SymbolNode("Association");
+				Retain(head);
+				break;
+			case wlr::WxfKind::Rule:
+			case wlr::WxfKind::RuleDelayed:
+				head = SymbolNode(view.Kind() == wlr::WxfKind::Rule ? "Rule" : "RuleDelayed");
+				Retain(head);
+				break;
+			default:
+				head = SymbolNode("$Failed");
+				Retain(head);
+				return head;
+		}
+
+		for(wlr::WxfView part : view)
+		{
+			children.push_back(ReadWxf(part));
+		}
+
+		Node* node = NewNormal(head, children);
+
+		Release(head);
+
+		for(Node* child : children)
+		{
+			Release(child);
+		}
+
+		return node;
+	}
+
+	Node* Arithmetic(Node* node, bool plus)
+	{
+		bool real = false;
+		mint integer = plus ? 0 : 1;
+		mreal value = plus ? 0.0 : 1.0;
+
+		for(Node* child : node->children)
+		{
+			if(child->kind == Kind::Integer)
+			{
+				integer = plus ? integer + child->integer : integer * child->integer;
+				value = plus ? value + static_cast<mreal>(child->integer) : value * static_cast<mreal>(child->integer);
+			}
+			else if(child->kind == Kind::Real)
+			{
+				real = true;
+				value = plus ? value + child->real : value * child->real;
+			}
+			else
+			{
+				Retain(node);
+				return node;
+			}
+		}
+
+		return real ? NewReal(value) : NewInteger(integer);
+	}
+
+	/* Helpers in Native/wlr */
+
+	/**
+		The helper whose Function source is text, recognized by a call that only that helper makes
+		@remarks A helper's source can change without the fake noticing; the benchmarks that use the helper then fail
+	   their checks instead of measuring a path that does nothing.
+	*/
+	Helper HelperOf(std::string_view text)
+	{
+		if(text.compare(0, 9, "Function[") != 0)
+		{
+			return Helper::None;
+		}
+
+		if(text.find("Cases[expression, _String") != std::string_view::npos)
+		{
+			return Helper::StringArena;
+		}
+
+		if(text.find("NumericArray[expression, type]") != std::string_view::npos)
+		{
+			return Helper::Pack;
+		}
+
+		if(text.find("Boole[Not[StringQ[#]]]") != std::string_view::npos)
+		{
+			return Helper::Batch;
+		}
+
+		if(text.find("ToTabular[") != std::string_view::npos)
+		{
+			return Helper::ToTabular;
+		}
+
+		if(text.find("ColumnKeys[") != std::string_view::npos)
+		{
+			return Helper::FromTabular;
+		}
+
+		return Helper::None;
+	}
+
+	bool HasHead(const Node* node, std::string_view name)
+	{
+		return node->kind == Kind::Normal && IsSymbol(node->head, name);
+	}
+
+	Node* NewPackedIntegers(std::vector<mint> values)
+	{
+		Node* node = new Node(Kind::PackedInteger);
+		node->integers = std::move(values);
+		return node;
+	}
+
+	/**
+		Element index of a rank-1 NumericArray of integers or reals as a new Integer or Real, or nullptr
+	*/
+	Node* NumericArrayElement(const st_MNumericArray& array, std::size_t index)
+	{
+		const unsigned char* data = array.data.data();
+
+		switch(array.type)
+		{
+			case MNumericArray_Type_Bit8:
+				return NewInteger(reinterpret_cast<const std::int8_t*>(data)[index]);
+			case MNumericArray_Type_UBit8:
+				return NewInteger(data[index]);
+			case MNumericArray_Type_Bit16:
+				return NewInteger(reinterpret_cast<const std::int16_t*>(data)[index]);
+			case MNumericArray_Type_UBit16:
+				return NewInteger(reinterpret_cast<const std::uint16_t*>(data)[index]);
+			case MNumericArray_Type_Bit32:
+				return NewInteger(reinterpret_cast<const std::int32_t*>(data)[index]);
+			case MNumericArray_Type_UBit32:
+				return NewInteger(reinterpret_cast<const std::uint32_t*>(data)[index]);
+			case MNumericArray_Type_Bit64:
+				return NewInteger(reinterpret_cast<const std::int64_t*>(data)[index]);
+			case MNumericArray_Type_Real32:
+				return NewReal(reinterpret_cast<const float*>(data)[index]);
+			case MNumericArray_Type_Real64:
+				return NewReal(reinterpret_cast<const double*>(data)[index]);
+			default:
+				return nullptr;
+		}
+	}
+
+	/**
+		ToTabularFunction: {{name, values, invalidPositions}, ...} becomes Tabular[<|name -> {element, ...}, ...|>]
+		@remarks The fake's Tabular is that one Association of lists, with Missing["NotAvailable"] for invalid rows.
+	*/
+	Node* ToTabular(const Node* columns)
+	{
+		if(!HasHead(columns, "List"))
+		{
+			return nullptr;
+		}
+
+		std::vector<Node*> rules;
+
+		for(const Node* column : columns->children)
+		{
+			if(!HasHead(column, "List") || column->children.size() != 3 || column->children[0]->kind != Kind::String)
+			{
+				break;
+			}
+
+			const Node* values = column->children[1];
+			const Node* invalid = column->children[2];
+			std::vector<Node*> elements;
+
+			if(values->kind == Kind::NumericArray && values->numericArray.dimensions.size() == 1)
+			{
+				for(std::size_t index = 0; index < static_cast<std::size_t>(values->numericArray.length); ++index)
+				{
+					elements.push_back(NumericArrayElement(values->numericArray, index));
+				}
+			}
+			else if(HasHead(values, "List"))
+			{
+				for(Node* element : values->children)
+				{
+					Retain(element);
+					elements.push_back(element);
+				}
+			}
+
+			const bool valid = std::none_of(elements.begin(), elements.end(), [](Node* e) { return e == nullptr; }) &&
+							   (invalid->kind == Kind::PackedInteger || HasHead(invalid, "List"));
+
+			if(valid)
+			{
+				for(std::size_t index = 0; index < ElementCount(invalid); ++index)
+				{
+					Node* position = Element(invalid, index);
+					const mint row = position->kind == Kind::Integer ? position->integer : 0;
+
+					Release(position);
+
+					if(row >= 1 && row <= static_cast<mint>(elements.size()))
+					{
+						Node* notAvailable = NewString("NotAvailable");
+
+						Release(elements[static_cast<std::size_t>(row - 1)]);
+						elements[static_cast<std::size_t>(row - 1)] = NewNormal(SymbolNode("Missing"), {notAvailable});
+						Release(notAvailable);
+					}
+				}
+
+				Node* list = NewNormal(SymbolNode("List"), elements);
+				rules.push_back(NewNormal(SymbolNode("Rule"), {column->children[0], list}));
+				Release(list);
+			}
+
+			for(Node* element : elements)
+			{
+				Release(element);
+			}
+
+			if(!valid)
+			{
+				break;
+			}
+		}
+
+		Node* result = nullptr;
+
+		if(rules.size() == columns->children.size())
+		{
+			Node* association = NewNormal(SymbolNode("Association"), rules);
+			result = NewNormal(SymbolNode("Tabular"), {association});
+			Release(association);
+		}
+
+		for(Node* rule : rules)
+		{
+			Release(rule);
+		}
+
+		return result;
+	}
+
+	/**
+		FromTabularFunction on the fake's Tabular: {{name, kind, values, invalidPositions}, ...}
+	*/
+	Node* FromTabular(const Node* tabular)
+	{
+		if(!HasHead(tabular, "Tabular") || tabular->children.size() != 1 ||
+		   !HasHead(tabular->children[0], "Association"))
+		{
+			return nullptr;
+		}
+
+		std::vector<Node*> columns;
+
+		for(const Node* rule : tabular->children[0]->children)
+		{
+			const Node* values = rule->children[1];
+
+			std::vector<mint> invalid;
+			bool integers = true;
+			bool reals = true;
+
+			for(std::size_t index = 0; index < values->children.size(); ++index)
+			{
+				const Node* element = values->children[index];
+
+				if(HasHead(element, "Missing"))
+				{
+					invalid.push_back(static_cast<mint>(index) + 1);
+				}
+				else
+				{
+					integers = integers && element->kind == Kind::Integer;
+					reals = reals && element->kind == Kind::Real;
+				}
+			}
+
+			const mint kind = integers ? 0 : reals ? 1 : 2;
+			Node* data = nullptr;
+
+			if(kind == 2)
+			{
+				std::string text;
+				std::vector<mint> offsets(1, 0);
+
+				for(const Node* element : values->children)
+				{
+					if(element->kind == Kind::String)
+					{
+						text += element->text;
+					}
+					else if(!HasHead(element, "Missing"))
+					{
+						Print(element, true, text);
+					}
+
+					offsets.push_back(static_cast<mint>(text.size()));
+				}
+
+				Node* joined = NewString(text);
+				Node* packedOffsets = NewPackedIntegers(std::move(offsets));
+				data = NewNormal(SymbolNode("List"), {joined, packedOffsets});
+				Release(joined);
+				Release(packedOffsets);
+			}
+			else if(kind == 0)
+			{
+				data = NewPackedIntegers(std::vector<mint>(values->children.size()));
+
+				for(std::size_t index = 0; index < values->children.size(); ++index)
+				{
+					const Node* element = values->children[index];
+					data->integers[index] = element->kind == Kind::Integer ? element->integer : 0;
+				}
+			}
+			else
+			{
+				data = new Node(Kind::PackedReal);
+				data->reals.resize(values->children.size());
+
+				for(std::size_t index = 0; index < values->children.size(); ++index)
+				{
+					const Node* element = values->children[index];
+					data->reals[index] = element->kind == Kind::Real ? element->real : 0.0;
+				}
+			}
+
+			// Developer`ToPackedArray leaves an empty list unpacked
+			Node* positions =
+				invalid.empty() ? NewNormal(SymbolNode("List"), {}) : NewPackedIntegers(std::move(invalid));
+			Node* kindNode = NewInteger(kind);
+
+			columns.push_back(NewNormal(SymbolNode("List"), {rule->children[0], kindNode, data, positions}));
+
+			Release(kindNode);
+			Release(data);
+			Release(positions);
+		}
+
+		Node* result = NewNormal(SymbolNode("List"), columns);
+
+		for(Node* column : columns)
+		{
+			Release(column);
+		}
+
+		return result;
+	}
+
+	void CollectStrings(const Node* node, std::vector<const Node*>& strings)
+	{
+		if(node->kind == Kind::String)
+		{
+			strings.push_back(node);
+		}
+		else if(node->kind == Kind::Normal)
+		{
+			for(const Node* child : node->children)
+			{
+				CollectStrings(child, strings);
+			}
+		}
+	}
+
+	/**
+		StringArenaFunction: {joined strings, packed offsets} for the strings of expression, heads excluded, in order
+	*/
+	Node* StringArena(const Node* expression)
+	{
+		std::vector<const Node*> strings;
+
+		CollectStrings(expression, strings);
+
+		std::string text;
+		std::vector<mint> offsets(1, 0);
+
+		for(const Node* string : strings)
+		{
+			text += string->text;
+			offsets.push_back(static_cast<mint>(text.size()));
+		}
+
+		Node* joined = NewString(text);
+		Node* packedOffsets = NewPackedIntegers(std::move(offsets));
+		Node* result = NewNormal(SymbolNode("List"), {joined, packedOffsets});
+
+		Release(joined);
+		Release(packedOffsets);
+
+		return result;
+	}
+
+	/**
+		Dimensions and elements, in row-major order, of a rectangular array of machine numbers
+	*/
+	struct ArrayContents
+	{
+		std::vector<mint> dimensions;
+		bool complete = false;
+		bool integers = true;
+		std::vector<mint> integerValues;
+		std::vector<mreal> realValues;
+	};
+
+	/**
+		Record that the array has a level of length elements at depth
+		@remarks Returns false if that breaks the rectangular shape.
+	*/
+	bool AddLevel(ArrayContents& contents, std::size_t depth, std::size_t length)
+	{
+		if(depth < contents.dimensions.size())
+		{
+			return contents.dimensions[depth] == static_cast<mint>(length);
+		}
+
+		if(contents.complete)
+		{
+			return false;
+		}
+
+		contents.dimensions.push_back(static_cast<mint>(length));
+
+		return true;
+	}
+
+	bool AddNumber(ArrayContents& contents, std::size_t depth, mint integer, mreal real, bool isInteger)
+	{
+		if(depth != contents.dimensions.size() || depth == 0)
+		{
+			return false;
+		}
+
+		contents.complete = true;
+		contents.integers = contents.integers && isInteger;
+		contents.integerValues.push_back(integer);
+		contents.realValues.push_back(isInteger ? static_cast<mreal>(integer) : real);
+
+		return true;
+	}
+
+	/**
+		Add the numbers of node, a number, a packed vector or a List, at depth
+	*/
+	bool CollectArray(const Node* node, std::size_t depth, ArrayContents& contents)
+	{
+		switch(node->kind)
+		{
+			case Kind::Integer:
+				return AddNumber(contents, depth, node->integer, 0.0, true);
+			case Kind::Real:
+				return AddNumber(contents, depth, 0, node->real, false);
+			case Kind::PackedInteger:
+			case Kind::PackedReal:
+			{
+				const bool integers = node->kind == Kind::PackedInteger;
+				const std::size_t length = integers ? node->integers.size() : node->reals.size();
+
+				if(!AddLevel(contents, depth, length))
+				{
+					return false;
+				}
+
+				for(std::size_t index = 0; index < length; ++index)
+				{
+					if(!(integers ? AddNumber(contents, depth + 1, node->integers[index], 0.0, true)
+								  : AddNumber(contents, depth + 1, 0, node->reals[index], false)))
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+			case Kind::Normal:
+				if(!IsSymbol(node->head, "List") || !AddLevel(contents, depth, node->children.size()))
+				{
+					return false;
+				}
+
+				for(const Node* child : node->children)
+				{
+					if(!CollectArray(child, depth + 1, contents))
+					{
+						return false;
+					}
+				}
+
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	/**
+		PackFunction: NumericArray[expression, type], or $Failed if expression is not a rectangular array of machine
+		numbers that fit type
+	*/
+	Node* Pack(const Node* expression, const Node* typeName)
+	{
+		numericarray_data_t type = MNumericArray_Type_Undef;
+
+		for(int candidate = MNumericArray_Type_Bit8; candidate <= MNumericArray_Type_Complex_Real16; ++candidate)
+		{
+			const char* name = wlr::detail::NumericArrayTypeName(static_cast<numericarray_data_t>(candidate));
+
+			if(typeName->kind == Kind::String && name != nullptr && typeName->text == name)
+			{
+				type = static_cast<numericarray_data_t>(candidate);
+			}
+		}
+
+		ArrayContents contents;
+
+		Node* failed = SymbolNode("$Failed");
+		Retain(failed);
+
+		if(type == MNumericArray_Type_Undef || !CollectArray(expression, 0, contents))
+		{
+			return failed;
+		}
+
+		Node* node = new Node(Kind::NumericArray);
+		node->numericArray.type = type;
+		node->numericArray.dimensions = contents.dimensions;
+		node->numericArray.length = static_cast<mint>(contents.realValues.size());
+		node->numericArray.data.resize(contents.realValues.size() * wlr::NumericArrayElementSize(type));
+		bytesInUse += static_cast<std::int64_t>(node->numericArray.data.size());
+
+		const errcode_t error =
+			contents.integers
+				? wlr::ConvertElements(contents.integerValues.data(), wlr::NumericArrayType<mint>,
+									   node->numericArray.data.data(), type, node->numericArray.length,
+									   MNumericArray_Convert_Check, 0.0)
+				: wlr::ConvertElements(contents.realValues.data(), MNumericArray_Type_Real64,
+									   node->numericArray.data.data(), type, node->numericArray.length,
+									   MNumericArray_Convert_Check, 0.0);
+
+		if(error != LIBRARY_NO_ERROR)
+		{
+			Release(node);
+			return failed;
+		}
+
+		Release(failed);
+
+		return node;
+	}
+
+	/**
+		BatchFunction of wlr/BatchingEvaluator.h: {results with every non-string replaced by "", packed 1 for every
+		non-string and 0 for every string}
+	*/
+	Node* Batch(const Node* results)
+	{
+		if(!HasHead(results, "List"))
+		{
+			return nullptr;
+		}
+
+		std::vector<Node*> outputs;
+		std::vector<mint> failed;
+
+		for(Node* result : results->children)
+		{
+			if(result->kind == Kind::String)
+			{
+				Retain(result);
+				outputs.push_back(result);
+			}
+			else
+			{
+				outputs.push_back(NewString(""));
+			}
+
+			failed.push_back(result->kind == Kind::String ? 0 : 1);
+		}
+
+		Node* outputList = NewNormal(SymbolNode("List"), outputs);
+		Node* failedList = NewPackedIntegers(std::move(failed));
+		Node* result = NewNormal(SymbolNode("List"), {outputList, failedList});
+
+		for(Node* output : outputs)
+		{
+			Release(output);
+		}
+
+		Release(outputList);
+		Release(failedList);
+
+		return result;
+	}
+
+	Node* EvaluateHelper(Helper helper, const Node* call)
+	{
+		const std::vector<Node*>& arguments = call->children;
+
+		switch(helper)
+		{
+			case Helper::StringArena:
+				return arguments.size() == 1 ? StringArena(arguments[0]) : nullptr;
+			case Helper::Pack:
+				return arguments.size() == 2 ? Pack(arguments[0], arguments[1]) : nullptr;
+			case Helper::Batch:
+				return arguments.size() == 1 ? Batch(arguments[0]) : nullptr;
+			case Helper::ToTabular:
+				return arguments.size() == 1 ? ToTabular(arguments[0]) : nullptr;
+			case Helper::FromTabular:
+				return arguments.size() == 1 ? FromTabular(arguments[0]) : nullptr;
+			default:
+				return nullptr;
+		}
+	}
+
+	/**
+		Normal of a NumericArray of mint or Real64 elements from level on: a packed vector at the last level, a List of
+		the next level above it
+	*/
+	Node* NormalLevel(const st_MNumericArray& array, std::size_t level, std::size_t& offset)
+	{
+		const std::size_t length = static_cast<std::size_t>(array.dimensions[level]);
+
+		if(level + 1 < array.dimensions.size())
+		{
+			std::vector<Node*> rows;
+
+			for(std::size_t index = 0; index < length; ++index)
+			{
+				rows.push_back(NormalLevel(array, level + 1, offset));
+			}
+
+			Node* result = NewNormal(SymbolNode("List"), rows);
+
+			for(Node* row : rows)
+			{
+				Release(row);
+			}
+
+			return result;
+		}
+
+		Node* row = nullptr;
+
+		if(array.type == wlr::NumericArrayType<mint>)
+		{
+			const mint* data = reinterpret_cast<const mint*>(array.data.data()) + offset;
+
+			row = new Node(Kind::PackedInteger);
+			row->integers.assign(data, data + length);
+		}
+		else
+		{
+			const mreal* data = reinterpret_cast<const mreal*>(array.data.data()) + offset;
+
+			row = new Node(Kind::PackedReal);
+			row->reals.assign(data, data + length);
+		}
+
+		offset += length;
+
+		return row;
+	}
+
+	/**
+		Developer`FromPackedArray: packed vectors, at any depth of Lists, become Lists of Integer or Real elements
+	*/
+	Node* Unpacked(Node* node)
+	{
+		std::vector<Node*> elements;
+
+		if(node->kind == Kind::PackedInteger)
+		{
+			for(mint value : node->integers)
+			{
+				elements.push_back(NewInteger(value));
+			}
+		}
+		else if(node->kind == Kind::PackedReal)
+		{
+			for(mreal value : node->reals)
+			{
+				elements.push_back(NewReal(value));
+			}
+		}
+		else if(HasHead(node, "List"))
+		{
+			for(Node* child : node->children)
+			{
+				elements.push_back(Unpacked(child));
+			}
+		}
+		else
+		{
+			Retain(node);
+			return node;
+		}
+
+		Node* result = NewNormal(SymbolNode("List"), elements);
+
+		for(Node* element : elements)
+		{
+			Release(element);
+		}
+
+		return result;
+	}
+
+	Node* Evaluate(Node* node)
+	{
+		if(node->kind != Kind::Normal)
+		{
+			Retain(node);
+			return node;
+		}
+
+		if(IsSymbol(node->head, "Unevaluated") && node->children.size() == 1)
+		{
+			Retain(node->children[0]);
+			return node->children[0];
+		}
+
+		std::vector<Node*> children;
+
+		children.reserve(node->children.size());
+
+		for(Node* child : node->children)
+		{
+			children.push_back(Evaluate(child));
+		}
+
+		Node* evaluated = NewNormal(node->head, children);
+
+		for(Node* child : children)
+		{
+			Release(child);
+		}
+
+		Node* result = nullptr;
+
+		if(evaluated->head->helper != Helper::None)
+		{
+			result = EvaluateHelper(evaluated->head->helper, evaluated);
+		}
+		else if(IsSymbol(evaluated->head, "Plus") || IsSymbol(evaluated->head, "Times"))
+		{
+			result = Arithmetic(evaluated, IsSymbol(evaluated->head, "Plus"));
+		}
+		else if(IsSymbol(evaluated->head, "Total") && evaluated->children.size() == 1 &&
+				(evaluated->children[0]->kind == Kind::PackedInteger || evaluated->children[0]->kind == Kind::PackedReal))
+		{
+			const Node* vector = evaluated->children[0];
+
+			result = vector->kind == Kind::PackedInteger
+						 ? NewInteger(std::accumulate(vector->integers.begin(), vector->integers.end(), mint(0)))
+						 : NewReal(std::accumulate(vector->reals.begin(), vector->reals.end(), 0.0));
+		}
+		else if(IsSymbol(evaluated->head, "ToString") && !evaluated->children.empty())
+		{
+			std::string text;
+			const bool inputForm = evaluated->children.size() > 1 && IsSymbol(evaluated->children[1], "InputForm");
+			Print(evaluated->children[0], inputForm, text);
+			result = NewString(text);
+		}
+		else if(IsSymbol(evaluated->head, "Normal") && evaluated->children.size() == 1 &&
+				evaluated->children[0]->kind == Kind::NumericArray &&
+				(evaluated->children[0]->numericArray.type == wlr::NumericArrayType<mint> ||
+				 evaluated->children[0]->numericArray.type == MNumericArray_Type_Real64))
+		{
+			std::size_t offset = 0;
+
+			result = NormalLevel(evaluated->children[0]->numericArray, 0, offset);
+		}
+		else if(IsSymbol(evaluated->head, "Normal") && evaluated->children.size() == 1 &&
+				(evaluated->children[0]->kind == Kind::PackedInteger || evaluated->children[0]->kind == Kind::PackedReal))
+		{
+			result = evaluated->children[0];
+			Retain(result);
+		}
+		else if(evaluated->head->kind == Kind::Symbol && evaluated->head->text == "Developer`FromPackedArray" &&
+				evaluated->children.size() == 1)
+		{
+			result = Unpacked(evaluated->children[0]);
+		}
+		else if(IsSymbol(evaluated->head, "Association") && evaluated->children.size() == 1 &&
+				HasHead(evaluated->children[0], "List"))
+		{
+			result = NewNormal(evaluated->head, evaluated->children[0]->children);
+		}
+		else if(IsSymbol(evaluated->head, "Print"))
+		{
+			std::string text;
+
+			for(const Node* child : evaluated->children)
+			{
+				Print(child, false, text);
+			}
+
+			text += '\n';
+
+			for(const auto& handler : stdoutHandlers)
+			{
+				handler.first(text.data(), static_cast<mint>(text.size()), handler.second);
+			}
+
+			result = SymbolNode("Null");
+			Retain(result);
+		}
+		else if(IsSymbol(evaluated->head, "Message") && !evaluated->children.empty() &&
+				evaluated->children[0]->kind == Kind::Normal && IsSymbol(evaluated->children[0]->head, "MessageName") &&
+				evaluated->children[0]->children.size() == 2)
+		{
+			// Message[MessageName[symbol, "tag"], arguments...] passes MessageName[symbol, "tag"], Hold[Message[...]] and
+			// the arguments in InputForm as the message text, the way the runtime passes the name, the held message and
+			// the formatted text
+			std::string text;
+
+			for(std::size_t index = 1; index < evaluated->children.size(); ++index)
+			{
+				Print(evaluated->children[index], true, text);
+			}
+
+			Node* heldMessage = NewNormal(SymbolNode("Hold"), {evaluated});
+			Node* textNode = NewString(text);
+
+			for(const auto& handler : messageHandlers)
+			{
+				handler.first(evaluated->children[0], heldMessage, textNode, handler.second);
+			}
+
+			Release(heldMessage);
+			Release(textNode);
+
+			result = SymbolNode("Null");
+			Retain(result);
+		}
+		else if(IsSymbol(evaluated->head, "BinarySerialize") && !evaluated->children.empty())
+		{
+			wlr::WxfWriter writer;
+			WriteWxf(evaluated->children[0], writer);
+			result = NewBytes(writer.Bytes());
+		}
+		else if(IsSymbol(evaluated->head, "BinaryDeserialize") && evaluated->children.size() == 1 &&
+				evaluated->children[0]->kind == Kind::NumericArray)
+		{
+			const std::vector<unsigned char>& bytes = evaluated->children[0]->numericArray.data;
+
+			wlr::WxfDocument document;
+
+			if(document.Parse(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size())) == WLR_SUCCESS)
+			{
+				result = ReadWxf(document.Root());
+			}
+		}
+		else if((IsSymbol(evaluated->head, "ByteArray") ||
+				 (IsSymbol(evaluated->head, "NumericArray") && evaluated->children.size() == 2)) &&
+				!evaluated->children.empty() && evaluated->children[0]->kind == Kind::NumericArray &&
+				evaluated->children[0]->numericArray.type == MNumericArray_Type_UBit8)
+		{
+			// ByteArray and NumericArray[..., "UnsignedInteger8"] of a byte array are the byte array
+			result = evaluated->children[0];
+			Retain(result);
+		}
+
+		if(result == nullptr)
+		{
+			return evaluated;
+		}
+
+		Release(evaluated);
+
+		return result;
+	}
+
+	/* Buffers returned to the caller */
+
+	template <typename T>
+	T* CopyToBuffer(const T* data, std::size_t count)
+	{
+		T* buffer = static_cast<T*>(std::malloc(std::max<std::size_t>(1, count * sizeof(T))));
+		std::memcpy(buffer, data, count * sizeof(T));
+		return buffer;
+	}
+
+	struct ExpressionBag
+	{
+		std::vector<Node*> children;
+	};
+
+	wlr_expr FromVaList(Node* head, mint count, va_list arguments)
+	{
+		std::vector<Node*> children;
+
+		children.reserve(static_cast<std::size_t>(count));
+
+		for(mint index = 0; index < count; ++index)
+		{
+			children.push_back(AsNode(va_arg(arguments, wlr_expr)));
+		}
+
+		return Pooled(NewNormal(head, children));
+	}
+
+	mint FlattenedLength(const std::vector<mint>& dimensions)
+	{
+		mint length = 1;
+
+		for(mint dimension : dimensions)
+		{
+			length *= dimension;
+		}
+
+		return length;
+	}
+}
+
+/* Runtime */
+
+wlr_err_t wlr_sdk_StartRuntime(wlr_application_t, wlr_version_t, wlr_license_t, const char*, const wlr_runtime_conf*)
+{
+	if(const char* value = std::getenv("WLR_FAKE_CALL_LATENCY_NS"))
+	{
+		callLatency = std::chrono::nanoseconds(std::atoll(value));
+	}
+
+	if(const char* value = std::getenv("WLR_FAKE_EVAL_LATENCY_NS"))
+	{
+		evalLatency = std::chrono::nanoseconds(std::atoll(value));
+	}
+
+	return WLR_SUCCESS;
+}
+
+wlr_err_t wlr_sdk_RegisterSignatureFile(wlr_application_t, const char*)
+{
+	return WLR_SUCCESS;
+}
+
+mbool wlr_sdk_CodeSignatureModuleDefined(void)
+{
+	return 0;
+}
+
+void wlr_InitializeRuntimeConfiguration(wlr_runtime_conf* configuration)
+{
+	configuration->argumentCount = 0;
+	configuration->arguments = nullptr;
+	configuration->containmentSetting = WLR_UNCONTAINED;
+}
+
+wlr_err_t wlr_StartRuntime(wlr_version_t version, wlr_license_t licenseType, const char* layoutDirectory,
+						   const wlr_runtime_conf* configuration)
+{
+	return wlr_sdk_StartRuntime(WLR_EXECUTABLE, version, licenseType, layoutDirectory, configuration);
+}
+
+void wlr_CloseRuntime(void)
+{
+}
+
+mint wlr_MemoryInUse(void)
+{
+	Call();
+	return static_cast<mint>(bytesInUse);
+}
+
+/* Evaluation */
+
+wlr_expr wlr_Eval(wlr_expr expression)
+{
+	Call();
+	Spin(evalLatency);
+
+	if(abortRequested.load())
+	{
+		return SymbolNode("$Aborted");
+	}
+
+	return Pooled(Evaluate(AsNode(expression)));
+}
+
+wlr_expr wlr_EvalData(wlr_expr expression)
+{
+	return wlr_Eval(expression);
+}
+
+wlr_expr wlr_EvalString(wlr_expr inputString)
+{
+	return wlr_Eval(wlr_ParseExpression(inputString));
+}
+
+wlr_expr wlr_Get(const char* fileName)
+{
+	wlr_expr contents = wlr_Deserialize(fileName);
+
+	return wlr_ErrorQ(contents) ? contents : wlr_Eval(contents);
+}
+
+void wlr_Abort(void)
+{
+	abortRequested.store(true);
+}
+
+void wlr_ClearAbort(void)
+{
+	abortRequested.store(false);
+}
+
+wlr_err_t wlr_AddStdoutHandler(wlr_stdout_handler_t handlerFunction, const void* contextData)
+{
+	stdoutHandlers.push_back({handlerFunction, const_cast<void*>(contextData)});
+	return WLR_SUCCESS;
+}
+
+wlr_err_t wlr_AddMessageHandler(wlr_message_handler_t handlerFunction, const void* contextData)
+{
+	messageHandlers.push_back({handlerFunction, const_cast<void*>(contextData)});
+	return WLR_SUCCESS;
+}
+
+void wlr_RemoveStdoutHandler(wlr_stdout_handler_t handlerFunction)
+{
+	stdoutHandlers.erase(std::remove_if(stdoutHandlers.begin(), stdoutHandlers.end(),
+										[handlerFunction](const auto& handler) { return handler.first == handlerFunction; }),
+						 stdoutHandlers.end());
+}
+
+void wlr_RemoveMessageHandler(wlr_message_handler_t handlerFunction)
+{
+	messageHandlers.erase(std::remove_if(messageHandlers.begin(), messageHandlers.end(),
+										 [handlerFunction](const auto& handler) { return handler.first == handlerFunction; }),
+						  messageHandlers.end());
+}
+
+/* Pools and lifetimes */
+
+void wlr_CreateExpressionPool(void)
+{
+	Call();
+	pools.emplace_back();
+}
+
+void wlr_ReleaseExpressionPool(void)
+{
+	Call();
+
+	if(pools.size() > 1)
+	{
+		for(Node* node : pools.back())
+		{
+			Release(node);
+		}
+
+		pools.pop_back();
+	}
+}
+
+void wlr_ReleaseExpression(wlr_expr detachedExpression)
+{
+	Call();
+	Release(AsNode(detachedExpression));
+}
+
+void wlr_MoveExpressionToParentPool(wlr_expr expression)
+{
+	Call();
+
+	if(pools.size() > 1)
+	{
+		Retain(AsNode(expression));
+		pools[pools.size() - 2].push_back(AsNode(expression));
+	}
+}
+
+void wlr_DetachExpression(wlr_expr expression)
+{
+	Call();
+	Retain(AsNode(expression));
+}
+
+wlr_expr wlr_Clone(wlr_expr expression)
+{
+	Call();
+
+	const Node* source = AsNode(expression);
+
+	if(source->kind == Kind::Symbol || source->kind == Kind::Error)
+	{
+		return Borrowed(AsNode(expression));
+	}
+
+	Node* copy = new Node(source->kind);
+
+	copy->integer = source->integer;
+	copy->real = source->real;
+	copy->text = source->text;
+	copy->integers = source->integers;
+	copy->reals = source->reals;
+	copy->numericArray = source->numericArray;
+	copy->helper = source->helper;
+	copy->head = source->head;
+	copy->children = source->children;
+
+	Retain(copy->head);
+
+	for(Node* child : copy->children)
+	{
+		Retain(child);
+	}
+
+	return Pooled(copy);
+}
+
+void wlr_ReleaseAll(void)
+{
+	Call();
+
+	while(pools.size() > 1)
+	{
+		wlr_ReleaseExpressionPool();
+	}
+}
+
+void wlr_Release(void* data)
+{
+	Call();
+	std::free(data);
+}
+
+/* Errors */
+
+wlr_expr wlr_Error(wlr_err_t errorType)
+{
+	return Error(errorType);
+}
+
+mbool wlr_ErrorQ(wlr_expr expression)
+{
+	return AsNode(expression)->kind == Kind::Error;
+}
+
+wlr_err_t wlr_ErrorType(wlr_expr errorExpression)
+{
+	const Node* node = AsNode(errorExpression);
+	return node->kind == Kind::Error ? static_cast<wlr_err_t>(node->integer) : WLR_SUCCESS;
+}
+
+/* Atoms */
+
+wlr_expr wlr_Integer(mint value)
+{
+	Call();
+	return Pooled(NewInteger(value));
+}
+
+wlr_err_t wlr_IntegerData(wlr_expr machineIntegerExpression, mint* result)
+{
+	Call();
+
+	const Node* node = AsNode(machineIntegerExpression);
+
+	if(node->kind != Kind::Integer)
+	{
+		return WLR_UNEXPECTED_TYPE;
+	}
+
+	*result = node->integer;
+	return WLR_SUCCESS;
+}
+
+wlr_err_t wlr_IntegerConvert(wlr_expr numberExpression, mint* result)
+{
+	Call();
+
+	const Node* node = AsNode(numberExpression);
+
+	if(node->kind == Kind::Real)
+	{
+		*result = static_cast<mint>(node->real);
+		return WLR_SUCCESS;
+	}
+
+	return wlr_IntegerData(numberExpression, result);
+}
+
+wlr_expr wlr_Real(mreal value)
+{
+	Call();
+	return Pooled(NewReal(value));
+}
+
+wlr_err_t wlr_RealData(wlr_expr machineRealExpression, mreal* result)
+{
+	Call();
+
+	const Node* node = AsNode(machineRealExpression);
+
+	if(node->kind != Kind::Real)
+	{
+		return WLR_UNEXPECTED_TYPE;
+	}
+
+	*result = node->real;
+	return WLR_SUCCESS;
+}
+
+wlr_err_t wlr_RealConvert(wlr_expr numberExpression, mreal* result)
+{
+	Call();
+
+	const Node* node = AsNode(numberExpression);
+
+	if(node->kind == Kind::Integer)
+	{
+		*result = static_cast<mreal>(node->integer);
+		return WLR_SUCCESS;
+	}
+
+	return wlr_RealData(numberExpression, result);
+}
+
+wlr_expr wlr_Complex(wlr_expr realPart, wlr_expr imaginaryPart)
+{
+	Call();
+	return Pooled(NewNormal(SymbolNode("Complex"), {AsNode(realPart), AsNode(imaginaryPart)}));
+}
+
+wlr_expr wlr_String(const char* string)
+{
+	Call();
+	return Pooled(NewString(string));
+}
+
+wlr_expr wlr_StringFromData(const char* utf8Data, mint utf8DataLength)
+{
+	Call();
+	return Pooled(NewString(std::string_view(utf8Data, static_cast<std::size_t>(utf8DataLength))));
+}
+
+wlr_expr wlr_RawString(const char* string)
+{
+	return wlr_String(string);
+}
+
+wlr_expr wlr_RawStringFromData(const char* utf8Data, mint utf8DataLength)
+{
+	return wlr_StringFromData(utf8Data, utf8DataLength);
+}
+
+wlr_err_t wlr_StringData(wlr_expr expression, char** resultData, mint* resultLength)
+{
+	Call();
+
+	const Node* node = AsNode(expression);
+
+	if(node->kind != Kind::String)
+	{
+		return WLR_UNEXPECTED_TYPE;
+	}
+
+	*resultData = CopyToBuffer(node->text.c_str(), node->text.size() + 1);
+
+	if(resultLength != nullptr)
+	{
+		*resultLength = static_cast<mint>(node->text.size());
+	}
+
+	return WLR_SUCCESS;
+}
+
+wlr_expr wlr_Symbol(const char* symbolName)
+{
+	Call();
+	return SymbolNode(symbolName);
+}
+
+wlr_expr wlr_SystemSymbol(const char* baseSymbolName)
+{
+	Call();
+	return SymbolNode(std::string("System`") + baseSymbolName);
+}
+
+wlr_expr wlr_GlobalSymbol(const char* baseSymbolName)
+{
+	Call();
+	return SymbolNode(std::string("Global`") + baseSymbolName);
+}
+
+wlr_expr wlr_ContextSymbol(const char* symbolContext, const char* baseSymbolName)
+{
+	Call();
+	return SymbolNode(std::string(symbolContext) + baseSymbolName);
+}
+
+wlr_expr wlr_SymbolName(wlr_expr symbol)
+{
+	Call();
+
+	const Node* node = AsNode(symbol);
+
+	if(node->kind != Kind::Symbol)
+	{
+		return Error(WLR_UNEXPECTED_TYPE);
+	}
+
+	return Pooled(NewString(std::string_view(node->text).substr(node->text.rfind('`') + 1)));
+}
+
+/* Normal expressions */
+
+wlr_expr wlr_VariadicE(void* expressionHead, mint childElementNumber, ...)
+{
+	Call();
+
+	va_list arguments;
+	va_start(arguments, childElementNumber);
+	wlr_expr result = FromVaList(AsNode(expressionHead), childElementNumber, arguments);
+	va_end(arguments);
+
+	return result;
+}
+
+wlr_expr wlr_iVariadicE(wlr_expr expressionHead, mint childElementNumber, va_list childElements)
+{
+	Call();
+	return FromVaList(AsNode(expressionHead), childElementNumber, childElements);
+}
+
+wlr_expr wlr_VariadicList(mint childElementNumber, ...)
+{
+	Call();
+
+	va_list arguments;
+	va_start(arguments, childElementNumber);
+	wlr_expr result = FromVaList(SymbolNode("List"), childElementNumber, arguments);
+	va_end(arguments);
+
+	return result;
+}
+
+wlr_expr wlr_iVariadicList(mint childElementNumber, va_list childElements)
+{
+	Call();
+	return FromVaList(SymbolNode("List"), childElementNumber, childElements);
+}
+
+wlr_expr wlr_VariadicAssociation(mint keyValuePairNumber, ...)
+{
+	Call();
+
+	va_list arguments;
+	va_start(arguments, keyValuePairNumber);
+	wlr_expr result = FromVaList(SymbolNode("Association"), keyValuePairNumber, arguments);
+	va_end(arguments);
+
+	return result;
+}
+
+wlr_expr wlr_iVariadicAssociation(mint keyValuePairNumber, va_list keyValuePairs)
+{
+	Call();
+	return FromVaList(SymbolNode("Association"), keyValuePairNumber, keyValuePairs);
+}
+
+wlr_expr wlr_Rule(wlr_expr leftHandSide, wlr_expr rightHandSide)
+{
+	Call();
+	return Pooled(NewNormal(SymbolNode("Rule"), {AsNode(leftHandSide), AsNode(rightHandSide)}));
+}
+
+mbool wlr_RuleQ(wlr_expr expression)
+{
+	Call();
+	const Node* node = AsNode(expression);
+	return node->kind == Kind::Normal && IsSymbol(node->head, "Rule");
+}
+
+mbool wlr_ListQ(wlr_expr expression)
+{
+	Call();
+	const Node* node = AsNode(expression);
+	return node->kind == Kind::PackedInteger || node->kind == Kind::PackedReal ||
+		   (node->kind == Kind::Normal && IsSymbol(node->head, "List"));
+}
+
+mbool wlr_AssociationQ(wlr_expr expression)
+{
+	Call();
+	const Node* node = AsNode(expression);
+	return node->kind == Kind::Normal && IsSymbol(node->head, "Association") &&
+		   std::all_of(node->children.begin(), node->children.end(),
+					   [](const Node* child) { return HasHead(child, "Rule") && child->children.size() == 2; });
+}
+
+mbool wlr_TrueQ(wlr_expr expression)
+{
+	Call();
+	return IsSymbol(AsNode(expression), "True");
+}
+
+mbool wlr_SameQ(wlr_expr firstExpression, wlr_expr secondExpression)
+{
+	Call();
+	return Same(AsNode(firstExpression), AsNode(secondExpression));
+}
+
+mint wlr_Length(wlr_expr expression)
+{
+	Call();
+	return static_cast<mint>(ElementCount(AsNode(expression)));
+}
+
+wlr_expr wlr_Part(wlr_expr expression, mint index)
+{
+	Call();
+
+	const Node* node = AsNode(expression);
+
+	if(index == 0)
+	{
+		return wlr_Head(expression);
+	}
+
+	const mint length = static_cast<mint>(ElementCount(node));
+
+	if(index < 0)
+	{
+		index += length + 1;
+	}
+
+	if(index < 1 || index > length || node->kind == Kind::NumericArray)
+	{
+		return Error(WLR_OUT_OF_BOUNDS);
+	}
+
+	return Pooled(Element(node, static_cast<std::size_t>(index - 1)));
+}
+
+wlr_expr wlr_First(wlr_expr expression)
+{
+	return wlr_Part(expression, 1);
+}
+
+wlr_expr wlr_Last(wlr_expr expression)
+{
+	return wlr_Part(expression, -1);
+}
+
+wlr_expr wlr_Head(wlr_expr expression)
+{
+	Call();
+
+	const Node* node = AsNode(expression);
+
+	switch(node->kind)
+	{
+		case Kind::Integer:
+			return SymbolNode("Integer");
+		case Kind::Real:
+			return SymbolNode("Real");
+		case Kind::String:
+			return SymbolNode("String");
+		case Kind::Symbol:
+			return SymbolNode("Symbol");
+		case Kind::PackedInteger:
+		case Kind::PackedReal:
+			return SymbolNode("List");
+		case Kind::NumericArray:
+			return SymbolNode("NumericArray");
+		case Kind::Normal:
+			return Borrowed(node->head);
+		default:
+			return Error(WLR_UNEXPECTED_TYPE);
+	}
+}
+
+wlr_expr wlr_ReplacePart(wlr_expr expression, mint index, wlr_expr newPart)
+{
+	Call();
+
+	const Node* node = AsNode(expression);
+
+	if(node->kind != Kind::Normal || index < 0 || index > static_cast<mint>(node->children.size()))
+	{
+		return Error(WLR_OUT_OF_BOUNDS);
+	}
+
+	std::vector<Node*> children = node->children;
+
+	if(index == 0)
+	{
+		return Pooled(NewNormal(AsNode(newPart), children));
+	}
+
+	children[static_cast<std::size_t>(index - 1)] = AsNode(newPart);
+
+	return Pooled(NewNormal(node->head, children));
+}
+
+wlr_expr_t wlr_ExpressionType(wlr_expr expression)
+{
+	Call();
+
+	const Node* node = AsNode(expression);
+
+	switch(node->kind)
+	{
+		case Kind::Integer:
+		case Kind::Real:
+			return WLR_NUMBER;
+		case Kind::String:
+			return WLR_STRING;
+		case Kind::Symbol:
+			return WLR_SYMBOL;
+		case Kind::Error:
+			return WLR_ERROR;
+		case Kind::PackedInteger:
+		case Kind::PackedReal:
+			return WLR_PACKED_ARRAY;
+		case Kind::NumericArray:
+			return WLR_NUMERIC_ARRAY;
+		default:
+			return WLR_NORMAL;
+	}
+}
+
+/* Expression bags */
+
+wlr_exprbag wlr_ExpressionBag(void)
+{
+	Call();
+	return new ExpressionBag();
+}
+
+wlr_err_t wlr_AddExpression(wlr_exprbag expressionBag, wlr_expr expression)
+{
+	Call();
+	static_cast<ExpressionBag*>(expressionBag)->children.push_back(AsNode(expression));
+	return WLR_SUCCESS;
+}
+
+mint wlr_ExpressionBagLength(wlr_exprbag expressionBag)
+{
+	Call();
+	return static_cast<mint>(static_cast<ExpressionBag*>(expressionBag)->children.size());
+}
+
+wlr_expr wlr_ExpressionBagToExpression(wlr_exprbag expressionBag, wlr_expr expressionHead)
+{
+	Call();
+	return Pooled(NewNormal(AsNode(expressionHead), static_cast<ExpressionBag*>(expressionBag)->children));
+}
+
+void wlr_ReleaseExpressionBag(wlr_exprbag expressionBag)
+{
+	Call();
+	delete static_cast<ExpressionBag*>(expressionBag);
+}
+
+/* Packed arrays */
+
+wlr_expr wlr_ExpressionFromIntegerArray(mint arrayLength, const mint* array, wlr_expr)
+{
+	Call();
+
+	Node* node = new Node(Kind::PackedInteger);
+	node->integers.assign(array, array + arrayLength);
+	bytesInUse += arrayLength * static_cast<mint>(sizeof(mint));
+
+	return Pooled(node);
+}
+
+wlr_expr wlr_ExpressionFromRealArray(mint arrayLength, const mreal* array, wlr_expr)
+{
+	Call();
+
+	Node* node = new Node(Kind::PackedReal);
+	node->reals.assign(array, array + arrayLength);
+	bytesInUse += arrayLength * static_cast<mint>(sizeof(mreal));
+
+	return Pooled(node);
+}
+
+wlr_err_t wlr_IntegerArrayData(wlr_expr expression, mint* resultLength, mint** resultArray)
+{
+	Call();
+
+	const Node* node = AsNode(expression);
+
+	if(node->kind != Kind::PackedInteger)
+	{
+		return WLR_UNEXPECTED_TYPE;
+	}
+
+	*resultLength = static_cast<mint>(node->integers.size());
+	*resultArray = CopyToBuffer(node->integers.data(), node->integers.size());
+
+	return WLR_SUCCESS;
+}
+
+wlr_err_t wlr_RealArrayData(wlr_expr expression, mint* resultLength, mreal** resultArray)
+{
+	Call();
+
+	const Node* node = AsNode(expression);
+
+	if(node->kind != Kind::PackedReal)
+	{
+		return WLR_UNEXPECTED_TYPE;
+	}
+
+	*resultLength = static_cast<mint>(node->reals.size());
+	*resultArray = CopyToBuffer(node->reals.data(), node->reals.size());
+
+	return WLR_SUCCESS;
+}
+
+/* Numeric arrays */
+
+errcode_t wlr_MNumericArray_new(const numericarray_data_t type, const mint rank, const mint* dims, MNumericArray* res)
+{
+	Call();
+
+	const std::size_t elementSize = wlr::NumericArrayElementSize(type);
+
+	if(elementSize == 0 || rank < 1)
+	{
+		return LIBRARY_TYPE_ERROR;
+	}
+
+	MNumericArray array = new st_MNumericArray();
+
+	array->type = type;
+	array->dimensions.assign(dims, dims + rank);
+	array->length = FlattenedLength(array->dimensions);
+	array->data.resize(static_cast<std::size_t>(array->length) * elementSize);
+
+	*res = array;
+
+	return LIBRARY_NO_ERROR;
+}
+
+errcode_t wlr_MNumericArray_clone(const MNumericArray from, MNumericArray* to)
+{
+	Call();
+	*to = new st_MNumericArray(*from);
+	return LIBRARY_NO_ERROR;
+}
+
+void wlr_MNumericArray_free(MNumericArray narray)
+{
+	Call();
+	delete narray;
+}
+
+void wlr_MNumericArray_disown(MNumericArray)
+{
+}
+
+void wlr_MNumericArray_disownAll(MNumericArray)
+{
+}
+
+mint wlr_MNumericArray_shareCount(const MNumericArray)
+{
+	return 0;
+}
+
+numericarray_data_t wlr_MNumericArray_getType(const MNumericArray narray)
+{
+	Call();
+	return narray->type;
+}
+
+mint wlr_MNumericArray_getRank(const MNumericArray narray)
+{
+	Call();
+	return static_cast<mint>(narray->dimensions.size());
+}
+
+mint wlr_MNumericArray_getFlattenedLength(const MNumericArray narray)
+{
+	Call();
+	return narray->length;
+}
+
+mint* wlr_MNumericArray_getDimensions(const MNumericArray narray)
+{
+	Call();
+	return narray->dimensions.data();
+}
+
+void* wlr_MNumericArray_getData(const MNumericArray narray)
+{
+	Call();
+	return narray->data.data();
+}
+
+errcode_t wlr_MNumericArray_convertType(MNumericArray* outP, const MNumericArray narray,
+										const numericarray_data_t result_type, const numericarray_convert_method_t method,
+										const mreal tolerance)
+{
+	Call();
+
+	MNumericArray result = nullptr;
+
+	errcode_t error = wlr_MNumericArray_new(result_type, static_cast<mint>(narray->dimensions.size()),
+											narray->dimensions.data(), &result);
+
+	if(error == LIBRARY_NO_ERROR)
+	{
+		error = wlr::ConvertElements(narray->data.data(), narray->type, result->data.data(), result_type, narray->length,
+									 method, tolerance);
+	}
+
+	if(error != LIBRARY_NO_ERROR)
+	{
+		delete result;
+		return error;
+	}
+
+	*outP = result;
+
+	return LIBRARY_NO_ERROR;
+}
+
+wlr_expr wlr_ExpressionFromNumericArray(const MNumericArray numericArray, wlr_expr)
+{
+	Call();
+
+	Node* node = new Node(Kind::NumericArray);
+	node->numericArray = *numericArray;
+	bytesInUse += static_cast<std::int64_t>(numericArray->data.size());
+
+	return Pooled(node);
+}
+
+wlr_err_t wlr_NumericArrayData(wlr_expr expression, MNumericArray* result)
+{
+	Call();
+
+	Node* node = AsNode(expression);
+
+	if(node->kind != Kind::NumericArray)
+	{
+		return WLR_UNEXPECTED_TYPE;
+	}
+
+	*result = &node->numericArray;
+
+	return WLR_SUCCESS;
+}
+
+/* Parsing and serialization */
+
+wlr_expr wlr_ParseExpression(wlr_expr inputString)
+{
+	Call();
+
+	const Node* input = AsNode(inputString);
+
+	if(input->kind != Kind::String)
+	{
+		return Error(WLR_UNEXPECTED_TYPE);
+	}
+
+	// The bodies of the helpers are beyond the parser; they become a Function that EvaluateHelper runs natively
+	if(const Helper helper = HelperOf(input->text); helper != Helper::None)
+	{
+		Node* function = NewNormal(SymbolNode("Function"), {});
+		function->helper = helper;
+
+		return Pooled(function);
+	}
+
+	Node* parsed = Parser(input->text).ParseAll();
+
+	return parsed == nullptr ? Error(WLR_MALFORMED) : Pooled(parsed);
+}
+
+wlr_err_t wlr_Serialize(const char* fileName, wlr_expr expression)
+{
+	Call();
+
+	std::string text;
+	Print(AsNode(expression), true, text);
+
+	std::FILE* file = std::fopen(fileName, "wb");
+
+	if(file == nullptr)
+	{
+		return WLR_MISCELLANEOUS_ERROR;
+	}
+
+	const bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+
+	return std::fclose(file) == 0 && written ? WLR_SUCCESS : WLR_MISCELLANEOUS_ERROR;
+}
+
+wlr_expr wlr_Deserialize(const char* fileName)
+{
+	Call();
+
+	std::FILE* file = std::fopen(fileName, "rb");
+
+	if(file == nullptr)
+	{
+		return Error(WLR_MISCELLANEOUS_ERROR);
+	}
+
+	std::string text;
+	char buffer[65536];
+	std::size_t count;
+
+	while((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		text.append(buffer, count);
+	}
+
+	std::fclose(file);
+
+	Node* parsed = Parser(text).ParseAll();
+
+	return parsed == nullptr ? Error(WLR_MALFORMED) : Pooled(parsed);
+}
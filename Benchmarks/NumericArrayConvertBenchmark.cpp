@@ -0,0 +1,109 @@
+/*
+	Compare wlr_MNumericArray_convertType with the host-side wlr::ConvertType on 16 million elements
+
+	Every conversion must succeed on both sides with the same elements, or the benchmark exits with code 1. The
+	random inputs cover only the common case; NumericArrayConvertCheck checks every pair of types and methods, and
+	NaN, infinities, out-of-range values and .5 ties, against hard-coded results.
+*/
+
+#include <cstring>
+#include <random>
+
+#include "Benchmark.h"
+#include "wlr/NumericArrayConvert.h"
+
+namespace
+{
+	/**
+		Time the conversion both ways; false unless both succeed with the same elements
+	*/
+	bool Compare(const char* label, const wlr::NumericArray& source, numericarray_data_t resultType,
+				 numericarray_convert_method_t method, mreal tolerance)
+	{
+		const std::size_t iterations = 10;
+
+		MNumericArray runtimeResult = nullptr;
+		errcode_t runtimeError = 0;
+
+		benchmark::Print(benchmark::Measure(std::string(label) + ", wlr_MNumericArray_convertType", iterations, [&] {
+			if(runtimeResult != nullptr)
+			{
+				wlr_MNumericArray_free(runtimeResult);
+			}
+			runtimeError = wlr_MNumericArray_convertType(&runtimeResult, source.Get(), resultType, method, tolerance);
+		}));
+
+		wlr::NumericArray hostResult;
+		errcode_t hostError = 0;
+
+		benchmark::Print(benchmark::Measure(std::string(label) + ", wlr::ConvertType", iterations, [&] {
+			hostError = wlr::ConvertType(hostResult, source.Get(), resultType, method, tolerance);
+		}));
+
+		wlr::ConvertOptions parallel;
+		parallel.threadCount = 0;
+
+		benchmark::Print(benchmark::Measure(std::string(label) + ", wlr::ConvertType (all threads)", iterations, [&] {
+			hostError = wlr::ConvertType(hostResult, source.Get(), resultType, method, tolerance, parallel);
+		}));
+
+		const bool same =
+			runtimeError == LIBRARY_NO_ERROR && hostError == LIBRARY_NO_ERROR &&
+			(std::memcmp(wlr_MNumericArray_getData(runtimeResult), wlr_MNumericArray_getData(hostResult.Get()),
+						 static_cast<std::size_t>(wlr_MNumericArray_getFlattenedLength(source.Get())) *
+							 wlr::NumericArrayElementSize(resultType)) == 0);
+
+		std::printf("%-48s %s\n", label, same ? "results match" : "RESULTS DIFFER");
+
+		if(runtimeResult != nullptr)
+		{
+			wlr_MNumericArray_free(runtimeResult);
+		}
+
+		return same;
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	const mint length = mint(1) << 24;
+
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<double> distribution(-1000.0, 1000.0);
+
+	wlr::NumericArray reals;
+	wlr::NumericArray::Create(MNumericArray_Type_Real64, 1, &length, reals);
+
+	for(double& value : reals.View<double, 1>())
+	{
+		value = distribution(generator);
+	}
+
+	bool same = true;
+
+	same &= Compare("Real64 -> Real32, Check", reals, MNumericArray_Type_Real32, MNumericArray_Convert_Check, 1e-6);
+	same &= Compare("Real64 -> Bit16, Round", reals, MNumericArray_Type_Bit16, MNumericArray_Convert_Round, 1e-6);
+
+	wlr::NumericArray floats;
+	wlr::ConvertType(floats, reals.Get(), MNumericArray_Type_Real32, MNumericArray_Convert_Coerce, 1e-6);
+
+	same &= Compare("Real32 -> Real16, Clip_Check", floats, MNumericArray_Type_Real16, MNumericArray_Convert_Clip_Check,
+					1e-6);
+
+	wlr::NumericArray bytes;
+	wlr::NumericArray::Create(MNumericArray_Type_UBit8, 1, &length, bytes);
+
+	for(std::uint8_t& value : bytes.View<std::uint8_t, 1>())
+	{
+		value = static_cast<std::uint8_t>(generator());
+	}
+
+	same &= Compare("UBit8 -> Real32, Scale", bytes, MNumericArray_Type_Real32, MNumericArray_Convert_Scale, 1e-6);
+
+	return same ? 0 : 1;
+}
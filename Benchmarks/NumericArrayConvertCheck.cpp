@@ -0,0 +1,749 @@
+/*
+	Correctness check of wlr::ConvertElements against hard-coded and independently computed results
+
+	usage: NumericArrayConvertCheck <layout directory>
+
+	Prints one line per mismatch and exits with code 1 if there is any:
+
+		expected  - fixed inputs with NaN, infinities, out-of-range values, .5 ties, tolerances, scaling and wrapping,
+					and the result (or failure) each conversion must give, from wlr::ConvertElements and from
+					wlr_MNumericArray_convertType
+		reference - every pair of element types with every method at three non-zero tolerances on in-range values,
+					compared with results computed here from the documented rules: the value itself, or for Scale the
+					value mapped between the integer ranges, and the failures Scale gives on reals past 1
+		kernels   - the same conversions, and the same on out-of-range and non-finite inputs, with every vector kernel
+					the CPU supports and split across threads, compared with the scalar code
+
+	Linked against Benchmarks/FakeRuntime, whose wlr_MNumericArray_convertType calls wlr::ConvertElements itself, the
+	runtime half of the expected results checks nothing more than the host half.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/NumericArrayConvert.h"
+
+namespace
+{
+	int checks = 0;
+	int failures = 0;
+
+	const numericarray_data_t elementTypes[] = {
+		MNumericArray_Type_Bit8,		   MNumericArray_Type_UBit8,		  MNumericArray_Type_Bit16,
+		MNumericArray_Type_UBit16,		   MNumericArray_Type_Bit32,		  MNumericArray_Type_UBit32,
+		MNumericArray_Type_Bit64,		   MNumericArray_Type_UBit64,		  MNumericArray_Type_Real16,
+		MNumericArray_Type_Real32,		   MNumericArray_Type_Real64,		  MNumericArray_Type_Complex_Real16,
+		MNumericArray_Type_Complex_Real32, MNumericArray_Type_Complex_Real64};
+
+	// The methods that fail on out-of-range values unless they clip
+	const numericarray_convert_method_t methods[] = {MNumericArray_Convert_Check,  MNumericArray_Convert_Clip_Check,
+													 MNumericArray_Convert_Coerce, MNumericArray_Convert_Clip_Coerce,
+													 MNumericArray_Convert_Round,  MNumericArray_Convert_Clip_Round};
+
+	const numericarray_convert_method_t allMethods[] = {
+		MNumericArray_Convert_Check,	   MNumericArray_Convert_Clip_Check, MNumericArray_Convert_Coerce,
+		MNumericArray_Convert_Clip_Coerce, MNumericArray_Convert_Round,		 MNumericArray_Convert_Clip_Round,
+		MNumericArray_Convert_Scale,	   MNumericArray_Convert_Clip_Scale, MNumericArray_Convert_Cast,
+		MNumericArray_Convert_Clip_Cast};
+
+	const mreal tolerances[] = {1e-6, 0.25, 0.5};
+
+	const char* TypeName(numericarray_data_t type)
+	{
+		switch(type)
+		{
+			case MNumericArray_Type_Bit8:
+				return "Integer8";
+			case MNumericArray_Type_UBit8:
+				return "UnsignedInteger8";
+			case MNumericArray_Type_Bit16:
+				return "Integer16";
+			case MNumericArray_Type_UBit16:
+				return "UnsignedInteger16";
+			case MNumericArray_Type_Bit32:
+				return "Integer32";
+			case MNumericArray_Type_UBit32:
+				return "UnsignedInteger32";
+			case MNumericArray_Type_Bit64:
+				return "Integer64";
+			case MNumericArray_Type_UBit64:
+				return "UnsignedInteger64";
+			case MNumericArray_Type_Real16:
+				return "Real16";
+			case MNumericArray_Type_Real32:
+				return "Real32";
+			case MNumericArray_Type_Real64:
+				return "Real64";
+			case MNumericArray_Type_Complex_Real16:
+				return "ComplexReal16";
+			case MNumericArray_Type_Complex_Real32:
+				return "ComplexReal32";
+			case MNumericArray_Type_Complex_Real64:
+				return "ComplexReal64";
+			default:
+				return "?";
+		}
+	}
+
+	const char* MethodName(numericarray_convert_method_t method)
+	{
+		static const char* const names[] = {"Check", "ClipAndCheck", "Coerce", "ClipAndCoerce", "Round",
+											"ClipAndRound", "Scale", "ClipAndScale", "Cast", "ClipAndCast"};
+
+		return names[method - MNumericArray_Convert_Check];
+	}
+
+	template <typename T>
+	bool SameReals(const T* first, const T* second, std::size_t count)
+	{
+		for(std::size_t index = 0; index < count; ++index)
+		{
+			const bool bothNaN = std::isnan(first[index]) && std::isnan(second[index]);
+
+			if(!bothNaN && std::memcmp(&first[index], &second[index], sizeof(T)) != 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool SameHalves(const std::uint16_t* first, const std::uint16_t* second, std::size_t count)
+	{
+		auto isNaN = [](std::uint16_t bits) { return (bits & 0x7C00u) == 0x7C00u && (bits & 0x3FFu) != 0; };
+
+		for(std::size_t index = 0; index < count; ++index)
+		{
+			if(first[index] != second[index] && !(isNaN(first[index]) && isNaN(second[index])))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+		True if two arrays of length elements of type hold the same values, bit for bit except that any two NaNs match
+	*/
+	bool SameElements(numericarray_data_t type, const void* first, const void* second, mint length)
+	{
+		const std::size_t count = static_cast<std::size_t>(length);
+
+		switch(type)
+		{
+			case MNumericArray_Type_Real32:
+				return SameReals(static_cast<const float*>(first), static_cast<const float*>(second), count);
+			case MNumericArray_Type_Complex_Real32:
+				return SameReals(static_cast<const float*>(first), static_cast<const float*>(second), 2 * count);
+			case MNumericArray_Type_Real64:
+				return SameReals(static_cast<const double*>(first), static_cast<const double*>(second), count);
+			case MNumericArray_Type_Complex_Real64:
+				return SameReals(static_cast<const double*>(first), static_cast<const double*>(second), 2 * count);
+			case MNumericArray_Type_Real16:
+				return SameHalves(static_cast<const std::uint16_t*>(first), static_cast<const std::uint16_t*>(second),
+								  count);
+			case MNumericArray_Type_Complex_Real16:
+				return SameHalves(static_cast<const std::uint16_t*>(first), static_cast<const std::uint16_t*>(second),
+								  2 * count);
+			default:
+				return std::memcmp(first, second, count * wlr::NumericArrayElementSize(type)) == 0;
+		}
+	}
+
+	void Fail(const char* check, const char* label, numericarray_data_t sourceType, numericarray_data_t resultType,
+			  numericarray_convert_method_t method, mreal tolerance, const char* detail)
+	{
+		++failures;
+
+		std::printf("MISMATCH %s/%s: %s -> %s, %s, tolerance %g: %s\n", check, label, TypeName(sourceType),
+					TypeName(resultType), MethodName(method), tolerance, detail);
+	}
+
+	/* Hard-coded results */
+
+	/**
+		Convert input to D with the host code and with the runtime, and require expectedError and, on success, expected
+	*/
+	template <typename D, typename S>
+	void Expect(const char* label, const std::vector<S>& input, numericarray_convert_method_t method, mreal tolerance,
+				errcode_t expectedError, const std::vector<D>& expected = {})
+	{
+		const mint length = static_cast<mint>(input.size());
+		const numericarray_data_t sourceType = wlr::NumericArrayType<S>;
+		const numericarray_data_t resultType = wlr::NumericArrayType<D>;
+
+		++checks;
+
+		std::vector<D> hostResult(input.size());
+
+		const errcode_t hostError =
+			wlr::ConvertElements(input.data(), sourceType, hostResult.data(), resultType, length, method, tolerance);
+
+		if(hostError != expectedError)
+		{
+			Fail("expected", label, sourceType, resultType, method, tolerance, "host error code differs");
+		}
+		else if(expectedError == LIBRARY_NO_ERROR &&
+				!SameElements(resultType, hostResult.data(), expected.data(), length))
+		{
+			Fail("expected", label, sourceType, resultType, method, tolerance, "host result differs");
+		}
+
+		wlr::NumericArray source;
+		MNumericArray runtimeResult = nullptr;
+
+		wlr::NumericArray::FromBuffer(input.data(), 1, &length, source);
+
+		const errcode_t runtimeError =
+			wlr_MNumericArray_convertType(&runtimeResult, source.Get(), resultType, method, tolerance);
+
+		if(runtimeError != expectedError)
+		{
+			Fail("expected", label, sourceType, resultType, method, tolerance, "runtime error code differs");
+		}
+		else if(expectedError == LIBRARY_NO_ERROR &&
+				!SameElements(resultType, wlr_MNumericArray_getData(runtimeResult), expected.data(), length))
+		{
+			Fail("expected", label, sourceType, resultType, method, tolerance, "runtime result differs");
+		}
+
+		if(runtimeResult != nullptr)
+		{
+			wlr_MNumericArray_free(runtimeResult);
+		}
+	}
+
+	void CheckExpectedResults()
+	{
+		const double nan = std::numeric_limits<double>::quiet_NaN();
+		const double infinity = std::numeric_limits<double>::infinity();
+		const float floatNaN = std::numeric_limits<float>::quiet_NaN();
+		const float floatInfinity = std::numeric_limits<float>::infinity();
+		const float floatMaximum = std::numeric_limits<float>::max();
+		const double twoTo63 = 9223372036854775808.0;
+
+		const errcode_t ok = LIBRARY_NO_ERROR;
+		const errcode_t fails = LIBRARY_NUMERICAL_ERROR;
+
+		// .5 ties round to even; Coerce truncates towards zero; Check accepts values within tolerance of an integer
+		const std::vector<double> ties = {0.5, 1.5, 2.5, -0.5, -2.5, 3.5};
+		const std::vector<std::int32_t> tiesRounded = {0, 2, 2, 0, -2, 4};
+
+		Expect("ties", ties, MNumericArray_Convert_Round, 1e-6, ok, tiesRounded);
+		Expect("ties", ties, MNumericArray_Convert_Clip_Round, 1e-6, ok, tiesRounded);
+		Expect("ties", ties, MNumericArray_Convert_Coerce, 1e-6, ok, std::vector<std::int32_t> {0, 1, 2, 0, -2, 3});
+		Expect("ties", ties, MNumericArray_Convert_Clip_Coerce, 1e-6, ok,
+			   std::vector<std::int32_t> {0, 1, 2, 0, -2, 3});
+		Expect<std::int32_t>("ties", ties, MNumericArray_Convert_Check, 0.25, fails);
+		Expect<std::int32_t>("ties", ties, MNumericArray_Convert_Clip_Check, 0.25, fails);
+		Expect("ties", ties, MNumericArray_Convert_Check, 0.5, ok, tiesRounded);
+
+		Expect("ties", std::vector<float> {2.5f, 3.5f, -3.5f}, MNumericArray_Convert_Round, 1e-6, ok,
+			   std::vector<std::int8_t> {2, 4, -4});
+		Expect("ties", std::vector<float> {2.5f, 3.5f, -3.5f}, MNumericArray_Convert_Coerce, 1e-6, ok,
+			   std::vector<std::int8_t> {2, 3, -3});
+		Expect("ties", std::vector<wlr::Half> {{0x4100}, {0x4300}}, MNumericArray_Convert_Round, 1e-6, ok,
+			   std::vector<std::int8_t> {2, 4});
+		Expect("ties", std::vector<std::complex<double>> {{2.5, 0.0}, {-3.5, 0.0}}, MNumericArray_Convert_Round, 1e-6,
+			   ok, std::vector<std::int16_t> {2, -4});
+
+		// Tolerance of Check
+		const std::vector<double> nearIntegers = {2.0000001, -3.0};
+
+		Expect("tolerance", nearIntegers, MNumericArray_Convert_Check, 1e-6, ok, std::vector<std::int32_t> {2, -3});
+		Expect<std::int32_t>("tolerance", nearIntegers, MNumericArray_Convert_Check, 1e-9, fails);
+
+		const std::vector<std::complex<double>> complexValues = {{1.5, 0.25}};
+
+		Expect("tolerance", complexValues, MNumericArray_Convert_Check, 0.5, ok, std::vector<double> {1.5});
+		Expect<double>("tolerance", complexValues, MNumericArray_Convert_Check, 0.1, fails);
+		Expect<double>("tolerance", complexValues, MNumericArray_Convert_Clip_Check, 0.1, fails);
+		Expect("tolerance", complexValues, MNumericArray_Convert_Coerce, 0.1, ok, std::vector<double> {1.5});
+
+		// NaN is out of range for every integer type, even with clipping
+		for(numericarray_convert_method_t method : methods)
+		{
+			Expect<std::int8_t>("NaN", std::vector<double> {1.0, nan}, method, 0.5, fails);
+			Expect<std::uint64_t>("NaN", std::vector<float> {floatNaN}, method, 0.5, fails);
+			Expect<std::int16_t>("NaN", std::vector<wlr::Half> {{0x7E00}}, method, 0.5, fails);
+		}
+
+		// Infinities saturate when clipping, and are never within tolerance of an integer
+		const std::vector<double> infinities = {infinity, -infinity};
+
+		Expect<std::int8_t>("infinity", infinities, MNumericArray_Convert_Check, 0.5, fails);
+		Expect<std::int8_t>("infinity", infinities, MNumericArray_Convert_Clip_Check, 0.5, fails);
+		Expect<std::int8_t>("infinity", infinities, MNumericArray_Convert_Coerce, 0.5, fails);
+		Expect("infinity", infinities, MNumericArray_Convert_Clip_Coerce, 0.5, ok,
+			   std::vector<std::int8_t> {127, -128});
+		Expect<std::int8_t>("infinity", infinities, MNumericArray_Convert_Round, 0.5, fails);
+		Expect("infinity", infinities, MNumericArray_Convert_Clip_Round, 0.5, ok, std::vector<std::int8_t> {127, -128});
+
+		// Infinities and NaN are representable in every real type
+		for(numericarray_convert_method_t method : methods)
+		{
+			Expect("non-finite", std::vector<double> {infinity, -infinity, nan}, method, 1e-6, ok,
+				   std::vector<float> {floatInfinity, -floatInfinity, floatNaN});
+			Expect("non-finite", std::vector<float> {floatInfinity, floatNaN}, method, 1e-6, ok,
+				   std::vector<wlr::Half> {{0x7C00}, {0x7E00}});
+		}
+
+		// Out-of-range reals to integers
+		const std::vector<double> bytesOutOfRange = {300.0, -1.0, 255.0};
+		const std::vector<std::uint8_t> bytesClipped = {255, 0, 255};
+
+		Expect<std::uint8_t>("range", bytesOutOfRange, MNumericArray_Convert_Check, 1e-6, fails);
+		Expect("range", bytesOutOfRange, MNumericArray_Convert_Clip_Check, 1e-6, ok, bytesClipped);
+		Expect<std::uint8_t>("range", bytesOutOfRange, MNumericArray_Convert_Coerce, 1e-6, fails);
+		Expect("range", bytesOutOfRange, MNumericArray_Convert_Clip_Coerce, 1e-6, ok, bytesClipped);
+		Expect<std::uint8_t>("range", bytesOutOfRange, MNumericArray_Convert_Round, 1e-6, fails);
+		Expect("range", bytesOutOfRange, MNumericArray_Convert_Clip_Round, 1e-6, ok, bytesClipped);
+
+		// 2^63 is just past the Integer64 range, -2^63 is its minimum
+		Expect<std::int64_t>("range", std::vector<double> {twoTo63, -twoTo63}, MNumericArray_Convert_Round, 1e-6,
+							 fails);
+		Expect("range", std::vector<double> {twoTo63, -twoTo63}, MNumericArray_Convert_Clip_Round, 1e-6, ok,
+			   std::vector<std::int64_t> {std::numeric_limits<std::int64_t>::max(),
+										  std::numeric_limits<std::int64_t>::min()});
+		Expect("range", std::vector<double> {-twoTo63}, MNumericArray_Convert_Round, 1e-6, ok,
+			   std::vector<std::int64_t> {std::numeric_limits<std::int64_t>::min()});
+
+		// Out-of-range reals to narrower reals; finite values that round to infinity fail or clip to the maximum
+		const std::vector<double> floatsOutOfRange = {1e39, -1e39, infinity, 0.1};
+		const std::vector<float> floatsClipped = {floatMaximum, -floatMaximum, floatInfinity, 0.1f};
+
+		Expect<float>("range", floatsOutOfRange, MNumericArray_Convert_Check, 1e-6, fails);
+		Expect("range", floatsOutOfRange, MNumericArray_Convert_Clip_Check, 1e-6, ok, floatsClipped);
+		Expect<float>("range", floatsOutOfRange, MNumericArray_Convert_Coerce, 1e-6, fails);
+		Expect("range", floatsOutOfRange, MNumericArray_Convert_Clip_Coerce, 1e-6, ok, floatsClipped);
+		Expect<float>("range", floatsOutOfRange, MNumericArray_Convert_Round, 1e-6, fails);
+		Expect("range", floatsOutOfRange, MNumericArray_Convert_Clip_Round, 1e-6, ok, floatsClipped);
+
+		// 65519 rounds to the largest Real16, 65504; 65520 rounds to infinity
+		Expect<wlr::Half>("range", std::vector<float> {65519.0f, 65520.0f}, MNumericArray_Convert_Round, 1e-6, fails);
+		Expect("range", std::vector<float> {65519.0f, 65520.0f, 1.0f, 0.5f}, MNumericArray_Convert_Clip_Round, 1e-6, ok,
+			   std::vector<wlr::Half> {{0x7BFF}, {0x7BFF}, {0x3C00}, {0x3800}});
+		Expect("range", std::vector<float> {65519.0f}, MNumericArray_Convert_Check, 1e-6, ok,
+			   std::vector<wlr::Half> {{0x7BFF}});
+		Expect<wlr::Half>("range", std::vector<std::int32_t> {100000}, MNumericArray_Convert_Check, 1e-6, fails);
+		Expect("range", std::vector<std::int32_t> {100000}, MNumericArray_Convert_Clip_Check, 1e-6, ok,
+			   std::vector<wlr::Half> {{0x7BFF}});
+
+		// Out-of-range integers to integers
+		const std::vector<std::int64_t> integersOutOfRange = {-1, 256, 255};
+
+		for(numericarray_convert_method_t method : methods)
+		{
+			const bool clip = method == MNumericArray_Convert_Clip_Check ||
+							  method == MNumericArray_Convert_Clip_Coerce || method == MNumericArray_Convert_Clip_Round;
+
+			Expect("range", integersOutOfRange, method, 1e-6, clip ? ok : fails,
+				   std::vector<std::uint8_t> {0, 255, 255});
+			Expect("range", std::vector<std::uint64_t> {std::numeric_limits<std::uint64_t>::max(), 5}, method, 1e-6,
+				   clip ? ok : fails, std::vector<std::int64_t> {std::numeric_limits<std::int64_t>::max(), 5});
+			Expect("range", std::vector<std::int16_t> {-129, 127}, method, 1e-6, clip ? ok : fails,
+				   std::vector<std::int8_t> {-128, 127});
+		}
+
+		// Scale maps integers onto [0, 1] or [-1, 1]; the minimum of a signed type maps to -1 like the one above it
+		std::vector<std::uint8_t> bytes;
+		std::vector<float> bytesScaled;
+
+		for(int value = 0; value < 40; ++value)
+		{
+			bytes.push_back(static_cast<std::uint8_t>(value * 6 + 21));
+			bytesScaled.push_back(static_cast<float>((value * 6 + 21) / 255.0));
+		}
+
+		Expect("scale", bytes, MNumericArray_Convert_Scale, 1e-6, ok, bytesScaled);
+		Expect("scale", bytes, MNumericArray_Convert_Clip_Scale, 1e-6, ok, bytesScaled);
+		Expect("scale", std::vector<std::uint8_t> {0, 51, 255}, MNumericArray_Convert_Scale, 1e-6, ok,
+			   std::vector<float> {0.0f, 0.2f, 1.0f});
+		Expect("scale", std::vector<std::int8_t> {-128, -127, 0, 127}, MNumericArray_Convert_Scale, 1e-6, ok,
+			   std::vector<double> {-1.0, -1.0, 0.0, 1.0});
+		Expect("scale", std::vector<std::uint8_t> {0, 128, 255}, MNumericArray_Convert_Scale, 1e-6, ok,
+			   std::vector<std::int8_t> {0, 64, 127});
+		Expect("scale", std::vector<std::int16_t> {-32768, 32767, 0}, MNumericArray_Convert_Scale, 1e-6, ok,
+			   std::vector<std::int8_t> {-127, 127, 0});
+
+		// Reals are already normalized: 0.5 * 255 ties to 128, and values past [-1, 1] are out of range
+		const std::vector<double> normalized = {0.5, -1.0, 1.0, 2.0};
+
+		Expect<std::uint8_t>("scale", normalized, MNumericArray_Convert_Scale, 1e-6, fails);
+		Expect("scale", normalized, MNumericArray_Convert_Clip_Scale, 1e-6, ok,
+			   std::vector<std::uint8_t> {128, 0, 255, 255});
+		Expect("scale", std::vector<double> {0.5, -1.0}, MNumericArray_Convert_Scale, 1e-6, ok,
+			   std::vector<std::int16_t> {16384, -32767});
+		Expect("scale", std::vector<double> {0.5, 3.0}, MNumericArray_Convert_Scale, 1e-6, ok,
+			   std::vector<float> {0.5f, 3.0f});
+
+		// Cast never fails: integers wrap, reals truncate and saturate, NaN becomes 0; Clip_Cast clamps integers
+		const std::vector<std::int32_t> wrapping = {300, -1, 256, 7};
+
+		Expect("cast", wrapping, MNumericArray_Convert_Cast, 1e-6, ok, std::vector<std::uint8_t> {44, 255, 0, 7});
+		Expect("cast", wrapping, MNumericArray_Convert_Clip_Cast, 1e-6, ok, std::vector<std::uint8_t> {255, 0, 255, 7});
+		Expect("cast", std::vector<std::uint64_t> {std::numeric_limits<std::uint64_t>::max()},
+			   MNumericArray_Convert_Cast, 1e-6, ok, std::vector<std::int64_t> {-1});
+
+		const std::vector<double> truncated = {nan, 1e10, -1e10, 2.7, -2.7};
+
+		for(numericarray_convert_method_t method : {MNumericArray_Convert_Cast, MNumericArray_Convert_Clip_Cast})
+		{
+			Expect("cast", truncated, method, 1e-6, ok, std::vector<std::int8_t> {0, 127, -128, 2, -2});
+		}
+
+		Expect("cast", std::vector<double> {1e39, 0.1}, MNumericArray_Convert_Cast, 1e-6, ok,
+			   std::vector<float> {floatInfinity, 0.1f});
+		Expect("cast", std::vector<double> {1e39, 0.1}, MNumericArray_Convert_Clip_Cast, 1e-6, ok,
+			   std::vector<float> {floatMaximum, 0.1f});
+	}
+
+	/* Reference results for in-range values */
+
+	struct ElementInfo
+	{
+		bool integer;
+		bool complex;
+		double maximum;
+		double upperBoundExclusive;
+	};
+
+	ElementInfo Info(numericarray_data_t type)
+	{
+		switch(type)
+		{
+			case MNumericArray_Type_Bit8:
+				return {true, false, 127.0, 128.0};
+			case MNumericArray_Type_UBit8:
+				return {true, false, 255.0, 256.0};
+			case MNumericArray_Type_Bit16:
+				return {true, false, 32767.0, 32768.0};
+			case MNumericArray_Type_UBit16:
+				return {true, false, 65535.0, 65536.0};
+			case MNumericArray_Type_Bit32:
+				return {true, false, 2147483647.0, 2147483648.0};
+			case MNumericArray_Type_UBit32:
+				return {true, false, 4294967295.0, 4294967296.0};
+			case MNumericArray_Type_Bit64:
+				return {true, false, 9223372036854775807.0, 9223372036854775808.0};
+			case MNumericArray_Type_UBit64:
+				return {true, false, 18446744073709551615.0, 18446744073709551616.0};
+			case MNumericArray_Type_Complex_Real16:
+			case MNumericArray_Type_Complex_Real32:
+			case MNumericArray_Type_Complex_Real64:
+				return {false, true, 0.0, 0.0};
+			default:
+				return {false, false, 0.0, 0.0};
+		}
+	}
+
+	double HalfValue(std::uint16_t bits)
+	{
+		const int exponent = (bits >> 10) & 0x1F;
+		const double mantissa = bits & 0x3FF;
+		const double magnitude =
+			exponent == 0 ? std::ldexp(mantissa, -24) : std::ldexp(mantissa + 1024.0, exponent - 25);
+
+		return bits & 0x8000 ? -magnitude : magnitude;
+	}
+
+	/**
+		Real part of element index of an array of type, and its imaginary part in imaginary
+	*/
+	double ElementValue(numericarray_data_t type, const void* data, std::size_t index, double& imaginary)
+	{
+		imaginary = 0.0;
+
+		switch(type)
+		{
+			case MNumericArray_Type_Bit8:
+				return static_cast<const std::int8_t*>(data)[index];
+			case MNumericArray_Type_UBit8:
+				return static_cast<const std::uint8_t*>(data)[index];
+			case MNumericArray_Type_Bit16:
+				return static_cast<const std::int16_t*>(data)[index];
+			case MNumericArray_Type_UBit16:
+				return static_cast<const std::uint16_t*>(data)[index];
+			case MNumericArray_Type_Bit32:
+				return static_cast<const std::int32_t*>(data)[index];
+			case MNumericArray_Type_UBit32:
+				return static_cast<const std::uint32_t*>(data)[index];
+			case MNumericArray_Type_Bit64:
+				return static_cast<double>(static_cast<const std::int64_t*>(data)[index]);
+			case MNumericArray_Type_UBit64:
+				return static_cast<double>(static_cast<const std::uint64_t*>(data)[index]);
+			case MNumericArray_Type_Real16:
+				return HalfValue(static_cast<const std::uint16_t*>(data)[index]);
+			case MNumericArray_Type_Real32:
+				return static_cast<const float*>(data)[index];
+			case MNumericArray_Type_Real64:
+				return static_cast<const double*>(data)[index];
+			case MNumericArray_Type_Complex_Real16:
+				imaginary = HalfValue(static_cast<const std::uint16_t*>(data)[2 * index + 1]);
+				return HalfValue(static_cast<const std::uint16_t*>(data)[2 * index]);
+			case MNumericArray_Type_Complex_Real32:
+				imaginary = static_cast<const float*>(data)[2 * index + 1];
+				return static_cast<const float*>(data)[2 * index];
+			default:
+				imaginary = static_cast<const double*>(data)[2 * index + 1];
+				return static_cast<const double*>(data)[2 * index];
+		}
+	}
+
+	/**
+		True if a result element of type is value rounded to that type
+	*/
+	bool IsRoundedValue(numericarray_data_t type, double result, double value)
+	{
+		switch(type)
+		{
+			case MNumericArray_Type_Real16:
+			case MNumericArray_Type_Complex_Real16:
+				// Rounded through Real32, which can round twice, and to a multiple of the smallest subnormal, 2^-24
+				return std::fabs(result - value) <= std::max(std::ldexp(std::fabs(value), -10), std::ldexp(1.0, -24));
+			case MNumericArray_Type_Real32:
+			case MNumericArray_Type_Complex_Real32:
+				return result == static_cast<double>(static_cast<float>(value));
+			default:
+				return result == value;
+		}
+	}
+
+	/**
+		Compare the conversion of the in-range values in source with the documented rules
+		@remarks Every in-range value is an integer from 0 to 100, which every element type holds exactly, so only Scale
+	   changes values, and only Scale of a real to an integer type can fail.
+	*/
+	void CheckReference(const char* label, const void* source, numericarray_data_t sourceType, const void* result,
+						numericarray_data_t resultType, mint length, numericarray_convert_method_t method,
+						mreal tolerance, errcode_t error)
+	{
+		const ElementInfo sourceInfo = Info(sourceType);
+		const ElementInfo resultInfo = Info(resultType);
+
+		const bool scale = sourceType != resultType && (method == MNumericArray_Convert_Scale ||
+														method == MNumericArray_Convert_Clip_Scale);
+
+		bool expectFailure = false;
+		bool differs = false;
+
+		for(std::size_t index = 0; index < static_cast<std::size_t>(length); ++index)
+		{
+			double imaginary;
+			double value = ElementValue(sourceType, source, index, imaginary);
+
+			if(scale && sourceInfo.integer)
+			{
+				value /= sourceInfo.maximum;
+			}
+
+			if(scale && resultInfo.integer)
+			{
+				value = std::nearbyint(value * resultInfo.maximum);
+
+				if(value >= resultInfo.upperBoundExclusive)
+				{
+					expectFailure = expectFailure || method == MNumericArray_Convert_Scale;
+					value = resultInfo.maximum;
+				}
+			}
+
+			const double converted = ElementValue(resultType, result, index, imaginary);
+
+			differs = differs || !IsRoundedValue(resultType, converted, value) || imaginary != 0.0;
+		}
+
+		if((error == LIBRARY_NO_ERROR) == expectFailure)
+		{
+			Fail("reference", label, sourceType, resultType, method, tolerance,
+				 expectFailure ? "the conversion should fail" : "the conversion failed");
+		}
+		else if(error == LIBRARY_NO_ERROR && differs)
+		{
+			Fail("reference", label, sourceType, resultType, method, tolerance, "elements differ");
+		}
+	}
+
+	/* Every pair of types, against the runtime and across kernels */
+
+	/**
+		Real64 values tiled to length; the in-range ones fit every element type exactly
+	*/
+	std::vector<double> Tile(const std::vector<double>& values, std::size_t length)
+	{
+		std::vector<double> result(length);
+
+		for(std::size_t index = 0; index < length; ++index)
+		{
+			result[index] = values[index % values.size()];
+		}
+
+		return result;
+	}
+
+	bool ConvertAtLevel(const void* source, numericarray_data_t sourceType, void* destination,
+						numericarray_data_t resultType, mint length, const wlr::convert::Method& method,
+						wlr::SimdLevel level)
+	{
+		return wlr::convert::VisitElementType(sourceType, [&](auto* sourceTag) {
+			using S = std::remove_pointer_t<decltype(sourceTag)>;
+
+			return wlr::convert::VisitElementType(resultType, [&](auto* resultTag) {
+				using D = std::remove_pointer_t<decltype(resultTag)>;
+
+				return wlr::convert::ConvertTyped(static_cast<const S*>(source), static_cast<D*>(destination), length,
+												  method, level);
+			});
+		});
+	}
+
+	void CheckAllPairs()
+	{
+		struct Input
+		{
+			const char* label;
+			std::vector<double> values;
+			bool inRange;
+		};
+
+		const double nan = std::numeric_limits<double>::quiet_NaN();
+		const double infinity = std::numeric_limits<double>::infinity();
+
+		// Odd lengths so that every kernel also runs its scalar tail
+		const std::size_t length = 1037;
+
+		std::vector<double> inRange;
+
+		for(int value = 0; value <= 100; ++value)
+		{
+			inRange.push_back(value);
+		}
+
+		const Input inputs[] = {
+			{"in range", Tile(inRange, length), true},
+			{"out of range",
+			 Tile({0.5, 1.5, 2.5, -2.5, -1.0, 127.5, 128.0, 255.5, 256.0, -129.0, 32767.5, 65504.0, 65519.0, 65520.0,
+				   1e10, -1e10, 3e38, 1e39, -1e39, 9223372036854775808.0, -9223372036854775808.0,
+				   18446744073709551616.0, 2.0000001},
+				  length),
+			 false},
+			{"non-finite", Tile({infinity, -infinity, nan, 1.0, -1.0}, length), false}};
+
+		std::vector<wlr::SimdLevel> levels = {wlr::SimdLevel::Scalar};
+
+		for(wlr::SimdLevel level : {wlr::SimdLevel::AVX2, wlr::SimdLevel::AVX512})
+		{
+			if(wlr::ActiveSimdLevel() != wlr::SimdLevel::NEON && level <= wlr::ActiveSimdLevel())
+			{
+				levels.push_back(level);
+			}
+		}
+
+		wlr::ConvertOptions threaded;
+		threaded.threadCount = 4;
+		threaded.minimumElementsPerThread = 64;
+
+		const mint count = static_cast<mint>(length);
+
+		for(const Input& input : inputs)
+		{
+			for(numericarray_data_t sourceType : elementTypes)
+			{
+				// The source elements are the seed values cast into sourceType
+				wlr::NumericArray source;
+				wlr::NumericArray::Create(sourceType, 1, &count, source);
+
+				void* sourceData = wlr_MNumericArray_getData(source.Get());
+
+				wlr::ConvertElements(input.values.data(), MNumericArray_Type_Real64, sourceData, sourceType, count,
+									 MNumericArray_Convert_Clip_Cast, 0.0);
+
+				for(numericarray_data_t resultType : elementTypes)
+				{
+					const std::size_t resultBytes = length * wlr::NumericArrayElementSize(resultType);
+
+					std::vector<unsigned char> hostResult(resultBytes);
+					std::vector<unsigned char> otherResult(resultBytes);
+
+					for(numericarray_convert_method_t method : allMethods)
+					{
+						for(mreal tolerance : tolerances)
+						{
+							++checks;
+
+							const errcode_t hostError = wlr::ConvertElements(sourceData, sourceType, hostResult.data(),
+																			 resultType, count, method, tolerance);
+
+							if(input.inRange)
+							{
+								CheckReference(input.label, sourceData, sourceType, hostResult.data(), resultType,
+											   count, method, tolerance, hostError);
+							}
+
+							wlr::convert::Method decoded;
+							wlr::convert::DecodeMethod(method, tolerance, decoded);
+
+							for(wlr::SimdLevel level : levels)
+							{
+								const bool converted = ConvertAtLevel(sourceData, sourceType, otherResult.data(),
+																	  resultType, count, decoded, level);
+
+								if(converted != (hostError == LIBRARY_NO_ERROR))
+								{
+									Fail("kernels", input.label, sourceType, resultType, method, tolerance,
+										 "a kernel disagrees on failure");
+								}
+								else if(converted &&
+										!SameElements(resultType, hostResult.data(), otherResult.data(), count))
+								{
+									Fail("kernels", input.label, sourceType, resultType, method, tolerance,
+										 "a kernel gives different elements");
+								}
+							}
+
+							const errcode_t threadedError =
+								wlr::ConvertElements(sourceData, sourceType, otherResult.data(), resultType, count,
+													 method, tolerance, threaded);
+
+							if(threadedError != hostError)
+							{
+								Fail("kernels", input.label, sourceType, resultType, method, tolerance,
+									 "threaded error code differs");
+							}
+							else if(hostError == LIBRARY_NO_ERROR &&
+									!SameElements(resultType, hostResult.data(), otherResult.data(), count))
+							{
+								Fail("kernels", input.label, sourceType, resultType, method, tolerance,
+									 "threaded elements differ");
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	CheckExpectedResults();
+	CheckAllPairs();
+
+	std::printf("%d conversions checked, %d mismatches\n", checks, failures);
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+/*
+	Correctness check of wlr::OutputCapture
+
+	usage: OutputCaptureCheck <layout directory>
+
+	Prints what failed and exits with code 1 at the first failure:
+
+		capture     - Print output and messages reach the sink in order, with the symbol and tag of the message name
+		attribution - each record carries the request id of the innermost RequestScope alive when it was produced
+		drops       - a ring too small for the output keeps the newest records and counts the overwritten ones
+		truncation  - a record larger than a quarter of the ring is cut to fit and counted
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/Expr.h"
+#include "wlr/OutputCapture.h"
+#include "wlr/Strings.h"
+
+namespace
+{
+	struct Record
+	{
+		wlr::CaptureKind kind;
+		std::uint64_t request;
+		std::string symbol;
+		std::string tag;
+		std::string text;
+	};
+
+	/**
+		Sink that keeps a copy of every record
+	*/
+	struct Recorder
+	{
+		std::mutex mutex;
+		std::vector<Record> records;
+
+		wlr::OutputCapture::Sink Sink()
+		{
+			return [this](const wlr::CapturedOutput& output) {
+				std::lock_guard<std::mutex> lock(mutex);
+
+				records.push_back(Record {output.kind, output.request, std::string(output.symbol),
+										  std::string(output.tag), std::string(output.text)});
+			};
+		}
+
+		std::vector<Record> Take()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			return std::move(records);
+		}
+	};
+
+	void Evaluate(const std::string& input)
+	{
+		wlr::ExpressionPool pool;
+
+		wlr_EvalString(wlr::ToExpression(input));
+	}
+
+	void CheckCaptureAndAttribution()
+	{
+		Recorder recorder;
+		wlr::OutputCapture capture(recorder.Sink());
+
+		benchmark::Require(capture.Attach() == WLR_SUCCESS, "attaching the capture");
+
+		Evaluate("Print[\"before\"]");
+
+		{
+			wlr::OutputCapture::RequestScope outer(capture, 7);
+
+			Evaluate("Print[\"outer\"]");
+
+			{
+				wlr::OutputCapture::RequestScope inner(capture, 8);
+
+				Evaluate("Message[MessageName[f, \"argx\"], 42]");
+			}
+
+			Evaluate("Message[MessageName[g, \"tag\"], \"text\"]");
+		}
+
+		Evaluate("Print[\"after\"]");
+
+		capture.Flush();
+
+		const std::vector<Record> records = recorder.Take();
+
+		benchmark::Require(records.size() == 5, "capture: every Print and message is delivered");
+
+		benchmark::Require(records[0].kind == wlr::CaptureKind::Stdout && records[0].text == "before\n" &&
+							   records[0].symbol.empty() && records[0].tag.empty(),
+						   "capture: Print output is a stdout record");
+		benchmark::Require(records[2].kind == wlr::CaptureKind::Message && records[2].symbol == "f" &&
+							   records[2].tag == "argx" && !records[2].text.empty(),
+						   "capture: a message has the symbol and tag of its MessageName");
+		benchmark::Require(records[3].kind == wlr::CaptureKind::Message && records[3].symbol == "g" &&
+							   records[3].tag == "tag",
+						   "capture: every message has its own name");
+
+		const std::uint64_t requests[] = {0, 7, 8, 7, 0};
+
+		for(std::size_t index = 0; index < records.size(); ++index)
+		{
+			benchmark::Require(records[index].request == requests[index],
+							   "attribution: a record carries the request of the innermost scope");
+		}
+
+		const wlr::OutputCaptureStatistics statistics = capture.Statistics();
+
+		benchmark::Require(statistics.captured == 5 && statistics.delivered == 5 && statistics.dropped == 0 &&
+							   statistics.truncated == 0,
+						   "capture: the statistics count every record as delivered");
+
+		capture.Detach();
+
+		Evaluate("Print[\"detached\"]");
+		capture.Flush();
+
+		benchmark::Require(recorder.Take().empty(), "capture: nothing is captured after Detach");
+	}
+
+	void CheckDropsAndTruncation()
+	{
+		// The smallest ring, drained only on Flush
+		wlr::OutputCaptureOptions options;
+		options.capacityBytes = 256;
+		options.drainInterval = std::chrono::microseconds(3600000000LL);
+
+		Recorder recorder;
+		wlr::OutputCapture capture(recorder.Sink(), options);
+
+		benchmark::Require(capture.Attach() == WLR_SUCCESS, "attaching the capture");
+
+		const int prints = 100;
+
+		for(int index = 0; index < prints; ++index)
+		{
+			Evaluate("Print[" + std::to_string(index) + "]");
+		}
+
+		capture.Flush();
+
+		std::vector<Record> records = recorder.Take();
+		wlr::OutputCaptureStatistics statistics = capture.Statistics();
+
+		benchmark::Require(statistics.captured == prints && statistics.dropped > 0 &&
+							   statistics.delivered + statistics.dropped == statistics.captured &&
+							   records.size() == statistics.delivered,
+						   "drops: every record is either delivered or counted as dropped");
+
+		for(std::size_t index = 0; index < records.size(); ++index)
+		{
+			const std::size_t expected = prints - records.size() + index;
+
+			benchmark::Require(records[index].text == std::to_string(expected) + "\n",
+							   "drops: the newest records are kept, in order");
+		}
+
+		Evaluate("Print[\"" + std::string(1000, 'x') + "\"]");
+		capture.Flush();
+
+		records = recorder.Take();
+		statistics = capture.Statistics();
+
+		benchmark::Require(records.size() == 1 && statistics.truncated == 1 && !records[0].text.empty() &&
+							   records[0].text.size() < 1000 &&
+							   records[0].text.find_first_not_of('x') == std::string::npos,
+						   "truncation: a record larger than a quarter of the ring is cut to fit");
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	CheckCaptureAndAttribution();
+	CheckDropsAndTruncation();
+
+	std::printf("OutputCapture checks passed\n");
+
+	return 0;
+}
@@ -0,0 +1,184 @@
+/*
+	Host-side overhead suite: expression construction, variadic building, string and numeric array marshaling, pool
+	create/release, and end-to-end EvaluateToOutputForm
+
+	usage: OverheadSuite <layout directory> [results.json]
+
+	Linked against StandaloneApplicationsSDK.lib, every measurement includes the real runtime. Linked against
+	FakeRuntime/FakeRuntime.cpp instead, the runtime side costs next to nothing (or a fixed latency per call, see that
+	file), so the numbers isolate the overhead of the helpers in Native/wlr/. Results are printed and also written as
+	JSON (to OverheadSuite.json by default) for comparing runs with each other.
+*/
+
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/Evaluate.h"
+#include "wlr/ExpressionTemplate.h"
+#include "wlr/ParseCache.h"
+#include "wlr/Tensor.h"
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	const char* outputFile = argumentCount > 2 ? arguments[2] : "OverheadSuite.json";
+
+	std::vector<benchmark::Result> results;
+
+	auto run = [&results](const std::string& name, std::size_t iterations, auto&& body) {
+		results.push_back(benchmark::Measure(name, iterations, body));
+		benchmark::Print(results.back());
+	};
+
+	wlr::RecyclingExpressionPool pool(1024);
+
+	const std::size_t iterations = 100000;
+
+	// Expression construction
+
+	run("construct/wlr_Integer", iterations, [&] {
+		wlr_Integer(42);
+		pool.EndRequest();
+	});
+
+	run("construct/wlr_Real", iterations, [&] {
+		wlr_Real(2.5);
+		pool.EndRequest();
+	});
+
+	run("construct/wlr_SystemSymbol", iterations, [&] {
+		wlr_SystemSymbol("List");
+		pool.EndRequest();
+	});
+
+	run("construct/wlr::Symbol", iterations, [&] { wlr::Symbol(wlr::SystemSymbol::List); });
+
+	// Variadic building
+
+	run("variadic/3 children, wlr_List macro", iterations, [&] {
+		wlr_List(wlr_Integer(1), wlr_Real(2.5), wlr_String("three"));
+		pool.EndRequest();
+	});
+
+	run("variadic/3 children, wlr::List", iterations, [&] {
+		wlr::List(1, 2.5, "three");
+		pool.EndRequest();
+	});
+
+	run("variadic/25 children, wlr::List", iterations, [&] {
+		wlr::List(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25);
+		pool.EndRequest();
+	});
+
+	std::vector<mint> integers(10000);
+	std::iota(integers.begin(), integers.end(), mint(1));
+
+	// Large measurements recycle the pool every iteration rather than holding 1024 large results
+	const std::size_t largeIterations = 1000;
+
+	run("variadic/10000 children, wlr::List(wlr::Splice(...))", largeIterations, [&] {
+		wlr::List(wlr::Splice(integers));
+		pool.Recycle();
+	});
+
+	// String marshaling
+
+	const std::string text(256, 'x');
+
+	run("string/256 bytes, wlr::ToExpression", iterations, [&] {
+		wlr::ToExpression(text);
+		pool.EndRequest();
+	});
+
+	wlr::Expr stringExpression = wlr::Expr::Detach(wlr::ToExpression(text));
+
+	run("string/256 bytes, wlr_StringData copy", iterations, [&] {
+		char* stringData = nullptr;
+		mint stringDataLength = 0;
+		wlr_StringData(stringExpression.Get(), &stringData, &stringDataLength);
+		std::string copy(stringData, static_cast<std::size_t>(stringDataLength));
+		wlr_Release(stringData);
+	});
+
+	run("string/256 bytes, wlr::StringData view", iterations, [&] { wlr::StringData(stringExpression.Get()).View(); });
+
+	// Numeric array marshaling
+
+	std::vector<mreal> reals(100000);
+	std::iota(reals.begin(), reals.end(), 0.0);
+	const mint realCount = static_cast<mint>(reals.size());
+
+	run("numeric/100000 reals, wlr::TensorExpression", largeIterations, [&] {
+		wlr::TensorExpression(reals.data(), &realCount, 1);
+		pool.Recycle();
+	});
+
+	wlr::Expr packedReals = wlr::Expr::Detach(wlr::TensorExpression(reals.data(), &realCount, 1));
+
+	run("numeric/100000 reals, wlr::TensorData", largeIterations, [&] {
+		wlr::NumericArray result;
+		wlr::TensorData<mreal>(packedReals.Get(), result);
+		pool.EndRequest();
+	});
+
+	const mint matrixDimensions[2] = {316, 316};
+	std::vector<float> matrix(316 * 316, 1.5f);
+
+	run("numeric/316x316 Real32, wlr::TensorExpression", largeIterations, [&] {
+		wlr::TensorExpression(matrix.data(), matrixDimensions, 2);
+		pool.Recycle();
+	});
+
+	// Pools
+
+	run("pool/wlr::ExpressionPool create + release", iterations, [&] { wlr::ExpressionPool scope; });
+
+	run("pool/wlr::ExpressionPool with 8 expressions", iterations, [&] {
+		wlr::ExpressionPool scope;
+		for(mint value = 0; value < 8; ++value)
+		{
+			wlr_Integer(value);
+		}
+	});
+
+	// End to end
+
+	run("evaluate/EvaluateToOutputForm, pool per call", iterations, [&] {
+		wlr::ExpressionPool scope;
+		wlr::EvaluateToOutputForm("1 + 2 * 3");
+	});
+
+	run("evaluate/EvaluateToOutputForm, recycling pool", iterations, [&] {
+		wlr::EvaluateToOutputForm("1 + 2 * 3");
+		pool.EndRequest();
+	});
+
+	wlr::ParseCache parseCache;
+
+	run("evaluate/EvaluateToOutputForm, parse cache", iterations, [&] {
+		wlr::EvaluateToOutputForm("1 + 2 * 3", parseCache);
+		pool.EndRequest();
+	});
+
+	const wlr::ExpressionTemplate sum = wlr::ExpressionTemplate::Parse("ToString[#x + #y * 3, OutputForm]");
+
+	run("evaluate/wlr::ExpressionTemplate + wlr_Eval", iterations, [&] {
+		wlr::StringFromExpression(wlr_Eval(sum.Instantiate(1, 2)));
+		pool.EndRequest();
+	});
+
+	if(!benchmark::WriteJson(outputFile, "OverheadSuite", results))
+	{
+		std::fprintf(stderr, "Failed to write %s.\n", outputFile);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*
+	Round-trip check of the memory-file and pipe paths in wlr/Serialization.h
+
+	usage: SerializationCheck <layout directory>
+
+	Prints what failed and exits with code 1 at the first failure. Each path serializes an expression larger than a pipe
+	buffer and requires the expression read back to be SameQ to the original:
+
+		memory file - SerializeToBuffer, then Deserialize and DeserializeFromMemory of its bytes
+		pipe        - SerializeToString and SerializeToStream with several chunk sizes, including 0 and 1, which are
+					  raised to MinimumChunkSize, then DeserializeFromMemory and DeserializeFromStream
+		descriptor  - POSIX: SerializeToDescriptor into a temporary file, which must hold the same bytes
+		errors      - a sink that refuses data makes SerializeToStream fail, and truncated data does not deserialize
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/Expr.h"
+#include "wlr/ExpressionBuilder.h"
+#include "wlr/Serialization.h"
+
+namespace
+{
+	/**
+		A list of 20,000 records {i, "record i", i / 4.}, several hundred kilobytes once serialized
+	*/
+	wlr_expr MakeExpression()
+	{
+		wlr_exprbag bag = wlr_ExpressionBag();
+
+		for(mint index = 0; index < 20000; ++index)
+		{
+			const std::string name = "record " + std::to_string(index);
+
+			wlr_AddExpression(bag, wlr::List(wlr_Integer(index), wlr::ToExpression(name),
+											 wlr_Real(static_cast<mreal>(index) / 4.0)));
+		}
+
+		wlr_expr result = wlr_ExpressionBagToExpression(bag, wlr::Symbol(wlr::SystemSymbol::List));
+		wlr_ReleaseExpressionBag(bag);
+
+		return result;
+	}
+
+	void RequireSame(wlr_expr readBack, wlr_expr original, const char* what)
+	{
+		benchmark::Require(!wlr_ErrorQ(readBack) && wlr_SameQ(readBack, original), what);
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	wlr::ExpressionPool pool;
+
+	wlr_expr expression = MakeExpression();
+
+	// Memory file
+	wlr::SerializedBuffer buffer;
+
+	benchmark::Require(wlr::SerializeToBuffer(expression, buffer) == WLR_SUCCESS, "memory file: SerializeToBuffer");
+	benchmark::Require(buffer.Size() > (std::size_t(1) << 17), "memory file: the data is larger than a pipe buffer");
+
+	RequireSame(wlr::Deserialize(buffer), expression, "memory file: Deserialize of the buffer");
+	RequireSame(wlr::DeserializeFromMemory(buffer.View()), expression, "memory file: DeserializeFromMemory");
+
+	// Pipe, with chunks below the minimum, around it and above a pipe buffer
+	std::string bytes;
+
+	for(std::size_t chunkSize : {std::size_t(0), std::size_t(1), std::size_t(4097), std::size_t(1) << 20})
+	{
+		benchmark::Require(wlr::SerializeToString(expression, bytes, chunkSize) == WLR_SUCCESS,
+						   "pipe: SerializeToString");
+		benchmark::Require(bytes == buffer.View(), "pipe: the same bytes as the memory file");
+
+		std::vector<std::size_t> chunks;
+		std::string streamed;
+
+		benchmark::Require(wlr::SerializeToStream(
+							   expression,
+							   [&](const char* data, std::size_t size) {
+								   chunks.push_back(size);
+								   streamed.append(data, size);
+								   return true;
+							   },
+							   chunkSize) == WLR_SUCCESS,
+						   "pipe: SerializeToStream");
+		benchmark::Require(streamed == bytes, "pipe: SerializeToStream delivers every byte in order");
+
+		for(std::size_t size : chunks)
+		{
+			benchmark::Require(size > 0 && size <= std::max(chunkSize, wlr::MinimumChunkSize),
+							   "pipe: every chunk fits the chunk size");
+		}
+
+		RequireSame(wlr::DeserializeFromMemory(bytes, chunkSize), expression, "pipe: DeserializeFromMemory");
+
+		std::size_t offset = 0;
+		std::size_t largestRequest = 0;
+
+		wlr_expr streamedBack = wlr::DeserializeFromStream(
+			[&](char* data, std::size_t capacity) {
+				largestRequest = std::max(largestRequest, capacity);
+
+				const std::size_t count = std::min(capacity, bytes.size() - offset);
+				bytes.copy(data, count, offset);
+				offset += count;
+				return count;
+			},
+			chunkSize);
+
+		RequireSame(streamedBack, expression, "pipe: DeserializeFromStream");
+		benchmark::Require(largestRequest >= wlr::MinimumChunkSize, "pipe: the source is asked for whole chunks");
+	}
+
+#if !defined(_WIN32)
+	// Descriptor
+	std::FILE* file = std::tmpfile();
+
+	benchmark::Require(file != nullptr, "descriptor: creating a temporary file");
+	benchmark::Require(wlr::SerializeToDescriptor(expression, fileno(file)) == WLR_SUCCESS,
+					   "descriptor: SerializeToDescriptor");
+
+	std::string fromFile(bytes.size() + 1, '\0');
+
+	std::rewind(file);
+	fromFile.resize(std::fread(&fromFile[0], 1, fromFile.size(), file));
+	std::fclose(file);
+
+	benchmark::Require(fromFile == bytes, "descriptor: the file holds the serialized bytes");
+#endif
+
+	// Errors
+	benchmark::Require(wlr::SerializeToStream(expression, [](const char*, std::size_t) { return false; }) ==
+						   WLR_MISCELLANEOUS_ERROR,
+					   "errors: a refusing sink fails SerializeToStream");
+	benchmark::Require(wlr_ErrorQ(wlr::DeserializeFromMemory(bytes.substr(0, bytes.size() / 2))),
+					   "errors: half of the data does not deserialize");
+
+	std::printf("Serialization checks passed, %zu bytes\n", bytes.size());
+
+	return 0;
+}
@@ -0,0 +1,103 @@
+/*
+	Compare string extraction patterns on a list of 10,000 strings
+
+		copy per string    - wlr_StringData, copy into std::string, wlr_Release (StringFromExpression in SampleProgram.cs)
+		view per string    - wlr::StringData, read through std::string_view without copying
+		arena              - wlr::ExtractStrings, all strings at once
+
+	Every call is checked and the run stops at the first failure. The arena is also checked to hold every string of the
+	list, in order.
+*/
+
+#include <string>
+
+#include "Benchmark.h"
+#include "wlr/Strings.h"
+#include "wlr/Symbols.h"
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	const mint stringCount = 10000;
+
+	// Built from the host rather than with Table, so that the list does not depend on the evaluator
+	wlr_exprbag bag = wlr_ExpressionBag();
+
+	for(mint index = 1; index <= stringCount; ++index)
+	{
+		const std::string text = "result-" + std::to_string(index);
+
+		wlr_AddExpression(bag, wlr_StringFromData(text.data(), static_cast<mint>(text.size())));
+	}
+
+	wlr::Expr strings = wlr::Expr::Detach(wlr_ExpressionBagToExpression(bag, wlr::Symbol(wlr::SystemSymbol::List)));
+	wlr_ReleaseExpressionBag(bag);
+
+	benchmark::Require(wlr_Length(strings.Get()) == stringCount, "building the list of strings");
+
+	wlr::RecyclingExpressionPool pool(16);
+
+	const std::size_t iterations = 100;
+
+	std::size_t totalBytes = 0;
+
+	benchmark::Print(benchmark::Measure("10000 strings, copy per string", iterations, [&] {
+		for(mint index = 1; index <= stringCount; ++index)
+		{
+			char* stringData = nullptr;
+			mint stringDataLength = 0;
+
+			benchmark::Require(wlr_StringData(wlr_Part(strings.Get(), index), &stringData, &stringDataLength) ==
+								   WLR_SUCCESS,
+							   "wlr_StringData");
+
+			std::string copy(stringData, static_cast<std::size_t>(stringDataLength));
+
+			wlr_Release(stringData);
+
+			totalBytes += copy.size();
+		}
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("10000 strings, wlr::StringData view", iterations, [&] {
+		for(mint index = 1; index <= stringCount; ++index)
+		{
+			wlr::StringData stringData(wlr_Part(strings.Get(), index));
+
+			benchmark::Require(stringData.Error() == WLR_SUCCESS, "wlr::StringData");
+
+			totalBytes += stringData.View().size();
+		}
+		pool.EndRequest();
+	}));
+
+	wlr::StringArena probe;
+
+	benchmark::Require(wlr::ExtractStrings(strings.Get(), probe) == WLR_SUCCESS, "wlr::ExtractStrings");
+	benchmark::Require(probe.Size() == static_cast<std::size_t>(stringCount), "wlr::ExtractStrings string count");
+
+	for(std::size_t index = 0; index < probe.Size(); ++index)
+	{
+		benchmark::Require(probe[index] == "result-" + std::to_string(index + 1), "wlr::ExtractStrings contents");
+	}
+	pool.EndRequest();
+
+	benchmark::Print(benchmark::Measure("10000 strings, wlr::ExtractStrings arena", iterations, [&] {
+		wlr::StringArena arena;
+
+		benchmark::Require(wlr::ExtractStrings(strings.Get(), arena) == WLR_SUCCESS, "wlr::ExtractStrings");
+
+		for(std::size_t index = 0; index < arena.Size(); ++index)
+		{
+			totalBytes += arena[index].size();
+		}
+		pool.EndRequest();
+	}));
+
+	return totalBytes == 0;
+}
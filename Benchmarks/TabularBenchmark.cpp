@@ -0,0 +1,298 @@
+/*
+	Compare moving a table between host columns and the runtime row by row with the columnar paths in wlr/Tabular.h
+
+	usage: TabularBenchmark <layout directory> [results.json]
+
+	The table has 100,000 rows and three columns: an Integer64 id, a Real64 score with every hundredth row missing,
+	and a short UTF-8 name. Writing row by row builds one association per row with a call per cell; writing by columns
+	encodes the columns with wlr::TabularExpression and evaluates it once. The cost of evaluating the deserialized
+	columns depends on the runtime, so the encoding is also measured alone. Reading compares wlr_Part and the *Data
+	functions per cell with wlr::EvaluateToColumns, and with decoding alone bytes encoded as the kernel sends them.
+	The table is written with TabularExpression and read back with EvaluateToColumns before anything is timed, and the
+	program exits with code 1 unless the columns come back unchanged.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/ExpressionBuilder.h"
+#include "wlr/Strings.h"
+#include "wlr/Tabular.h"
+
+namespace
+{
+	struct Table
+	{
+		std::vector<std::int64_t> ids;
+		std::vector<double> scores;
+		std::vector<std::uint8_t> scoreValidity;
+		std::string names;
+		std::vector<mint> nameOffsets;
+
+		mint Rows() const noexcept
+		{
+			return static_cast<mint>(ids.size());
+		}
+
+		bool ScoreValid(std::size_t row) const noexcept
+		{
+			return (scoreValidity[row / 8] >> (row % 8)) & 1;
+		}
+	};
+
+	Table MakeTable(std::size_t rows)
+	{
+		Table table;
+
+		table.ids.resize(rows);
+		table.scores.resize(rows);
+		table.scoreValidity.assign((rows + 7) / 8, 0xFF);
+		table.nameOffsets.assign(1, 0);
+
+		for(std::size_t row = 0; row < rows; ++row)
+		{
+			table.ids[row] = static_cast<std::int64_t>(row);
+			table.scores[row] = static_cast<double>(row) * 0.25;
+
+			if(row % 100 == 99)
+			{
+				table.scoreValidity[row / 8] &= static_cast<std::uint8_t>(~(1u << (row % 8)));
+			}
+
+			table.names += "name " + std::to_string(row % 1000);
+			table.nameOffsets.push_back(static_cast<mint>(table.names.size()));
+		}
+
+		return table;
+	}
+
+	std::vector<wlr::TabularColumn> Columns(const Table& table)
+	{
+		return {wlr::TabularColumn::Numeric("id", table.ids.data()),
+				wlr::TabularColumn::Numeric("score", table.scores.data(), table.scoreValidity.data()),
+				wlr::TabularColumn::Strings("name", table.names.data(), table.nameOffsets.data())};
+	}
+
+	wlr_expr BuildRows(const Table& table)
+	{
+		wlr_exprbag rowBag = wlr_ExpressionBag();
+
+		for(std::size_t row = 0; row < table.ids.size(); ++row)
+		{
+			const mint begin = table.nameOffsets[row];
+
+			wlr_AddExpression(
+				rowBag,
+				wlr::Association(
+					wlr::Rule("id", wlr_Integer(table.ids[row])),
+					wlr::Rule("score", table.ScoreValid(row) ? wlr_Real(table.scores[row])
+															 : wlr::E(wlr::Symbol("Missing"), wlr_String("NotAvailable"))),
+					wlr::Rule("name", wlr_StringFromData(table.names.data() + begin, table.nameOffsets[row + 1] - begin))));
+		}
+
+		wlr_expr rows = wlr_ExpressionBagToExpression(rowBag, wlr::Symbol(wlr::SystemSymbol::List));
+		wlr_ReleaseExpressionBag(rowBag);
+
+		return wlr::E(wlr::Symbol("Tabular"), rows);
+	}
+
+	/**
+		Rows as {id, score, name} lists, the shape a per-cell reader walks
+	*/
+	wlr_expr BuildRowLists(const Table& table)
+	{
+		wlr_exprbag rowBag = wlr_ExpressionBag();
+
+		for(std::size_t row = 0; row < table.ids.size(); ++row)
+		{
+			const mint begin = table.nameOffsets[row];
+
+			wlr_AddExpression(rowBag, wlr::List(wlr_Integer(table.ids[row]), wlr_Real(table.scores[row]),
+												wlr_StringFromData(table.names.data() + begin,
+																   table.nameOffsets[row + 1] - begin)));
+		}
+
+		wlr_expr rows = wlr_ExpressionBagToExpression(rowBag, wlr::Symbol(wlr::SystemSymbol::List));
+		wlr_ReleaseExpressionBag(rowBag);
+
+		return rows;
+	}
+
+	void ReadRowsByPart(wlr_expr rows, Table& table)
+	{
+		const mint count = wlr_Length(rows);
+
+		table.ids.resize(static_cast<std::size_t>(count));
+		table.scores.resize(static_cast<std::size_t>(count));
+		table.names.clear();
+		table.nameOffsets.assign(1, 0);
+
+		for(mint index = 1; index <= count; ++index)
+		{
+			wlr_expr row = wlr_Part(rows, index);
+			mint id = 0;
+
+			wlr_IntegerData(wlr_Part(row, 1), &id);
+			wlr_RealData(wlr_Part(row, 2), &table.scores[static_cast<std::size_t>(index - 1)]);
+
+			table.ids[static_cast<std::size_t>(index - 1)] = id;
+			table.names += wlr::StringData(wlr_Part(row, 3)).View();
+			table.nameOffsets.push_back(static_cast<mint>(table.names.size()));
+		}
+	}
+
+	/**
+		Columns in the form the kernel side of wlr::EvaluateToColumns serializes them
+		@remarks BinarySerialize narrows packed integers, so the ids, offsets and invalid positions go out as Integer32.
+	*/
+	std::string EncodeAsKernel(const Table& table)
+	{
+		std::vector<std::int64_t> invalid;
+
+		for(std::size_t row = 0; row < table.ids.size(); ++row)
+		{
+			if(!table.ScoreValid(row))
+			{
+				invalid.push_back(static_cast<std::int64_t>(row) + 1);
+			}
+		}
+
+		const mint rows = table.Rows();
+		const mint offsetCount = rows + 1;
+		const mint invalidCount = static_cast<mint>(invalid.size());
+
+		wlr::WxfWriter writer;
+
+		writer.List(3);
+		writer.List(4).String("id").Integer(0).PackedIntegers(table.ids.data(), &rows, 1).List(0);
+		writer.List(4).String("score").Integer(1).PackedArray(table.scores.data(), &rows, 1);
+		writer.PackedIntegers(invalid.data(), &invalidCount, 1);
+		writer.List(4).String("name").Integer(2).List(2).String(table.names);
+		writer.PackedIntegers(table.nameOffsets.data(), &offsetCount, 1).List(0);
+
+		return std::string(writer.Bytes());
+	}
+
+	/**
+		True if decoded holds the columns of table, ignoring the scores of rows that are not valid
+	*/
+	bool SameColumns(const wlr::TabularColumns& decoded, const Table& table)
+	{
+		const std::size_t rows = table.ids.size();
+
+		if(decoded.ColumnCount() != 3 || decoded.RowCount() != table.Rows() || decoded.Find("id") == 3 ||
+		   decoded.Find("score") == 3 || decoded.Find("name") == 3)
+		{
+			return false;
+		}
+
+		const wlr::TabularColumnView& id = decoded[decoded.Find("id")];
+		const wlr::TabularColumnView& score = decoded[decoded.Find("score")];
+		const wlr::TabularColumnView& name = decoded[decoded.Find("name")];
+
+		if(id.kind != wlr::TabularColumnKind::Integer || score.kind != wlr::TabularColumnKind::Real ||
+		   name.kind != wlr::TabularColumnKind::String || id.validity != nullptr || score.validity == nullptr ||
+		   name.validity != nullptr)
+		{
+			return false;
+		}
+
+		std::vector<double> scores(rows);
+
+		if(!score.values.CopyArrayData(scores.data()))
+		{
+			return false;
+		}
+
+		for(std::size_t row = 0; row < rows; ++row)
+		{
+			const bool valid = (score.validity[row / 8] >> (row % 8)) & 1;
+
+			if(id.integers[row] != table.ids[row] || valid != table.ScoreValid(row) ||
+			   (valid && scores[row] != table.scores[row]) || name.stringOffsets[row + 1] != table.nameOffsets[row + 1])
+			{
+				return false;
+			}
+		}
+
+		return name.stringOffsets[0] == 0 && name.stringData == table.names;
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	const char* outputFile = argumentCount > 2 ? arguments[2] : "TabularBenchmark.json";
+
+	std::vector<benchmark::Result> results;
+
+	auto run = [&results](const std::string& name, std::size_t iterations, auto&& body) {
+		results.push_back(benchmark::Measure(name, iterations, body));
+		benchmark::Print(results.back());
+	};
+
+	wlr::RecyclingExpressionPool pool(4);
+
+	const Table table = MakeTable(100000);
+	const std::vector<wlr::TabularColumn> columns = Columns(table);
+	const std::size_t iterations = 5;
+
+	wlr::Expr tabular = wlr::Expr::Detach(wlr_Eval(wlr::TabularExpression(columns, table.Rows())));
+	wlr::TabularColumns decoded;
+
+	benchmark::Require(!wlr_ErrorQ(tabular.Get()) && wlr::EvaluateToColumns(tabular.Get(), decoded) == WLR_SUCCESS,
+					   "writing the table with TabularExpression and reading it with EvaluateToColumns");
+	benchmark::Require(SameColumns(decoded, table), "the columns read with EvaluateToColumns match the table");
+	pool.EndRequest();
+
+	run("write/association per row, 100k rows", iterations, [&] {
+		wlr_Eval(BuildRows(table));
+		pool.EndRequest();
+	});
+
+	run("write/TabularExpression, 100k rows", iterations, [&] {
+		wlr_Eval(wlr::TabularExpression(columns, table.Rows()));
+		pool.EndRequest();
+	});
+
+	run("encode/TabularExpression only, 100k rows", iterations, [&] {
+		wlr::TabularExpression(columns, table.Rows());
+		pool.EndRequest();
+	});
+
+	wlr::Expr rows = wlr::Expr::Detach(wlr_Eval(BuildRowLists(table)));
+	Table readBack;
+
+	run("read/wlr_Part per cell, 100k rows", iterations, [&] {
+		ReadRowsByPart(rows.Get(), readBack);
+		pool.EndRequest();
+	});
+
+	run("read/EvaluateToColumns, 100k rows", iterations, [&] {
+		benchmark::Require(wlr::EvaluateToColumns(tabular.Get(), decoded) == WLR_SUCCESS, "EvaluateToColumns");
+		pool.EndRequest();
+	});
+
+	const std::string bytes = EncodeAsKernel(table);
+
+	run("read/TabularColumns::Parse, 100k rows", iterations, [&] {
+		benchmark::Require(decoded.Parse(bytes) == WLR_SUCCESS, "decoding the columns");
+	});
+
+	benchmark::Require(SameColumns(decoded, table), "the decoded columns match the table");
+
+	if(!benchmark::WriteJson(outputFile, "TabularBenchmark", results))
+	{
+		std::fprintf(stderr, "Failed to write %s.\n", outputFile);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,56 @@
+/*
+	Compare instantiating a wlr::ExpressionTemplate with formatting and parsing the same input text
+*/
+
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "wlr/ExpressionTemplate.h"
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	wlr::RecyclingExpressionPool pool(1024);
+
+	const std::size_t iterations = 100000;
+
+	double x = 0.5;
+
+	auto format = [](double value) {
+		char input[128];
+		std::snprintf(input, sizeof(input), "N[Sin[%.17g] + Cos[%d]^2, 20]", value, 7);
+		return wlr_ParseExpression(wlr_String(input));
+	};
+
+	const wlr::ExpressionTemplate power = wlr::ExpressionTemplate::Parse("N[Sin[#x] + Cos[#y]^2, 20]");
+
+	benchmark::Require(power.Valid() && power.PlaceholderCount() == 2, "parsing the template");
+	benchmark::Require(wlr_SameQ(power.Instantiate(x, 7), format(x)),
+					   "the instantiated template is the expression the formatted text parses to");
+
+	// Numbered slots take their values by number, wherever they first appear
+	const wlr::ExpressionTemplate swapped = wlr::ExpressionTemplate::Parse("f[#2, #1, #2]");
+
+	benchmark::Require(swapped.Valid() && swapped.PlaceholderCount() == 2, "parsing a template with numbered slots");
+	benchmark::Require(wlr_SameQ(swapped.Instantiate(1, 2), wlr_ParseExpression(wlr_String("f[2, 1, 2]"))),
+					   "#n takes the n-th value");
+	pool.EndRequest();
+
+	benchmark::Print(benchmark::Measure("format + wlr_ParseExpression", iterations, [&] {
+		benchmark::Require(!wlr_ErrorQ(format(x)), "parsing the formatted input");
+		x += 1.0;
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("wlr::ExpressionTemplate::Instantiate", iterations, [&] {
+		benchmark::Require(!wlr_ErrorQ(power.Instantiate(x, 7)), "instantiating the template");
+		x += 1.0;
+		pool.EndRequest();
+	}));
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+	Compare per-element marshaling of 100,000 reals with the bulk paths in wlr/Tensor.h
+
+	Every read is checked for success and for the number of elements read, and the values of each tensor are checked
+	against the source data before its time is printed. Reading a matrix or an unpacked list packs it inside the kernel.
+*/
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/Tensor.h"
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	wlr::RecyclingExpressionPool pool(16);
+
+	std::vector<mreal> values(100000);
+	std::iota(values.begin(), values.end(), 0.5);
+
+	const mint length = static_cast<mint>(values.size());
+	const mint matrixDimensions[] = {length / 100, 100};
+
+	const std::size_t iterations = 100;
+
+	benchmark::Print(benchmark::Measure("build, wlr_Real per element", iterations, [&] {
+		wlr_exprbag expressionBag = wlr_ExpressionBag();
+		for(mreal value : values)
+		{
+			wlr_AddExpression(expressionBag, wlr_Real(value));
+		}
+		wlr_ExpressionBagToExpression(expressionBag, wlr::Symbol(wlr::SystemSymbol::List));
+		wlr_ReleaseExpressionBag(expressionBag);
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("build, wlr::TensorExpression rank 1", iterations, [&] {
+		wlr::TensorExpression(values.data(), &length, 1);
+		pool.EndRequest();
+	}));
+
+	benchmark::Print(benchmark::Measure("build, wlr::TensorExpression rank 2", iterations, [&] {
+		wlr::TensorExpression(values.data(), matrixDimensions, 2);
+		pool.EndRequest();
+	}));
+
+	wlr::Expr vector = wlr::Expr::Detach(wlr::TensorExpression(values.data(), &length, 1));
+	wlr::Expr matrix = wlr::Expr::Detach(wlr_Eval(wlr::TensorExpression(values.data(), matrixDimensions, 2)));
+	wlr::Expr unpacked = wlr::Expr::Detach(wlr_Eval(wlr::E(wlr::Symbol("Developer`FromPackedArray"), vector.Get())));
+
+	std::vector<mreal> readBack(values.size());
+
+	benchmark::Print(benchmark::Measure("read, wlr_Part per element", iterations, [&] {
+		for(mint index = 0; index < length; ++index)
+		{
+			mreal& value = readBack[static_cast<std::size_t>(index)];
+
+			benchmark::Require(wlr_RealData(wlr_Part(vector.Get(), index + 1), &value) == WLR_SUCCESS, "wlr_RealData");
+		}
+		pool.EndRequest();
+	}));
+
+	wlr::NumericArray result;
+
+	auto readTensor = [&](const char* name, const wlr::Expr& tensor) {
+		benchmark::Require(wlr::TensorData<mreal>(tensor.Get(), result) == WLR_SUCCESS, "wlr::TensorData");
+		benchmark::Require(wlr_MNumericArray_getFlattenedLength(result.Get()) == length,
+						   "wlr::TensorData element count");
+
+		const mreal* data = static_cast<const mreal*>(wlr_MNumericArray_getData(result.Get()));
+
+		benchmark::Require(std::equal(values.begin(), values.end(), data), "wlr::TensorData values");
+		pool.EndRequest();
+
+		benchmark::Print(benchmark::Measure(name, iterations, [&] {
+			benchmark::Require(wlr::TensorData<mreal>(tensor.Get(), result) == WLR_SUCCESS, "wlr::TensorData");
+			benchmark::Require(wlr_MNumericArray_getFlattenedLength(result.Get()) == length,
+							   "wlr::TensorData element count");
+			pool.EndRequest();
+		}));
+	};
+
+	readTensor("read, wlr::TensorData packed vector", vector);
+	readTensor("read, wlr::TensorData packed matrix", matrix);
+	readTensor("read, wlr::TensorData unpacked vector", unpacked);
+
+	return 0;
+}
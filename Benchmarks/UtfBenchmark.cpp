@@ -0,0 +1,166 @@
+/*
+	Throughput of the UTF-8 <-> UTF-16 transcoders in wlr/Utf.h at each instruction set level the CPU supports
+
+	usage: UtfBenchmark <layout directory> [results.json]
+
+	Each measurement converts 1 MB of text: ASCII expression text, and the same text with a non-ASCII character every
+	40 characters (mixing 2-, 3- and 4-byte UTF-8). The last measurements build a list of 10,000 strings from UTF-16,
+	the bulk path for string arrays.
+*/
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/Utf.h"
+
+namespace
+{
+	std::string MakeText(std::size_t size, bool mixed)
+	{
+		static const char* const nonAscii[] = {"\xC3\xA9", "\xCE\xBB", "\xE2\x88\x9E", "\xE6\x95\xB0", "\xF0\x9D\x94\xB8"};
+
+		const std::string expression = "Plot[Sin[x] + Cos[2 x], {x, 0, 2 Pi}, PlotRange -> All] ";
+
+		std::string text;
+		text.reserve(size + 64);
+
+		for(std::size_t index = 0; text.size() < size; ++index)
+		{
+			text += expression[index % expression.size()];
+
+			if(mixed && index % 40 == 39)
+			{
+				text += nonAscii[(index / 40) % 5];
+			}
+		}
+
+		return text;
+	}
+
+	const char* LevelName(wlr::SimdLevel level)
+	{
+		switch(level)
+		{
+			case wlr::SimdLevel::SSE41:
+				return "SSE4.1";
+			case wlr::SimdLevel::AVX2:
+				return "AVX2";
+			case wlr::SimdLevel::AVX512:
+				return "AVX-512";
+			case wlr::SimdLevel::NEON:
+				return "NEON";
+			default:
+				return "scalar";
+		}
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	const char* outputFile = argumentCount > 2 ? arguments[2] : "UtfBenchmark.json";
+
+	std::vector<benchmark::Result> results;
+
+	auto run = [&results](const std::string& name, std::size_t iterations, auto&& body) {
+		results.push_back(benchmark::Measure(name, iterations, body));
+		benchmark::Print(results.back());
+	};
+
+	// Every level up to the active one; on x86 they are ordered, and NEON is the only vector level on AArch64
+	std::vector<wlr::SimdLevel> levels = {wlr::SimdLevel::Scalar};
+
+	for(wlr::SimdLevel level : {wlr::SimdLevel::SSE41, wlr::SimdLevel::AVX2, wlr::SimdLevel::AVX512})
+	{
+		if(wlr::ActiveSimdLevel() != wlr::SimdLevel::NEON && level <= wlr::ActiveSimdLevel())
+		{
+			levels.push_back(level);
+		}
+	}
+
+	if(wlr::ActiveSimdLevel() == wlr::SimdLevel::NEON)
+	{
+		levels.push_back(wlr::SimdLevel::NEON);
+	}
+
+	const std::size_t iterations = 200;
+
+	// Results are stored here so that the conversions cannot be optimized away
+	volatile std::size_t sink = 0;
+
+	for(bool mixed : {false, true})
+	{
+		const std::string utf8 = MakeText(1 << 20, mixed);
+		const std::string label = mixed ? "mixed" : "ASCII";
+
+		std::u16string utf16;
+		wlr::Utf8ToUtf16(utf8, utf16);
+
+		std::vector<char16_t> units(wlr::MaximumUtf16Length(utf8.size()));
+		std::vector<char> bytes(wlr::MaximumUtf8Length(utf16.size()));
+
+		for(wlr::SimdLevel level : levels)
+		{
+			const std::string suffix = " 1 MB " + label + ", " + LevelName(level);
+
+			run("validate UTF-8" + suffix, iterations, [&] { sink = wlr::ValidateUtf8(utf8.data(), utf8.size(), level).read; });
+
+			run("UTF-8 -> UTF-16" + suffix, iterations,
+				[&] { sink = wlr::Utf8ToUtf16(utf8.data(), utf8.size(), units.data(), units.size(), level).written; });
+
+			run("UTF-16 -> UTF-8" + suffix, iterations,
+				[&] { sink = wlr::Utf16ToUtf8(utf16.data(), utf16.size(), bytes.data(), bytes.size(), level).written; });
+		}
+	}
+
+	// 10,000 short strings, as a .NET front end would pass a string[]
+	std::u16string strings;
+	std::vector<std::size_t> offsets = {0};
+
+	for(int index = 0; index < 10000; ++index)
+	{
+		std::u16string string;
+		wlr::Utf8ToUtf16("result-" + std::to_string(index), string);
+
+		strings += string;
+		offsets.push_back(strings.size());
+	}
+
+	wlr::RecyclingExpressionPool pool(16);
+
+	run("StringListFromUtf16, 10000 strings", 100, [&] {
+		wlr_expr list;
+		wlr::StringListFromUtf16(strings.data(), offsets.data(), offsets.size() - 1, list);
+		pool.EndRequest();
+	});
+
+	run("wlr_String per string after scalar transcoding, 10000 strings", 100, [&] {
+		wlr_exprbag bag = wlr_ExpressionBag();
+		std::string bytes;
+
+		for(std::size_t index = 0; index + 1 < offsets.size(); ++index)
+		{
+			wlr::Utf16ToUtf8(std::u16string_view(strings.data() + offsets[index], offsets[index + 1] - offsets[index]),
+							 bytes);
+			wlr_AddExpression(bag, wlr_String(bytes.c_str()));
+		}
+
+		wlr_ExpressionBagToExpression(bag, wlr::Symbol(wlr::SystemSymbol::List));
+		wlr_ReleaseExpressionBag(bag);
+		pool.EndRequest();
+	});
+
+	if(!benchmark::WriteJson(outputFile, "UtfBenchmark", results))
+	{
+		std::fprintf(stderr, "Failed to write %s.\n", outputFile);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+/*
+	Check of the deadline overloads of EvaluateToOutputForm in wlr/Watchdog.h
+
+	usage: WatchdogCheck <layout directory>
+
+	Prints what failed and exits with code 1 at the first failure:
+
+		success  - an input that finishes well within its deadline returns its output and is not aborted
+		timeout  - a slow input with a short deadline is aborted and returns EvaluationStatus::TimedOut
+		recovery - the evaluation after the abort succeeds, so the abort was cleared
+		expired  - a deadline that passed before the call times out without arming the watchdog
+
+	Against Benchmarks/FakeRuntime, every wlr_Eval takes WLR_FAKE_EVAL_LATENCY_NS, which the check sets to 50 ms unless
+	it is already set; a value set by the caller must exceed the 20 ms deadline of the slow input. Against the real
+	runtime the slow input is Pause[1].
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Benchmark.h"
+#include "wlr/Watchdog.h"
+
+int main(int argumentCount, char** arguments)
+{
+	// The fake runtime reads the latency when it starts; the real runtime ignores the variable
+#if defined(_WIN32)
+	if(std::getenv("WLR_FAKE_EVAL_LATENCY_NS") == nullptr)
+	{
+		_putenv_s("WLR_FAKE_EVAL_LATENCY_NS", "50000000");
+	}
+#else
+	setenv("WLR_FAKE_EVAL_LATENCY_NS", "50000000", 0);
+#endif
+
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	wlr::ExpressionPool pool;
+
+	wlr::EvaluationWatchdog watchdog;
+
+	using std::chrono::milliseconds;
+	using std::chrono::seconds;
+
+	// Success
+	wlr::EvaluationResult result = wlr::EvaluateToOutputForm("1 + 2", seconds(10), watchdog);
+
+	benchmark::Require(result.status == wlr::EvaluationStatus::Success && result.output == "3",
+					   "success: 1 + 2 within its deadline");
+	benchmark::Require(watchdog.Statistics().aborts == 0, "success: the watchdog did not abort");
+
+	// Timeout
+	const auto start = wlr::EvaluationWatchdog::Clock::now();
+
+	result = wlr::EvaluateToOutputForm("Pause[1]", milliseconds(20), watchdog);
+
+	const auto elapsed = wlr::EvaluationWatchdog::Clock::now() - start;
+
+	benchmark::Require(result.status == wlr::EvaluationStatus::TimedOut && result.output.empty(),
+					   "timeout: a slow input times out");
+	benchmark::Require(watchdog.Statistics().aborts == 1 && watchdog.Statistics().timeouts == 1,
+					   "timeout: the watchdog aborted once");
+	benchmark::Require(elapsed < milliseconds(1000), "timeout: the abort cut the evaluation short");
+
+	// Recovery
+	result = wlr::EvaluateToOutputForm("2 + 3", seconds(10), watchdog);
+
+	benchmark::Require(result.status == wlr::EvaluationStatus::Success && result.output == "5",
+					   "recovery: the next evaluation succeeds");
+
+	// Expired
+	result = wlr::EvaluateToOutputForm("1 + 2", wlr::EvaluationWatchdog::Clock::now() - milliseconds(1), watchdog);
+
+	const wlr::WatchdogStatistics statistics = watchdog.Statistics();
+
+	benchmark::Require(result.status == wlr::EvaluationStatus::TimedOut, "expired: a passed deadline times out");
+	benchmark::Require(statistics.armed == 3 && statistics.aborts == 1 && statistics.timeouts == 2,
+					   "expired: the watchdog was not armed");
+
+	std::printf("Watchdog checks passed, timeout after %.1f ms\n",
+				std::chrono::duration<double, std::milli>(elapsed).count());
+
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*
+	Throughput of wlr::WorkerPool for 1, 2, 4, ... workers, up to one per available CPU
+
+	usage: WorkerPoolBenchmark <layout directory> [results.json]
+
+	Unlike the other benchmarks, this program does not start a runtime itself: every worker process starts its own.
+	Each measurement sends the same number of independent requests and reports the mean wall-clock time per request, so
+	linear scaling shows up as the time halving when the worker count doubles. The last measurement passes a
+	1,000,000-element tensor through the shared arena with every request.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/WorkerPool.h"
+
+int main(int argumentCount, char** arguments)
+{
+	if(argumentCount < 2)
+	{
+		std::fprintf(stderr, "usage: %s <layout directory> [results.json]\n", arguments[0]);
+		return 1;
+	}
+
+	const std::string layoutDirectory = arguments[1];
+	const char* outputFile = argumentCount > 2 ? arguments[2] : "WorkerPoolBenchmark.json";
+
+	auto startRuntime = [&layoutDirectory](std::size_t) {
+		wlr_runtime_conf configuration;
+		wlr_InitializeRuntimeConfiguration(&configuration);
+
+		return wlr_sdk_StartRuntime(WLR_EXECUTABLE, WLR_VERSION_1, WLR_LICENSE_OR_SIGNED_CODE_MODE,
+									layoutDirectory.c_str(), &configuration);
+	};
+
+	const std::size_t maximumWorkers = std::max(1u, std::thread::hardware_concurrency());
+	const std::size_t requests = 2000;
+
+	std::vector<benchmark::Result> results;
+
+	// Every request must succeed, on every worker, with the same output
+	auto check = [](std::future<wlr::EvaluationResult>& pending, const std::string& expected) {
+		const wlr::EvaluationResult result = pending.get();
+
+		benchmark::Require(result.status == wlr::EvaluationStatus::Success && !result.output.empty(),
+						   "a worker pool request");
+		benchmark::Require(result.output == expected, "every worker returns the same output");
+	};
+
+	auto measure = [&](const std::string& name, std::size_t requests, wlr::WorkerPool& pool, auto&& submit) {
+		// Wait for every worker to start its runtime before timing
+		std::vector<std::future<wlr::EvaluationResult>> warmup;
+		for(std::size_t index = 0; index < pool.WorkerCount() * 4; ++index)
+		{
+			warmup.push_back(submit());
+		}
+
+		const std::string expected = submit().get().output;
+
+		for(auto& result : warmup)
+		{
+			check(result, expected);
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::future<wlr::EvaluationResult>> pending;
+		pending.reserve(requests);
+
+		for(std::size_t index = 0; index < requests; ++index)
+		{
+			pending.push_back(submit());
+		}
+
+		for(auto& result : pending)
+		{
+			check(result, expected);
+		}
+
+		const double nanoseconds = static_cast<double>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+		results.push_back(benchmark::Result {name, requests, nanoseconds / static_cast<double>(requests)});
+		benchmark::Print(results.back());
+	};
+
+	for(std::size_t workers = 1;; workers = std::min(workers * 2, maximumWorkers))
+	{
+		wlr::WorkerPoolOptions options;
+		options.workerCount = workers;
+
+		wlr::WorkerPool pool(startRuntime, options);
+
+		std::future<wlr::EvaluationResult> sum = pool.Evaluate("1 + 2");
+		check(sum, "3");
+
+		std::future<wlr::EvaluationResult> malformed = pool.Evaluate("1 +");
+		benchmark::Require(malformed.get().status == wlr::EvaluationStatus::Failed, "input that does not parse fails");
+
+		measure("evaluate, " + std::to_string(workers) + " workers", requests, pool,
+				[&] { return pool.Evaluate("Total[Range[10^5]^2]"); });
+
+		if(workers == maximumWorkers)
+		{
+			const mint length = 1000000;
+
+			wlr::SharedTensor argument = pool.AllocateTensor(MNumericArray_Type_Real64, 1, &length);
+			std::iota(argument.Data<mreal>(), argument.Data<mreal>() + length, 0.0);
+
+			measure("apply to 10^6 reals in shared memory, " + std::to_string(workers) + " workers", requests / 10, pool,
+					[&] { return pool.Apply("Total", argument); });
+
+			break;
+		}
+	}
+
+	if(!benchmark::WriteJson(outputFile, "WorkerPoolBenchmark", results))
+	{
+		std::fprintf(stderr, "Failed to write %s.\n", outputFile);
+		return 1;
+	}
+
+	return 0;
+}
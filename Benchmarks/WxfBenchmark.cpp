@@ -0,0 +1,268 @@
+/*
+	Compare moving a large nested result between the runtime and native C++ structures node by node with the bulk WXF
+	paths in wlr/Wxf.h
+
+	usage: WxfBenchmark <layout directory> [results.json]
+
+	The data is a list of 10,000 records {id, name, score, {tags...}, {values...}}, where values is a packed vector of
+	16 reals. Reading it node by node takes one wlr_Part call per field and tag and one wlr_StringData per string;
+	reading it through WXF takes one evaluation and a native decode. Writing compares building the expression with the
+	variadic builders against encoding it with wlr::WxfWriter and deserializing it in one evaluation.
+*/
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "wlr/Evaluate.h"
+#include "wlr/ExpressionBuilder.h"
+#include "wlr/RuntimeBuffer.h"
+#include "wlr/Wxf.h"
+
+namespace
+{
+	struct Record
+	{
+		mint id;
+		std::string name;
+		mreal score;
+		std::vector<std::string> tags;
+		std::vector<mreal> values;
+
+		bool operator==(const Record& other) const
+		{
+			return id == other.id && name == other.name && score == other.score && tags == other.tags &&
+				   values == other.values;
+		}
+	};
+
+	std::vector<Record> MakeRecords(std::size_t count)
+	{
+		std::vector<Record> records(count);
+
+		for(std::size_t index = 0; index < count; ++index)
+		{
+			Record& record = records[index];
+
+			record.id = static_cast<mint>(index);
+			record.name = "record " + std::to_string(index);
+			record.score = static_cast<mreal>(index) * 0.5;
+			record.tags = {"alpha", "beta", "tag " + std::to_string(index % 7)};
+			record.values.resize(16);
+
+			for(std::size_t value = 0; value < record.values.size(); ++value)
+			{
+				record.values[value] = static_cast<mreal>(index + value) * 0.25;
+			}
+		}
+
+		return records;
+	}
+
+	wlr_expr BuildRecords(const std::vector<Record>& records)
+	{
+		wlr_exprbag recordBag = wlr_ExpressionBag();
+
+		for(const Record& record : records)
+		{
+			wlr_exprbag tagBag = wlr_ExpressionBag();
+
+			for(const std::string& tag : record.tags)
+			{
+				wlr_AddExpression(tagBag, wlr_StringFromData(tag.data(), static_cast<mint>(tag.size())));
+			}
+
+			wlr_expr tags = wlr_ExpressionBagToExpression(tagBag, wlr::Symbol(wlr::SystemSymbol::List));
+			wlr_ReleaseExpressionBag(tagBag);
+
+			wlr_AddExpression(
+				recordBag,
+				wlr::List(wlr_Integer(record.id), wlr_StringFromData(record.name.data(), static_cast<mint>(record.name.size())),
+						  wlr_Real(record.score), tags,
+						  wlr_ExpressionFromRealArray(static_cast<mint>(record.values.size()), record.values.data(),
+													  wlr::Symbol(wlr::SystemSymbol::List))));
+		}
+
+		wlr_expr result = wlr_ExpressionBagToExpression(recordBag, wlr::Symbol(wlr::SystemSymbol::List));
+		wlr_ReleaseExpressionBag(recordBag);
+
+		return result;
+	}
+
+	void EncodeRecords(const std::vector<Record>& records, wlr::WxfWriter& writer)
+	{
+		writer.Clear();
+		writer.List(records.size());
+
+		for(const Record& record : records)
+		{
+			const mint length = static_cast<mint>(record.values.size());
+
+			writer.List(5).Integer(record.id).String(record.name).Real(record.score);
+
+			writer.List(record.tags.size());
+
+			for(const std::string& tag : record.tags)
+			{
+				writer.String(tag);
+			}
+
+			writer.PackedArray(record.values.data(), &length, 1);
+		}
+	}
+
+	void ReadRecordsByPart(wlr_expr expression, std::vector<Record>& records)
+	{
+		const mint count = wlr_Length(expression);
+
+		records.resize(static_cast<std::size_t>(count));
+
+		for(mint index = 1; index <= count; ++index)
+		{
+			wlr_expr recordExpression = wlr_Part(expression, index);
+			Record& record = records[static_cast<std::size_t>(index - 1)];
+
+			wlr_IntegerData(wlr_Part(recordExpression, 1), &record.id);
+			record.name = wlr::StringFromExpression(wlr_Part(recordExpression, 2));
+			wlr_RealData(wlr_Part(recordExpression, 3), &record.score);
+
+			wlr_expr tags = wlr_Part(recordExpression, 4);
+			const mint tagCount = wlr_Length(tags);
+
+			record.tags.resize(static_cast<std::size_t>(tagCount));
+
+			for(mint tag = 1; tag <= tagCount; ++tag)
+			{
+				record.tags[static_cast<std::size_t>(tag - 1)] = wlr::StringFromExpression(wlr_Part(tags, tag));
+			}
+
+			wlr::RuntimeBuffer<mreal> values;
+
+			if(wlr_RealArrayData(wlr_Part(recordExpression, 5), values.OutLength(), values.OutData()) == WLR_SUCCESS)
+			{
+				record.values.assign(values.Data(), values.Data() + values.Size());
+			}
+		}
+	}
+
+	void ReadRecordsFromWxf(wlr::WxfView list, std::vector<Record>& records)
+	{
+		records.resize(list.Length());
+
+		std::size_t index = 0;
+
+		for(wlr::WxfView recordView : list)
+		{
+			Record& record = records[index++];
+
+			record.id = static_cast<mint>(recordView.Part(1).Integer());
+			record.name = recordView.Part(2).Text();
+			record.score = recordView.Part(3).Real();
+
+			wlr::WxfView tags = recordView.Part(4);
+
+			record.tags.resize(tags.Length());
+
+			std::size_t tag = 0;
+
+			for(wlr::WxfView tagView : tags)
+			{
+				record.tags[tag++] = tagView.Text();
+			}
+
+			wlr::WxfView values = recordView.Part(5);
+
+			record.values.resize(values.Length());
+			benchmark::Require(values.CopyArrayData(record.values.data()), "reading the packed values from WXF");
+		}
+	}
+}
+
+int main(int argumentCount, char** arguments)
+{
+	if(!benchmark::StartRuntime(argumentCount, arguments))
+	{
+		return 1;
+	}
+
+	const char* outputFile = argumentCount > 2 ? arguments[2] : "WxfBenchmark.json";
+
+	std::vector<benchmark::Result> results;
+
+	auto run = [&results](const std::string& name, std::size_t iterations, auto&& body) {
+		results.push_back(benchmark::Measure(name, iterations, body));
+		benchmark::Print(results.back());
+	};
+
+	wlr::RecyclingExpressionPool pool(4);
+
+	const std::vector<Record> records = MakeRecords(10000);
+	const std::size_t iterations = 20;
+
+	wlr::Expr result = wlr::Expr::Detach(wlr_Eval(BuildRecords(records)));
+
+	std::vector<Record> readBack;
+	wlr::WxfDocument document;
+	wlr::WxfWriter writer;
+
+	run("read/wlr_Part per node", iterations, [&] {
+		ReadRecordsByPart(result.Get(), readBack);
+		pool.EndRequest();
+	});
+
+	benchmark::Require(readBack == records, "the records read with wlr_Part match the originals");
+
+	readBack.clear();
+
+	run("read/ExpressionToWxf + decode", iterations, [&] {
+		benchmark::Require(wlr::ExpressionToWxf(result.Get(), document) == WLR_SUCCESS, "ExpressionToWxf");
+		ReadRecordsFromWxf(document.Root(), readBack);
+		pool.EndRequest();
+	});
+
+	benchmark::Require(readBack == records, "the records decoded from WXF match the originals");
+
+	EncodeRecords(records, writer);
+
+	const std::string bytes(writer.Bytes());
+
+	run("decode/WxfDocument::Parse only", iterations, [&] { document.Parse(bytes); });
+
+	benchmark::Require(document.Parse(bytes) == WLR_SUCCESS, "decoding the WxfWriter bytes");
+	ReadRecordsFromWxf(document.Root(), readBack);
+	benchmark::Require(readBack == records, "the records decoded from WxfWriter bytes match the originals");
+
+	benchmark::Require(wlr_SameQ(wlr_Eval(wlr::WxfExpression(writer.Bytes())), result.Get()),
+					   "BinaryDeserialize of the WxfWriter bytes is the same expression as the variadic builders'");
+
+	// BinarySerialize writes these as Integer32, which must still read back as mint
+	const std::vector<mint> integers = {1, -2, 300, 70000};
+	std::vector<mint> integersBack(integers.size());
+
+	benchmark::Require(wlr::ExpressionToWxf(wlr::ToExpression(integers), document) == WLR_SUCCESS &&
+						   document.Root().CopyArrayData(integersBack.data()) && integersBack == integers,
+					   "reading a narrowed packed integer array as mint");
+	pool.EndRequest();
+
+	run("write/variadic builders", iterations, [&] {
+		wlr_Eval(BuildRecords(records));
+		pool.EndRequest();
+	});
+
+	run("write/WxfWriter + BinaryDeserialize", iterations, [&] {
+		EncodeRecords(records, writer);
+		wlr_Eval(wlr::WxfExpression(writer.Bytes()));
+		pool.EndRequest();
+	});
+
+	run("encode/WxfWriter only", iterations, [&] { EncodeRecords(records, writer); });
+
+	if(!benchmark::WriteJson(outputFile, "WxfBenchmark", results))
+	{
+		std::fprintf(stderr, "Failed to write %s.\n", outputFile);
+		return 1;
+	}
+
+	return 0;
+}
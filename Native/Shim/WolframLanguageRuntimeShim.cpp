@@ -0,0 +1,336 @@
+/*
+	Implementation of the entry points in WolframLanguageRuntimeShim.h
+
+	Compile with WLR_SHIM_EXPORT_LINKING defined, for example
+
+		cl /std:c++17 /O2 /LD /DWLR_SHIM_EXPORT_LINKING /I SDK /I Native Native/Shim/WolframLanguageRuntimeShim.cpp
+			SDK/bin/StandaloneApplicationsSDK_Shared.lib
+*/
+
+#include "WolframLanguageRuntimeShim.h"
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "wlr/Expr.h"
+#include "wlr/ExpressionBuilder.h"
+#include "wlr/Strings.h"
+#include "wlr/Symbols.h"
+#include "wlr/Utf.h"
+
+namespace
+{
+	/**
+		Output kept for the calling thread after a call returned WLR_OUT_OF_BOUNDS
+	*/
+	struct PendingOutput
+	{
+		std::string bytes;
+		bool present = false;
+	};
+
+	thread_local PendingOutput pendingOutput;
+
+	/**
+		Evaluate ToString[<parsed input>, OutputForm] in the current expression pool
+	*/
+	wlr_expr EvaluateToOutputFormExpression(wlr_expr inputString)
+	{
+		wlr_expr parsedExpression = wlr_ParseExpression(inputString);
+
+		return wlr_Eval(wlr::E(wlr::Symbol(wlr::SystemSymbol::ToString), parsedExpression,
+							   wlr::Symbol(wlr::SystemSymbol::OutputForm)));
+	}
+
+	void KeepPendingOutput(std::string bytes)
+	{
+		pendingOutput.bytes = std::move(bytes);
+		pendingOutput.present = true;
+	}
+}
+
+extern "C" wlr_err_t wlrshim_StartRuntime(const char* layoutDirectory)
+{
+	return wlr_sdk_StartRuntime(WLR_EXECUTABLE, WLR_VERSION_1, WLR_LICENSE_OR_SIGNED_CODE_MODE, layoutDirectory,
+								nullptr);
+}
+
+extern "C" wlr_err_t wlrshim_EvaluateToOutputForm(const char* input, mint inputLength, char* output,
+												  mint outputCapacity, mint* outputLength)
+{
+	pendingOutput.present = false;
+
+	wlr::ExpressionPool pool;
+
+	const wlr::StringData result(
+		EvaluateToOutputFormExpression(wlr::ToExpression(std::string_view(input, static_cast<std::size_t>(inputLength)))));
+
+	if(result.Error() != WLR_SUCCESS)
+	{
+		*outputLength = 0;
+
+		return WLR_UNEXPECTED_TYPE;
+	}
+
+	const std::string_view text = result.View();
+
+	*outputLength = static_cast<mint>(text.size());
+
+	if(*outputLength > outputCapacity)
+	{
+		KeepPendingOutput(std::string(text));
+
+		return WLR_OUT_OF_BOUNDS;
+	}
+
+	if(!text.empty())
+	{
+		std::memcpy(output, text.data(), text.size());
+	}
+
+	return WLR_SUCCESS;
+}
+
+extern "C" wlr_err_t wlrshim_EvaluateBatchToOutputForm(const char* inputs, const mint* inputOffsets, mint inputCount,
+													   char* output, mint outputCapacity, mint* outputOffsets,
+													   wlr_err_t* statuses)
+{
+	pendingOutput.present = false;
+
+	// Results are copied straight into output until the first one that does not fit; from then on they are collected
+	// for wlrshim_CopyPendingOutput
+	std::string overflow;
+	bool overflowed = false;
+	mint offset = 0;
+
+	outputOffsets[0] = 0;
+
+	for(mint index = 0; index < inputCount; ++index)
+	{
+		wlr::ExpressionPool pool;
+
+		const std::string_view input(inputs + inputOffsets[index],
+									 static_cast<std::size_t>(inputOffsets[index + 1] - inputOffsets[index]));
+
+		const wlr::StringData result(EvaluateToOutputFormExpression(wlr::ToExpression(input)));
+		const std::string_view text = result.View();
+
+		if(statuses != nullptr)
+		{
+			statuses[index] = result.Error() == WLR_SUCCESS ? WLR_SUCCESS : WLR_UNEXPECTED_TYPE;
+		}
+
+		if(!overflowed && offset + static_cast<mint>(text.size()) > outputCapacity)
+		{
+			overflowed = true;
+			overflow.assign(output, static_cast<std::size_t>(offset));
+		}
+
+		if(overflowed)
+		{
+			overflow.append(text);
+		}
+		else if(!text.empty())
+		{
+			std::memcpy(output + offset, text.data(), text.size());
+		}
+
+		offset += static_cast<mint>(text.size());
+		outputOffsets[index + 1] = offset;
+	}
+
+	if(overflowed)
+	{
+		KeepPendingOutput(std::move(overflow));
+
+		return WLR_OUT_OF_BOUNDS;
+	}
+
+	return WLR_SUCCESS;
+}
+
+extern "C" wlr_err_t wlrshim_CopyPendingOutput(char* output, mint outputCapacity, mint* outputLength)
+{
+	if(!pendingOutput.present)
+	{
+		*outputLength = 0;
+
+		return WLR_MISCELLANEOUS_ERROR;
+	}
+
+	*outputLength = static_cast<mint>(pendingOutput.bytes.size());
+
+	if(*outputLength > outputCapacity)
+	{
+		return WLR_OUT_OF_BOUNDS;
+	}
+
+	pendingOutput.bytes.copy(output, pendingOutput.bytes.size());
+
+	pendingOutput.bytes.clear();
+	pendingOutput.present = false;
+
+	return WLR_SUCCESS;
+}
+
+extern "C" wlr_err_t wlrshim_EvaluateToOutputFormUtf16(const char16_t* input, mint inputLength, char16_t* output,
+													   mint outputCapacity, mint* outputLength)
+{
+	pendingOutput.present = false;
+
+	*outputLength = 0;
+
+	wlr::ExpressionPool pool;
+
+	wlr_expr inputString;
+
+	if(wlr::StringFromUtf16(std::u16string_view(input, static_cast<std::size_t>(inputLength)), inputString) !=
+	   WLR_SUCCESS)
+	{
+		return WLR_MALFORMED;
+	}
+
+	const wlr::StringData result(EvaluateToOutputFormExpression(inputString));
+
+	if(result.Error() != WLR_SUCCESS)
+	{
+		return WLR_UNEXPECTED_TYPE;
+	}
+
+	const std::string_view text = result.View();
+
+	const wlr::TranscodeResult transcoded =
+		wlr::Utf8ToUtf16(text.data(), text.size(), output, static_cast<std::size_t>(outputCapacity));
+
+	if(transcoded.error == WLR_OUT_OF_BOUNDS)
+	{
+		*outputLength = static_cast<mint>(wlr::Utf16LengthOfUtf8(text.data(), text.size()));
+
+		KeepPendingOutput(std::string(text));
+	}
+	else if(transcoded.error == WLR_SUCCESS)
+	{
+		*outputLength = static_cast<mint>(transcoded.written);
+	}
+
+	return transcoded.error;
+}
+
+extern "C" wlr_err_t wlrshim_EvaluateBatchToOutputFormUtf16(const char16_t* inputs, const mint* inputOffsets,
+															mint inputCount, char16_t* output, mint outputCapacity,
+															mint* outputOffsets, wlr_err_t* statuses)
+{
+	pendingOutput.present = false;
+
+	// As in wlrshim_EvaluateBatchToOutputForm, but the overflow is kept as UTF-8 and transcoded when it is copied
+	std::string overflow;
+	bool overflowed = false;
+	mint offset = 0;
+
+	outputOffsets[0] = 0;
+
+	for(mint index = 0; index < inputCount; ++index)
+	{
+		wlr::ExpressionPool pool;
+
+		const std::u16string_view input(inputs + inputOffsets[index],
+										static_cast<std::size_t>(inputOffsets[index + 1] - inputOffsets[index]));
+
+		wlr_expr inputString;
+		wlr_err_t status = wlr::StringFromUtf16(input, inputString);
+
+		wlr::StringData result;
+
+		if(status == WLR_SUCCESS)
+		{
+			result = wlr::StringData(EvaluateToOutputFormExpression(inputString));
+			status = result.Error() == WLR_SUCCESS ? WLR_SUCCESS : WLR_UNEXPECTED_TYPE;
+		}
+
+		const std::string_view text = result.View();
+
+		std::size_t units = 0;
+
+		if(!overflowed)
+		{
+			const wlr::TranscodeResult transcoded = wlr::Utf8ToUtf16(
+				text.data(), text.size(), output + offset, static_cast<std::size_t>(outputCapacity - offset));
+
+			if(transcoded.error == WLR_OUT_OF_BOUNDS)
+			{
+				overflowed = true;
+				wlr::Utf16ToUtf8(std::u16string_view(output, static_cast<std::size_t>(offset)), overflow);
+			}
+			else if(transcoded.error != WLR_SUCCESS)
+			{
+				status = transcoded.error;
+			}
+			else
+			{
+				units = transcoded.written;
+			}
+		}
+
+		// A result that cannot be transcoded gets an empty slot and its error, in the buffer or in the overflow
+		if(overflowed)
+		{
+			const wlr::TranscodeResult validated = wlr::ValidateUtf8(text.data(), text.size());
+
+			if(validated.error != WLR_SUCCESS)
+			{
+				status = validated.error;
+			}
+			else
+			{
+				overflow.append(text);
+				units = wlr::Utf16LengthOfUtf8(text.data(), text.size());
+			}
+		}
+
+		if(statuses != nullptr)
+		{
+			statuses[index] = status;
+		}
+
+		offset += static_cast<mint>(units);
+		outputOffsets[index + 1] = offset;
+	}
+
+	if(overflowed)
+	{
+		KeepPendingOutput(std::move(overflow));
+
+		return WLR_OUT_OF_BOUNDS;
+	}
+
+	return WLR_SUCCESS;
+}
+
+extern "C" wlr_err_t wlrshim_CopyPendingOutputUtf16(char16_t* output, mint outputCapacity, mint* outputLength)
+{
+	if(!pendingOutput.present)
+	{
+		*outputLength = 0;
+
+		return WLR_MISCELLANEOUS_ERROR;
+	}
+
+	const std::string& bytes = pendingOutput.bytes;
+
+	*outputLength = static_cast<mint>(wlr::Utf16LengthOfUtf8(bytes.data(), bytes.size()));
+
+	if(*outputLength > outputCapacity)
+	{
+		return WLR_OUT_OF_BOUNDS;
+	}
+
+	const wlr::TranscodeResult transcoded =
+		wlr::Utf8ToUtf16(bytes.data(), bytes.size(), output, static_cast<std::size_t>(outputCapacity));
+
+	pendingOutput.bytes.clear();
+	pendingOutput.present = false;
+
+	return transcoded.error;
+}
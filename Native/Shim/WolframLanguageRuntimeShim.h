@@ -0,0 +1,92 @@
+/*
+	Blittable single-call entry points for calling the runtime from .NET
+
+	Every function takes only pointers, mint and wlr_err_t, has no variable argument list, and does all of its
+	expression work in native code, so one managed-to-native transition covers a whole evaluation. Inputs and outputs
+	are UTF-8 buffers owned by the caller; nothing allocated by the shim is returned to the caller.
+
+	When an output buffer is too small, the function returns WLR_OUT_OF_BOUNDS, reports the required length, and keeps
+	the output for the calling thread, so that wlrshim_CopyPendingOutput can retrieve it without evaluating again.
+
+	Build WolframLanguageRuntimeShim.cpp as a shared library with SDK/ and Native/ on the include path, linking
+	against the SDK library. WolframLanguageRuntimeShim.cs contains the .NET bindings.
+*/
+
+#pragma once
+
+#include "WolframLanguageRuntimeV1SDK.h"
+
+#ifndef __cplusplus
+#include <uchar.h>
+#endif
+
+#if defined(WLR_SHIM_EXPORT_LINKING)
+#define WLR_SHIM_ATTRIBUTE DLLEXPORT
+#else
+#define WLR_SHIM_ATTRIBUTE DLLIMPORT
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+	Start the runtime with the given layout directory and no runtime configuration
+	@remarks layoutDirectory is a null-terminated string.
+*/
+WLR_SHIM_ATTRIBUTE wlr_err_t wlrshim_StartRuntime(const char* layoutDirectory);
+
+/**
+	Evaluate UTF-8 input text and write the result in OutputForm to output
+	@remarks *outputLength receives the length of the result in bytes. Returns WLR_OUT_OF_BOUNDS if it is larger than
+   outputCapacity, and WLR_UNEXPECTED_TYPE with a zero length if the result could not be converted to a string.
+*/
+WLR_SHIM_ATTRIBUTE wlr_err_t wlrshim_EvaluateToOutputForm(const char* input, mint inputLength, char* output,
+														  mint outputCapacity, mint* outputLength);
+
+/**
+	Evaluate inputCount UTF-8 inputs to OutputForm in one call
+	@remarks Input i occupies bytes [inputOffsets[i], inputOffsets[i + 1]) of inputs, and result i is written to bytes
+   [outputOffsets[i], outputOffsets[i + 1]) of output, so both offset arrays have inputCount + 1 elements. A result
+   that could not be converted to a string is empty and sets statuses[i] to WLR_UNEXPECTED_TYPE; statuses may be null.
+   Returns WLR_OUT_OF_BOUNDS if outputOffsets[inputCount] is larger than outputCapacity.
+*/
+WLR_SHIM_ATTRIBUTE wlr_err_t wlrshim_EvaluateBatchToOutputForm(const char* inputs, const mint* inputOffsets,
+															   mint inputCount, char* output, mint outputCapacity,
+															   mint* outputOffsets, wlr_err_t* statuses);
+
+/**
+	Copy the output kept by the last call on this thread that returned WLR_OUT_OF_BOUNDS, and discard it
+	@remarks Returns WLR_OUT_OF_BOUNDS, keeping the output, if it is still larger than outputCapacity, and
+   WLR_MISCELLANEOUS_ERROR if there is no pending output.
+*/
+WLR_SHIM_ATTRIBUTE wlr_err_t wlrshim_CopyPendingOutput(char* output, mint outputCapacity, mint* outputLength);
+
+/**
+	UTF-16 version of wlrshim_EvaluateToOutputForm, for hosts that hold text as UTF-16
+	@remarks Lengths and capacities are in code units. The input is validated and transcoded to UTF-8 in one pass;
+   unpaired surrogates make it fail with WLR_MALFORMED.
+*/
+WLR_SHIM_ATTRIBUTE wlr_err_t wlrshim_EvaluateToOutputFormUtf16(const char16_t* input, mint inputLength,
+															   char16_t* output, mint outputCapacity,
+															   mint* outputLength);
+
+/**
+	UTF-16 version of wlrshim_EvaluateBatchToOutputForm
+	@remarks Offsets are in code units. An input with unpaired surrogates is not evaluated; its result is empty and
+   statuses[i] is WLR_MALFORMED.
+*/
+WLR_SHIM_ATTRIBUTE wlr_err_t wlrshim_EvaluateBatchToOutputFormUtf16(const char16_t* inputs, const mint* inputOffsets,
+																	mint inputCount, char16_t* output,
+																	mint outputCapacity, mint* outputOffsets,
+																	wlr_err_t* statuses);
+
+/**
+	UTF-16 version of wlrshim_CopyPendingOutput, for output kept by the UTF-16 entry points
+*/
+WLR_SHIM_ATTRIBUTE wlr_err_t wlrshim_CopyPendingOutputUtf16(char16_t* output, mint outputCapacity,
+															mint* outputLength);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,243 @@
+/*
+	Opt-in request coalescing for small evaluations
+
+	Every EvaluateToOutputForm call pays for a full parse, wlr_Eval, ToString and wlr_StringData round trip, however small
+	the input is. A wlr::BatchingEvaluator collects the inputs submitted within a short window (or until a size limit
+	is reached) and evaluates them in the kernel as a single List of ToString[..., OutputForm] calls. The results are
+	extracted with one wlr::ExtractStrings call and handed back to the individual callers.
+
+	Each input is parsed with wlr_ParseExpression, as EvaluateToOutputForm does, and fails on its own if it does not
+	parse. An element fails in the kernel only if its ToString does not return a string, the same case in which
+	EvaluateToOutputForm returns an empty string; messages are issued as usual and do not fail it.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Evaluate.h"
+#include "ExpressionBuilder.h"
+#include "KernelExecutor.h"
+#include "RuntimeBuffer.h"
+#include "Strings.h"
+#include "Symbols.h"
+#include "Tracing.h"
+
+namespace wlr
+{
+	/**
+		Limits that decide when a batch is sent to the kernel
+		@remarks A batch is dispatched as soon as it holds maximumBatchSize inputs, or when window has elapsed since its
+	   first input arrived, whichever comes first. window therefore bounds the extra latency batching adds.
+	*/
+	struct BatchingOptions
+	{
+		std::size_t maximumBatchSize = 64;
+		std::chrono::microseconds window = std::chrono::microseconds(200);
+	};
+
+	/**
+		Coalesces EvaluateToOutputForm requests from many threads into batched evaluations on a KernelExecutor
+		@remarks The destructor dispatches any inputs still pending. The executor must outlive the BatchingEvaluator and
+	   every batch it dispatched.
+	*/
+	class BatchingEvaluator
+	{
+	public:
+		explicit BatchingEvaluator(KernelExecutor& executor, BatchingOptions options = BatchingOptions())
+			: executor(executor), options(options)
+		{
+			if(this->options.maximumBatchSize == 0)
+			{
+				this->options.maximumBatchSize = 1;
+			}
+
+			flusher = std::thread([this] { RunFlusher(); });
+		}
+
+		BatchingEvaluator(const BatchingEvaluator&) = delete;
+		BatchingEvaluator& operator=(const BatchingEvaluator&) = delete;
+
+		~BatchingEvaluator()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				stopping = true;
+			}
+
+			condition.notify_one();
+
+			flusher.join();
+		}
+
+		/**
+			Queue input for evaluation to OutputForm in the next batch
+		*/
+		std::future<EvaluationResult> EvaluateToOutputForm(std::string input)
+		{
+			PendingEvaluation evaluation {std::move(input), std::promise<EvaluationResult>()};
+
+			std::future<EvaluationResult> result = evaluation.result.get_future();
+
+			bool wakeFlusher = false;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if(pending.empty())
+				{
+					firstPendingTime = std::chrono::steady_clock::now();
+					wakeFlusher = true;
+				}
+
+				pending.push_back(std::move(evaluation));
+
+				wakeFlusher = wakeFlusher || pending.size() >= options.maximumBatchSize;
+			}
+
+			if(wakeFlusher)
+			{
+				condition.notify_one();
+			}
+
+			return result;
+		}
+
+	private:
+		struct PendingEvaluation
+		{
+			std::string input;
+			std::promise<EvaluationResult> result;
+		};
+
+		using Batch = std::vector<PendingEvaluation>;
+
+		void RunFlusher()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			for(;;)
+			{
+				condition.wait(lock, [this] { return stopping || !pending.empty(); });
+
+				if(pending.empty())
+				{
+					break;
+				}
+
+				condition.wait_until(lock, firstPendingTime + options.window,
+									 [this] { return stopping || pending.size() >= options.maximumBatchSize; });
+
+				auto batch = std::make_shared<Batch>();
+
+				batch->swap(pending);
+
+				lock.unlock();
+
+				executor.Submit([batch] { EvaluateBatch(*batch); });
+
+				lock.lock();
+			}
+		}
+
+		/**
+			Function that maps a list of evaluated ToString results to {outputs, failed}, where failed holds 1 for every
+			result that is not a string
+			@remarks Kept once a parse succeeds; an error is passed on to the batch and the next batch parses again.
+		*/
+		static wlr_expr BatchFunction()
+		{
+			static std::atomic<wlr_expr> function {nullptr};
+
+			return detail::CachedExpression(function, [] {
+				return wlr_ParseExpression(
+					wlr_String("Function[results, {Replace[results, Except[_String] -> \"\", {1}], "
+							   "Developer`ToPackedArray[Boole[Not[StringQ[#]]] & /@ results]}]"));
+			});
+		}
+
+		// Runs on the kernel thread
+		static void EvaluateBatch(Batch& batch)
+		{
+			WLR_TRACE_SPAN("BatchingEvaluator::EvaluateBatch");
+
+			std::vector<wlr_expr> calls;
+			std::vector<PendingEvaluation*> parsed;
+
+			calls.reserve(batch.size());
+			parsed.reserve(batch.size());
+
+			for(PendingEvaluation& evaluation : batch)
+			{
+				wlr_expr parsedExpression =
+					WLR_TRACED("wlr_ParseExpression", wlr_ParseExpression(ToExpression(evaluation.input)));
+
+				if(wlr_ErrorQ(parsedExpression))
+				{
+					evaluation.result.set_value(EvaluationResult {EvaluationStatus::Failed, std::string()});
+					continue;
+				}
+
+				calls.push_back(E(Symbol(SystemSymbol::ToString), parsedExpression, Symbol(SystemSymbol::OutputForm)));
+				parsed.push_back(&evaluation);
+			}
+
+			if(parsed.empty())
+			{
+				return;
+			}
+
+			wlr_expr evaluated = WLR_TRACED("wlr_Eval (batch)", wlr_Eval(E(BatchFunction(), List(Splice(calls)))));
+
+			StringArena outputs;
+
+			RuntimeBuffer<mint> failed;
+
+			wlr_err_t error =
+				wlr_ErrorQ(evaluated) ? wlr_ErrorType(evaluated) : ExtractStrings(wlr_Part(evaluated, 1), outputs);
+
+			if(error == WLR_SUCCESS)
+			{
+				error = wlr_IntegerArrayData(wlr_Part(evaluated, 2), failed.OutLength(), failed.OutData());
+			}
+
+			const bool complete =
+				error == WLR_SUCCESS && outputs.Size() == parsed.size() && failed.Size() == parsed.size();
+
+			for(std::size_t index = 0; index < parsed.size(); ++index)
+			{
+				if(complete && failed[index] == 0)
+				{
+					parsed[index]->result.set_value(
+						EvaluationResult {EvaluationStatus::Success, std::string(outputs[index])});
+				}
+				else
+				{
+					parsed[index]->result.set_value(EvaluationResult {EvaluationStatus::Failed, std::string()});
+				}
+			}
+		}
+
+		KernelExecutor& executor;
+		BatchingOptions options;
+
+		std::mutex mutex;
+		std::condition_variable condition;
+		Batch pending;
+		std::chrono::steady_clock::time_point firstPendingTime;
+		bool stopping = false;
+
+		std::thread flusher;
+	};
+}
@@ -0,0 +1,314 @@
+/*
+	C++20 coroutine interface to a KernelExecutor
+
+	A reactor thread that calls wlr_Eval, or waits on the std::future from KernelExecutor::Submit, is blocked for the
+	whole evaluation. The awaitables in this file suspend the calling coroutine instead, post the work to the kernel
+	thread, and resume the coroutine on the caller's executor once the result is ready, so one reactor thread can keep
+	any number of requests in flight:
+
+		std::optional<wlr::Expr> result = co_await wlr::EvaluateAsync(kernel, std::move(expression), reactor);
+
+	The executor is any object with a thread-safe Post(std::coroutine_handle<>) member that resumes the handle on the
+	executor's own thread. It must outlive the awaited operation.
+
+	An EvaluationCancellation maps cancellation onto the runtime: work that has not started yet is skipped, and work
+	that is running is interrupted with wlr_Abort, after which the kernel thread calls wlr_ClearAbort. Either way the
+	awaiting coroutine is resumed with the cancelled result.
+
+	This header requires C++20 coroutines and is empty otherwise; the rest of the folder stays C++17.
+*/
+
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "Evaluate.h"
+#include "Expr.h"
+#include "KernelExecutor.h"
+
+namespace wlr
+{
+	/**
+		Cancels the operations it is passed to, from any thread
+		@remarks Cancel is sticky: operations started with a cancelled EvaluationCancellation are skipped. Use one per
+	   logical request.
+	*/
+	class EvaluationCancellation
+	{
+	public:
+		EvaluationCancellation() = default;
+
+		EvaluationCancellation(const EvaluationCancellation&) = delete;
+		EvaluationCancellation& operator=(const EvaluationCancellation&) = delete;
+
+		void Cancel()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if(cancelled)
+			{
+				return;
+			}
+
+			cancelled = true;
+
+			// Abort while holding the lock, so that End either sees the abort or the abort is never issued
+			if(running)
+			{
+				abortIssued = true;
+
+				wlr_Abort();
+			}
+		}
+
+		bool Cancelled() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			return cancelled;
+		}
+
+	private:
+		template <typename Executor, typename Work>
+		friend class KernelAwaitable;
+
+		/**
+			Mark work as running on the kernel thread; false if it was cancelled first
+		*/
+		bool Begin()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			running = !cancelled;
+
+			return running;
+		}
+
+		/**
+			Mark the work as finished; true if wlr_Abort was called for it
+		*/
+		bool End()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			const bool aborted = abortIssued;
+
+			running = false;
+			abortIssued = false;
+
+			return aborted;
+		}
+
+		mutable std::mutex mutex;
+		bool cancelled = false;
+		bool running = false;
+		bool abortIssued = false;
+	};
+
+	namespace detail
+	{
+		/**
+			Posts a continuation to an executor when destroyed, unless moved from
+			@remarks Captured by the item posted to the kernel thread, so that the awaiting coroutine is resumed both
+		   after the item runs and when the executor destroys it unrun because the runtime failed to start.
+		*/
+		template <typename Executor>
+		class ResumeOnDestruction
+		{
+		public:
+			ResumeOnDestruction(Executor& executor, std::coroutine_handle<> continuation) noexcept
+				: executor(&executor), continuation(continuation)
+			{
+			}
+
+			ResumeOnDestruction(ResumeOnDestruction&& other) noexcept
+				: executor(other.executor), continuation(std::exchange(other.continuation, nullptr))
+			{
+			}
+
+			ResumeOnDestruction& operator=(ResumeOnDestruction&&) = delete;
+
+			~ResumeOnDestruction()
+			{
+				if(continuation)
+				{
+					executor->Post(continuation);
+				}
+			}
+
+		private:
+			Executor* executor;
+			std::coroutine_handle<> continuation;
+		};
+	}
+
+	/**
+		Awaitable that runs work on the kernel thread and resumes the awaiting coroutine on executor
+		@remarks co_await yields std::optional of the work's result, which is empty if the work was cancelled before or
+	   while it ran, if it threw, or if the runtime failed to start. Like KernelExecutor::Submit, work runs inside the
+	   kernel thread's expression pool and must return native values or detached wlr::Expr handles. The work object is
+	   destroyed on the kernel thread, whether it ran or not, unless the runtime failed to start.
+	*/
+	template <typename Executor, typename Work>
+	class KernelAwaitable
+	{
+	public:
+		using Result = std::invoke_result_t<Work&>;
+
+		static_assert(!std::is_void<Result>::value, "wlr::KernelAwaitable: work must return a value");
+
+		KernelAwaitable(KernelExecutor& kernel, Work work, Executor& executor, EvaluationCancellation* cancellation)
+			: kernel(kernel), work(std::in_place, std::move(work)), executor(executor), cancellation(cancellation)
+		{
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> continuation)
+		{
+			// The awaitable lives in the suspended coroutine's frame until the continuation is resumed
+			kernel.Post([this, resume = detail::ResumeOnDestruction<Executor>(executor, continuation)] { Run(); }, [] {});
+		}
+
+		std::optional<Result> await_resume()
+		{
+			return std::move(result);
+		}
+
+	private:
+		void Run()
+		{
+			if(cancellation == nullptr)
+			{
+				try
+				{
+					result.emplace((*work)());
+				}
+				catch(...)
+				{
+				}
+			}
+			else if(cancellation->Begin())
+			{
+				bool succeeded = true;
+
+				try
+				{
+					result.emplace((*work)());
+				}
+				catch(...)
+				{
+					succeeded = false;
+				}
+
+				if(cancellation->End())
+				{
+					// The result of an aborted evaluation cannot be trusted, even if it finished as the abort arrived
+					wlr_ClearAbort();
+
+					succeeded = false;
+				}
+
+				if(!succeeded)
+				{
+					result.reset();
+				}
+			}
+
+			// Destroy the work here, so that any expressions it captured are released on the kernel thread
+			work.reset();
+		}
+
+		KernelExecutor& kernel;
+		std::optional<Work> work;
+		Executor& executor;
+		EvaluationCancellation* cancellation;
+		std::optional<Result> result;
+	};
+
+	/**
+		Run work on the kernel thread without blocking the calling coroutine
+	*/
+	template <typename Work, typename Executor>
+	KernelAwaitable<Executor, std::decay_t<Work>> Schedule(KernelExecutor& kernel, Work&& work, Executor& executor,
+															EvaluationCancellation* cancellation = nullptr)
+	{
+		return KernelAwaitable<Executor, std::decay_t<Work>>(kernel, std::forward<Work>(work), executor, cancellation);
+	}
+
+	/**
+		Evaluate a detached expression on the kernel thread and resume with the detached result
+		@remarks co_await yields an empty optional if the evaluation was cancelled.
+	*/
+	template <typename Executor>
+	auto EvaluateAsync(KernelExecutor& kernel, Expr expression, Executor& executor,
+					   EvaluationCancellation* cancellation = nullptr)
+	{
+		return Schedule(
+			kernel, [expression = std::move(expression)] { return Expr::Detach(wlr_Eval(expression.Get())); }, executor,
+			cancellation);
+	}
+
+	namespace detail
+	{
+		/**
+			Work that evaluates input text to OutputForm
+		*/
+		struct OutputFormWork
+		{
+			std::string input;
+
+			EvaluationResult operator()() const
+			{
+				wlr_expr evaluatedExpression = wlr_Eval(E(Symbol(SystemSymbol::ToString),
+														  wlr_ParseExpression(ToExpression(input)),
+														  Symbol(SystemSymbol::OutputForm)));
+
+				if(wlr_ExpressionType(evaluatedExpression) != WLR_STRING)
+				{
+					return EvaluationResult {EvaluationStatus::Failed, std::string()};
+				}
+
+				return EvaluationResult {EvaluationStatus::Success, StringFromExpression(evaluatedExpression)};
+			}
+		};
+
+		template <typename Executor>
+		class OutputFormAwaitable : public KernelAwaitable<Executor, OutputFormWork>
+		{
+		public:
+			using KernelAwaitable<Executor, OutputFormWork>::KernelAwaitable;
+
+			EvaluationResult await_resume()
+			{
+				std::optional<EvaluationResult> result = KernelAwaitable<Executor, OutputFormWork>::await_resume();
+
+				return result ? std::move(*result) : EvaluationResult {EvaluationStatus::Cancelled, std::string()};
+			}
+		};
+	}
+
+	/**
+		Evaluate input text to OutputForm on the kernel thread, as EvaluateToOutputForm does, and resume with the result
+		@remarks co_await yields EvaluationStatus::Cancelled if the evaluation was cancelled.
+	*/
+	template <typename Executor>
+	detail::OutputFormAwaitable<Executor> EvaluateAsync(KernelExecutor& kernel, std::string input, Executor& executor,
+														EvaluationCancellation* cancellation = nullptr)
+	{
+		return detail::OutputFormAwaitable<Executor>(kernel, detail::OutputFormWork {std::move(input)}, executor,
+													 cancellation);
+	}
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*
+	C++ counterpart of EvaluateToOutputForm in SampleProgram.cs
+
+	Documentation links for SDK functions used in this file:
+
+		wlr_Eval - https://wolfr.am/1wl9OeJOl
+		wlr_ParseExpression - https://wolfr.am/1wl9SBSNH
+		wlr_StringData - https://wolfr.am/1wl9XfJgQ
+		wlr_Symbol - https://wolfr.am/1wla3FzQg
+*/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "Expr.h"
+#include "ExpressionBuilder.h"
+#include "ParseCache.h"
+#include "Strings.h"
+#include "Symbols.h"
+#include "Tracing.h"
+
+namespace wlr
+{
+	/**
+		Outcome of evaluating a single input
+	*/
+	enum class EvaluationStatus
+	{
+		Success,
+		Failed,
+		TimedOut,
+		Cancelled
+	};
+
+	/**
+		Result of evaluating a single input to OutputForm
+		@remarks output is empty unless status is EvaluationStatus::Success.
+	*/
+	struct EvaluationResult
+	{
+		EvaluationStatus status;
+		std::string output;
+	};
+
+	/**
+		Copy the contents of a string expression into a std::string
+		@remarks Returns an empty string if the expression is not a string.
+	*/
+	inline std::string StringFromExpression(wlr_expr stringExpression)
+	{
+		WLR_TRACE_SPAN("wlr_StringData");
+
+		return std::string(StringData(stringExpression).View());
+	}
+
+	/**
+		Evaluate an input string, returning the result as a string in OutputForm
+		@remarks Returns an empty string on error.
+		@remarks Unlike the C# sample, this function does not create its own expression pool. Every intermediate
+	   expression is left in the caller's current pool, so a request loop can share one RecyclingExpressionPool instead of
+	   paying for a pool per call.
+	*/
+	inline std::string EvaluateToOutputForm(std::string_view input)
+	{
+		WLR_TRACE_SPAN("EvaluateToOutputForm");
+
+		wlr_expr inputString = WLR_TRACED("wlr_StringFromData", ToExpression(input));
+
+		wlr_expr parsedExpression = WLR_TRACED("wlr_ParseExpression", wlr_ParseExpression(inputString));
+
+		// Evaluate ToString[<expression parsed from input string>, OutputForm]
+		wlr_expr evaluatedExpression = WLR_TRACED(
+			"wlr_Eval + ToString",
+			wlr_Eval(E(Symbol(SystemSymbol::ToString), parsedExpression, Symbol(SystemSymbol::OutputForm))));
+
+		return StringFromExpression(evaluatedExpression);
+	}
+
+	/**
+		Evaluate an input string to OutputForm, taking its parse tree from parseCache
+		@remarks Returns an empty string on error. Intermediate expressions are left in the caller's current pool.
+	*/
+	inline std::string EvaluateToOutputForm(std::string_view input, ParseCache& parseCache)
+	{
+		WLR_TRACE_SPAN("EvaluateToOutputForm");
+
+		wlr_expr parsedExpression = WLR_TRACED("ParseCache::Parse", parseCache.Parse(input));
+
+		wlr_expr evaluatedExpression = WLR_TRACED(
+			"wlr_Eval + ToString",
+			wlr_Eval(E(Symbol(SystemSymbol::ToString), parsedExpression, Symbol(SystemSymbol::OutputForm))));
+
+		return StringFromExpression(evaluatedExpression);
+	}
+}
@@ -0,0 +1,247 @@
+/*
+	C++ ownership helpers for the expression API in WolframLanguageRuntimeV1.h
+
+	Every expression returned by the expression API lives in the current expression pool until that pool is released.
+	Expressions that must outlive the pool are detached with wlr_DetachExpression and released individually with
+	wlr_ReleaseExpression. The types in this file make both lifetimes explicit:
+
+		wlr::Expr                     - move-only owner of a single detached expression
+		wlr::ExpressionPool           - scoped wlr_CreateExpressionPool / wlr_ReleaseExpressionPool pair
+		wlr::RecyclingExpressionPool  - long-lived pool shared by many short requests, released every N requests
+
+	All three go through the wrappers in Instrumentation.h, which only count pools and detached expressions when
+	WLR_ENABLE_INSTRUMENTATION is defined and otherwise call the runtime directly.
+*/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "Instrumentation.h"
+#include "WolframLanguageRuntimeV1.h"
+
+namespace wlr
+{
+	/**
+		Move-only owner of a detached expression
+		@remarks The destructor calls wlr_ReleaseExpression. An Expr is exactly one wlr_expr wide and every member is
+	   inline, so unless WLR_ENABLE_INSTRUMENTATION is defined it compiles down to the bare pointer.
+		@remarks Use Expr for long-lived expressions (cached parse trees, interned symbols, results kept between
+	   requests). Short-lived expressions should stay in an expression pool as plain wlr_expr values.
+	*/
+	class Expr
+	{
+	public:
+		Expr() noexcept = default;
+
+		Expr(const Expr&) = delete;
+		Expr& operator=(const Expr&) = delete;
+
+		Expr(Expr&& other) noexcept : expression(other.expression)
+		{
+			other.expression = nullptr;
+		}
+
+		Expr& operator=(Expr&& other) noexcept
+		{
+			if(this != &other)
+			{
+				Reset();
+
+				expression = other.expression;
+				other.expression = nullptr;
+			}
+
+			return *this;
+		}
+
+		~Expr()
+		{
+			Reset();
+		}
+
+		/**
+			Take ownership of an expression that has already been detached from its pool
+		*/
+		static Expr Adopt(wlr_expr detachedExpression) noexcept
+		{
+			return Expr(detachedExpression);
+		}
+
+		/**
+			Detach an expression from the current expression pool and take ownership of it
+		*/
+		static Expr Detach(wlr_expr pooledExpression, CallSite site = CallSite::Current()) noexcept
+		{
+			if(pooledExpression != nullptr)
+			{
+				instrumentation::DetachExpression(pooledExpression, site);
+			}
+
+			return Expr(pooledExpression);
+		}
+
+		/**
+			Return an independent detached copy of this expression
+		*/
+		Expr Clone(CallSite site = CallSite::Current()) const noexcept
+		{
+			return expression == nullptr ? Expr() : Detach(wlr_Clone(expression), site);
+		}
+
+		/**
+			Return a copy of this expression that lives in the current expression pool
+			@remarks The copy is released together with the pool, so it can be freely embedded in larger expressions built
+		   for a single request.
+		*/
+		wlr_expr CloneToPool() const noexcept
+		{
+			assert(expression != nullptr);
+
+			return wlr_Clone(expression);
+		}
+
+		/**
+			Return the underlying expression without giving up ownership
+		*/
+		wlr_expr Get() const noexcept
+		{
+			return expression;
+		}
+
+		/**
+			Give up ownership of the underlying detached expression
+			@remarks The caller becomes responsible for calling wlr_ReleaseExpression.
+		*/
+		wlr_expr Release() noexcept
+		{
+			wlr_expr detachedExpression = expression;
+
+			expression = nullptr;
+
+			return detachedExpression;
+		}
+
+		/**
+			Release the owned expression, if any
+		*/
+		void Reset() noexcept
+		{
+			if(expression != nullptr)
+			{
+				instrumentation::ReleaseExpression(expression);
+
+				expression = nullptr;
+			}
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return expression != nullptr;
+		}
+
+	private:
+		explicit Expr(wlr_expr detachedExpression) noexcept : expression(detachedExpression)
+		{
+		}
+
+		wlr_expr expression = nullptr;
+	};
+
+	static_assert(sizeof(Expr) == sizeof(wlr_expr), "wlr::Expr must be exactly as wide as wlr_expr");
+	static_assert(std::is_nothrow_move_constructible<Expr>::value && std::is_nothrow_move_assignable<Expr>::value,
+				  "wlr::Expr moves must not throw");
+
+	/**
+		Scoped expression pool
+		@remarks Creates a pool on construction and releases it (and every non-detached expression created in it) on
+	   destruction. Pools form a stack in the runtime, so ExpressionPool objects cannot be copied or moved.
+	*/
+	class ExpressionPool
+	{
+	public:
+		ExpressionPool() noexcept
+		{
+			instrumentation::CreateExpressionPool();
+		}
+
+		ExpressionPool(const ExpressionPool&) = delete;
+		ExpressionPool& operator=(const ExpressionPool&) = delete;
+
+		~ExpressionPool()
+		{
+			instrumentation::ReleaseExpressionPool();
+		}
+
+		/**
+			Move an expression from this pool to the enclosing pool, so that it survives the end of this scope
+		*/
+		static wlr_expr Promote(wlr_expr expression) noexcept
+		{
+			wlr_MoveExpressionToParentPool(expression);
+
+			return expression;
+		}
+	};
+
+	/**
+		Expression pool that is kept open across many short requests
+		@remarks Creating and releasing a pool around every request is the pattern used by EvaluateToOutputForm in
+	   SampleProgram.cs. A RecyclingExpressionPool instead keeps one pool open and only releases it after every
+	   requestsPerCycle calls to EndRequest, trading a bounded amount of retained memory for not paying the pool cost on
+	   every request.
+		@remarks Call EndRequest once a request no longer needs any of its pooled expressions. Results that must outlive
+	   the request should be detached into a wlr::Expr first.
+	*/
+	class RecyclingExpressionPool
+	{
+	public:
+		explicit RecyclingExpressionPool(std::size_t requestsPerCycle = 64) noexcept
+			: requestsPerCycle(requestsPerCycle == 0 ? 1 : requestsPerCycle)
+		{
+			instrumentation::CreateExpressionPool();
+		}
+
+		RecyclingExpressionPool(const RecyclingExpressionPool&) = delete;
+		RecyclingExpressionPool& operator=(const RecyclingExpressionPool&) = delete;
+
+		~RecyclingExpressionPool()
+		{
+			instrumentation::ReleaseExpressionPool();
+		}
+
+		/**
+			Mark the end of a request, recycling the pool if requestsPerCycle requests have ended since the last recycle
+		*/
+		void EndRequest() noexcept
+		{
+			if(++requestsInCycle >= requestsPerCycle)
+			{
+				Recycle();
+			}
+		}
+
+		/**
+			Release every pooled expression now and start a fresh pool
+		*/
+		void Recycle() noexcept
+		{
+			instrumentation::ReleaseExpressionPool();
+			instrumentation::CreateExpressionPool();
+
+			requestsInCycle = 0;
+		}
+
+		std::size_t RequestsInCycle() const noexcept
+		{
+			return requestsInCycle;
+		}
+
+	private:
+		std::size_t requestsPerCycle;
+		std::size_t requestsInCycle = 0;
+	};
+}
@@ -0,0 +1,348 @@
+/*
+	Type-checked C++17 replacement for the wlr_E, wlr_List and wlr_Association macros
+
+	The macros in WolframLanguageRuntimeV1.h count their arguments with the preprocessor, forward them through va_list
+	to wlr_VariadicE / wlr_VariadicList / wlr_VariadicAssociation, and stop at 25 children. The builders in this file
+	accept any number of children of any of the following kinds:
+
+		wlr_expr, wlr::Expr                 - used as-is (a wlr::Expr is borrowed, not consumed)
+		bool                                - True or False
+		integral types                      - wlr_Integer, or a big integer parsed from the decimal digits of a value
+											  beyond the range of mint
+		floating-point types                - wlr_Real
+		std::complex<T>                     - wlr_Complex
+		const char*, std::string(_view)     - wlr_StringFromData
+		contiguous ranges of mint / mreal   - a packed List built with wlr_ExpressionFromIntegerArray / RealArray
+		other contiguous ranges             - a List of their converted elements
+		wlr::Splice(range)                  - the converted elements of the range, spliced in as individual children
+
+	Children are collected with wlr_ExpressionBag and wlr_ExpressionBagToExpression. When every child of a wlr::List is
+	a native integer that fits mint (or every child is a native real) the child count is known at compile time, and the
+	packed List is built with a single call to wlr_ExpressionFromIntegerArray (or wlr_ExpressionFromRealArray) from a
+	stack array. Other heads are never packed. wlr::Association builds an atomic association.
+*/
+
+#pragma once
+
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "Expr.h"
+#include "Symbols.h"
+
+namespace wlr
+{
+	/**
+		Marker that splices the elements of a contiguous range into the enclosing expression as individual children
+		@remarks Create one with wlr::Splice(range). The range must outlive the builder call.
+	*/
+	template <typename Range>
+	struct SplicedRange
+	{
+		const Range& range;
+	};
+
+	template <typename Range>
+	SplicedRange<Range> Splice(const Range& range) noexcept
+	{
+		return SplicedRange<Range> {range};
+	}
+
+	namespace detail
+	{
+		template <typename T>
+		using Bare = std::remove_cv_t<std::remove_reference_t<T>>;
+
+		template <typename T, typename = void>
+		struct IsContiguousRange : std::false_type
+		{
+		};
+
+		template <typename T>
+		struct IsContiguousRange<T, std::void_t<decltype(std::data(std::declval<const T&>())),
+												decltype(std::size(std::declval<const T&>()))>> : std::true_type
+		{
+		};
+
+		template <typename T>
+		struct IsComplex : std::false_type
+		{
+		};
+
+		template <typename T>
+		struct IsComplex<std::complex<T>> : std::true_type
+		{
+		};
+
+		template <typename T>
+		struct IsSplice : std::false_type
+		{
+		};
+
+		template <typename Range>
+		struct IsSplice<SplicedRange<Range>> : std::true_type
+		{
+		};
+
+		template <typename T>
+		constexpr bool IsStringLike = std::is_convertible<const T&, std::string_view>::value;
+
+		template <typename T>
+		constexpr bool IsNativeInteger = std::is_integral<T>::value && !std::is_same<T, bool>::value;
+
+		template <typename T>
+		constexpr bool IsNativeReal = std::is_floating_point<T>::value;
+
+		inline wlr_expr ListHead()
+		{
+			return Symbol(SystemSymbol::List);
+		}
+
+		/**
+			True if the native integer value is within the range of mint
+		*/
+		template <typename T>
+		constexpr bool FitsMint(T value) noexcept
+		{
+			if constexpr(std::is_signed<T>::value && sizeof(T) > sizeof(mint))
+			{
+				return value >= std::numeric_limits<mint>::min() && value <= std::numeric_limits<mint>::max();
+			}
+			else if constexpr(!std::is_signed<T>::value && sizeof(T) >= sizeof(mint))
+			{
+				return value <= static_cast<std::make_unsigned_t<mint>>(std::numeric_limits<mint>::max());
+			}
+			else
+			{
+				return true;
+			}
+		}
+
+		/**
+			wlr_Integer of value, or the big integer parsed from its decimal digits if it does not fit mint
+		*/
+		template <typename T>
+		wlr_expr IntegerExpression(T value)
+		{
+			if(FitsMint(value))
+			{
+				return wlr_Integer(static_cast<mint>(value));
+			}
+
+			const std::string digits = std::to_string(value);
+
+			return wlr_ParseExpression(wlr_StringFromData(digits.data(), static_cast<mint>(digits.size())));
+		}
+
+		template <typename T>
+		wlr_expr ToExpression(const T& value);
+
+		template <typename Range>
+		void AddRangeElements(wlr_exprbag expressionBag, const Range& range)
+		{
+			for(const auto& element : range)
+			{
+				wlr_AddExpression(expressionBag, detail::ToExpression(element));
+			}
+		}
+
+		template <typename Range>
+		wlr_expr ListFromRange(const Range& range)
+		{
+			using Element = Bare<decltype(*std::data(range))>;
+
+			const mint length = static_cast<mint>(std::size(range));
+
+			if constexpr(std::is_same<Element, mint>::value)
+			{
+				return wlr_ExpressionFromIntegerArray(length, std::data(range), ListHead());
+			}
+			else if constexpr(std::is_same<Element, mreal>::value)
+			{
+				return wlr_ExpressionFromRealArray(length, std::data(range), ListHead());
+			}
+			else
+			{
+				wlr_exprbag expressionBag = wlr_ExpressionBag();
+
+				AddRangeElements(expressionBag, range);
+
+				wlr_expr result = wlr_ExpressionBagToExpression(expressionBag, ListHead());
+
+				wlr_ReleaseExpressionBag(expressionBag);
+
+				return result;
+			}
+		}
+
+		template <typename T>
+		wlr_expr ToExpression(const T& value)
+		{
+			using Type = Bare<T>;
+
+			if constexpr(std::is_same<Type, wlr_expr>::value)
+			{
+				return value;
+			}
+			else if constexpr(std::is_same<Type, Expr>::value)
+			{
+				return value.Get();
+			}
+			else if constexpr(std::is_same<Type, bool>::value)
+			{
+				return Symbol(value ? SystemSymbol::TrueSymbol : SystemSymbol::FalseSymbol);
+			}
+			else if constexpr(IsNativeInteger<Type>)
+			{
+				return IntegerExpression(value);
+			}
+			else if constexpr(IsNativeReal<Type>)
+			{
+				return wlr_Real(static_cast<mreal>(value));
+			}
+			else if constexpr(IsComplex<Type>::value)
+			{
+				return wlr_Complex(wlr_Real(static_cast<mreal>(value.real())), wlr_Real(static_cast<mreal>(value.imag())));
+			}
+			else if constexpr(IsStringLike<Type>)
+			{
+				const std::string_view string(value);
+
+				return wlr_StringFromData(string.data(), static_cast<mint>(string.size()));
+			}
+			else if constexpr(IsContiguousRange<Type>::value)
+			{
+				return ListFromRange(value);
+			}
+			else
+			{
+				static_assert(sizeof(Type) == 0, "wlr: no conversion from this type to an expression");
+			}
+		}
+
+		template <typename T>
+		void AddChild(wlr_exprbag expressionBag, const T& child)
+		{
+			if constexpr(IsSplice<Bare<T>>::value)
+			{
+				AddRangeElements(expressionBag, child.range);
+			}
+			else
+			{
+				wlr_AddExpression(expressionBag, detail::ToExpression(child));
+			}
+		}
+
+		template <typename... Children>
+		wlr_expr BuildFromBag(wlr_expr expressionHead, const Children&... children)
+		{
+			wlr_exprbag expressionBag = wlr_ExpressionBag();
+
+			(AddChild(expressionBag, children), ...);
+
+			wlr_expr result = wlr_ExpressionBagToExpression(expressionBag, expressionHead);
+
+			wlr_ReleaseExpressionBag(expressionBag);
+
+			return result;
+		}
+	}
+
+	/**
+		Convert a single native value or handle to an expression in the current expression pool
+		@remarks See the top of this file for the supported types.
+	*/
+	template <typename T>
+	wlr_expr ToExpression(const T& value)
+	{
+		return detail::ToExpression(value);
+	}
+
+	/**
+		Number of children a builder call with these argument types produces, or -1 if it is only known at run time
+		@remarks Only wlr::Splice arguments make the child count dynamic.
+	*/
+	template <typename... Children>
+	constexpr mint StaticChildCount =
+		((detail::IsSplice<detail::Bare<Children>>::value || ...) ? -1 : static_cast<mint>(sizeof...(Children)));
+
+	/**
+		Build the expression expressionHead[children...]
+		@remarks The new expression and every converted child live in the current expression pool. The children are
+	   never packed, whatever the head; use wlr::List for a packed List of native numbers.
+	*/
+	template <typename Head, typename... Children>
+	wlr_expr E(const Head& expressionHead, const Children&... children)
+	{
+		return detail::BuildFromBag(detail::ToExpression(expressionHead), children...);
+	}
+
+	/**
+		Build the expression List[children...]
+		@remarks Native integers that all fit mint, or native reals, make a packed List.
+	*/
+	template <typename... Children>
+	wlr_expr List(const Children&... children)
+	{
+		constexpr std::size_t childCount = sizeof...(Children);
+
+		if constexpr(childCount > 0 && (detail::IsNativeInteger<detail::Bare<Children>> && ...))
+		{
+			if((detail::FitsMint(children) && ...))
+			{
+				const std::array<mint, childCount> values {static_cast<mint>(children)...};
+
+				return wlr_ExpressionFromIntegerArray(static_cast<mint>(childCount), values.data(), detail::ListHead());
+			}
+
+			return detail::BuildFromBag(detail::ListHead(), children...);
+		}
+		else if constexpr(childCount > 0 && (detail::IsNativeReal<detail::Bare<Children>> && ...))
+		{
+			const std::array<mreal, childCount> values {static_cast<mreal>(children)...};
+
+			return wlr_ExpressionFromRealArray(static_cast<mint>(childCount), values.data(), detail::ListHead());
+		}
+		else
+		{
+			return detail::BuildFromBag(detail::ListHead(), children...);
+		}
+	}
+
+	/**
+		Build the expression Rule[leftHandSide, rightHandSide]
+	*/
+	template <typename Key, typename Value>
+	wlr_expr Rule(const Key& leftHandSide, const Value& rightHandSide)
+	{
+		return wlr_Rule(detail::ToExpression(leftHandSide), detail::ToExpression(rightHandSide));
+	}
+
+	/**
+		Build the atomic association <|rules...|>
+		@remarks Every argument should be a rule, for example wlr::Rule("key", 1). The result satisfies wlr_AssociationQ
+	   without being evaluated: it is built with wlr_VariadicAssociation, or, when a wlr::Splice makes the number of
+	   rules dynamic, by evaluating Association[{rules...}].
+	*/
+	template <typename... Rules>
+	wlr_expr Association(const Rules&... rules)
+	{
+		if constexpr(StaticChildCount<Rules...> >= 0)
+		{
+			return wlr_VariadicAssociation(static_cast<mint>(sizeof...(Rules)), detail::ToExpression(rules)...);
+		}
+		else
+		{
+			wlr_expr ruleList = detail::BuildFromBag(detail::ListHead(), rules...);
+
+			return wlr_Eval(detail::BuildFromBag(Symbol(SystemSymbol::Association), ruleList));
+		}
+	}
+}
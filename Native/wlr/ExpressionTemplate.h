@@ -0,0 +1,302 @@
+/*
+	Expressions parsed once with placeholders and instantiated with native values
+
+	Building an input string with the request's arguments and parsing it again for every request costs a string format,
+	a wlr_String and a full wlr_ParseExpression. A wlr::ExpressionTemplate parses the expression once, with named (#name)
+	or numbered (#1) slots as placeholders, and records the part position of every slot. Instantiating the template
+	replaces the slots with wlr_Part / wlr_ReplacePart along the recorded positions, so no formatting or parsing happens
+	per request.
+
+		auto power = wlr::ExpressionTemplate::Parse("N[Sin[#x] + Cos[#y]^2, 20]");
+		wlr_Eval(power.Instantiate(0.5, 1.25));
+
+	Slots inside Function bodies (for example the # in Map[#^2 &, list]) belong to that function and are left alone.
+	Slots inside atomic associations are not found.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Expr.h"
+#include "ExpressionBuilder.h"
+#include "Strings.h"
+#include "Symbols.h"
+
+namespace wlr
+{
+	/**
+		Parsed expression with placeholder slots that can be filled in without reparsing
+		@remarks A numbered slot #n is placeholder n - 1, as in Function, so f[#2, #1] swaps its values; a number up to
+	   the highest one used counts as a placeholder even if its slot does not appear. Named slots follow the numbered
+	   ones in the order of their first appearance in a depth-first walk of the expression. A placeholder that appears
+	   several times is replaced at every position.
+	*/
+	class ExpressionTemplate
+	{
+	public:
+		ExpressionTemplate() = default;
+
+		/**
+			Parse text and locate its placeholders
+			@remarks Check Valid() on the result; it is false if text failed to parse.
+		*/
+		static ExpressionTemplate Parse(std::string_view text)
+		{
+			ExpressionTemplate result;
+
+			wlr_expr parsed = wlr_ParseExpression(ToExpression(text));
+
+			if(wlr_ErrorQ(parsed))
+			{
+				return result;
+			}
+
+			result.expression = Expr::Detach(wlr_Clone(parsed));
+
+			std::vector<mint> path;
+			std::vector<std::size_t> slotNumbers;
+
+			result.FindPlaceholders(parsed, Symbol(SystemSymbol::Slot), Symbol(SystemSymbol::Function), path,
+									slotNumbers);
+			result.NumberPlaceholders(slotNumbers);
+
+			return result;
+		}
+
+		bool Valid() const noexcept
+		{
+			return static_cast<bool>(expression);
+		}
+
+		std::size_t PlaceholderCount() const noexcept
+		{
+			return placeholderNames.size();
+		}
+
+		/**
+			Index of the placeholder #name (or #n for a numbered slot, looked up as "n")
+		*/
+		std::optional<std::size_t> PlaceholderIndex(std::string_view name) const
+		{
+			for(std::size_t index = 0; index < placeholderNames.size(); ++index)
+			{
+				if(placeholderNames[index] == name)
+				{
+					return index;
+				}
+			}
+
+			return std::nullopt;
+		}
+
+		/**
+			Return a copy of the template in the current expression pool with placeholder i replaced by values[i]
+			@remarks Returns wlr_Error(WLR_OUT_OF_BOUNDS) if the template is not valid or valueCount is not the number
+			of placeholders.
+		*/
+		wlr_expr InstantiateFrom(const wlr_expr* values, std::size_t valueCount) const
+		{
+			if(!Valid() || valueCount != placeholderNames.size())
+			{
+				return wlr_Error(WLR_OUT_OF_BOUNDS);
+			}
+
+			if(occurrences.empty())
+			{
+				return expression.CloneToPool();
+			}
+
+			wlr_expr result = expression.Get();
+
+			for(const Occurrence& occurrence : occurrences)
+			{
+				result = ReplaceAt(result, paths.data() + occurrence.pathOffset, occurrence.pathLength,
+								   values[occurrence.placeholder]);
+			}
+
+			return result;
+		}
+
+		/**
+			Return a copy of the template with its placeholders replaced by native values or expressions, in order
+			@remarks Returns wlr_Error(WLR_OUT_OF_BOUNDS) if the number of values is not the number of placeholders.
+		*/
+		template <typename... Values>
+		wlr_expr Instantiate(const Values&... values) const
+		{
+			const wlr_expr expressions[sizeof...(Values) + 1] = {ToExpression(values)..., nullptr};
+
+			return InstantiateFrom(expressions, sizeof...(Values));
+		}
+
+	private:
+		struct Occurrence
+		{
+			std::size_t placeholder;
+			std::size_t pathOffset;
+			std::size_t pathLength;
+		};
+
+		static wlr_expr ReplaceAt(wlr_expr root, const mint* path, std::size_t pathLength, wlr_expr value)
+		{
+			if(pathLength == 0)
+			{
+				return value;
+			}
+
+			wlr_expr replaced = ReplaceAt(wlr_Part(root, path[0]), path + 1, pathLength - 1, value);
+
+			return wlr_ReplacePart(root, path[0], replaced);
+		}
+
+		/**
+			Name of the placeholder for the argument of a slot, with its number in slotNumber (0 for a named slot)
+			@remarks #0, the function itself in a Function, is not a placeholder.
+		*/
+		static std::optional<std::string> PlaceholderName(wlr_expr slotArgument, std::size_t& slotNumber)
+		{
+			slotNumber = 0;
+
+			switch(wlr_ExpressionType(slotArgument))
+			{
+				case WLR_STRING:
+					return std::string(StringData(slotArgument).View());
+
+				case WLR_NUMBER:
+				{
+					mint number = 0;
+
+					if(wlr_IntegerData(slotArgument, &number) == WLR_SUCCESS && number > 0)
+					{
+						slotNumber = static_cast<std::size_t>(number);
+
+						return std::to_string(number);
+					}
+
+					return std::nullopt;
+				}
+
+				default:
+					return std::nullopt;
+			}
+		}
+
+		void AddOccurrence(const std::string& name, const std::vector<mint>& path)
+		{
+			std::size_t placeholder = PlaceholderIndex(name).value_or(placeholderNames.size());
+
+			if(placeholder == placeholderNames.size())
+			{
+				placeholderNames.push_back(name);
+			}
+
+			occurrences.push_back(Occurrence {placeholder, paths.size(), path.size()});
+
+			paths.insert(paths.end(), path.begin(), path.end());
+		}
+
+		/**
+			Renumber the placeholders found in order of appearance so that #n is placeholder n - 1 and the named ones
+			follow
+			@remarks slotNumbers holds the slot number of each placeholder found, 0 for a named one.
+		*/
+		void NumberPlaceholders(const std::vector<std::size_t>& slotNumbers)
+		{
+			std::size_t highest = 0;
+
+			for(std::size_t number : slotNumbers)
+			{
+				highest = std::max(highest, number);
+			}
+
+			if(highest == 0)
+			{
+				return;
+			}
+
+			std::vector<std::string> names(highest);
+			std::vector<std::size_t> renumbered(slotNumbers.size());
+
+			for(std::size_t number = 1; number <= highest; ++number)
+			{
+				names[number - 1] = std::to_string(number);
+			}
+
+			for(std::size_t placeholder = 0; placeholder < slotNumbers.size(); ++placeholder)
+			{
+				if(slotNumbers[placeholder] != 0)
+				{
+					renumbered[placeholder] = slotNumbers[placeholder] - 1;
+				}
+				else
+				{
+					renumbered[placeholder] = names.size();
+					names.push_back(placeholderNames[placeholder]);
+				}
+			}
+
+			for(Occurrence& occurrence : occurrences)
+			{
+				occurrence.placeholder = renumbered[occurrence.placeholder];
+			}
+
+			placeholderNames = std::move(names);
+		}
+
+		void FindPlaceholders(wlr_expr node, wlr_expr slotSymbol, wlr_expr functionSymbol, std::vector<mint>& path,
+							  std::vector<std::size_t>& slotNumbers)
+		{
+			if(wlr_ExpressionType(node) != WLR_NORMAL)
+			{
+				return;
+			}
+
+			wlr_expr head = wlr_Head(node);
+
+			const mint length = wlr_Length(node);
+
+			if(wlr_SameQ(head, slotSymbol) && length == 1)
+			{
+				std::size_t slotNumber;
+
+				if(std::optional<std::string> name = PlaceholderName(wlr_Part(node, 1), slotNumber))
+				{
+					if(!PlaceholderIndex(*name))
+					{
+						slotNumbers.push_back(slotNumber);
+					}
+
+					AddOccurrence(*name, path);
+				}
+
+				return;
+			}
+
+			if(wlr_SameQ(head, functionSymbol))
+			{
+				return;
+			}
+
+			for(mint index = 1; index <= length; ++index)
+			{
+				path.push_back(index);
+
+				FindPlaceholders(wlr_Part(node, index), slotSymbol, functionSymbol, path, slotNumbers);
+
+				path.pop_back();
+			}
+		}
+
+		Expr expression;
+		std::vector<std::string> placeholderNames;
+		std::vector<Occurrence> occurrences;
+		std::vector<mint> paths;
+	};
+}
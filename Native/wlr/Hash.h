@@ -0,0 +1,79 @@
+/*
+	Fast non-cryptographic hashing used by the caches in this folder
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace wlr
+{
+	namespace detail
+	{
+		constexpr std::uint64_t HashMultiplier = 0x9E3779B97F4A7C15ull;
+
+		inline std::uint64_t MixHash(std::uint64_t value) noexcept
+		{
+			value ^= value >> 32;
+			value *= 0xD6E8FEB86659FD93ull;
+			value ^= value >> 32;
+			value *= 0xD6E8FEB86659FD93ull;
+			value ^= value >> 32;
+
+			return value;
+		}
+	}
+
+	/**
+		Combine a hash with another 64-bit value
+	*/
+	inline std::uint64_t HashCombine(std::uint64_t seed, std::uint64_t value) noexcept
+	{
+		return detail::MixHash(seed ^ (value + detail::HashMultiplier + (seed << 6) + (seed >> 2)));
+	}
+
+	/**
+		Hash a byte string, eight bytes at a time
+	*/
+	inline std::uint64_t HashBytes(std::string_view bytes, std::uint64_t seed = 0) noexcept
+	{
+		std::uint64_t hash = seed ^ (static_cast<std::uint64_t>(bytes.size()) * detail::HashMultiplier);
+
+		const char* data = bytes.data();
+		std::size_t remaining = bytes.size();
+
+		while(remaining >= 8)
+		{
+			std::uint64_t word;
+			std::memcpy(&word, data, 8);
+
+			hash = (hash ^ detail::MixHash(word)) * detail::HashMultiplier;
+
+			data += 8;
+			remaining -= 8;
+		}
+
+		std::uint64_t tail = 0;
+
+		if(remaining > 0)
+		{
+			std::memcpy(&tail, data, remaining);
+		}
+
+		return detail::MixHash(hash ^ tail);
+	}
+
+	/**
+		Hasher for unordered containers keyed by UTF-8 text
+	*/
+	struct TextHash
+	{
+		std::size_t operator()(std::string_view text) const noexcept
+		{
+			return static_cast<std::size_t>(HashBytes(text));
+		}
+	};
+}
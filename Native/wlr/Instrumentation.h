@@ -0,0 +1,530 @@
+/*
+	Memory accounting for evaluations and expression lifetimes
+
+	wlr::instrumentation wraps the expression-lifetime functions of the runtime (wlr_CreateExpressionPool,
+	wlr_ReleaseExpressionPool, wlr_DetachExpression, wlr_ReleaseExpression and wlr_ReleaseAll). wlr::Expr,
+	wlr::ExpressionPool and wlr::RecyclingExpressionPool call the wrappers, so with WLR_ENABLE_INSTRUMENTATION defined the
+	wrappers keep the current pool depth, its high-water mark and the number of live detached expressions in relaxed
+	atomic counters covering every expression managed through Expr.h. Without it the wrappers only call the runtime, the
+	counters read as 0, and Expr.h costs nothing over the bare C API.
+
+	wlr::MeasureEvaluation samples wlr_MemoryInUse before and after a piece of work, and records the change in memory,
+	the duration and the counters above under a request tag. Each tag gets a histogram of memory growth and high-water
+	marks. The cost per measured evaluation is two wlr_MemoryInUse calls, two clock reads and one uncontended lock;
+	set a sampling interval to measure only every Nth evaluation of a tag.
+
+	Defining WLR_TRACK_DETACHED_EXPRESSIONS (intended for debug builds) enables the counters and also records the call
+	site of every detach, so that wlr::instrumentation::ReportLiveExpressions can list detached expressions that were
+	never released.
+*/
+
+#pragma once
+
+#if defined(WLR_TRACK_DETACHED_EXPRESSIONS) && !defined(WLR_ENABLE_INSTRUMENTATION)
+#define WLR_ENABLE_INSTRUMENTATION
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Hash.h"
+#include "WolframLanguageRuntimeV1.h"
+
+namespace wlr
+{
+	/**
+		Source location of a call, captured through default arguments
+	*/
+	struct CallSite
+	{
+		const char* file = "";
+		unsigned line = 0;
+		const char* function = "";
+
+#if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1926)
+		static constexpr CallSite Current(const char* file = __builtin_FILE(), unsigned line = __builtin_LINE(),
+										  const char* function = __builtin_FUNCTION()) noexcept
+		{
+			return CallSite {file, line, function};
+		}
+#else
+		static constexpr CallSite Current() noexcept
+		{
+			return CallSite {};
+		}
+#endif
+	};
+
+	namespace instrumentation
+	{
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+		struct Counters
+		{
+			std::atomic<std::int64_t> poolDepth {0};
+			std::atomic<std::int64_t> poolDepthHighWater {0};
+			std::atomic<std::int64_t> liveDetachedExpressions {0};
+			std::atomic<std::uint64_t> detachedTotal {0};
+			std::atomic<std::uint64_t> releasedTotal {0};
+		};
+
+		inline Counters& GlobalCounters() noexcept
+		{
+			static Counters counters;
+
+			return counters;
+		}
+#endif
+
+		inline std::int64_t PoolDepth() noexcept
+		{
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+			return GlobalCounters().poolDepth.load(std::memory_order_relaxed);
+#else
+			return 0;
+#endif
+		}
+
+		/**
+			Deepest pool depth reached since the last ResetPoolDepthHighWater
+		*/
+		inline std::int64_t PoolDepthHighWater() noexcept
+		{
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+			return GlobalCounters().poolDepthHighWater.load(std::memory_order_relaxed);
+#else
+			return 0;
+#endif
+		}
+
+		/**
+			Raise the pool depth high-water mark to at least depth
+		*/
+		inline void RaisePoolDepthHighWater(std::int64_t depth) noexcept
+		{
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+			std::atomic<std::int64_t>& highWater = GlobalCounters().poolDepthHighWater;
+
+			std::int64_t current = highWater.load(std::memory_order_relaxed);
+
+			while(depth > current && !highWater.compare_exchange_weak(current, depth, std::memory_order_relaxed))
+			{
+			}
+#else
+			(void) depth;
+#endif
+		}
+
+		/**
+			Restart the pool depth high-water mark from the current depth and return the mark it replaces
+		*/
+		inline std::int64_t ResetPoolDepthHighWater() noexcept
+		{
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+			return GlobalCounters().poolDepthHighWater.exchange(PoolDepth(), std::memory_order_relaxed);
+#else
+			return 0;
+#endif
+		}
+
+		inline std::int64_t LiveDetachedExpressions() noexcept
+		{
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+			return GlobalCounters().liveDetachedExpressions.load(std::memory_order_relaxed);
+#else
+			return 0;
+#endif
+		}
+
+#if defined(WLR_TRACK_DETACHED_EXPRESSIONS)
+		namespace detail
+		{
+			struct LiveExpressionTable
+			{
+				std::mutex mutex;
+				std::unordered_map<wlr_expr, CallSite> sites;
+			};
+
+			/**
+				Deliberately never destroyed, so that expressions released during static destruction are still handled
+			*/
+			inline LiveExpressionTable& LiveExpressions()
+			{
+				static LiveExpressionTable* const table = new LiveExpressionTable();
+
+				return *table;
+			}
+		}
+#endif
+
+		inline void CreateExpressionPool() noexcept
+		{
+			wlr_CreateExpressionPool();
+
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+			RaisePoolDepthHighWater(GlobalCounters().poolDepth.fetch_add(1, std::memory_order_relaxed) + 1);
+#endif
+		}
+
+		inline void ReleaseExpressionPool() noexcept
+		{
+			wlr_ReleaseExpressionPool();
+
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+			GlobalCounters().poolDepth.fetch_sub(1, std::memory_order_relaxed);
+#endif
+		}
+
+		inline void DetachExpression(wlr_expr expression, CallSite site = CallSite::Current()) noexcept
+		{
+			wlr_DetachExpression(expression);
+
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+			Counters& counters = GlobalCounters();
+
+			counters.liveDetachedExpressions.fetch_add(1, std::memory_order_relaxed);
+			counters.detachedTotal.fetch_add(1, std::memory_order_relaxed);
+#endif
+
+#if defined(WLR_TRACK_DETACHED_EXPRESSIONS)
+			detail::LiveExpressionTable& table = detail::LiveExpressions();
+
+			std::lock_guard<std::mutex> lock(table.mutex);
+
+			table.sites[expression] = site;
+#else
+			(void) site;
+#endif
+		}
+
+		inline void ReleaseExpression(wlr_expr detachedExpression) noexcept
+		{
+			wlr_ReleaseExpression(detachedExpression);
+
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+			Counters& counters = GlobalCounters();
+
+			counters.liveDetachedExpressions.fetch_sub(1, std::memory_order_relaxed);
+			counters.releasedTotal.fetch_add(1, std::memory_order_relaxed);
+#endif
+
+#if defined(WLR_TRACK_DETACHED_EXPRESSIONS)
+			detail::LiveExpressionTable& table = detail::LiveExpressions();
+
+			std::lock_guard<std::mutex> lock(table.mutex);
+
+			table.sites.erase(detachedExpression);
+#endif
+		}
+
+		/**
+			Release every pool and every detached expression
+			@remarks Any wlr::Expr still alive afterwards holds a dangling expression and must be released with
+		   Release(), not Reset().
+		*/
+		inline void ReleaseAll() noexcept
+		{
+			wlr_ReleaseAll();
+
+#if defined(WLR_ENABLE_INSTRUMENTATION)
+			Counters& counters = GlobalCounters();
+
+			counters.poolDepth.store(0, std::memory_order_relaxed);
+			counters.liveDetachedExpressions.store(0, std::memory_order_relaxed);
+#endif
+
+#if defined(WLR_TRACK_DETACHED_EXPRESSIONS)
+			detail::LiveExpressionTable& table = detail::LiveExpressions();
+
+			std::lock_guard<std::mutex> lock(table.mutex);
+
+			table.sites.clear();
+#endif
+		}
+
+		/**
+			Detached expressions that have not been released, with the call site that detached them
+			@remarks Always empty unless WLR_TRACK_DETACHED_EXPRESSIONS is defined.
+		*/
+		inline std::vector<std::pair<wlr_expr, CallSite>> LiveExpressions()
+		{
+			std::vector<std::pair<wlr_expr, CallSite>> result;
+
+#if defined(WLR_TRACK_DETACHED_EXPRESSIONS)
+			detail::LiveExpressionTable& table = detail::LiveExpressions();
+
+			std::lock_guard<std::mutex> lock(table.mutex);
+
+			result.assign(table.sites.begin(), table.sites.end());
+#endif
+
+			return result;
+		}
+
+		/**
+			Print every live detached expression, grouped by call site, and return how many there are
+			@remarks Intended to run at shutdown, before wlr_ReleaseAll. Interned symbols and cached templates are
+		   detached for the lifetime of the process and show up here by design.
+		*/
+		inline std::size_t ReportLiveExpressions(std::FILE* stream = stderr)
+		{
+			std::vector<std::pair<wlr_expr, CallSite>> live = LiveExpressions();
+
+			std::sort(live.begin(), live.end(), [](const auto& first, const auto& second) {
+				const int byFile = std::string_view(first.second.file).compare(second.second.file);
+
+				return byFile != 0 ? byFile < 0 : first.second.line < second.second.line;
+			});
+
+			for(std::size_t begin = 0; begin < live.size();)
+			{
+				std::size_t end = begin + 1;
+
+				while(end < live.size() && live[end].second.line == live[begin].second.line &&
+					  std::string_view(live[end].second.file) == live[begin].second.file)
+				{
+					++end;
+				}
+
+				const CallSite& site = live[begin].second;
+
+				std::fprintf(stream, "%zu detached expression(s) never released, detached at %s:%u (%s)\n", end - begin,
+							 site.file, site.line, site.function);
+
+				begin = end;
+			}
+
+			return live.size();
+		}
+	}
+
+	/**
+		Accumulated measurements for one request tag
+		@remarks memoryGrowthHistogram[i] counts evaluations whose memory growth g satisfies 2^(i-1) <= g < 2^i bytes
+	   (bucket 0 counts evaluations that did not grow memory).
+	*/
+	struct EvaluationMemoryStatistics
+	{
+		std::string tag;
+		std::uint64_t evaluations = 0;
+		std::int64_t totalMemoryDelta = 0;
+		std::int64_t maximumMemoryDelta = 0;
+		std::int64_t highWaterMemoryInUse = 0;
+		std::int64_t highWaterPoolDepth = 0;
+		std::int64_t highWaterLiveDetachedExpressions = 0;
+		std::int64_t detachedExpressionDelta = 0;
+		std::uint64_t totalNanoseconds = 0;
+		std::uint64_t maximumNanoseconds = 0;
+		static constexpr std::size_t HistogramBuckets = 48;
+
+		std::array<std::uint64_t, HistogramBuckets> memoryGrowthHistogram {};
+	};
+
+	/**
+		Per-tag store for wlr::MeasureEvaluation
+	*/
+	class EvaluationMemoryRecorder
+	{
+	public:
+		/**
+			Measure only one of every sampleInterval evaluations of each tag
+		*/
+		explicit EvaluationMemoryRecorder(std::uint32_t sampleInterval = 1) noexcept
+			: sampleInterval(sampleInterval == 0 ? 1 : sampleInterval)
+		{
+		}
+
+		/**
+			The recorder used by wlr::MeasureEvaluation when none is given
+		*/
+		static EvaluationMemoryRecorder& Global()
+		{
+			static EvaluationMemoryRecorder* const recorder = new EvaluationMemoryRecorder();
+
+			return *recorder;
+		}
+
+		/**
+			Decide whether the next evaluation of tag is measured
+		*/
+		bool ShouldSample(std::string_view tag)
+		{
+			if(sampleInterval == 1)
+			{
+				return true;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			return Entry(tag).skipped++ % sampleInterval == 0;
+		}
+
+		void Record(std::string_view tag, std::int64_t memoryBefore, std::int64_t memoryAfter,
+					std::int64_t liveDetachedBefore, std::int64_t liveDetachedAfter, std::int64_t poolDepthHighWater,
+					std::uint64_t nanoseconds)
+		{
+			const std::int64_t delta = memoryAfter - memoryBefore;
+
+			std::size_t bucket = 0;
+
+			for(std::int64_t growth = delta; growth > 0 && bucket + 1 < EvaluationMemoryStatistics::HistogramBuckets;
+				growth >>= 1)
+			{
+				++bucket;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			EvaluationMemoryStatistics& statistics = Entry(tag).statistics;
+
+			++statistics.evaluations;
+			statistics.totalMemoryDelta += delta;
+			statistics.maximumMemoryDelta = std::max(statistics.maximumMemoryDelta, delta);
+			statistics.highWaterMemoryInUse = std::max({statistics.highWaterMemoryInUse, memoryBefore, memoryAfter});
+			statistics.highWaterPoolDepth = std::max(statistics.highWaterPoolDepth, poolDepthHighWater);
+			statistics.highWaterLiveDetachedExpressions =
+				std::max({statistics.highWaterLiveDetachedExpressions, liveDetachedBefore, liveDetachedAfter});
+			statistics.detachedExpressionDelta += liveDetachedAfter - liveDetachedBefore;
+			statistics.totalNanoseconds += nanoseconds;
+			statistics.maximumNanoseconds = std::max(statistics.maximumNanoseconds, nanoseconds);
+			++statistics.memoryGrowthHistogram[bucket];
+		}
+
+		/**
+			Copy of the statistics of every tag
+		*/
+		std::vector<EvaluationMemoryStatistics> Snapshot() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			std::vector<EvaluationMemoryStatistics> result;
+
+			result.reserve(entries.size());
+
+			for(const auto& entry : entries)
+			{
+				result.push_back(entry.second->statistics);
+			}
+
+			return result;
+		}
+
+		void Clear()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			entries.clear();
+		}
+
+		/**
+			Print one line per tag, largest total memory growth first
+		*/
+		void WriteReport(std::FILE* stream = stderr) const
+		{
+			std::vector<EvaluationMemoryStatistics> statistics = Snapshot();
+
+			std::sort(statistics.begin(), statistics.end(),
+					  [](const auto& first, const auto& second) { return first.totalMemoryDelta > second.totalMemoryDelta; });
+
+			for(const EvaluationMemoryStatistics& entry : statistics)
+			{
+				std::fprintf(stream,
+							 "%-32s %8llu evals  memory %+12lld B total %+10lld B max  peak %12lld B  pools %3lld  "
+							 "detached %+6lld (peak %lld)  %10.1f us mean\n",
+							 entry.tag.c_str(), static_cast<unsigned long long>(entry.evaluations),
+							 static_cast<long long>(entry.totalMemoryDelta), static_cast<long long>(entry.maximumMemoryDelta),
+							 static_cast<long long>(entry.highWaterMemoryInUse), static_cast<long long>(entry.highWaterPoolDepth),
+							 static_cast<long long>(entry.detachedExpressionDelta),
+							 static_cast<long long>(entry.highWaterLiveDetachedExpressions),
+							 entry.evaluations == 0 ? 0.0
+													: static_cast<double>(entry.totalNanoseconds) / 1000.0 /
+														  static_cast<double>(entry.evaluations));
+			}
+		}
+
+	private:
+		struct TagEntry
+		{
+			EvaluationMemoryStatistics statistics;
+			std::uint64_t skipped = 0;
+		};
+
+		TagEntry& Entry(std::string_view tag)
+		{
+			auto found = entries.find(tag);
+
+			if(found == entries.end())
+			{
+				auto entry = std::make_unique<TagEntry>();
+
+				entry->statistics.tag = std::string(tag);
+
+				found = entries.emplace(entry->statistics.tag, std::move(entry)).first;
+			}
+
+			return *found->second;
+		}
+
+		std::uint32_t sampleInterval;
+		mutable std::mutex mutex;
+		// Keys view the tag string of their own entry
+		std::unordered_map<std::string_view, std::unique_ptr<TagEntry>, TextHash> entries;
+	};
+
+	/**
+		Run work and record its effect on kernel memory under tag
+		@remarks Must be called on the thread that owns the runtime. Returns whatever work returns.
+		@remarks The pool depth and detached expression counts are recorded only with WLR_ENABLE_INSTRUMENTATION
+	   defined; the pool depth high-water mark covers every pool created while work runs, including nested
+	   measurements.
+	*/
+	template <typename Work>
+	decltype(auto) MeasureEvaluation(std::string_view tag, Work&& work,
+									 EvaluationMemoryRecorder& recorder = EvaluationMemoryRecorder::Global())
+	{
+		if(!recorder.ShouldSample(tag))
+		{
+			return work();
+		}
+
+		struct Sample
+		{
+			EvaluationMemoryRecorder& recorder;
+			std::string_view tag;
+			std::int64_t memoryBefore = wlr_MemoryInUse();
+			std::int64_t liveDetachedBefore = instrumentation::LiveDetachedExpressions();
+			std::int64_t enclosingPoolDepthHighWater = instrumentation::ResetPoolDepthHighWater();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			~Sample()
+			{
+				const auto elapsed = std::chrono::steady_clock::now() - start;
+
+				const std::int64_t poolDepthHighWater = instrumentation::PoolDepthHighWater();
+
+				// An enclosing measurement still sees the pools created during this one
+				instrumentation::RaisePoolDepthHighWater(enclosingPoolDepthHighWater);
+
+				recorder.Record(tag, memoryBefore, wlr_MemoryInUse(), liveDetachedBefore,
+								instrumentation::LiveDetachedExpressions(), poolDepthHighWater,
+								static_cast<std::uint64_t>(
+									std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+			}
+		};
+
+		Sample sample {recorder, tag};
+
+		return work();
+	}
+}
@@ -0,0 +1,512 @@
+/*
+	Single-threaded owner of the runtime that accepts work from any thread
+
+	The runtime is not safe to call from several threads at once. Rather than having every caller serialize around
+	wlr_Eval with a shared mutex, a wlr::KernelExecutor starts the runtime on a dedicated kernel thread and runs every
+	submitted work item there, in submission order. Submission goes through a lock-free multi-producer, single-consumer
+	queue, so producers never block each other; the only lock is taken to wake the kernel thread when it is idle.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "Expr.h"
+
+namespace wlr
+{
+	namespace detail
+	{
+		/**
+			Intrusive node of the MPSC queue
+		*/
+		struct WorkItem
+		{
+			virtual ~WorkItem() = default;
+
+			virtual void Run() = 0;
+
+			/**
+				Complete the item with error instead of running it
+				@remarks Items without a future to carry the error are only destroyed.
+			*/
+			virtual void Fail(std::exception_ptr)
+			{
+			}
+
+			std::atomic<WorkItem*> next {nullptr};
+			std::chrono::steady_clock::time_point enqueueTime;
+		};
+
+		template <typename Work>
+		struct TaskWorkItem final : WorkItem
+		{
+			explicit TaskWorkItem(Work&& work) : task(std::move(work))
+			{
+			}
+
+			void Run() override
+			{
+				task();
+			}
+
+			Work task;
+		};
+
+		/**
+			Work item of KernelExecutor::Submit, which completes its promise with the result, the exception thrown, or
+			the error it is failed with
+		*/
+		template <typename Work, typename Result>
+		struct PromiseWorkItem final : WorkItem
+		{
+			explicit PromiseWorkItem(Work&& work) : work(std::move(work))
+			{
+			}
+
+			void Run() override
+			{
+				try
+				{
+					if constexpr(std::is_void<Result>::value)
+					{
+						work();
+						promise.set_value();
+					}
+					else
+					{
+						promise.set_value(work());
+					}
+				}
+				catch(...)
+				{
+					promise.set_exception(std::current_exception());
+				}
+			}
+
+			void Fail(std::exception_ptr error) override
+			{
+				promise.set_exception(error);
+			}
+
+			Work work;
+			std::promise<Result> promise;
+		};
+
+		/**
+			Unbounded lock-free multi-producer, single-consumer queue (Vyukov's intrusive design)
+			@remarks Push may be called from any thread; Pop must only be called from the consumer thread. Pop can briefly
+		   return nullptr while a concurrent Push is half-way through linking its node.
+		*/
+		class MpscQueue
+		{
+		public:
+			MpscQueue() noexcept : head(&stub), tail(&stub)
+			{
+			}
+
+			void Push(WorkItem* item) noexcept
+			{
+				item->next.store(nullptr, std::memory_order_relaxed);
+
+				WorkItem* previous = head.exchange(item, std::memory_order_acq_rel);
+
+				previous->next.store(item, std::memory_order_release);
+			}
+
+			WorkItem* Pop() noexcept
+			{
+				WorkItem* current = tail;
+				WorkItem* next = current->next.load(std::memory_order_acquire);
+
+				if(current == &stub)
+				{
+					if(next == nullptr)
+					{
+						return nullptr;
+					}
+
+					tail = next;
+					current = next;
+					next = next->next.load(std::memory_order_acquire);
+				}
+
+				if(next != nullptr)
+				{
+					tail = next;
+					return current;
+				}
+
+				if(current != head.load(std::memory_order_acquire))
+				{
+					return nullptr;
+				}
+
+				Push(&stub);
+
+				next = current->next.load(std::memory_order_acquire);
+
+				if(next != nullptr)
+				{
+					tail = next;
+					return current;
+				}
+
+				return nullptr;
+			}
+
+		private:
+			std::atomic<WorkItem*> head;
+			WorkItem* tail;
+
+			struct StubWorkItem final : WorkItem
+			{
+				void Run() override
+				{
+				}
+			} stub;
+		};
+	}
+
+	/**
+		Counters published by a KernelExecutor
+		@remarks queueDepth is the number of submitted items that have not started running. Wait times measure the time
+	   between submission and the start of execution.
+	*/
+	struct KernelExecutorStatistics
+	{
+		std::uint64_t submitted;
+		std::uint64_t completed;
+		std::uint64_t queueDepth;
+		std::uint64_t totalWaitNanoseconds;
+		std::uint64_t maximumWaitNanoseconds;
+	};
+
+	/**
+		Dedicated kernel thread that owns the runtime
+		@remarks The constructor launches the kernel thread, which calls startRuntime (typically a lambda around
+	   wlr_sdk_StartRuntime) before running any work. Every work item runs inside a RecyclingExpressionPool owned by the
+	   kernel thread, so work must return native values or detached wlr::Expr handles, never pooled wlr_expr values.
+		@remarks If startRuntime does not return WLR_SUCCESS or throws, no work runs. Futures returned by Submit hold
+	   the exception startRuntime threw, or a std::runtime_error naming the error it returned; Post items are destroyed
+	   without calling their callbacks.
+		@remarks The destructor runs every item already submitted, then stops the kernel thread. It does not close the
+	   runtime. Work submitted once the destructor has started is not run: its future holds a std::runtime_error.
+	*/
+	class KernelExecutor
+	{
+	public:
+		explicit KernelExecutor(std::function<wlr_err_t()> startRuntime, std::size_t requestsPerPoolCycle = 64)
+		{
+			kernelThread = std::thread(
+				[this, startRuntime = std::move(startRuntime), requestsPerPoolCycle]() mutable
+				{ Run(std::move(startRuntime), requestsPerPoolCycle); });
+		}
+
+		KernelExecutor(const KernelExecutor&) = delete;
+		KernelExecutor& operator=(const KernelExecutor&) = delete;
+
+		~KernelExecutor()
+		{
+			stopping.store(true, std::memory_order_seq_cst);
+
+			Wake();
+
+			kernelThread.join();
+
+			// Items pushed while the kernel thread was leaving
+			FailWork(StoppedError(), false);
+		}
+
+		/**
+			Future holding the result of the startRuntime function, or the exception it threw
+		*/
+		std::shared_future<wlr_err_t> Started() const
+		{
+			return started;
+		}
+
+		/**
+			Run work on the kernel thread and return a future for its result
+		*/
+		template <typename Work>
+		std::future<std::invoke_result_t<std::decay_t<Work>&>> Submit(Work&& work)
+		{
+			using Result = std::invoke_result_t<std::decay_t<Work>&>;
+
+			auto* item = new detail::PromiseWorkItem<std::decay_t<Work>, Result>(std::forward<Work>(work));
+
+			std::future<Result> result = item->promise.get_future();
+
+			Enqueue(item);
+
+			return result;
+		}
+
+		/**
+			Run work on the kernel thread and pass its result to onComplete, also on the kernel thread
+			@remarks onComplete should return quickly; it delays every item queued behind it.
+			@remarks There is no future to carry an exception, so if work throws, onComplete is not called and the
+		   exception is dropped; an exception from onComplete is dropped too. Work that cannot run, because the runtime
+		   did not start or the executor is stopping, is destroyed without calling onComplete. Use Submit to observe
+		   failures.
+		*/
+		template <typename Work, typename Callback>
+		void Post(Work&& work, Callback&& onComplete)
+		{
+			EnqueueTask(
+				[work = std::forward<Work>(work), onComplete = std::forward<Callback>(onComplete)]() mutable
+				{
+					try
+					{
+						if constexpr(std::is_void<std::invoke_result_t<std::decay_t<Work>&>>::value)
+						{
+							work();
+							onComplete();
+						}
+						else
+						{
+							onComplete(work());
+						}
+					}
+					catch(...)
+					{
+					}
+				});
+		}
+
+		/**
+			Whether the calling thread is the kernel thread
+		*/
+		bool OnKernelThread() const noexcept
+		{
+			return std::this_thread::get_id() == kernelThread.get_id();
+		}
+
+		KernelExecutorStatistics Statistics() const noexcept
+		{
+			const std::uint64_t submittedCount = submitted.load(std::memory_order_relaxed);
+			const std::uint64_t startedCount = dequeued.load(std::memory_order_relaxed);
+
+			return KernelExecutorStatistics {submittedCount,
+											 completed.load(std::memory_order_relaxed),
+											 submittedCount - startedCount,
+											 totalWaitNanoseconds.load(std::memory_order_relaxed),
+											 maximumWaitNanoseconds.load(std::memory_order_relaxed)};
+		}
+
+	private:
+		template <typename Work>
+		void EnqueueTask(Work&& work)
+		{
+			Enqueue(new detail::TaskWorkItem<std::decay_t<Work>>(std::forward<Work>(work)));
+		}
+
+		void Enqueue(detail::WorkItem* item)
+		{
+			if(stopping.load(std::memory_order_seq_cst))
+			{
+				item->Fail(StoppedError());
+				delete item;
+				return;
+			}
+
+			item->enqueueTime = std::chrono::steady_clock::now();
+
+			// Count the item before publishing it, so that queueDepth never goes negative
+			submitted.fetch_add(1, std::memory_order_seq_cst);
+
+			queue.Push(item);
+
+			if(sleeping.load(std::memory_order_seq_cst))
+			{
+				Wake();
+			}
+		}
+
+		void Wake()
+		{
+			{
+				std::lock_guard<std::mutex> lock(wakeMutex);
+			}
+
+			wakeCondition.notify_one();
+		}
+
+		static std::exception_ptr StoppedError()
+		{
+			return std::make_exception_ptr(std::runtime_error("wlr::KernelExecutor: the executor is stopping"));
+		}
+
+		bool HasPendingWork() const noexcept
+		{
+			return submitted.load(std::memory_order_seq_cst) != dequeued.load(std::memory_order_relaxed);
+		}
+
+		void Run(std::function<wlr_err_t()> startRuntime, std::size_t requestsPerPoolCycle)
+		{
+			std::exception_ptr startupError;
+
+			try
+			{
+				const wlr_err_t error = startRuntime();
+
+				if(error != WLR_SUCCESS)
+				{
+					const std::string message =
+						"wlr::KernelExecutor: the runtime did not start, error " + std::to_string(static_cast<int>(error));
+
+					startupError = std::make_exception_ptr(std::runtime_error(message));
+				}
+
+				startedPromise.set_value(error);
+			}
+			catch(...)
+			{
+				startupError = std::current_exception();
+
+				startedPromise.set_exception(startupError);
+			}
+
+			if(startupError)
+			{
+				FailWork(startupError, true);
+				return;
+			}
+
+			RecyclingExpressionPool pool(requestsPerPoolCycle);
+
+			for(;;)
+			{
+				detail::WorkItem* item = queue.Pop();
+
+				if(item == nullptr)
+				{
+					if(HasPendingWork())
+					{
+						// A producer is between publishing its node and linking it
+						std::this_thread::yield();
+						continue;
+					}
+
+					if(stopping.load(std::memory_order_seq_cst))
+					{
+						break;
+					}
+
+					WaitForWork();
+					continue;
+				}
+
+				dequeued.fetch_add(1, std::memory_order_relaxed);
+
+				RecordWait(item->enqueueTime);
+
+				item->Run();
+
+				delete item;
+
+				completed.fetch_add(1, std::memory_order_relaxed);
+
+				pool.EndRequest();
+			}
+		}
+
+		/**
+			Fail every queued item without running it, and, if untilStopped, every item submitted until the executor
+			stops
+			@remarks Runs on the only consumer of the queue: the kernel thread, or the destructor once it has joined it.
+		*/
+		void FailWork(std::exception_ptr error, bool untilStopped)
+		{
+			for(;;)
+			{
+				detail::WorkItem* item = queue.Pop();
+
+				if(item == nullptr)
+				{
+					if(HasPendingWork())
+					{
+						std::this_thread::yield();
+						continue;
+					}
+
+					if(!untilStopped || stopping.load(std::memory_order_seq_cst))
+					{
+						break;
+					}
+
+					WaitForWork();
+					continue;
+				}
+
+				dequeued.fetch_add(1, std::memory_order_relaxed);
+
+				item->Fail(error);
+
+				delete item;
+
+				completed.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		void WaitForWork()
+		{
+			sleeping.store(true, std::memory_order_seq_cst);
+
+			if(!HasPendingWork() && !stopping.load(std::memory_order_seq_cst))
+			{
+				std::unique_lock<std::mutex> lock(wakeMutex);
+
+				wakeCondition.wait(lock, [this] { return HasPendingWork() || stopping.load(std::memory_order_seq_cst); });
+			}
+
+			sleeping.store(false, std::memory_order_seq_cst);
+		}
+
+		void RecordWait(std::chrono::steady_clock::time_point enqueueTime) noexcept
+		{
+			const std::uint64_t waitNanoseconds = static_cast<std::uint64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - enqueueTime)
+					.count());
+
+			totalWaitNanoseconds.fetch_add(waitNanoseconds, std::memory_order_relaxed);
+
+			if(waitNanoseconds > maximumWaitNanoseconds.load(std::memory_order_relaxed))
+			{
+				maximumWaitNanoseconds.store(waitNanoseconds, std::memory_order_relaxed);
+			}
+		}
+
+		detail::MpscQueue queue;
+
+		std::atomic<std::uint64_t> submitted {0};
+		std::atomic<std::uint64_t> dequeued {0};
+		std::atomic<std::uint64_t> completed {0};
+		std::atomic<std::uint64_t> totalWaitNanoseconds {0};
+		std::atomic<std::uint64_t> maximumWaitNanoseconds {0};
+
+		std::atomic<bool> sleeping {false};
+		std::atomic<bool> stopping {false};
+		std::mutex wakeMutex;
+		std::condition_variable wakeCondition;
+
+		std::promise<wlr_err_t> startedPromise;
+		std::shared_future<wlr_err_t> started {startedPromise.get_future().share()};
+
+		std::thread kernelThread;
+	};
+}
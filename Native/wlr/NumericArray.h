@@ -0,0 +1,509 @@
+/*
+	Typed views over MNumericArray data
+
+	The MNumericArray functions in WolframLanguageRuntimeV1.h return the element type, rank, dimensions and a void* to the
+	data through separate calls. wlr::NumericArrayView<T, Rank> checks the element type and rank once, then gives typed,
+	row-major access to the elements in place, with bounds checks in debug builds and flat iterators. A view of host
+	memory may also be strided, for example a region of a larger image or one channel of interleaved samples.
+	wlr::NumericArray owns an MNumericArray allocated on the host.
+
+	The expression API has no way to make an MNumericArray that refers to memory it did not allocate: wlr_MNumericArray_new
+	always allocates its own buffer. To avoid copying large payloads, allocate the array first with
+	wlr::NumericArray::Create and produce the data directly into View<T, Rank>(); wlr::NumericArray::FromBuffer is the
+	single-memcpy fallback for data that already exists elsewhere.
+*/
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<version>)
+#include <version>
+#endif
+
+#if defined(__cpp_lib_span)
+#include <span>
+#endif
+
+#if defined(__cpp_lib_mdspan)
+#include <mdspan>
+#endif
+
+#include "WolframLanguageRuntimeV1.h"
+
+namespace wlr
+{
+	/**
+		IEEE 754 binary16 value, stored as its bit pattern (MNumericArray_Type_Real16)
+	*/
+	struct Half
+	{
+		std::uint16_t bits;
+	};
+
+	/**
+		Complex number with binary16 parts (MNumericArray_Type_Complex_Real16)
+	*/
+	struct ComplexHalf
+	{
+		Half real;
+		Half imaginary;
+	};
+
+	/**
+		The numericarray_data_t corresponding to the host element type T, or MNumericArray_Type_Undef if there is none
+	*/
+	template <typename T>
+	constexpr numericarray_data_t NumericArrayType = MNumericArray_Type_Undef;
+
+	template <>
+	constexpr numericarray_data_t NumericArrayType<std::int8_t> = MNumericArray_Type_Bit8;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<std::uint8_t> = MNumericArray_Type_UBit8;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<std::int16_t> = MNumericArray_Type_Bit16;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<std::uint16_t> = MNumericArray_Type_UBit16;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<std::int32_t> = MNumericArray_Type_Bit32;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<std::uint32_t> = MNumericArray_Type_UBit32;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<std::int64_t> = MNumericArray_Type_Bit64;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<std::uint64_t> = MNumericArray_Type_UBit64;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<float> = MNumericArray_Type_Real32;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<double> = MNumericArray_Type_Real64;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<std::complex<float>> = MNumericArray_Type_Complex_Real32;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<std::complex<double>> = MNumericArray_Type_Complex_Real64;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<Half> = MNumericArray_Type_Real16;
+	template <>
+	constexpr numericarray_data_t NumericArrayType<ComplexHalf> = MNumericArray_Type_Complex_Real16;
+
+	/**
+		Size in bytes of one element of the given type
+	*/
+	constexpr std::size_t NumericArrayElementSize(numericarray_data_t type) noexcept
+	{
+		switch(type)
+		{
+			case MNumericArray_Type_Bit8:
+			case MNumericArray_Type_UBit8:
+				return 1;
+			case MNumericArray_Type_Bit16:
+			case MNumericArray_Type_UBit16:
+			case MNumericArray_Type_Real16:
+				return 2;
+			case MNumericArray_Type_Bit32:
+			case MNumericArray_Type_UBit32:
+			case MNumericArray_Type_Real32:
+			case MNumericArray_Type_Complex_Real16:
+				return 4;
+			case MNumericArray_Type_Bit64:
+			case MNumericArray_Type_UBit64:
+			case MNumericArray_Type_Real64:
+			case MNumericArray_Type_Complex_Real32:
+				return 8;
+			case MNumericArray_Type_Complex_Real64:
+				return 16;
+			default:
+				return 0;
+		}
+	}
+
+	/**
+		Rank value for views whose rank is only known at run time
+	*/
+	constexpr std::size_t DynamicRank = static_cast<std::size_t>(-1);
+
+	/**
+		Non-owning, typed view of the elements of an MNumericArray or of host memory
+		@remarks T may be const-qualified for read-only access. The view is valid while the underlying array is alive and
+	   not resized; it never copies elements.
+		@remarks Indices are zero-based. Out-of-range indices are caught by assert in debug builds only.
+		@remarks Views of an MNumericArray are contiguous and row-major. A view of host memory may instead have a stride
+	   per axis, in elements; such a view supports operator() and operator[], but not the flat accessors begin, end,
+	   Flat and MdSpan, which require Contiguous(). An MNumericArray is always contiguous, so a strided view must be
+	   copied element by element to pass it to the runtime.
+	*/
+	template <typename T, std::size_t Rank = DynamicRank>
+	class NumericArrayView
+	{
+		static_assert(NumericArrayType<std::remove_const_t<T>> != MNumericArray_Type_Undef,
+					  "wlr::NumericArrayView: T is not a numeric array element type");
+		static_assert(Rank != 0, "wlr::NumericArrayView: Rank must be at least 1");
+
+	public:
+		NumericArrayView() noexcept = default;
+
+		/**
+			View the elements of numericArray
+			@remarks If the element type is not T, or the rank is not Rank, the view is left empty and Valid() is false.
+		*/
+		explicit NumericArrayView(MNumericArray numericArray) noexcept
+		{
+			if(numericArray == nullptr ||
+			   wlr_MNumericArray_getType(numericArray) != NumericArrayType<std::remove_const_t<T>>)
+			{
+				return;
+			}
+
+			const mint arrayRank = wlr_MNumericArray_getRank(numericArray);
+
+			if(Rank != DynamicRank && arrayRank != static_cast<mint>(Rank))
+			{
+				return;
+			}
+
+			data = static_cast<T*>(wlr_MNumericArray_getData(numericArray));
+			dimensions = wlr_MNumericArray_getDimensions(numericArray);
+			rank = arrayRank;
+			length = wlr_MNumericArray_getFlattenedLength(numericArray);
+		}
+
+		/**
+			View host memory with the given row-major dimensions
+		*/
+		NumericArrayView(T* data, const mint* dimensions, mint rank) noexcept
+			: data(data), dimensions(dimensions), rank(rank), length(1)
+		{
+			assert(Rank == DynamicRank || rank == static_cast<mint>(Rank));
+
+			for(mint axis = 0; axis < rank; ++axis)
+			{
+				length *= dimensions[axis];
+			}
+		}
+
+		/**
+			View host memory with the given dimensions and a stride per axis, both counted in elements
+			@remarks dimensions and strides must outlive the view. Strides may be negative or larger than row-major
+		   ones; element (i0, i1, ...) is data[i0 * strides[0] + i1 * strides[1] + ...].
+		*/
+		NumericArrayView(T* data, const mint* dimensions, const mint* strides, mint rank) noexcept
+			: NumericArrayView(data, dimensions, rank)
+		{
+			this->strides = strides;
+		}
+
+		bool Valid() const noexcept
+		{
+			return data != nullptr;
+		}
+
+		T* Data() const noexcept
+		{
+			return data;
+		}
+
+		/**
+			Total number of elements
+		*/
+		mint Length() const noexcept
+		{
+			return length;
+		}
+
+		mint RankOf() const noexcept
+		{
+			return rank;
+		}
+
+		mint Dimension(mint axis) const noexcept
+		{
+			assert(axis >= 0 && axis < rank);
+
+			return dimensions[axis];
+		}
+
+		const mint* Dimensions() const noexcept
+		{
+			return dimensions;
+		}
+
+		/**
+			Whether the elements are stored back to back in row-major order, as in every MNumericArray
+		*/
+		bool Contiguous() const noexcept
+		{
+			return strides == nullptr;
+		}
+
+		/**
+			Element at the given zero-based indices, one per axis
+		*/
+		template <typename... Indices>
+		T& operator()(Indices... indices) const noexcept
+		{
+			static_assert(Rank == DynamicRank || sizeof...(Indices) == Rank,
+						  "wlr::NumericArrayView: wrong number of indices");
+			assert(static_cast<mint>(sizeof...(Indices)) == rank);
+
+			const mint indexArray[] = {static_cast<mint>(indices)...};
+
+			mint offset = 0;
+
+			for(mint axis = 0; axis < rank; ++axis)
+			{
+				assert(indexArray[axis] >= 0 && indexArray[axis] < dimensions[axis]);
+
+				offset = strides == nullptr ? offset * dimensions[axis] + indexArray[axis]
+											: offset + indexArray[axis] * strides[axis];
+			}
+
+			return data[offset];
+		}
+
+		/**
+			Sub-view with the first axis fixed at index, or the element itself for a rank-1 view
+			@remarks Views with DynamicRank always return a sub-view; use operator() to reach elements.
+		*/
+		decltype(auto) operator[](mint index) const noexcept
+		{
+			assert(index >= 0 && index < dimensions[0]);
+
+			const mint subLength = dimensions[0] == 0 ? 0 : length / dimensions[0];
+			const mint stride = strides == nullptr ? subLength : strides[0];
+
+			if constexpr(Rank == 1)
+			{
+				return data[index * stride];
+			}
+			else
+			{
+				constexpr std::size_t SubRank = Rank == DynamicRank ? DynamicRank : Rank - 1;
+
+				return NumericArrayView<T, SubRank>(data + index * stride, dimensions + 1,
+													strides == nullptr ? nullptr : strides + 1, subLength, rank - 1);
+			}
+		}
+
+		/**
+			Copy every element, in row-major order, to Length() elements at destination
+			@remarks A single memcpy for a contiguous view; the way to pack a strided view into an MNumericArray.
+		*/
+		void CopyTo(std::remove_const_t<T>* destination) const noexcept
+		{
+			if(strides == nullptr)
+			{
+				std::memcpy(destination, data, static_cast<std::size_t>(length) * sizeof(T));
+			}
+			else if(length != 0)
+			{
+				CopyAxis(destination, data, 0);
+			}
+		}
+
+		/**
+			First element in row-major order
+			@remarks begin, end, Flat and MdSpan require Contiguous().
+		*/
+		T* begin() const noexcept
+		{
+			assert(Contiguous());
+
+			return data;
+		}
+
+		T* end() const noexcept
+		{
+			assert(Contiguous());
+
+			return data + length;
+		}
+
+#if defined(__cpp_lib_span)
+		/**
+			All elements in row-major order
+		*/
+		std::span<T> Flat() const noexcept
+		{
+			assert(Contiguous());
+
+			return std::span<T>(data, static_cast<std::size_t>(length));
+		}
+#endif
+
+#if defined(__cpp_lib_mdspan)
+		/**
+			The elements as a std::mdspan with the same extents
+		*/
+		auto MdSpan() const noexcept
+			requires(Rank != DynamicRank)
+		{
+			assert(Contiguous());
+
+			std::array<mint, Rank> extents;
+
+			for(std::size_t axis = 0; axis < Rank; ++axis)
+			{
+				extents[axis] = dimensions[axis];
+			}
+
+			return std::mdspan<T, std::dextents<mint, Rank>>(data, extents);
+		}
+#endif
+
+	private:
+		template <typename, std::size_t>
+		friend class NumericArrayView;
+
+		NumericArrayView(T* data, const mint* dimensions, const mint* strides, mint length, mint rank) noexcept
+			: data(data), dimensions(dimensions), strides(strides), rank(rank), length(length)
+		{
+		}
+
+		std::remove_const_t<T>* CopyAxis(std::remove_const_t<T>* destination, T* source, mint axis) const noexcept
+		{
+			for(mint index = 0; index < dimensions[axis]; ++index, source += strides[axis])
+			{
+				if(axis + 1 == rank)
+				{
+					*destination++ = *source;
+				}
+				else
+				{
+					destination = CopyAxis(destination, source, axis + 1);
+				}
+			}
+
+			return destination;
+		}
+
+		T* data = nullptr;
+		const mint* dimensions = nullptr;
+		// Null for contiguous row-major storage
+		const mint* strides = nullptr;
+		mint rank = 0;
+		mint length = 0;
+	};
+
+	/**
+		Move-only owner of an MNumericArray allocated on the host
+		@remarks The destructor calls wlr_MNumericArray_free.
+	*/
+	class NumericArray
+	{
+	public:
+		NumericArray() noexcept = default;
+
+		NumericArray(const NumericArray&) = delete;
+		NumericArray& operator=(const NumericArray&) = delete;
+
+		NumericArray(NumericArray&& other) noexcept : numericArray(other.numericArray)
+		{
+			other.numericArray = nullptr;
+		}
+
+		NumericArray& operator=(NumericArray&& other) noexcept
+		{
+			if(this != &other)
+			{
+				Reset();
+
+				numericArray = other.numericArray;
+				other.numericArray = nullptr;
+			}
+
+			return *this;
+		}
+
+		~NumericArray()
+		{
+			Reset();
+		}
+
+		/**
+			Allocate an uninitialized array of the given type and dimensions
+		*/
+		static errcode_t Create(numericarray_data_t type, mint rank, const mint* dimensions, NumericArray& result) noexcept
+		{
+			result.Reset();
+
+			return wlr_MNumericArray_new(type, rank, dimensions, &result.numericArray);
+		}
+
+		/**
+			Allocate an array and fill it from a host buffer of the same element type, with a single memcpy
+		*/
+		template <typename T>
+		static errcode_t FromBuffer(const T* data, mint rank, const mint* dimensions, NumericArray& result) noexcept
+		{
+			errcode_t error = Create(NumericArrayType<T>, rank, dimensions, result);
+
+			if(error == 0)
+			{
+				const mint length = wlr_MNumericArray_getFlattenedLength(result.numericArray);
+
+				std::memcpy(wlr_MNumericArray_getData(result.numericArray), data, static_cast<std::size_t>(length) * sizeof(T));
+			}
+
+			return error;
+		}
+
+		/**
+			Take ownership of an existing MNumericArray
+		*/
+		static NumericArray Adopt(MNumericArray numericArray) noexcept
+		{
+			NumericArray result;
+
+			result.numericArray = numericArray;
+
+			return result;
+		}
+
+		template <typename T, std::size_t Rank = DynamicRank>
+		NumericArrayView<T, Rank> View() const noexcept
+		{
+			return NumericArrayView<T, Rank>(numericArray);
+		}
+
+		MNumericArray Get() const noexcept
+		{
+			return numericArray;
+		}
+
+		/**
+			Give up ownership; the caller becomes responsible for wlr_MNumericArray_free
+		*/
+		MNumericArray Release() noexcept
+		{
+			MNumericArray released = numericArray;
+
+			numericArray = nullptr;
+
+			return released;
+		}
+
+		void Reset() noexcept
+		{
+			if(numericArray != nullptr)
+			{
+				wlr_MNumericArray_free(numericArray);
+
+				numericArray = nullptr;
+			}
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return numericArray != nullptr;
+		}
+
+	private:
+		MNumericArray numericArray = nullptr;
+	};
+}
@@ -0,0 +1,1081 @@
+/*
+	Host-side replacement for wlr_MNumericArray_convertType
+
+	wlr::ConvertElements converts between every pair of MNumericArray_Data_Type element types with each
+	MNumericArray_Convert_Method. It runs on the calling thread(s) instead of inside the runtime, picks a vector kernel for
+	the CPU at run time, and can split large arrays across several threads.
+
+	Methods (the Clip_ variants first clamp every value to the range of the result type, so they never fail on range):
+
+		Check   - fail unless every value fits the result type; a real value converted to an integer type must be within
+				  tolerance of an integer, and a complex value converted to a non-complex type must have an imaginary part
+				  within tolerance of 0
+		Coerce  - fail on out-of-range values; reals are truncated towards zero, imaginary parts are dropped
+		Round   - fail on out-of-range values; reals are rounded to the nearest integer (ties to even)
+		Scale   - map the full range of an integer type onto [0, 1] (unsigned) or [-1, 1] (signed) and back, rounding to
+				  the nearest integer; fail on out-of-range values
+		Cast    - never fail: integers wrap modulo the width of the result type, reals are truncated and saturate, NaN
+				  becomes 0
+
+	A real value is out of range for Real32 or Real16 if it is finite and rounds to infinity in that type; infinities and
+	NaNs are representable in every real and complex type. NaN is out of range for every integer type. Real16 results are
+	rounded through Real32.
+
+	Every vector kernel produces exactly the same bits as the scalar code for the same input.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "NumericArray.h"
+#include "Simd.h"
+
+namespace wlr
+{
+	/**
+		How a conversion is executed
+		@remarks threadCount 0 means one thread per hardware thread. An array is only split if every thread gets at least
+	   minimumElementsPerThread elements.
+	*/
+	struct ConvertOptions
+	{
+		unsigned threadCount = 1;
+		mint minimumElementsPerThread = mint(1) << 18;
+	};
+
+	namespace convert
+	{
+		enum class Base
+		{
+			Check,
+			Coerce,
+			Round,
+			Scale,
+			Cast
+		};
+
+		struct Method
+		{
+			Base base;
+			bool clip;
+			double tolerance;
+		};
+
+		template <typename T>
+		constexpr bool IsComplex = std::is_same<T, std::complex<float>>::value ||
+								   std::is_same<T, std::complex<double>>::value || std::is_same<T, ComplexHalf>::value;
+
+		template <typename T>
+		constexpr bool IsReal =
+			std::is_same<T, float>::value || std::is_same<T, double>::value || std::is_same<T, Half>::value;
+
+		template <typename T>
+		constexpr bool IsInteger = std::is_integral<T>::value;
+
+		/* binary16 <-> binary32, round to nearest even */
+
+		inline float HalfToFloat(Half value) noexcept
+		{
+			const std::uint32_t sign = static_cast<std::uint32_t>(value.bits & 0x8000u) << 16;
+			std::uint32_t exponent = (value.bits >> 10) & 0x1Fu;
+			std::uint32_t mantissa = value.bits & 0x3FFu;
+
+			std::uint32_t bits;
+
+			if(exponent == 0x1F)
+			{
+				bits = sign | 0x7F800000u | (mantissa << 13);
+			}
+			else if(exponent != 0)
+			{
+				bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+			}
+			else if(mantissa == 0)
+			{
+				bits = sign;
+			}
+			else
+			{
+				// Subnormal half: normalize
+				exponent = 113;
+
+				while((mantissa & 0x400u) == 0)
+				{
+					mantissa <<= 1;
+					--exponent;
+				}
+
+				bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+			}
+
+			float result;
+			std::memcpy(&result, &bits, sizeof(result));
+
+			return result;
+		}
+
+		inline Half FloatToHalf(float value) noexcept
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+
+			const std::uint16_t sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+			const std::uint32_t exponent = (bits >> 23) & 0xFFu;
+			std::uint32_t mantissa = bits & 0x7FFFFFu;
+
+			if(exponent == 0xFF)
+			{
+				// Infinity or NaN; keep NaNs quiet and non-zero
+				return Half {static_cast<std::uint16_t>(sign | 0x7C00u | (mantissa != 0 ? 0x200u | (mantissa >> 13) : 0u))};
+			}
+
+			const int unbiased = static_cast<int>(exponent) - 127;
+
+			if(unbiased > 15)
+			{
+				return Half {static_cast<std::uint16_t>(sign | 0x7C00u)};
+			}
+
+			if(unbiased >= -14)
+			{
+				// Normal half
+				std::uint32_t half = (static_cast<std::uint32_t>(unbiased + 15) << 10) | (mantissa >> 13);
+				const std::uint32_t remainder = mantissa & 0x1FFFu;
+
+				if(remainder > 0x1000u || (remainder == 0x1000u && (half & 1u) != 0))
+				{
+					++half;
+				}
+
+				return Half {static_cast<std::uint16_t>(sign | half)};
+			}
+
+			if(unbiased < -25)
+			{
+				return Half {sign};
+			}
+
+			// Subnormal half
+			mantissa |= 0x800000u;
+
+			const int shift = -1 - unbiased;
+			std::uint32_t half = mantissa >> shift;
+			const std::uint32_t remainder = mantissa & ((1u << shift) - 1u);
+			const std::uint32_t halfway = 1u << (shift - 1);
+
+			if(remainder > halfway || (remainder == halfway && (half & 1u) != 0))
+			{
+				++half;
+			}
+
+			return Half {static_cast<std::uint16_t>(sign | half)};
+		}
+
+		/* Reading elements */
+
+		template <typename T>
+		WLR_FORCE_INLINE double ReadReal(T value) noexcept
+		{
+			if constexpr(std::is_same<T, Half>::value)
+			{
+				return static_cast<double>(HalfToFloat(value));
+			}
+			else
+			{
+				return static_cast<double>(value);
+			}
+		}
+
+		template <typename T>
+		WLR_FORCE_INLINE double RealPart(const T& value) noexcept
+		{
+			if constexpr(std::is_same<T, ComplexHalf>::value)
+			{
+				return ReadReal(value.real);
+			}
+			else if constexpr(IsComplex<T>)
+			{
+				return static_cast<double>(value.real());
+			}
+			else
+			{
+				return ReadReal(value);
+			}
+		}
+
+		template <typename T>
+		WLR_FORCE_INLINE double ImaginaryPart(const T& value) noexcept
+		{
+			if constexpr(std::is_same<T, ComplexHalf>::value)
+			{
+				return ReadReal(value.imaginary);
+			}
+			else if constexpr(IsComplex<T>)
+			{
+				return static_cast<double>(value.imag());
+			}
+			else
+			{
+				return 0.0;
+			}
+		}
+
+		/* Ranges */
+
+		template <typename T>
+		struct RealLimits
+		{
+			// Largest finite value, and the smallest magnitude that rounds to infinity
+			static constexpr double maximum = static_cast<double>(std::numeric_limits<T>::max());
+			static constexpr double overflow = std::is_same<T, float>::value ? 3.4028235677973366e38
+																			 : std::numeric_limits<double>::infinity();
+		};
+
+		template <>
+		struct RealLimits<Half>
+		{
+			static constexpr double maximum = 65504.0;
+			static constexpr double overflow = 65520.0;
+		};
+
+		template <typename I>
+		constexpr double IntegerMaximum = static_cast<double>(std::numeric_limits<I>::max());
+
+		// Integer ranges as doubles, with an exclusive upper bound so that 64-bit limits are exact
+		template <typename I>
+		constexpr double IntegerLowerBound = static_cast<double>(std::numeric_limits<I>::min());
+
+		template <typename I>
+		constexpr double IntegerUpperBoundExclusive =
+			static_cast<double>(std::numeric_limits<I>::max() / 2 + 1) * 2.0;
+
+		/**
+			Normalized value of an integer for Scale: [0, 1] for unsigned types, [-1, 1] for signed types
+		*/
+		template <typename I>
+		WLR_FORCE_INLINE double NormalizeInteger(I value) noexcept
+		{
+			const double normalized = static_cast<double>(value) / IntegerMaximum<I>;
+
+			return normalized < -1.0 ? -1.0 : normalized;
+		}
+
+		/* Writing elements */
+
+		template <typename D>
+		WLR_FORCE_INLINE D RealToInteger(double value, const Method& method, bool& ok) noexcept
+		{
+			const double lower = IntegerLowerBound<D>;
+			const double upper = IntegerUpperBoundExclusive<D>;
+
+			if(value != value)
+			{
+				ok = ok && method.base == Base::Cast;
+				return D(0);
+			}
+
+			double integral;
+
+			switch(method.base)
+			{
+				case Base::Check:
+					integral = std::nearbyint(value);
+					ok = ok && std::fabs(value - integral) <= method.tolerance;
+					break;
+				case Base::Coerce:
+				case Base::Cast:
+					integral = std::trunc(value);
+					break;
+				case Base::Scale:
+					integral = std::nearbyint(value * IntegerMaximum<D>);
+					break;
+				default:
+					integral = std::nearbyint(value);
+					break;
+			}
+
+			if(integral < lower)
+			{
+				ok = ok && (method.clip || method.base == Base::Cast);
+				return std::numeric_limits<D>::min();
+			}
+
+			if(integral >= upper)
+			{
+				ok = ok && (method.clip || method.base == Base::Cast);
+				return std::numeric_limits<D>::max();
+			}
+
+			return static_cast<D>(integral);
+		}
+
+		template <typename D, typename S>
+		WLR_FORCE_INLINE D IntegerToInteger(S value, const Method& method, bool& ok) noexcept
+		{
+			if(method.base == Base::Cast && !method.clip)
+			{
+				return static_cast<D>(value);
+			}
+
+			if(method.base == Base::Scale)
+			{
+				return RealToInteger<D>(NormalizeInteger(value), method, ok);
+			}
+
+			const bool belowMinimum = std::is_signed<S>::value && (std::is_unsigned<D>::value
+																	   ? value < S(0)
+																	   : static_cast<std::intmax_t>(value) <
+																			 static_cast<std::intmax_t>(std::numeric_limits<D>::min()));
+
+			const bool aboveMaximum = !(value < S(0)) && static_cast<std::uintmax_t>(value) >
+															 static_cast<std::uintmax_t>(std::numeric_limits<D>::max());
+
+			if(belowMinimum)
+			{
+				ok = ok && method.clip;
+				return std::numeric_limits<D>::min();
+			}
+
+			if(aboveMaximum)
+			{
+				ok = ok && method.clip;
+				return std::numeric_limits<D>::max();
+			}
+
+			return static_cast<D>(value);
+		}
+
+		/**
+			Apply the range rule for the real type D to value, clamping it for the Clip_ methods
+		*/
+		template <typename D, typename W>
+		WLR_FORCE_INLINE W ClampReal(W value, const Method& method, bool& ok) noexcept
+		{
+			const W magnitude = std::fabs(value);
+
+			if(magnitude >= static_cast<W>(RealLimits<D>::overflow) && magnitude != std::numeric_limits<W>::infinity())
+			{
+				if(method.clip)
+				{
+					return value < 0 ? -static_cast<W>(RealLimits<D>::maximum) : static_cast<W>(RealLimits<D>::maximum);
+				}
+
+				ok = ok && method.base == Base::Cast;
+			}
+
+			return value;
+		}
+
+		// Real16 results are rounded through Real32, the same way the hardware conversions work
+		template <typename D>
+		WLR_FORCE_INLINE D RealToReal(double value, const Method& method, bool& ok) noexcept
+		{
+			if constexpr(std::is_same<D, double>::value)
+			{
+				return value;
+			}
+			else if constexpr(std::is_same<D, float>::value)
+			{
+				return static_cast<float>(ClampReal<float>(value, method, ok));
+			}
+			else
+			{
+				return FloatToHalf(ClampReal<Half>(RealToReal<float>(value, method, ok), method, ok));
+			}
+		}
+
+		/**
+			Convert one element of type S to type D
+		*/
+		template <typename S, typename D>
+		WLR_FORCE_INLINE D ConvertElement(const S& value, const Method& method, bool& ok) noexcept
+		{
+			if constexpr(std::is_same<S, D>::value)
+			{
+				return value;
+			}
+			else if constexpr(IsInteger<S> && IsInteger<D>)
+			{
+				return IntegerToInteger<D>(value, method, ok);
+			}
+			else
+			{
+				double real;
+				double imaginary = 0.0;
+
+				if constexpr(IsInteger<S>)
+				{
+					real = method.base == Base::Scale && !IsInteger<D> ? NormalizeInteger(value) : static_cast<double>(value);
+				}
+				else
+				{
+					real = RealPart(value);
+					imaginary = ImaginaryPart(value);
+
+					if constexpr(IsComplex<S> && !IsComplex<D>)
+					{
+						ok = ok && (method.base != Base::Check || std::fabs(imaginary) <= method.tolerance);
+					}
+				}
+
+				if constexpr(IsInteger<D>)
+				{
+					if constexpr(IsInteger<S>)
+					{
+						return D();
+					}
+					else
+					{
+						return RealToInteger<D>(real, method, ok);
+					}
+				}
+				else if constexpr(IsReal<D>)
+				{
+					return RealToReal<D>(real, method, ok);
+				}
+				else if constexpr(std::is_same<D, ComplexHalf>::value)
+				{
+					return ComplexHalf {RealToReal<Half>(real, method, ok), RealToReal<Half>(imaginary, method, ok)};
+				}
+				else
+				{
+					using Part = typename D::value_type;
+
+					return D(RealToReal<Part>(real, method, ok), RealToReal<Part>(imaginary, method, ok));
+				}
+			}
+		}
+
+		template <typename S, typename D>
+		WLR_FORCE_INLINE bool ConvertLoop(const S* source, D* destination, mint length, const Method& method) noexcept
+		{
+			bool ok = true;
+
+			for(mint index = 0; index < length; ++index)
+			{
+				destination[index] = ConvertElement<S, D>(source[index], method, ok);
+			}
+
+			return ok;
+		}
+
+		/* Generic kernels, compiled once per instruction set so that the compiler can vectorize them */
+
+		template <typename S, typename D>
+		bool ConvertScalar(const S* source, D* destination, mint length, const Method& method) noexcept
+		{
+			return ConvertLoop(source, destination, length, method);
+		}
+
+		template <typename S, typename D>
+		WLR_TARGET_AVX2 bool ConvertAvx2(const S* source, D* destination, mint length, const Method& method) noexcept
+		{
+			return ConvertLoop(source, destination, length, method);
+		}
+
+		template <typename S, typename D>
+		WLR_TARGET_AVX512 bool ConvertAvx512(const S* source, D* destination, mint length, const Method& method) noexcept
+		{
+			return ConvertLoop(source, destination, length, method);
+		}
+
+		/* Hand-written kernels for the hottest pairs */
+
+#if defined(WLR_SIMD_X86)
+		WLR_TARGET_AVX2 inline bool Real64ToReal32Avx2(const double* source, float* destination, mint length,
+													   const Method& method) noexcept
+		{
+			const __m256d signMask = _mm256_set1_pd(-0.0);
+			const __m256d overflow = _mm256_set1_pd(RealLimits<float>::overflow);
+			const __m256d infinity = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+			const __m256d maximum = _mm256_set1_pd(RealLimits<float>::maximum);
+			const bool checkRange = method.base != Base::Cast || method.clip;
+
+			__m256d failed = _mm256_setzero_pd();
+
+			mint index = 0;
+
+			for(; index + 4 <= length; index += 4)
+			{
+				__m256d value = _mm256_loadu_pd(source + index);
+
+				if(checkRange)
+				{
+					const __m256d magnitude = _mm256_andnot_pd(signMask, value);
+					const __m256d outOfRange = _mm256_and_pd(_mm256_cmp_pd(magnitude, overflow, _CMP_GE_OQ),
+															 _mm256_cmp_pd(magnitude, infinity, _CMP_NEQ_OQ));
+
+					if(method.clip)
+					{
+						const __m256d clamped = _mm256_or_pd(maximum, _mm256_and_pd(signMask, value));
+						value = _mm256_blendv_pd(value, clamped, outOfRange);
+					}
+					else
+					{
+						failed = _mm256_or_pd(failed, outOfRange);
+					}
+				}
+
+				_mm_storeu_ps(destination + index, _mm256_cvtpd_ps(value));
+			}
+
+			const bool ok = _mm256_movemask_pd(failed) == 0;
+
+			return ConvertLoop(source + index, destination + index, length - index, method) && ok;
+		}
+
+		// The AVX-512 kernels use the zero-masked forms of conversions and extracts with a full mask. GCC 12 builds the
+		// unmasked forms on an undefined source register, which -Wmaybe-uninitialized reports at -O2; with a constant
+		// full mask the compiler emits the same unmasked instructions.
+		WLR_TARGET_AVX512 inline bool Real64ToReal32Avx512(const double* source, float* destination, mint length,
+														   const Method& method) noexcept
+		{
+			const __m512d overflow = _mm512_set1_pd(RealLimits<float>::overflow);
+			const __m512d infinity = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+			const __m512d maximum = _mm512_set1_pd(RealLimits<float>::maximum);
+			const __m512i signMask = _mm512_set1_epi64(static_cast<long long>(0x8000000000000000ull));
+			const bool checkRange = method.base != Base::Cast || method.clip;
+
+			__mmask8 failed = 0;
+
+			mint index = 0;
+
+			for(; index + 8 <= length; index += 8)
+			{
+				__m512d value = _mm512_loadu_pd(source + index);
+
+				if(checkRange)
+				{
+					const __m512d magnitude = _mm512_abs_pd(value);
+					const __mmask8 outOfRange = _mm512_cmp_pd_mask(magnitude, overflow, _CMP_GE_OQ) &
+												_mm512_cmp_pd_mask(magnitude, infinity, _CMP_NEQ_OQ);
+
+					if(method.clip)
+					{
+						const __m512d clamped = _mm512_castsi512_pd(_mm512_or_si512(
+							_mm512_castpd_si512(maximum), _mm512_and_si512(_mm512_castpd_si512(value), signMask)));
+						value = _mm512_mask_blend_pd(outOfRange, value, clamped);
+					}
+					else
+					{
+						failed |= outOfRange;
+					}
+				}
+
+				_mm256_storeu_ps(destination + index, _mm512_maskz_cvtpd_ps(0xFF, value));
+			}
+
+			return ConvertLoop(source + index, destination + index, length - index, method) && failed == 0;
+		}
+
+		WLR_TARGET_AVX2 inline bool Real32ToReal16Avx2(const float* source, Half* destination, mint length,
+													   const Method& method) noexcept
+		{
+			const __m256 signMask = _mm256_set1_ps(-0.0f);
+			const __m256 overflow = _mm256_set1_ps(static_cast<float>(RealLimits<Half>::overflow));
+			const __m256 infinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+			const __m256 maximum = _mm256_set1_ps(static_cast<float>(RealLimits<Half>::maximum));
+			const bool checkRange = method.base != Base::Cast || method.clip;
+
+			__m256 failed = _mm256_setzero_ps();
+
+			mint index = 0;
+
+			for(; index + 8 <= length; index += 8)
+			{
+				__m256 value = _mm256_loadu_ps(source + index);
+
+				if(checkRange)
+				{
+					const __m256 magnitude = _mm256_andnot_ps(signMask, value);
+					const __m256 outOfRange = _mm256_and_ps(_mm256_cmp_ps(magnitude, overflow, _CMP_GE_OQ),
+															_mm256_cmp_ps(magnitude, infinity, _CMP_NEQ_OQ));
+
+					if(method.clip)
+					{
+						const __m256 clamped = _mm256_or_ps(maximum, _mm256_and_ps(signMask, value));
+						value = _mm256_blendv_ps(value, clamped, outOfRange);
+					}
+					else
+					{
+						failed = _mm256_or_ps(failed, outOfRange);
+					}
+				}
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index),
+								 _mm256_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+			}
+
+			const bool ok = _mm256_movemask_ps(failed) == 0;
+
+			return ConvertLoop(source + index, destination + index, length - index, method) && ok;
+		}
+
+		WLR_TARGET_AVX512 inline bool Real32ToReal16Avx512(const float* source, Half* destination, mint length,
+														   const Method& method) noexcept
+		{
+			const __m512 overflow = _mm512_set1_ps(static_cast<float>(RealLimits<Half>::overflow));
+			const __m512 infinity = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+			const __m512 maximum = _mm512_set1_ps(static_cast<float>(RealLimits<Half>::maximum));
+			const __m512i signMask = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+			const bool checkRange = method.base != Base::Cast || method.clip;
+
+			__mmask16 failed = 0;
+
+			mint index = 0;
+
+			for(; index + 16 <= length; index += 16)
+			{
+				__m512 value = _mm512_loadu_ps(source + index);
+
+				if(checkRange)
+				{
+					const __m512 magnitude = _mm512_abs_ps(value);
+					const __mmask16 outOfRange = _mm512_cmp_ps_mask(magnitude, overflow, _CMP_GE_OQ) &
+												 _mm512_cmp_ps_mask(magnitude, infinity, _CMP_NEQ_OQ);
+
+					if(method.clip)
+					{
+						const __m512 clamped = _mm512_castsi512_ps(_mm512_or_si512(
+							_mm512_castps_si512(maximum), _mm512_and_si512(_mm512_castps_si512(value), signMask)));
+						value = _mm512_mask_blend_ps(outOfRange, value, clamped);
+					}
+					else
+					{
+						failed = static_cast<__mmask16>(failed | outOfRange);
+					}
+				}
+
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + index),
+									_mm512_maskz_cvtps_ph(0xFFFF, value, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+			}
+
+			return ConvertLoop(source + index, destination + index, length - index, method) && failed == 0;
+		}
+
+		// Every UBit8 value fits every real type, so only Scale changes the result; it is computed in double like the
+		// scalar code so that the results are bit-identical
+		WLR_TARGET_AVX2 inline bool UBit8ToReal32Avx2(const std::uint8_t* source, float* destination, mint length,
+													  const Method& method) noexcept
+		{
+			const bool scale = method.base == Base::Scale;
+			const __m256d divisor = _mm256_set1_pd(255.0);
+
+			mint index = 0;
+
+			for(; index + 8 <= length; index += 8)
+			{
+				std::uint64_t bytes;
+				std::memcpy(&bytes, source + index, sizeof(bytes));
+
+				const __m256i widened = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(static_cast<long long>(bytes)));
+
+				if(scale)
+				{
+					const __m256d low = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(widened)), divisor);
+					const __m256d high = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(widened, 1)), divisor);
+
+					_mm_storeu_ps(destination + index, _mm256_cvtpd_ps(low));
+					_mm_storeu_ps(destination + index + 4, _mm256_cvtpd_ps(high));
+				}
+				else
+				{
+					_mm256_storeu_ps(destination + index, _mm256_cvtepi32_ps(widened));
+				}
+			}
+
+			return ConvertLoop(source + index, destination + index, length - index, method);
+		}
+
+		WLR_TARGET_AVX512 inline bool UBit8ToReal32Avx512(const std::uint8_t* source, float* destination, mint length,
+														  const Method& method) noexcept
+		{
+			const bool scale = method.base == Base::Scale;
+			const __m512d divisor = _mm512_set1_pd(255.0);
+
+			mint index = 0;
+
+			for(; index + 16 <= length; index += 16)
+			{
+				const __m512i widened =
+					_mm512_maskz_cvtepu8_epi32(0xFFFF, _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index)));
+
+				if(scale)
+				{
+					const __m256i lowHalf = _mm512_maskz_extracti64x4_epi64(0xF, widened, 0);
+					const __m256i highHalf = _mm512_maskz_extracti64x4_epi64(0xF, widened, 1);
+
+					const __m512d low = _mm512_div_pd(_mm512_maskz_cvtepi32_pd(0xFF, lowHalf), divisor);
+					const __m512d high = _mm512_div_pd(_mm512_maskz_cvtepi32_pd(0xFF, highHalf), divisor);
+
+					_mm256_storeu_ps(destination + index, _mm512_maskz_cvtpd_ps(0xFF, low));
+					_mm256_storeu_ps(destination + index + 8, _mm512_maskz_cvtpd_ps(0xFF, high));
+				}
+				else
+				{
+					_mm512_storeu_ps(destination + index, _mm512_maskz_cvtepi32_ps(0xFFFF, widened));
+				}
+			}
+
+			return ConvertLoop(source + index, destination + index, length - index, method);
+		}
+#endif
+
+#if defined(WLR_SIMD_NEON)
+		inline uint64x2_t NotMask(uint64x2_t value) noexcept
+		{
+			return vreinterpretq_u64_u8(vmvnq_u8(vreinterpretq_u8_u64(value)));
+		}
+
+		inline bool Real64ToReal32Neon(const double* source, float* destination, mint length, const Method& method) noexcept
+		{
+			const float64x2_t overflow = vdupq_n_f64(RealLimits<float>::overflow);
+			const float64x2_t infinity = vdupq_n_f64(std::numeric_limits<double>::infinity());
+			const float64x2_t maximum = vdupq_n_f64(RealLimits<float>::maximum);
+			const bool checkRange = method.base != Base::Cast || method.clip;
+
+			uint64x2_t failed = vdupq_n_u64(0);
+
+			mint index = 0;
+
+			for(; index + 4 <= length; index += 4)
+			{
+				float64x2_t low = vld1q_f64(source + index);
+				float64x2_t high = vld1q_f64(source + index + 2);
+
+				if(checkRange)
+				{
+					const uint64x2_t lowOut =
+						vandq_u64(vcgeq_f64(vabsq_f64(low), overflow), NotMask(vceqq_f64(vabsq_f64(low), infinity)));
+					const uint64x2_t highOut =
+						vandq_u64(vcgeq_f64(vabsq_f64(high), overflow), NotMask(vceqq_f64(vabsq_f64(high), infinity)));
+
+					if(method.clip)
+					{
+						low = vbslq_f64(lowOut, vbslq_f64(vdupq_n_u64(0x8000000000000000ull), low, maximum), low);
+						high = vbslq_f64(highOut, vbslq_f64(vdupq_n_u64(0x8000000000000000ull), high, maximum), high);
+					}
+					else
+					{
+						failed = vorrq_u64(failed, vorrq_u64(lowOut, highOut));
+					}
+				}
+
+				vst1q_f32(destination + index, vcvt_high_f32_f64(vcvt_f32_f64(low), high));
+			}
+
+			const bool ok = (vgetq_lane_u64(failed, 0) | vgetq_lane_u64(failed, 1)) == 0;
+
+			return ConvertLoop(source + index, destination + index, length - index, method) && ok;
+		}
+
+		inline bool Real32ToReal16Neon(const float* source, Half* destination, mint length, const Method& method) noexcept
+		{
+			const float32x4_t overflow = vdupq_n_f32(static_cast<float>(RealLimits<Half>::overflow));
+			const float32x4_t infinity = vdupq_n_f32(std::numeric_limits<float>::infinity());
+			const float32x4_t maximum = vdupq_n_f32(static_cast<float>(RealLimits<Half>::maximum));
+			const bool checkRange = method.base != Base::Cast || method.clip;
+
+			uint32x4_t failed = vdupq_n_u32(0);
+
+			mint index = 0;
+
+			for(; index + 4 <= length; index += 4)
+			{
+				float32x4_t value = vld1q_f32(source + index);
+
+				if(checkRange)
+				{
+					const uint32x4_t outOfRange =
+						vandq_u32(vcgeq_f32(vabsq_f32(value), overflow), vmvnq_u32(vceqq_f32(vabsq_f32(value), infinity)));
+
+					if(method.clip)
+					{
+						value = vbslq_f32(outOfRange, vbslq_f32(vdupq_n_u32(0x80000000u), value, maximum), value);
+					}
+					else
+					{
+						failed = vorrq_u32(failed, outOfRange);
+					}
+				}
+
+				vst1_u16(reinterpret_cast<std::uint16_t*>(destination + index),
+						 vreinterpret_u16_f16(vcvt_f16_f32(value)));
+			}
+
+			const bool ok = vmaxvq_u32(failed) == 0;
+
+			return ConvertLoop(source + index, destination + index, length - index, method) && ok;
+		}
+#endif
+
+		template <typename S, typename D>
+		bool ConvertTyped(const S* source, D* destination, mint length, const Method& method, SimdLevel level) noexcept
+		{
+			if constexpr(std::is_same<S, D>::value)
+			{
+				// Every method is the identity on values of the same type
+				std::memcpy(destination, source, static_cast<std::size_t>(length) * sizeof(S));
+
+				(void) method;
+				(void) level;
+
+				return true;
+			}
+			else
+			{
+#if defined(WLR_SIMD_X86)
+				if constexpr(std::is_same<S, double>::value && std::is_same<D, float>::value)
+				{
+					if(level == SimdLevel::AVX512)
+					{
+						return Real64ToReal32Avx512(source, destination, length, method);
+					}
+
+					if(level == SimdLevel::AVX2)
+					{
+						return Real64ToReal32Avx2(source, destination, length, method);
+					}
+				}
+
+				if constexpr(std::is_same<S, float>::value && std::is_same<D, Half>::value)
+				{
+					if(level == SimdLevel::AVX512)
+					{
+						return Real32ToReal16Avx512(source, destination, length, method);
+					}
+
+					if(level == SimdLevel::AVX2)
+					{
+						return Real32ToReal16Avx2(source, destination, length, method);
+					}
+				}
+
+				if constexpr(std::is_same<S, std::uint8_t>::value && std::is_same<D, float>::value)
+				{
+					if(level == SimdLevel::AVX512)
+					{
+						return UBit8ToReal32Avx512(source, destination, length, method);
+					}
+
+					if(level == SimdLevel::AVX2)
+					{
+						return UBit8ToReal32Avx2(source, destination, length, method);
+					}
+				}
+
+				switch(level)
+				{
+					case SimdLevel::AVX512:
+						return ConvertAvx512(source, destination, length, method);
+					case SimdLevel::AVX2:
+						return ConvertAvx2(source, destination, length, method);
+					default:
+						return ConvertScalar(source, destination, length, method);
+				}
+#elif defined(WLR_SIMD_NEON)
+				if constexpr(std::is_same<S, double>::value && std::is_same<D, float>::value)
+				{
+					return Real64ToReal32Neon(source, destination, length, method);
+				}
+
+				if constexpr(std::is_same<S, float>::value && std::is_same<D, Half>::value)
+				{
+					return Real32ToReal16Neon(source, destination, length, method);
+				}
+
+				// NEON is baseline on AArch64, so the generic loop is already vectorized for it
+				(void) level;
+
+				return ConvertScalar(source, destination, length, method);
+#else
+				(void) level;
+
+				return ConvertScalar(source, destination, length, method);
+#endif
+			}
+		}
+
+		/**
+			Call visitor with a null pointer of the host element type for type
+		*/
+		template <typename Visitor>
+		bool VisitElementType(numericarray_data_t type, Visitor&& visitor)
+		{
+			switch(type)
+			{
+				case MNumericArray_Type_Bit8:
+					return visitor(static_cast<std::int8_t*>(nullptr));
+				case MNumericArray_Type_UBit8:
+					return visitor(static_cast<std::uint8_t*>(nullptr));
+				case MNumericArray_Type_Bit16:
+					return visitor(static_cast<std::int16_t*>(nullptr));
+				case MNumericArray_Type_UBit16:
+					return visitor(static_cast<std::uint16_t*>(nullptr));
+				case MNumericArray_Type_Bit32:
+					return visitor(static_cast<std::int32_t*>(nullptr));
+				case MNumericArray_Type_UBit32:
+					return visitor(static_cast<std::uint32_t*>(nullptr));
+				case MNumericArray_Type_Bit64:
+					return visitor(static_cast<std::int64_t*>(nullptr));
+				case MNumericArray_Type_UBit64:
+					return visitor(static_cast<std::uint64_t*>(nullptr));
+				case MNumericArray_Type_Real32:
+					return visitor(static_cast<float*>(nullptr));
+				case MNumericArray_Type_Real64:
+					return visitor(static_cast<double*>(nullptr));
+				case MNumericArray_Type_Complex_Real32:
+					return visitor(static_cast<std::complex<float>*>(nullptr));
+				case MNumericArray_Type_Complex_Real64:
+					return visitor(static_cast<std::complex<double>*>(nullptr));
+				case MNumericArray_Type_Real16:
+					return visitor(static_cast<Half*>(nullptr));
+				case MNumericArray_Type_Complex_Real16:
+					return visitor(static_cast<ComplexHalf*>(nullptr));
+				default:
+					return false;
+			}
+		}
+
+		inline bool DecodeMethod(numericarray_convert_method_t method, mreal tolerance, Method& result) noexcept
+		{
+			static constexpr Base bases[] = {Base::Check, Base::Coerce, Base::Round, Base::Scale, Base::Cast};
+
+			const int offset = static_cast<int>(method) - static_cast<int>(MNumericArray_Convert_Check);
+
+			if(offset < 0 || offset > 9)
+			{
+				return false;
+			}
+
+			result = Method {bases[offset / 2], offset % 2 == 1, tolerance < 0 ? 0.0 : static_cast<double>(tolerance)};
+
+			return true;
+		}
+	}
+
+	/**
+		Convert length elements of sourceType at source into destinationType at destination
+		@remarks Returns LIBRARY_NO_ERROR on success, LIBRARY_TYPE_ERROR for an unknown type or method, and
+	   LIBRARY_NUMERICAL_ERROR if a value cannot be converted with the given method. On LIBRARY_NUMERICAL_ERROR the
+	   destination holds the clipped values.
+		@remarks source and destination must not overlap.
+	*/
+	inline errcode_t ConvertElements(const void* source, numericarray_data_t sourceType, void* destination,
+									 numericarray_data_t destinationType, mint length,
+									 numericarray_convert_method_t method, mreal tolerance,
+									 const ConvertOptions& options = ConvertOptions())
+	{
+		convert::Method decodedMethod;
+
+		if(!convert::DecodeMethod(method, tolerance, decodedMethod) ||
+		   NumericArrayElementSize(sourceType) == 0 || NumericArrayElementSize(destinationType) == 0)
+		{
+			return LIBRARY_TYPE_ERROR;
+		}
+
+		auto convertRange = [&](mint begin, mint end) -> bool
+		{
+			return convert::VisitElementType(
+				sourceType,
+				[&](auto* sourceTag)
+				{
+					using S = std::remove_pointer_t<decltype(sourceTag)>;
+
+					return convert::VisitElementType(
+						destinationType,
+						[&](auto* destinationTag)
+						{
+							using D = std::remove_pointer_t<decltype(destinationTag)>;
+
+							return convert::ConvertTyped(static_cast<const S*>(source) + begin,
+														 static_cast<D*>(destination) + begin, end - begin,
+														 decodedMethod, ActiveSimdLevel());
+						});
+				});
+		};
+
+		unsigned threadCount = options.threadCount == 0 ? std::thread::hardware_concurrency() : options.threadCount;
+
+		if(options.minimumElementsPerThread > 0)
+		{
+			threadCount = static_cast<unsigned>(std::min<mint>(threadCount, length / options.minimumElementsPerThread));
+		}
+
+		if(threadCount <= 1)
+		{
+			return convertRange(0, length) ? LIBRARY_NO_ERROR : LIBRARY_NUMERICAL_ERROR;
+		}
+
+		// Split into equal chunks, rounded to 64 elements to keep every thread on its own cache lines
+		const mint chunk = ((length / threadCount + 63) / 64) * 64;
+
+		std::vector<char> results(threadCount, 1);
+		std::vector<std::thread> threads;
+
+		threads.reserve(threadCount - 1);
+
+		for(unsigned thread = 1; thread < threadCount; ++thread)
+		{
+			const mint begin = std::min<mint>(length, chunk * thread);
+			const mint end = thread + 1 == threadCount ? length : std::min<mint>(length, begin + chunk);
+
+			threads.emplace_back([&, thread, begin, end] { results[thread] = convertRange(begin, end); });
+		}
+
+		results[0] = convertRange(0, std::min<mint>(length, chunk));
+
+		for(std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		for(char result : results)
+		{
+			if(!result)
+			{
+				return LIBRARY_NUMERICAL_ERROR;
+			}
+		}
+
+		return LIBRARY_NO_ERROR;
+	}
+
+	/**
+		Host-side counterpart of wlr_MNumericArray_convertType: allocate result with resultType and the dimensions of
+		source, and convert every element into it
+	*/
+	inline errcode_t ConvertType(NumericArray& result, const MNumericArray source, numericarray_data_t resultType,
+								 numericarray_convert_method_t method, mreal tolerance,
+								 const ConvertOptions& options = ConvertOptions())
+	{
+		errcode_t error = NumericArray::Create(resultType, wlr_MNumericArray_getRank(source),
+											   wlr_MNumericArray_getDimensions(source), result);
+
+		if(error != LIBRARY_NO_ERROR)
+		{
+			return error;
+		}
+
+		error = ConvertElements(wlr_MNumericArray_getData(source), wlr_MNumericArray_getType(source),
+								wlr_MNumericArray_getData(result.Get()), resultType,
+								wlr_MNumericArray_getFlattenedLength(source), method, tolerance, options);
+
+		if(error != LIBRARY_NO_ERROR)
+		{
+			result.Reset();
+		}
+
+		return error;
+	}
+}
@@ -0,0 +1,495 @@
+/*
+	Asynchronous capture of kernel output and messages
+
+	Handlers registered with wlr_AddStdoutHandler and wlr_AddMessageHandler run synchronously on the kernel thread, so a
+	handler that locks or writes to a file stalls every Print and every message. wlr::OutputCapture registers handlers
+	that only copy each stdout chunk, or the text of each message, into a preallocated ring and return. A consumer
+	thread drains the ring and passes each record to a sink, where the slow work (formatting, locking, file I/O) happens
+	off the kernel thread.
+
+	The ring has one producer (the kernel thread) and one consumer (the drain thread). It never blocks the producer:
+	when a record does not fit, the oldest unread records are dropped and counted. The producer makes no system calls;
+	the consumer polls at a configurable interval, and Flush wakes it early.
+
+	Each record carries the request id set with wlr::OutputCapture::RequestScope on the kernel thread, so output can be
+	attributed to the request whose evaluation produced it.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Expr.h"
+#include "Strings.h"
+#include "Symbols.h"
+
+namespace wlr
+{
+	enum class CaptureKind : std::uint8_t
+	{
+		Stdout,
+		Message
+	};
+
+	/**
+		One captured stdout chunk or message, as passed to the sink
+		@remarks For stdout, text is the chunk and symbol and tag are empty. For messages, symbol and tag are the parts
+	   of the MessageName[symbol, "tag"] the message handler receives first, and text is the message text it receives
+	   last; strings are copied as they are, symbols by name, and any other expression is recorded as empty. The views
+	   are valid only during the sink call.
+	*/
+	struct CapturedOutput
+	{
+		CaptureKind kind;
+		std::uint64_t request;
+		std::string_view symbol;
+		std::string_view tag;
+		std::string_view text;
+	};
+
+	/**
+		Settings of an OutputCapture
+		@remarks capacityBytes is rounded up to a power of two of at least 256. A single record larger than a quarter of
+	   the ring is truncated to that size.
+	*/
+	struct OutputCaptureOptions
+	{
+		std::size_t capacityBytes = std::size_t(1) << 20;
+		std::chrono::microseconds drainInterval {1000};
+	};
+
+	/**
+		Counters published by an OutputCapture
+		@remarks captured counts records written by the kernel thread, delivered those passed to the sink, dropped
+	   those overwritten before the consumer read them, and truncated those cut to fit the ring.
+	*/
+	struct OutputCaptureStatistics
+	{
+		std::uint64_t captured;
+		std::uint64_t delivered;
+		std::uint64_t dropped;
+		std::uint64_t truncated;
+	};
+
+	/**
+		Stdout and message handlers that copy into a ring, drained to a sink on a background thread
+		@remarks The runtime identifies handlers by function pointer, so only one OutputCapture may be attached at a time.
+		@remarks Attach, Detach, RequestScope and the destructor must be used on the kernel thread. Flush and Statistics
+	   may be called from any thread. The sink runs on the drain thread only.
+	*/
+	class OutputCapture
+	{
+	public:
+		using Sink = std::function<void(const CapturedOutput&)>;
+
+		/**
+			Request id of the output produced while the scope is alive, restoring the previous id afterwards
+		*/
+		class RequestScope
+		{
+		public:
+			RequestScope(OutputCapture& capture, std::uint64_t request) noexcept
+				: capture(capture), previous(capture.currentRequest)
+			{
+				capture.currentRequest = request;
+			}
+
+			RequestScope(const RequestScope&) = delete;
+			RequestScope& operator=(const RequestScope&) = delete;
+
+			~RequestScope()
+			{
+				capture.currentRequest = previous;
+			}
+
+		private:
+			OutputCapture& capture;
+			std::uint64_t previous;
+		};
+
+		explicit OutputCapture(Sink sink, OutputCaptureOptions options = OutputCaptureOptions())
+			: sink(std::move(sink)), drainInterval(options.drainInterval)
+		{
+			std::size_t words = HeaderWords * 8;
+
+			while(words * sizeof(std::uint64_t) < options.capacityBytes)
+			{
+				words *= 2;
+			}
+
+			ring.reset(new std::atomic<std::uint64_t>[words]);
+			mask = words - 1;
+			maximumPayloadBytes = (words / 4 - HeaderWords) * sizeof(std::uint64_t);
+
+			drainThread = std::thread([this] { Drain(); });
+		}
+
+		OutputCapture(const OutputCapture&) = delete;
+		OutputCapture& operator=(const OutputCapture&) = delete;
+
+		/**
+			Detach the handlers, deliver everything captured so far, and stop the drain thread
+		*/
+		~OutputCapture()
+		{
+			Detach();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+
+			wake.notify_one();
+
+			drainThread.join();
+		}
+
+		/**
+			Register the stdout and message handlers with the runtime
+		*/
+		wlr_err_t Attach()
+		{
+			if(attached)
+			{
+				return WLR_SUCCESS;
+			}
+
+			wlr_err_t error = wlr_AddStdoutHandler(&OutputCapture::StdoutHandler, this);
+
+			if(error != WLR_SUCCESS)
+			{
+				return error;
+			}
+
+			error = wlr_AddMessageHandler(&OutputCapture::MessageHandler, this);
+
+			if(error != WLR_SUCCESS)
+			{
+				wlr_RemoveStdoutHandler(&OutputCapture::StdoutHandler);
+				return error;
+			}
+
+			attached = true;
+
+			return WLR_SUCCESS;
+		}
+
+		void Detach()
+		{
+			if(attached)
+			{
+				wlr_RemoveStdoutHandler(&OutputCapture::StdoutHandler);
+				wlr_RemoveMessageHandler(&OutputCapture::MessageHandler);
+
+				attached = false;
+			}
+		}
+
+		/**
+			Wait until every record captured before the call has been delivered to the sink or dropped
+		*/
+		void Flush()
+		{
+			const std::uint64_t target = write.load(std::memory_order_acquire);
+
+			std::unique_lock<std::mutex> lock(mutex);
+
+			flushRequested = true;
+			wake.notify_one();
+
+			flushed.wait(lock, [this, target] { return drained >= target || stopping; });
+		}
+
+		OutputCaptureStatistics Statistics() const noexcept
+		{
+			return OutputCaptureStatistics {
+				captured.load(std::memory_order_relaxed), delivered.load(std::memory_order_relaxed),
+				dropped.load(std::memory_order_relaxed), truncated.load(std::memory_order_relaxed)};
+		}
+
+	private:
+		// Record layout in words: size and kind, request id, symbol and tag lengths, text length, then the payload bytes
+		static constexpr std::size_t HeaderWords = 4;
+
+		static void StdoutHandler(char* data, mint length, void* context)
+		{
+			static_cast<OutputCapture*>(context)->Write(CaptureKind::Stdout, std::string_view(), std::string_view(),
+														  std::string_view(data, static_cast<std::size_t>(length)));
+		}
+
+		static void MessageHandler(wlr_expr messageName, wlr_expr heldMessage, wlr_expr messageText, void* context)
+		{
+			(void) heldMessage;
+
+			const bool named = wlr_ExpressionType(messageName) == WLR_NORMAL && wlr_Length(messageName) == 2 &&
+							   wlr_SameQ(wlr_Head(messageName), Symbol(SystemSymbol::MessageName));
+
+			const StringData symbolText = named ? TextOf(wlr_Part(messageName, 1)) : StringData();
+			const StringData tagText = named ? TextOf(wlr_Part(messageName, 2)) : StringData();
+			const StringData text = TextOf(messageText);
+
+			static_cast<OutputCapture*>(context)->Write(CaptureKind::Message, symbolText.View(), tagText.View(),
+														  text.View());
+		}
+
+		/**
+			Contents of a string, name of a symbol, or nothing for any other expression
+		*/
+		static StringData TextOf(wlr_expr expression)
+		{
+			switch(wlr_ExpressionType(expression))
+			{
+				case WLR_STRING:
+					return StringData(expression);
+				case WLR_SYMBOL:
+					return StringData(wlr_SymbolName(expression));
+				default:
+					return StringData();
+			}
+		}
+
+		static std::size_t WordsFor(std::size_t bytes) noexcept
+		{
+			return (bytes + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+		}
+
+		/**
+			Append one record, dropping the oldest unread records until it fits; kernel thread only
+		*/
+		void Write(CaptureKind kind, std::string_view symbol, std::string_view tag, std::string_view text) noexcept
+		{
+			symbol = symbol.substr(0, maximumPayloadBytes);
+			tag = tag.substr(0, maximumPayloadBytes - symbol.size());
+
+			if(symbol.size() + tag.size() + text.size() > maximumPayloadBytes)
+			{
+				text = text.substr(0, maximumPayloadBytes - symbol.size() - tag.size());
+
+				truncated.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			const std::size_t words = HeaderWords + WordsFor(symbol.size() + tag.size() + text.size());
+			const std::uint64_t position = write.load(std::memory_order_relaxed);
+
+			MakeRoom(position, words);
+
+			std::uint64_t cursor = position;
+
+			Store(cursor++, static_cast<std::uint64_t>(words) | (static_cast<std::uint64_t>(kind) << 32));
+			Store(cursor++, currentRequest);
+			Store(cursor++, static_cast<std::uint64_t>(symbol.size()) | (static_cast<std::uint64_t>(tag.size()) << 32));
+			Store(cursor++, static_cast<std::uint64_t>(text.size()));
+
+			PayloadWriter payload {this, cursor};
+
+			payload.Append(symbol);
+			payload.Append(tag);
+			payload.Append(text);
+			payload.Finish();
+
+			write.store(position + words, std::memory_order_release);
+
+			captured.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void MakeRoom(std::uint64_t position, std::size_t words) noexcept
+		{
+			std::uint64_t oldest = read.load(std::memory_order_acquire);
+
+			while(position + words - oldest > mask + 1)
+			{
+				// The producer wrote the header at oldest, so reading it here is not a race
+				const std::uint64_t oldestWords = ring[oldest & mask].load(std::memory_order_relaxed) & 0xFFFFFFFFu;
+
+				if(read.compare_exchange_weak(oldest, oldest + oldestWords, std::memory_order_acq_rel,
+											  std::memory_order_acquire))
+				{
+					oldest += oldestWords;
+
+					dropped.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		void Store(std::uint64_t position, std::uint64_t word) noexcept
+		{
+			ring[position & mask].store(word, std::memory_order_relaxed);
+		}
+
+		/**
+			Packs bytes from several fields into consecutive ring words
+		*/
+		struct PayloadWriter
+		{
+			OutputCapture* capture;
+			std::uint64_t cursor;
+			std::uint64_t pending = 0;
+			std::size_t filled = 0;
+
+			void Append(std::string_view bytes) noexcept
+			{
+				const char* data = bytes.data();
+				std::size_t remaining = bytes.size();
+
+				while(remaining > 0 && filled != 0)
+				{
+					pending |= static_cast<std::uint64_t>(static_cast<unsigned char>(*data++)) << (8 * filled);
+					--remaining;
+
+					if(++filled == sizeof(std::uint64_t))
+					{
+						capture->Store(cursor++, pending);
+						pending = 0;
+						filled = 0;
+					}
+				}
+
+				for(; remaining >= sizeof(std::uint64_t); remaining -= sizeof(std::uint64_t))
+				{
+					std::uint64_t word;
+					std::memcpy(&word, data, sizeof(word));
+
+					capture->Store(cursor++, word);
+					data += sizeof(word);
+				}
+
+				for(; remaining > 0; --remaining)
+				{
+					pending |= static_cast<std::uint64_t>(static_cast<unsigned char>(*data++)) << (8 * filled++);
+				}
+			}
+
+			void Finish() noexcept
+			{
+				if(filled != 0)
+				{
+					capture->Store(cursor, pending);
+				}
+			}
+		};
+
+		/**
+			Copy out and deliver every complete record; drain thread only
+			@remarks A record is copied before it is claimed. If the kernel thread dropped it in the meantime, the claim
+		   fails and the possibly overwritten copy is discarded.
+		*/
+		void DeliverAvailable()
+		{
+			for(;;)
+			{
+				const std::uint64_t end = write.load(std::memory_order_acquire);
+				std::uint64_t position = read.load(std::memory_order_acquire);
+
+				if(position >= end)
+				{
+					return;
+				}
+
+				const std::uint64_t header = ring[position & mask].load(std::memory_order_relaxed);
+				const std::size_t words = static_cast<std::size_t>(header & 0xFFFFFFFFu);
+
+				if(words < HeaderWords || words > end - position)
+				{
+					// Overwritten while it was read; the read position has moved on
+					continue;
+				}
+
+				record.resize(words);
+
+				for(std::size_t word = 0; word < words; ++word)
+				{
+					record[word] = ring[(position + word) & mask].load(std::memory_order_relaxed);
+				}
+
+				if(!read.compare_exchange_strong(position, position + words, std::memory_order_acq_rel,
+												 std::memory_order_acquire))
+				{
+					continue;
+				}
+
+				const std::size_t symbolSize = static_cast<std::size_t>(record[2] & 0xFFFFFFFFu);
+				const std::size_t tagSize = static_cast<std::size_t>(record[2] >> 32);
+				const std::size_t textSize = static_cast<std::size_t>(record[3]);
+
+				const char* payload = reinterpret_cast<const char*>(record.data() + HeaderWords);
+
+				sink(CapturedOutput {static_cast<CaptureKind>((header >> 32) & 0xFF), record[1],
+									 std::string_view(payload, symbolSize), std::string_view(payload + symbolSize, tagSize),
+									 std::string_view(payload + symbolSize + tagSize, textSize)});
+
+				delivered.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		void Drain()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			for(;;)
+			{
+				wake.wait_for(lock, drainInterval, [this] { return stopping || flushRequested; });
+
+				const bool stop = stopping;
+				flushRequested = false;
+
+				lock.unlock();
+
+				DeliverAvailable();
+
+				lock.lock();
+
+				// The read position moves before the sink runs, so Flush waits for this one instead
+				drained = read.load(std::memory_order_acquire);
+				flushed.notify_all();
+
+				if(stop)
+				{
+					return;
+				}
+			}
+		}
+
+		Sink sink;
+		std::chrono::microseconds drainInterval;
+
+		std::unique_ptr<std::atomic<std::uint64_t>[]> ring;
+		std::uint64_t mask;
+		std::size_t maximumPayloadBytes;
+
+		// Positions in words since the start, never wrapped; read is advanced by both threads
+		alignas(64) std::atomic<std::uint64_t> write {0};
+		alignas(64) std::atomic<std::uint64_t> read {0};
+
+		// Kernel thread only
+		std::uint64_t currentRequest = 0;
+		bool attached = false;
+
+		// Drain thread only
+		std::vector<std::uint64_t> record;
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable flushed;
+		bool stopping = false;
+		bool flushRequested = false;
+		std::uint64_t drained = 0;
+
+		std::atomic<std::uint64_t> captured {0};
+		std::atomic<std::uint64_t> delivered {0};
+		std::atomic<std::uint64_t> dropped {0};
+		std::atomic<std::uint64_t> truncated {0};
+
+		std::thread drainThread;
+	};
+}
@@ -0,0 +1,155 @@
+/*
+	LRU cache of parse trees keyed by input text
+
+	Repeated inputs otherwise pay for wlr_String and wlr_ParseExpression on every call. A wlr::ParseCache keeps a
+	detached clone of each parse tree, keyed by a hash of the UTF-8 input, and hands out pooled clones of it on a hit so
+	that the parser is not called at all.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "Expr.h"
+#include "ExpressionBuilder.h"
+#include "Hash.h"
+
+namespace wlr
+{
+	/**
+		Budget of a ParseCache
+		@remarks Entries are evicted, least recently used first, as soon as either limit is exceeded. The size of a parse
+	   tree is not observable through the expression API, so an entry is charged the length of its input text plus
+	   entryOverheadBytes.
+	*/
+	struct ParseCacheOptions
+	{
+		std::size_t maximumEntries = 1024;
+		std::size_t maximumBytes = std::size_t(16) << 20;
+		std::size_t entryOverheadBytes = 256;
+	};
+
+	struct ParseCacheStatistics
+	{
+		std::uint64_t hits;
+		std::uint64_t misses;
+		std::uint64_t evictions;
+		std::size_t entries;
+		std::size_t bytes;
+	};
+
+	/**
+		LRU cache from input text to detached parse tree
+		@remarks Not thread-safe. Like every other expression API call, use it from the thread that owns the runtime
+	   (for example inside work submitted to a wlr::KernelExecutor).
+		@remarks Inputs that fail to parse are not cached.
+	*/
+	class ParseCache
+	{
+	public:
+		explicit ParseCache(ParseCacheOptions options = ParseCacheOptions()) : options(options)
+		{
+		}
+
+		ParseCache(const ParseCache&) = delete;
+		ParseCache& operator=(const ParseCache&) = delete;
+
+		/**
+			Return the parse tree of input as an expression in the current expression pool
+			@remarks On a hit the cached tree is cloned with wlr_Clone; wlr_ParseExpression is only called on a miss.
+		*/
+		wlr_expr Parse(std::string_view input)
+		{
+			auto found = index.find(input);
+
+			if(found != index.end())
+			{
+				++hits;
+
+				entries.splice(entries.begin(), entries, found->second);
+
+				return found->second->parsed.CloneToPool();
+			}
+
+			++misses;
+
+			wlr_expr parsed = wlr_ParseExpression(ToExpression(input));
+
+			if(!wlr_ErrorQ(parsed))
+			{
+				Insert(input, parsed);
+			}
+
+			return parsed;
+		}
+
+		void Clear() noexcept
+		{
+			index.clear();
+			entries.clear();
+
+			bytes = 0;
+		}
+
+		ParseCacheStatistics Statistics() const noexcept
+		{
+			return ParseCacheStatistics {hits, misses, evictions, entries.size(), bytes};
+		}
+
+	private:
+		struct Entry
+		{
+			std::string input;
+			Expr parsed;
+		};
+
+		void Insert(std::string_view input, wlr_expr parsed)
+		{
+			const std::size_t entryBytes = input.size() + options.entryOverheadBytes;
+
+			if(options.maximumEntries == 0 || entryBytes > options.maximumBytes)
+			{
+				return;
+			}
+
+			entries.push_front(Entry {std::string(input), Expr::Detach(wlr_Clone(parsed))});
+
+			// The key views the string owned by the list node, which never moves
+			index.emplace(entries.front().input, entries.begin());
+
+			bytes += entryBytes;
+
+			while(entries.size() > options.maximumEntries || bytes > options.maximumBytes)
+			{
+				Evict();
+			}
+		}
+
+		void Evict() noexcept
+		{
+			Entry& leastRecent = entries.back();
+
+			bytes -= leastRecent.input.size() + options.entryOverheadBytes;
+
+			index.erase(leastRecent.input);
+			entries.pop_back();
+
+			++evictions;
+		}
+
+		ParseCacheOptions options;
+
+		std::list<Entry> entries;
+		std::unordered_map<std::string_view, std::list<Entry>::iterator, TextHash> index;
+
+		std::size_t bytes = 0;
+		std::uint64_t hits = 0;
+		std::uint64_t misses = 0;
+		std::uint64_t evictions = 0;
+	};
+}
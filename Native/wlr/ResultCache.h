@@ -0,0 +1,491 @@
+/*
+	Opt-in memoization of evaluation results
+
+	A wlr::ResultCache maps inputs to detached copies of their evaluated results. Inputs can be given two ways:
+
+		expression   - keyed by wlr::StructuralHash, which walks the expression with wlr_Head, wlr_Length and wlr_Part;
+					   a hit is only taken after wlr_SameQ confirms that the cached input is the same expression
+		input text   - keyed by a hash of the UTF-8 text, as in wlr::ParseCache; a hit is confirmed by comparing the text
+
+	Only pure requests should go through the cache. Pass CachePolicy::Bypass for anything that reads or changes state
+	(Set, RandomReal, Import, ...), and it is evaluated normally without touching the cache. Results that are errors or
+	$Aborted are never cached.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Expr.h"
+#include "ExpressionBuilder.h"
+#include "Hash.h"
+#include "NumericArray.h"
+#include "RuntimeBuffer.h"
+#include "Strings.h"
+#include "Symbols.h"
+
+namespace wlr
+{
+	namespace detail
+	{
+		inline std::uint64_t HashStringExpression(wlr_expr stringExpression, std::uint64_t seed) noexcept
+		{
+			return HashBytes(StringData(stringExpression).View(), seed);
+		}
+
+		template <typename T>
+		std::uint64_t HashElements(const T* data, std::size_t count, std::uint64_t seed) noexcept
+		{
+			return HashBytes(std::string_view(reinterpret_cast<const char*>(data), count * sizeof(T)), seed);
+		}
+
+		inline std::uint64_t SymbolHash(wlr_expr symbol)
+		{
+			return HashStringExpression(wlr_SymbolName(symbol), HashCombine(0, WLR_SYMBOL));
+		}
+
+		inline std::uint64_t IntegerHash(mint value) noexcept
+		{
+			return HashCombine(HashCombine(0, WLR_NUMBER), static_cast<std::uint64_t>(value));
+		}
+
+		inline std::uint64_t RealHash(mreal value) noexcept
+		{
+			std::uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+
+			return HashCombine(HashCombine(0, WLR_NUMBER) + 1, bits);
+		}
+
+		/**
+			Normal expression, association or packed array whose head and parts are being hashed
+			@remarks next is 0 while the head is due, then the index of the next part.
+		*/
+		struct HashFrame
+		{
+			wlr_expr expression;
+			std::uint64_t hash;
+			mint length;
+			mint next;
+		};
+
+		/**
+			Hash of a packed vector of machine integers or reals, element by element as for the List it packs
+		*/
+		template <typename T>
+		std::uint64_t HashPackedVector(wlr_expr expression, const RuntimeBuffer<T>& elements)
+		{
+			std::uint64_t hash = HashCombine(HashCombine(0, WLR_NORMAL), static_cast<std::uint64_t>(elements.Size()));
+
+			hash = HashCombine(hash, SymbolHash(wlr_Head(expression)));
+
+			for(std::size_t index = 0; index < elements.Size(); ++index)
+			{
+				if constexpr(std::is_same<T, mint>::value)
+				{
+					hash = HashCombine(hash, IntegerHash(elements[index]));
+				}
+				else
+				{
+					hash = HashCombine(hash, RealHash(elements[index]));
+				}
+			}
+
+			return hash;
+		}
+
+		/**
+			Set hash to the hash of expression and return true, or, if its head and parts have to be walked, push its
+			frame onto stack and return false
+		*/
+		inline bool HashOrPush(wlr_expr expression, std::vector<HashFrame>& stack, std::uint64_t& hash)
+		{
+			const wlr_expr_t type = wlr_ExpressionType(expression);
+
+			hash = HashCombine(0, static_cast<std::uint64_t>(type));
+
+			switch(type)
+			{
+				case WLR_NUMBER:
+				{
+					mint integer;
+					mreal real;
+
+					if(wlr_IntegerData(expression, &integer) == WLR_SUCCESS)
+					{
+						hash = IntegerHash(integer);
+					}
+					else if(wlr_RealData(expression, &real) == WLR_SUCCESS)
+					{
+						hash = RealHash(real);
+					}
+
+					return true;
+				}
+				case WLR_STRING:
+					hash = HashStringExpression(expression, hash);
+					return true;
+				case WLR_SYMBOL:
+					hash = SymbolHash(expression);
+					return true;
+				case WLR_PACKED_ARRAY:
+				{
+					// A packed array is SameQ to the List it packs, so it hashes as that List; only vectors are read
+					// in one piece, higher ranks are walked row by row
+					if(wlr_Length(expression) > 0 && wlr_ExpressionType(wlr_Part(expression, 1)) != WLR_NUMBER)
+					{
+						break;
+					}
+
+					RuntimeBuffer<mint> integers;
+
+					if(wlr_IntegerArrayData(expression, integers.OutLength(), integers.OutData()) == WLR_SUCCESS)
+					{
+						hash = HashPackedVector(expression, integers);
+						return true;
+					}
+
+					RuntimeBuffer<mreal> reals;
+
+					if(wlr_RealArrayData(expression, reals.OutLength(), reals.OutData()) == WLR_SUCCESS)
+					{
+						hash = HashPackedVector(expression, reals);
+						return true;
+					}
+
+					break;
+				}
+				case WLR_NUMERIC_ARRAY:
+				{
+					MNumericArray numericArray = nullptr;
+
+					if(wlr_NumericArrayData(expression, &numericArray) != WLR_SUCCESS)
+					{
+						return true;
+					}
+
+					const numericarray_data_t elementType = wlr_MNumericArray_getType(numericArray);
+					const std::size_t rank = static_cast<std::size_t>(wlr_MNumericArray_getRank(numericArray));
+					const mint length = wlr_MNumericArray_getFlattenedLength(numericArray);
+					const std::size_t elementSize = NumericArrayElementSize(elementType);
+					const char* data = static_cast<const char*>(wlr_MNumericArray_getData(numericArray));
+
+					hash = HashCombine(hash, static_cast<std::uint64_t>(elementType));
+					hash = HashElements(wlr_MNumericArray_getDimensions(numericArray), rank, hash);
+					hash = HashBytes(std::string_view(data, static_cast<std::size_t>(length) * elementSize), hash);
+					return true;
+				}
+				default:
+					break;
+			}
+
+			// Normal expressions, and anything whose data could not be read, are hashed part by part
+			const mint length = wlr_Length(expression);
+
+			if(type == WLR_PACKED_ARRAY)
+			{
+				hash = HashCombine(0, WLR_NORMAL);
+			}
+
+			hash = HashCombine(hash, static_cast<std::uint64_t>(length));
+
+			if(type == WLR_NORMAL || type == WLR_ASSOCIATION || type == WLR_PACKED_ARRAY)
+			{
+				stack.push_back(HashFrame {expression, hash, length, 0});
+				return false;
+			}
+
+			return true;
+		}
+	}
+
+	/**
+		Hash an expression by its structure: head, length and parts, down to the atoms
+		@remarks Equal expressions have equal hashes; in particular a packed array hashes like the List it packs, since
+	   the two are SameQ. The walk costs a few expression API calls per subexpression, except that packed vectors and
+	   numeric arrays are hashed from their data without a call per element. Numbers that are not machine integers or
+	   reals only contribute their type, which is still correct because hits are confirmed with wlr_SameQ.
+		@remarks The walk keeps its own stack, so the depth of the expression is limited by memory, not by the call
+	   stack.
+	*/
+	inline std::uint64_t StructuralHash(wlr_expr expression)
+	{
+		std::vector<detail::HashFrame> stack;
+
+		std::uint64_t hash = 0;
+
+		if(detail::HashOrPush(expression, stack, hash))
+		{
+			return hash;
+		}
+
+		for(;;)
+		{
+			detail::HashFrame& frame = stack.back();
+
+			if(frame.next > frame.length)
+			{
+				hash = frame.hash;
+
+				stack.pop_back();
+
+				if(stack.empty())
+				{
+					return hash;
+				}
+
+				stack.back().hash = HashCombine(stack.back().hash, hash);
+
+				continue;
+			}
+
+			const wlr_expr part = frame.next == 0 ? wlr_Head(frame.expression) : wlr_Part(frame.expression, frame.next);
+
+			++frame.next;
+
+			// frame is not used past this point, since pushing can move it
+			if(detail::HashOrPush(part, stack, hash))
+			{
+				stack.back().hash = HashCombine(stack.back().hash, hash);
+			}
+		}
+	}
+
+	/**
+		Whether a request may be answered from, and stored in, a ResultCache
+	*/
+	enum class CachePolicy
+	{
+		Use,
+		Bypass
+	};
+
+	/**
+		Budget of a ResultCache
+		@remarks Entries are evicted, least recently used first, as soon as either limit is exceeded. An entry is charged
+	   the growth of wlr_MemoryInUse while its input and result are copied into the cache, but at least
+	   minimumEntryBytes, since the runtime may share structure between copies.
+	*/
+	struct ResultCacheOptions
+	{
+		std::size_t maximumEntries = 1024;
+		std::size_t maximumBytes = std::size_t(64) << 20;
+		std::size_t minimumEntryBytes = 256;
+	};
+
+	/**
+		Counters published by a ResultCache
+		@remarks collisions counts cached inputs with a matching hash that wlr_SameQ (or the text comparison) rejected.
+	*/
+	struct ResultCacheStatistics
+	{
+		std::uint64_t hits;
+		std::uint64_t misses;
+		std::uint64_t collisions;
+		std::uint64_t bypasses;
+		std::uint64_t evictions;
+		std::size_t entries;
+		std::size_t bytes;
+	};
+
+	/**
+		LRU cache from input to detached evaluated result
+		@remarks Not thread-safe. Like every other expression API call, use it from the thread that owns the runtime.
+		@remarks Results are returned as clones in the current expression pool, exactly as a fresh wlr_Eval would return
+	   them.
+	*/
+	class ResultCache
+	{
+	public:
+		explicit ResultCache(ResultCacheOptions options = ResultCacheOptions()) : options(options)
+		{
+		}
+
+		ResultCache(const ResultCache&) = delete;
+		ResultCache& operator=(const ResultCache&) = delete;
+
+		/**
+			Evaluate expression, or return the cached result of evaluating the same expression before
+		*/
+		wlr_expr Evaluate(wlr_expr expression, CachePolicy policy = CachePolicy::Use)
+		{
+			if(policy == CachePolicy::Bypass)
+			{
+				++bypasses;
+
+				return wlr_Eval(expression);
+			}
+
+			const std::uint64_t hash = StructuralHash(expression);
+
+			if(wlr_expr cached = Find(hash, [expression](const Entry& entry) {
+				   return entry.text.empty() && wlr_SameQ(entry.input.Get(), expression);
+			   }))
+			{
+				return cached;
+			}
+
+			wlr_expr result = wlr_Eval(expression);
+
+			Insert(hash, std::string(), expression, result);
+
+			return result;
+		}
+
+		/**
+			Parse and evaluate input text, or return the cached result of evaluating the same text before
+		*/
+		wlr_expr EvaluateInput(std::string_view input, CachePolicy policy = CachePolicy::Use)
+		{
+			if(policy == CachePolicy::Bypass)
+			{
+				++bypasses;
+
+				return wlr_Eval(wlr_ParseExpression(ToExpression(input)));
+			}
+
+			const std::uint64_t hash = HashBytes(input, TextSeed);
+
+			if(wlr_expr cached = Find(hash, [input](const Entry& entry) { return entry.text == input; }))
+			{
+				return cached;
+			}
+
+			wlr_expr result = wlr_Eval(wlr_ParseExpression(ToExpression(input)));
+
+			Insert(hash, std::string(input), nullptr, result);
+
+			return result;
+		}
+
+		void Clear() noexcept
+		{
+			index.clear();
+			entries.clear();
+
+			bytes = 0;
+		}
+
+		ResultCacheStatistics Statistics() const noexcept
+		{
+			return ResultCacheStatistics {hits, misses, collisions, bypasses, evictions, entries.size(), bytes};
+		}
+
+	private:
+		// Keeps text keys and expression keys with the same hash in different buckets
+		static constexpr std::uint64_t TextSeed = 0x7465787400000000ull;
+
+		struct Entry
+		{
+			std::uint64_t hash;
+			std::string text;
+			Expr input;
+			Expr result;
+			std::size_t bytes;
+		};
+
+		using EntryList = std::list<Entry>;
+
+		template <typename Matches>
+		wlr_expr Find(std::uint64_t hash, Matches&& matches)
+		{
+			auto range = index.equal_range(hash);
+
+			for(auto candidate = range.first; candidate != range.second; ++candidate)
+			{
+				if(matches(*candidate->second))
+				{
+					++hits;
+
+					entries.splice(entries.begin(), entries, candidate->second);
+
+					return candidate->second->result.CloneToPool();
+				}
+
+				++collisions;
+			}
+
+			++misses;
+
+			return nullptr;
+		}
+
+		void Insert(std::uint64_t hash, std::string text, wlr_expr input, wlr_expr result)
+		{
+			if(options.maximumEntries == 0 || wlr_ErrorQ(result) ||
+			   wlr_SameQ(result, Symbol(SystemSymbol::Aborted)))
+			{
+				return;
+			}
+
+			const mint memoryBefore = wlr_MemoryInUse();
+
+			Expr inputCopy = input == nullptr ? Expr() : Expr::Detach(wlr_Clone(input));
+			Expr resultCopy = Expr::Detach(wlr_Clone(result));
+
+			const mint growth = wlr_MemoryInUse() - memoryBefore;
+
+			const std::size_t entryBytes =
+				std::max(options.minimumEntryBytes, text.size() + static_cast<std::size_t>(growth > 0 ? growth : 0));
+
+			if(entryBytes > options.maximumBytes)
+			{
+				return;
+			}
+
+			entries.push_front(Entry {hash, std::move(text), std::move(inputCopy), std::move(resultCopy), entryBytes});
+
+			index.emplace(hash, entries.begin());
+
+			bytes += entryBytes;
+
+			while(entries.size() > options.maximumEntries || bytes > options.maximumBytes)
+			{
+				Evict();
+			}
+		}
+
+		void Evict() noexcept
+		{
+			const Entry& leastRecent = entries.back();
+
+			auto range = index.equal_range(leastRecent.hash);
+
+			for(auto candidate = range.first; candidate != range.second; ++candidate)
+			{
+				if(&*candidate->second == &leastRecent)
+				{
+					index.erase(candidate);
+					break;
+				}
+			}
+
+			bytes -= leastRecent.bytes;
+
+			entries.pop_back();
+
+			++evictions;
+		}
+
+		ResultCacheOptions options;
+
+		EntryList entries;
+		std::unordered_multimap<std::uint64_t, EntryList::iterator> index;
+
+		std::size_t bytes = 0;
+		std::uint64_t hits = 0;
+		std::uint64_t misses = 0;
+		std::uint64_t collisions = 0;
+		std::uint64_t bypasses = 0;
+		std::uint64_t evictions = 0;
+	};
+}
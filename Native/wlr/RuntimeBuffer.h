@@ -0,0 +1,110 @@
+/*
+	Ownership of buffers that expression API functions allocate on behalf of the caller
+
+	Functions such as wlr_StringData, wlr_IntegerArrayData and wlr_RealArrayData return memory that must be freed with
+	wlr_Release. wlr::RuntimeBuffer owns one such buffer for the duration of a scope.
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#include "WolframLanguageRuntimeV1.h"
+
+namespace wlr
+{
+	/**
+		Move-only owner of a buffer allocated by the expression API
+		@remarks The destructor calls wlr_Release. Pass OutData() and OutLength() to the allocating function to fill it.
+	*/
+	template <typename T>
+	class RuntimeBuffer
+	{
+	public:
+		RuntimeBuffer() noexcept = default;
+
+		RuntimeBuffer(const RuntimeBuffer&) = delete;
+		RuntimeBuffer& operator=(const RuntimeBuffer&) = delete;
+
+		RuntimeBuffer(RuntimeBuffer&& other) noexcept : data(other.data), length(other.length)
+		{
+			other.data = nullptr;
+			other.length = 0;
+		}
+
+		RuntimeBuffer& operator=(RuntimeBuffer&& other) noexcept
+		{
+			if(this != &other)
+			{
+				Reset();
+
+				data = other.data;
+				length = other.length;
+				other.data = nullptr;
+				other.length = 0;
+			}
+
+			return *this;
+		}
+
+		~RuntimeBuffer()
+		{
+			Reset();
+		}
+
+		void Reset() noexcept
+		{
+			if(data != nullptr)
+			{
+				wlr_Release(data);
+			}
+
+			data = nullptr;
+			length = 0;
+		}
+
+		/**
+			Release any current buffer and return the address an allocating function should write the new pointer to
+		*/
+		T** OutData() noexcept
+		{
+			Reset();
+
+			return &data;
+		}
+
+		mint* OutLength() noexcept
+		{
+			return &length;
+		}
+
+		const T* Data() const noexcept
+		{
+			return data;
+		}
+
+		std::size_t Size() const noexcept
+		{
+			return static_cast<std::size_t>(length);
+		}
+
+		const T* begin() const noexcept
+		{
+			return data;
+		}
+
+		const T* end() const noexcept
+		{
+			return data + length;
+		}
+
+		const T& operator[](std::size_t index) const noexcept
+		{
+			return data[index];
+		}
+
+	private:
+		T* data = nullptr;
+		mint length = 0;
+	};
+}
@@ -0,0 +1,677 @@
+/*
+	Serialize and deserialize expressions without temporary files
+
+	wlr_Serialize and wlr_Deserialize only accept a file name. The functions in this file hand them the name of an
+	in-memory file or of one end of a pipe instead, so that serialized data never touches the disk:
+
+		wlr::SerializeToBuffer        - Linux: serialize into an anonymous memory file (memfd) and map it read-only;
+										the bytes are read in place, and wlr::Deserialize reads them back by name
+		wlr::SerializeToStream        - serialize through a pipe, handing the data to a callback in chunks, so that the
+										whole blob is never resident on the host side
+		wlr::SerializeToString        - serialize through a pipe into a growable buffer
+		wlr::SerializeToDescriptor    - POSIX: serialize through a pipe into a file descriptor (file, socket, pipe)
+		wlr::DeserializeFromStream    - deserialize from data supplied by a callback in chunks, through a pipe
+		wlr::DeserializeFromMemory    - deserialize from a block of memory, through a pipe
+
+	On POSIX systems the pipe is passed to the runtime as /dev/fd/N; on Windows it is a named pipe. The pipe-based
+	functions require the runtime to read and write the file sequentially; if it does not, they return its error.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "WolframLanguageRuntimeV1.h"
+
+namespace wlr
+{
+	/**
+		Receives serialized data in order; return false to discard the rest
+	*/
+	using ChunkSink = std::function<bool(const char* data, std::size_t size)>;
+
+	/**
+		Fills buffer with up to capacity bytes of serialized data and returns the count; 0 marks the end
+	*/
+	using ChunkSource = std::function<std::size_t(char* buffer, std::size_t capacity)>;
+
+	constexpr std::size_t DefaultChunkSize = std::size_t(1) << 20;
+
+	/**
+		Smallest chunk the pipe-based functions use; a smaller chunkSize, including 0, is raised to it
+	*/
+	constexpr std::size_t MinimumChunkSize = 4096;
+
+	namespace detail
+	{
+#if defined(_WIN32)
+		/**
+			A uniquely named pipe whose client end the runtime opens by name
+		*/
+		class RuntimePipe
+		{
+		public:
+			RuntimePipe(DWORD direction, std::size_t chunkSize)
+			{
+				static std::atomic<unsigned> counter {0};
+
+				char buffer[96];
+				std::snprintf(buffer, sizeof(buffer), "\\\\.\\pipe\\wlr-serialization-%lu-%u",
+							  static_cast<unsigned long>(GetCurrentProcessId()), counter.fetch_add(1));
+
+				name = buffer;
+
+				const DWORD bufferSize = static_cast<DWORD>(std::min<std::size_t>(chunkSize, 1u << 20));
+
+				handle = CreateNamedPipeA(name.c_str(), direction | FILE_FLAG_FIRST_PIPE_INSTANCE,
+										  PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, bufferSize,
+										  bufferSize, 0, nullptr);
+			}
+
+			RuntimePipe(const RuntimePipe&) = delete;
+			RuntimePipe& operator=(const RuntimePipe&) = delete;
+
+			~RuntimePipe()
+			{
+				if(Valid())
+				{
+					CloseHandle(handle);
+				}
+			}
+
+			bool Valid() const noexcept
+			{
+				return handle != INVALID_HANDLE_VALUE;
+			}
+
+			HANDLE Handle() const noexcept
+			{
+				return handle;
+			}
+
+			const char* Path() const noexcept
+			{
+				return name.c_str();
+			}
+
+			/**
+				Wait for the runtime to open the pipe
+			*/
+			bool Connect() const noexcept
+			{
+				return ConnectNamedPipe(handle, nullptr) || GetLastError() == ERROR_PIPE_CONNECTED;
+			}
+
+			/**
+				Release a thread still waiting in Connect because the runtime never opened the pipe
+				@remarks If the runtime did connect, the pipe is busy and this does nothing.
+			*/
+			void Unblock(DWORD access) const noexcept
+			{
+				HANDLE client = CreateFileA(name.c_str(), access, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+
+				if(client != INVALID_HANDLE_VALUE)
+				{
+					CloseHandle(client);
+				}
+			}
+
+		private:
+			std::string name;
+			HANDLE handle = INVALID_HANDLE_VALUE;
+		};
+#else
+		/**
+			Name under which the runtime can open an inherited file descriptor of this process
+		*/
+		inline std::string DescriptorPath(int descriptor)
+		{
+			return "/dev/fd/" + std::to_string(descriptor);
+		}
+
+		/**
+			An anonymous pipe whose ends are closed on destruction
+		*/
+		class RuntimePipe
+		{
+		public:
+			RuntimePipe() noexcept
+			{
+				if(pipe(descriptors) == 0)
+				{
+					fcntl(descriptors[0], F_SETFD, FD_CLOEXEC);
+					fcntl(descriptors[1], F_SETFD, FD_CLOEXEC);
+				}
+				else
+				{
+					descriptors[0] = descriptors[1] = -1;
+				}
+			}
+
+			RuntimePipe(const RuntimePipe&) = delete;
+			RuntimePipe& operator=(const RuntimePipe&) = delete;
+
+			~RuntimePipe()
+			{
+				CloseReadEnd();
+				CloseWriteEnd();
+			}
+
+			bool Valid() const noexcept
+			{
+				return descriptors[0] >= 0;
+			}
+
+			int ReadEnd() const noexcept
+			{
+				return descriptors[0];
+			}
+
+			int WriteEnd() const noexcept
+			{
+				return descriptors[1];
+			}
+
+			void CloseReadEnd() noexcept
+			{
+				if(descriptors[0] >= 0)
+				{
+					close(descriptors[0]);
+					descriptors[0] = -1;
+				}
+			}
+
+			void CloseWriteEnd() noexcept
+			{
+				if(descriptors[1] >= 0)
+				{
+					close(descriptors[1]);
+					descriptors[1] = -1;
+				}
+			}
+
+		private:
+			int descriptors[2];
+		};
+
+		/**
+			Write all of data, retrying on EINTR
+			@remarks Returns false on any other error, including EPIPE.
+		*/
+		inline bool WriteAll(int descriptor, const char* data, std::size_t size) noexcept
+		{
+			while(size > 0)
+			{
+				const ssize_t written = write(descriptor, data, size);
+
+				if(written < 0)
+				{
+					if(errno == EINTR)
+					{
+						continue;
+					}
+
+					return false;
+				}
+
+				data += written;
+				size -= static_cast<std::size_t>(written);
+			}
+
+			return true;
+		}
+
+		/**
+			Read until buffer is full or the writer closes its end
+		*/
+		inline std::size_t ReadFull(int descriptor, char* buffer, std::size_t capacity) noexcept
+		{
+			std::size_t total = 0;
+
+			while(total < capacity)
+			{
+				const ssize_t count = read(descriptor, buffer + total, capacity - total);
+
+				if(count < 0 && errno == EINTR)
+				{
+					continue;
+				}
+
+				if(count <= 0)
+				{
+					break;
+				}
+
+				total += static_cast<std::size_t>(count);
+			}
+
+			return total;
+		}
+#endif
+	}
+
+	/**
+		Serialize expression through a pipe, passing the data to sink in chunks of up to chunkSize bytes
+		@remarks A reader thread drains the pipe while the calling thread runs wlr_Serialize, so at most one chunk is
+	   held on the host side. If sink returns false the remaining data is drained and discarded, and the function
+	   returns WLR_MISCELLANEOUS_ERROR.
+		@remarks chunkSize is at least MinimumChunkSize; with no room to read into, the reader would stop and leave the
+	   runtime blocked on a full pipe.
+	*/
+	inline wlr_err_t SerializeToStream(wlr_expr expression, const ChunkSink& sink,
+									   std::size_t chunkSize = DefaultChunkSize)
+	{
+		chunkSize = std::max(chunkSize, MinimumChunkSize);
+
+		bool sinkAccepted = true;
+
+#if defined(_WIN32)
+		detail::RuntimePipe pipe(PIPE_ACCESS_INBOUND, chunkSize);
+
+		if(!pipe.Valid())
+		{
+			return WLR_MISCELLANEOUS_ERROR;
+		}
+
+		std::thread reader([&] {
+			if(!pipe.Connect())
+			{
+				return;
+			}
+
+			std::vector<char> chunk(chunkSize);
+			std::size_t filled = 0;
+			DWORD count = 0;
+
+			while(ReadFile(pipe.Handle(), chunk.data() + filled, static_cast<DWORD>(chunkSize - filled), &count, nullptr) &&
+				  count > 0)
+			{
+				filled += count;
+
+				if(filled == chunkSize)
+				{
+					sinkAccepted = sinkAccepted && sink(chunk.data(), filled);
+					filled = 0;
+				}
+			}
+
+			if(filled > 0)
+			{
+				sinkAccepted = sinkAccepted && sink(chunk.data(), filled);
+			}
+		});
+
+		const wlr_err_t error = wlr_Serialize(pipe.Path(), expression);
+
+		pipe.Unblock(GENERIC_WRITE);
+		reader.join();
+#else
+		detail::RuntimePipe pipe;
+
+		if(!pipe.Valid())
+		{
+			return WLR_MISCELLANEOUS_ERROR;
+		}
+
+		std::thread reader([&] {
+			std::vector<char> chunk(chunkSize);
+
+			for(;;)
+			{
+				const std::size_t count = detail::ReadFull(pipe.ReadEnd(), chunk.data(), chunkSize);
+
+				if(count == 0)
+				{
+					break;
+				}
+
+				sinkAccepted = sinkAccepted && sink(chunk.data(), count);
+			}
+		});
+
+		const wlr_err_t error = wlr_Serialize(detail::DescriptorPath(pipe.WriteEnd()).c_str(), expression);
+
+		// The runtime has closed its own descriptor; closing ours delivers end-of-file to the reader
+		pipe.CloseWriteEnd();
+		reader.join();
+#endif
+
+		if(error == WLR_SUCCESS && !sinkAccepted)
+		{
+			return WLR_MISCELLANEOUS_ERROR;
+		}
+
+		return error;
+	}
+
+	/**
+		Serialize expression into a growable buffer
+		@remarks buffer is cleared first; it grows in chunkSize steps as data arrives.
+	*/
+	inline wlr_err_t SerializeToString(wlr_expr expression, std::string& buffer, std::size_t chunkSize = DefaultChunkSize)
+	{
+		buffer.clear();
+
+		return SerializeToStream(
+			expression,
+			[&buffer](const char* data, std::size_t size) {
+				buffer.append(data, size);
+				return true;
+			},
+			chunkSize);
+	}
+
+#if !defined(_WIN32)
+	/**
+		Serialize expression into an open file descriptor, such as a checkpoint file or a socket
+	*/
+	inline wlr_err_t SerializeToDescriptor(wlr_expr expression, int descriptor, std::size_t chunkSize = DefaultChunkSize)
+	{
+		return SerializeToStream(
+			expression,
+			[descriptor](const char* data, std::size_t size) { return detail::WriteAll(descriptor, data, size); },
+			chunkSize);
+	}
+#endif
+
+	/**
+		Deserialize an expression from data produced by source, through a pipe
+		@remarks A writer thread feeds the pipe while the calling thread runs wlr_Deserialize, so at most one chunk is
+	   held on the host side. The result is in the current expression pool; on failure it is an error expression.
+		@remarks chunkSize is at least MinimumChunkSize, since a source asked for 0 bytes would end the data at once.
+	*/
+	inline wlr_expr DeserializeFromStream(const ChunkSource& source, std::size_t chunkSize = DefaultChunkSize)
+	{
+		chunkSize = std::max(chunkSize, MinimumChunkSize);
+
+#if defined(_WIN32)
+		detail::RuntimePipe pipe(PIPE_ACCESS_OUTBOUND, chunkSize);
+
+		if(!pipe.Valid())
+		{
+			return wlr_Error(WLR_MISCELLANEOUS_ERROR);
+		}
+
+		std::thread writer([&] {
+			if(!pipe.Connect())
+			{
+				return;
+			}
+
+			std::vector<char> chunk(chunkSize);
+			std::size_t count;
+
+			while((count = source(chunk.data(), chunkSize)) > 0)
+			{
+				DWORD written = 0;
+
+				if(!WriteFile(pipe.Handle(), chunk.data(), static_cast<DWORD>(count), &written, nullptr))
+				{
+					break;
+				}
+			}
+
+			FlushFileBuffers(pipe.Handle());
+			DisconnectNamedPipe(pipe.Handle());
+		});
+
+		wlr_expr result = wlr_Deserialize(pipe.Path());
+
+		pipe.Unblock(GENERIC_READ);
+		writer.join();
+#else
+		detail::RuntimePipe pipe;
+
+		if(!pipe.Valid())
+		{
+			return wlr_Error(WLR_MISCELLANEOUS_ERROR);
+		}
+
+		std::thread writer([&] {
+			// If the runtime stops reading early, write fails with EPIPE instead of killing the process
+#if defined(F_SETNOSIGPIPE)
+			fcntl(pipe.WriteEnd(), F_SETNOSIGPIPE, 1);
+#else
+			sigset_t pipeSignal;
+			sigemptyset(&pipeSignal);
+			sigaddset(&pipeSignal, SIGPIPE);
+			pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+#endif
+
+			std::vector<char> chunk(chunkSize);
+			std::size_t count;
+			bool broken = false;
+
+			while(!broken && (count = source(chunk.data(), chunkSize)) > 0)
+			{
+				broken = !detail::WriteAll(pipe.WriteEnd(), chunk.data(), count);
+			}
+
+			pipe.CloseWriteEnd();
+
+#if !defined(F_SETNOSIGPIPE) && defined(__linux__)
+			if(broken)
+			{
+				const timespec noWait {0, 0};
+				sigtimedwait(&pipeSignal, nullptr, &noWait);
+			}
+#endif
+		});
+
+		wlr_expr result = wlr_Deserialize(detail::DescriptorPath(pipe.ReadEnd()).c_str());
+
+		// Unblocks the writer if the runtime returned without reading everything
+		pipe.CloseReadEnd();
+		writer.join();
+#endif
+
+		return result;
+	}
+
+	/**
+		Deserialize an expression from size bytes at data
+	*/
+	inline wlr_expr DeserializeFromMemory(const void* data, std::size_t size, std::size_t chunkSize = DefaultChunkSize)
+	{
+		const char* next = static_cast<const char*>(data);
+		const char* const end = next + size;
+
+		return DeserializeFromStream(
+			[&](char* buffer, std::size_t capacity) {
+				const std::size_t count = std::min<std::size_t>(capacity, static_cast<std::size_t>(end - next));
+				std::copy(next, next + count, buffer);
+				next += count;
+				return count;
+			},
+			chunkSize);
+	}
+
+	inline wlr_expr DeserializeFromMemory(std::string_view data, std::size_t chunkSize = DefaultChunkSize)
+	{
+		return DeserializeFromMemory(data.data(), data.size(), chunkSize);
+	}
+
+	/**
+		Serialized expression held in memory
+		@remarks On Linux the data lives in an anonymous memory file that is mapped read-only: View() reads it in place,
+	   and wlr::Deserialize passes the file to the runtime by name, so neither direction copies the data on the host
+	   side. On other systems the data is held in a std::string filled through a pipe.
+	*/
+	class SerializedBuffer
+	{
+	public:
+		SerializedBuffer() noexcept = default;
+
+		SerializedBuffer(const SerializedBuffer&) = delete;
+		SerializedBuffer& operator=(const SerializedBuffer&) = delete;
+
+		SerializedBuffer(SerializedBuffer&& other) noexcept
+		{
+			*this = std::move(other);
+		}
+
+		SerializedBuffer& operator=(SerializedBuffer&& other) noexcept
+		{
+			if(this != &other)
+			{
+				Reset();
+
+#if defined(__linux__)
+				std::swap(descriptor, other.descriptor);
+				std::swap(mapping, other.mapping);
+				std::swap(size, other.size);
+#else
+				data = std::move(other.data);
+#endif
+			}
+
+			return *this;
+		}
+
+		~SerializedBuffer()
+		{
+			Reset();
+		}
+
+		/**
+			The serialized bytes
+		*/
+		std::string_view View() const noexcept
+		{
+#if defined(__linux__)
+			return std::string_view(static_cast<const char*>(mapping), size);
+#else
+			return data;
+#endif
+		}
+
+		std::size_t Size() const noexcept
+		{
+			return View().size();
+		}
+
+		void Reset() noexcept
+		{
+#if defined(__linux__)
+			if(mapping != nullptr)
+			{
+				munmap(mapping, size);
+				mapping = nullptr;
+			}
+
+			if(descriptor >= 0)
+			{
+				close(descriptor);
+				descriptor = -1;
+			}
+
+			size = 0;
+#else
+			data.clear();
+			data.shrink_to_fit();
+#endif
+		}
+
+		friend wlr_err_t SerializeToBuffer(wlr_expr expression, SerializedBuffer& buffer);
+		friend wlr_expr Deserialize(const SerializedBuffer& buffer);
+
+	private:
+#if defined(__linux__)
+		int descriptor = -1;
+		void* mapping = nullptr;
+		std::size_t size = 0;
+#else
+		std::string data;
+#endif
+	};
+
+	/**
+		Serialize expression into buffer, replacing its contents
+	*/
+	inline wlr_err_t SerializeToBuffer(wlr_expr expression, SerializedBuffer& buffer)
+	{
+		buffer.Reset();
+
+#if defined(__linux__)
+		const int descriptor = memfd_create("wlr-serialized", MFD_CLOEXEC);
+
+		if(descriptor < 0)
+		{
+			return WLR_MISCELLANEOUS_ERROR;
+		}
+
+		buffer.descriptor = descriptor;
+
+		const wlr_err_t error = wlr_Serialize(detail::DescriptorPath(descriptor).c_str(), expression);
+
+		struct stat status;
+
+		if(error != WLR_SUCCESS || fstat(descriptor, &status) != 0)
+		{
+			buffer.Reset();
+
+			return error != WLR_SUCCESS ? error : WLR_MISCELLANEOUS_ERROR;
+		}
+
+		buffer.size = static_cast<std::size_t>(status.st_size);
+
+		if(buffer.size > 0)
+		{
+			void* mapping = mmap(nullptr, buffer.size, PROT_READ, MAP_SHARED, descriptor, 0);
+
+			if(mapping == MAP_FAILED)
+			{
+				buffer.Reset();
+
+				return WLR_ALLOCATION_ERROR;
+			}
+
+			buffer.mapping = mapping;
+		}
+
+		return WLR_SUCCESS;
+#else
+		return SerializeToString(expression, buffer.data);
+#endif
+	}
+
+	/**
+		Deserialize the expression held by buffer
+	*/
+	inline wlr_expr Deserialize(const SerializedBuffer& buffer)
+	{
+#if defined(__linux__)
+		if(buffer.descriptor < 0)
+		{
+			return wlr_Error(WLR_MISCELLANEOUS_ERROR);
+		}
+
+		return wlr_Deserialize(detail::DescriptorPath(buffer.descriptor).c_str());
+#else
+		return DeserializeFromMemory(buffer.data);
+#endif
+	}
+}
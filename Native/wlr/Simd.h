@@ -0,0 +1,116 @@
+/*
+	Instruction set detection shared by the vectorized helpers (NumericArrayConvert.h, Utf.h)
+
+	Kernels for instruction sets beyond the compiler's baseline are compiled with the WLR_TARGET_* attributes and chosen
+	at run time with ActiveSimdLevel, so one binary runs on every x86-64 CPU. NEON is baseline on AArch64.
+*/
+
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define WLR_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define WLR_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(WLR_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define WLR_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define WLR_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define WLR_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx2,fma,f16c")))
+#else
+#define WLR_TARGET_SSE41
+#define WLR_TARGET_AVX2
+#define WLR_TARGET_AVX512
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define WLR_FORCE_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define WLR_FORCE_INLINE __forceinline
+#else
+#define WLR_FORCE_INLINE inline
+#endif
+
+namespace wlr
+{
+	/**
+		Vector instruction set used by the vectorized helpers
+		@remarks Levels are ordered: a kernel for a level may be run on any CPU that reports that level or a later
+	   x86 one.
+	*/
+	enum class SimdLevel
+	{
+		Scalar,
+		SSE41,
+		AVX2,
+		AVX512,
+		NEON
+	};
+
+	/**
+		Best instruction set supported by the CPU running this process
+	*/
+	inline SimdLevel DetectSimdLevel() noexcept
+	{
+#if defined(WLR_SIMD_NEON)
+		return SimdLevel::NEON;
+#elif defined(WLR_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+		__builtin_cpu_init();
+
+		if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"))
+		{
+			return SimdLevel::AVX512;
+		}
+
+		if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+		{
+			return SimdLevel::AVX2;
+		}
+
+		if(__builtin_cpu_supports("sse4.1"))
+		{
+			return SimdLevel::SSE41;
+		}
+
+		return SimdLevel::Scalar;
+#elif defined(WLR_SIMD_X86) && defined(_MSC_VER)
+		int registers[4];
+
+		__cpuid(registers, 1);
+
+		const bool hasSse41 = (registers[2] & (1 << 19)) != 0;
+		const bool osSavesYmm = (registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+		const bool hasF16cFma = (registers[2] & (1 << 29)) != 0 && (registers[2] & (1 << 12)) != 0;
+
+		__cpuidex(registers, 7, 0);
+
+		const bool hasAvx2 = (registers[1] & (1 << 5)) != 0;
+		const bool hasAvx512 = (registers[1] & (1 << 16)) != 0 && (registers[1] & (1 << 30)) != 0 &&
+							   (registers[1] & (1 << 31)) != 0 && (_xgetbv(0) & 0xE6) == 0xE6;
+
+		if(osSavesYmm && hasF16cFma && hasAvx2)
+		{
+			return hasAvx512 ? SimdLevel::AVX512 : SimdLevel::AVX2;
+		}
+
+		return hasSse41 ? SimdLevel::SSE41 : SimdLevel::Scalar;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+
+	/**
+		DetectSimdLevel, evaluated once per process
+	*/
+	inline SimdLevel ActiveSimdLevel() noexcept
+	{
+		static const SimdLevel level = DetectSimdLevel();
+
+		return level;
+	}
+}
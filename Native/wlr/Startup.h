@@ -0,0 +1,200 @@
+/*
+	Runtime startup with warm-up and per-phase timings
+
+	StartRuntime in SampleProgram.cs blocks Main for the whole kernel boot. wlr::StartRuntime runs the same boot as a
+	sequence of timed phases, followed by optional warm-up work, and returns a StartupReport:
+
+		configuration            - wlr_InitializeRuntimeConfiguration and the argument vector
+		signature registration   - wlr_sdk_RegisterSignatureFile, if a signature file is given
+		wlr_sdk_StartRuntime     - license or code signature check and kernel initialization (one opaque SDK call)
+		warm-up                  - one phase per wlr_Get file and per evaluated input, e.g. Needs["..."]
+
+	The SDK library itself is loaded by the operating system before main runs, so its load time cannot be separated
+	from process start here.
+
+	wlr::StartRuntimeAsync runs the same sequence on a background thread, so the host can initialize while the kernel
+	boots and make its first evaluation wait on the returned future. To boot the runtime on a KernelExecutor's kernel
+	thread instead, pass a lambda that calls wlr::StartRuntime and stores the report:
+
+		wlr::KernelExecutor executor([&options, &report] { report = wlr::StartRuntime(options); return report.result; });
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Before any header that includes WolframLanguageRuntimeV1.h, so that it selects the SDK's linking mode
+#include "WolframLanguageRuntimeV1SDK.h"
+
+#include "Expr.h"
+#include "ExpressionBuilder.h"
+#include "Tracing.h"
+
+namespace wlr
+{
+	/**
+		What to start and what to run before the runtime reports ready
+		@remarks warmupFiles are loaded with wlr_Get and warmupInputs are parsed and evaluated, in that order. A warm-up
+	   item that fails is recorded in its phase but does not fail the startup.
+	*/
+	struct StartupOptions
+	{
+		std::string layoutDirectory;
+		wlr_application_t application = WLR_EXECUTABLE;
+		wlr_version_t version = WLR_VERSION_1;
+		wlr_license_t license = WLR_LICENSE_OR_SIGNED_CODE_MODE;
+		std::vector<std::string> arguments;
+		wlr_containment_t containment = WLR_UNCONTAINED;
+		std::string signatureFile;
+		std::vector<std::string> warmupFiles;
+		std::vector<std::string> warmupInputs;
+	};
+
+	struct StartupPhase
+	{
+		std::string name;
+		std::chrono::nanoseconds duration;
+		bool succeeded;
+	};
+
+	/**
+		Outcome and timings of one startup
+		@remarks result is the first error from signature registration or wlr_sdk_StartRuntime, or WLR_SUCCESS. Phases
+	   after a failed one are not run.
+	*/
+	struct StartupReport
+	{
+		wlr_err_t result = WLR_RUNTIME_NOT_STARTED;
+		std::vector<StartupPhase> phases;
+		std::chrono::nanoseconds total {0};
+	};
+
+	namespace detail
+	{
+		template <typename Phase>
+		bool RunStartupPhase(StartupReport& report, std::string name, Phase&& phase)
+		{
+			WLR_TRACE_SPAN("StartupPhase");
+
+			const auto start = std::chrono::steady_clock::now();
+
+			const bool succeeded = phase();
+
+			report.phases.push_back(StartupPhase {
+				std::move(name), std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start),
+				succeeded});
+
+			return succeeded;
+		}
+	}
+
+	/**
+		Start the runtime on the calling thread, run the warm-up work, and report how long each phase took
+	*/
+	inline StartupReport StartRuntime(const StartupOptions& options)
+	{
+		WLR_TRACE_SPAN("StartRuntime");
+
+		StartupReport report;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		wlr_runtime_conf configuration;
+		std::vector<char*> arguments;
+
+		detail::RunStartupPhase(report, "configuration", [&] {
+			wlr_InitializeRuntimeConfiguration(&configuration);
+
+			for(const std::string& argument : options.arguments)
+			{
+				arguments.push_back(const_cast<char*>(argument.c_str()));
+			}
+
+			configuration.argumentCount = static_cast<mint>(arguments.size());
+			configuration.arguments = arguments.empty() ? nullptr : arguments.data();
+			configuration.containmentSetting = options.containment;
+
+			return true;
+		});
+
+		bool started = true;
+
+		if(!options.signatureFile.empty())
+		{
+			started = detail::RunStartupPhase(report, "signature registration", [&] {
+				report.result = wlr_sdk_RegisterSignatureFile(options.application, options.signatureFile.c_str());
+				return report.result == WLR_SUCCESS;
+			});
+		}
+
+		if(started)
+		{
+			started = detail::RunStartupPhase(report, "wlr_sdk_StartRuntime", [&] {
+				report.result = wlr_sdk_StartRuntime(options.application, options.version, options.license,
+													 options.layoutDirectory.c_str(), &configuration);
+				return report.result == WLR_SUCCESS;
+			});
+		}
+
+		if(started)
+		{
+			ExpressionPool pool;
+
+			for(const std::string& file : options.warmupFiles)
+			{
+				detail::RunStartupPhase(report, "warm-up: wlr_Get " + file,
+										[&] { return !wlr_ErrorQ(wlr_Get(file.c_str())); });
+			}
+
+			for(const std::string& input : options.warmupInputs)
+			{
+				detail::RunStartupPhase(report, "warm-up: " + input,
+										[&] { return !wlr_ErrorQ(wlr_Eval(wlr_ParseExpression(ToExpression(input)))); });
+			}
+		}
+
+		report.total = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+		return report;
+	}
+
+	/**
+		Start the runtime and run the warm-up work on a background thread
+		@remarks The future becomes ready once the runtime is started and warmed up, or has failed to start. The runtime
+	   is not safe to use from any thread before then, and is never safe to use from two threads at once.
+	*/
+	inline std::shared_future<StartupReport> StartRuntimeAsync(StartupOptions options)
+	{
+		std::packaged_task<StartupReport()> task([options = std::move(options)] { return StartRuntime(options); });
+
+		std::shared_future<StartupReport> report = task.get_future().share();
+
+		std::thread(std::move(task)).detach();
+
+		return report;
+	}
+
+	/**
+		Print one line per startup phase, then the total
+	*/
+	inline void WriteStartupReport(std::FILE* file, const StartupReport& report)
+	{
+		auto milliseconds = [](std::chrono::nanoseconds duration) {
+			return std::chrono::duration<double, std::milli>(duration).count();
+		};
+
+		for(const StartupPhase& phase : report.phases)
+		{
+			std::fprintf(file, "%-48s %10.2f ms%s\n", phase.name.c_str(), milliseconds(phase.duration),
+						 phase.succeeded ? "" : "  (failed)");
+		}
+
+		std::fprintf(file, "%-48s %10.2f ms\n", "total", milliseconds(report.total));
+	}
+}
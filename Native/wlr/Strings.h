@@ -0,0 +1,154 @@
+/*
+	String extraction without per-result copies
+
+	wlr_StringData allocates a fresh UTF-8 buffer for every call. StringFromExpression in SampleProgram.cs copies that
+	buffer into a managed string and frees it immediately, once per result. This file offers two cheaper patterns:
+
+		wlr::StringData   - owns the wlr_StringData buffer and exposes it as a std::string_view until it goes out of scope
+		wlr::StringArena  - every string leaf of an expression in one contiguous buffer plus an offsets array, extracted
+							with a single evaluation, one wlr_StringData call and one wlr_IntegerArrayData call
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string_view>
+
+#include "Expr.h"
+#include "ExpressionBuilder.h"
+#include "RuntimeBuffer.h"
+#include "Symbols.h"
+#include "Tracing.h"
+
+namespace wlr
+{
+	/**
+		UTF-8 contents of a string expression, valid until the StringData object is destroyed
+	*/
+	class StringData
+	{
+	public:
+		StringData() noexcept = default;
+
+		/**
+			Extract the contents of a string expression
+			@remarks Check Error() before using View(); on failure View() is empty.
+		*/
+		explicit StringData(wlr_expr stringExpression) noexcept
+		{
+			error = wlr_StringData(stringExpression, buffer.OutData(), buffer.OutLength());
+
+			if(error != WLR_SUCCESS)
+			{
+				buffer.Reset();
+			}
+		}
+
+		std::string_view View() const noexcept
+		{
+			return std::string_view(buffer.Data(), buffer.Size());
+		}
+
+		wlr_err_t Error() const noexcept
+		{
+			return error;
+		}
+
+	private:
+		RuntimeBuffer<char> buffer;
+		wlr_err_t error = WLR_SUCCESS;
+	};
+
+	/**
+		Every string leaf of an expression, stored back to back in a single UTF-8 buffer
+		@remarks String i occupies bytes [Offsets()[i], Offsets()[i + 1]) of the buffer. Both the buffer and the offsets
+	   array are the ones allocated by the expression API; nothing is copied on the host side.
+	*/
+	class StringArena
+	{
+	public:
+		std::size_t Size() const noexcept
+		{
+			return offsets.Size() == 0 ? 0 : offsets.Size() - 1;
+		}
+
+		std::string_view operator[](std::size_t index) const noexcept
+		{
+			const mint begin = offsets[index];
+
+			return std::string_view(data.Data() + begin, static_cast<std::size_t>(offsets[index + 1] - begin));
+		}
+
+		/**
+			The concatenation of every string in the arena
+		*/
+		std::string_view Data() const noexcept
+		{
+			return std::string_view(data.Data(), data.Size());
+		}
+
+		const RuntimeBuffer<mint>& Offsets() const noexcept
+		{
+			return offsets;
+		}
+
+		friend wlr_err_t ExtractStrings(wlr_expr expression, StringArena& arena);
+
+	private:
+		RuntimeBuffer<char> data;
+		RuntimeBuffer<mint> offsets;
+	};
+
+	namespace detail
+	{
+		/**
+			Function that returns {StringJoin[strings], offsets} for every string at any level of its argument
+			@remarks Parsed by the first call that succeeds and kept detached for the lifetime of the process; a parse
+		   error is returned to the caller and parsed again next time.
+		*/
+		inline wlr_expr StringArenaFunction()
+		{
+			static std::atomic<wlr_expr> function {nullptr};
+
+			return CachedExpression(function, [] {
+				return wlr_ParseExpression(
+					wlr_String("Function[expression, With[{strings = Cases[expression, _String, {0, Infinity}]}, "
+							   "{StringJoin[strings], Developer`ToPackedArray[Prepend[Accumulate[Length /@ "
+							   "ToCharacterCode[strings, \"UTF-8\"]], 0]]}]]"));
+			});
+		}
+	}
+
+	/**
+		Fill arena with every string leaf of expression, in depth-first order
+		@remarks This costs one wlr_Eval, one wlr_StringData and one wlr_IntegerArrayData call regardless of the number
+	   of strings. Intermediate expressions are left in the current expression pool.
+	*/
+	inline wlr_err_t ExtractStrings(wlr_expr expression, StringArena& arena)
+	{
+		WLR_TRACE_SPAN("ExtractStrings");
+
+		wlr_expr extracted = wlr_Eval(E(detail::StringArenaFunction(), expression));
+
+		if(wlr_ErrorQ(extracted))
+		{
+			return wlr_ErrorType(extracted);
+		}
+
+		wlr_err_t error = wlr_StringData(wlr_Part(extracted, 1), arena.data.OutData(), arena.data.OutLength());
+
+		if(error == WLR_SUCCESS)
+		{
+			error = wlr_IntegerArrayData(wlr_Part(extracted, 2), arena.offsets.OutLength(), arena.offsets.OutData());
+		}
+
+		if(error != WLR_SUCCESS)
+		{
+			arena.data.Reset();
+			arena.offsets.Reset();
+		}
+
+		return error;
+	}
+}
@@ -0,0 +1,243 @@
+/*
+	Interned symbols
+
+	wlr_Symbol, wlr_SystemSymbol and wlr_ContextSymbol convert their argument and look the symbol up in the kernel on
+	every call. The functions in this file resolve each symbol once, keep it as a detached expression for the lifetime
+	of the process, and serve later lookups from an array (for the common System` symbols listed in wlr::SystemSymbol)
+	or a hash table (for any other symbol).
+
+	The returned expressions are borrowed: they may be used anywhere an expression is expected, including as parts of
+	new expressions, but must not be released. Both tables may be used from several threads. A lookup the kernel answers
+	with an error expression returns that error without interning it, so the next call asks the kernel again.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "Expr.h"
+#include "Hash.h"
+
+namespace wlr
+{
+	/**
+		Frequently used System` symbols, resolved by array index
+	*/
+	enum class SystemSymbol : std::size_t
+	{
+		List,
+		Rule,
+		RuleDelayed,
+		Association,
+		ToString,
+		OutputForm,
+		InputForm,
+		ToExpression,
+		// True and False are macros in WolframLibrary.h
+		TrueSymbol,
+		FalseSymbol,
+		Null,
+		None,
+		All,
+		Automatic,
+		Missing,
+		Failed,
+		Aborted,
+		Slot,
+		Function,
+		Hold,
+		HoldComplete,
+		Plus,
+		Times,
+		Power,
+		Complex,
+		Rational,
+		Integer,
+		Real,
+		String,
+		Symbol,
+		NumericArray,
+		ByteArray,
+		Normal,
+		MessageName,
+		Count
+	};
+
+	namespace detail
+	{
+		constexpr const char* SystemSymbolNames[] = {
+			"List",
+			"Rule",
+			"RuleDelayed",
+			"Association",
+			"ToString",
+			"OutputForm",
+			"InputForm",
+			"ToExpression",
+			"True",
+			"False",
+			"Null",
+			"None",
+			"All",
+			"Automatic",
+			"Missing",
+			"$Failed",
+			"$Aborted",
+			"Slot",
+			"Function",
+			"Hold",
+			"HoldComplete",
+			"Plus",
+			"Times",
+			"Power",
+			"Complex",
+			"Rational",
+			"Integer",
+			"Real",
+			"String",
+			"Symbol",
+			"NumericArray",
+			"ByteArray",
+			"Normal",
+			"MessageName",
+		};
+
+		static_assert(sizeof(SystemSymbolNames) / sizeof(SystemSymbolNames[0]) ==
+						  static_cast<std::size_t>(SystemSymbol::Count),
+					  "every wlr::SystemSymbol needs a name");
+
+		/**
+			Interning table for symbols outside wlr::SystemSymbol, keyed by the full name passed to wlr_Symbol
+			@remarks The keys view strings owned by names, whose elements never move.
+		*/
+		struct SymbolTable
+		{
+			std::mutex mutex;
+			std::deque<std::string> names;
+			std::unordered_map<std::string_view, Expr, TextHash> symbols;
+		};
+
+		/**
+			The process-wide table, deliberately never destroyed so that no wlr_ReleaseExpression call happens after the
+			runtime has shut down
+		*/
+		inline SymbolTable& InternedSymbols()
+		{
+			static SymbolTable* const table = new SymbolTable();
+
+			return *table;
+		}
+
+		/**
+			Return the interned symbol for key, calling resolve to look it up in the kernel the first time
+		*/
+		template <typename Resolve>
+		wlr_expr InternSymbol(std::string_view key, Resolve&& resolve)
+		{
+			SymbolTable& table = InternedSymbols();
+
+			std::lock_guard<std::mutex> lock(table.mutex);
+
+			auto found = table.symbols.find(key);
+
+			if(found != table.symbols.end())
+			{
+				return found->second.Get();
+			}
+
+			wlr_expr symbol = resolve();
+
+			if(wlr_ErrorQ(symbol))
+			{
+				return symbol;
+			}
+
+			const std::string& name = table.names.emplace_back(key);
+
+			return table.symbols.emplace(name, Expr::Detach(symbol)).first->second.Get();
+		}
+
+		/**
+			Return the expression cached in entry, calling resolve to create it if entry is still empty
+			@remarks An error from resolve is returned without being cached, so a later call tries again. Threads that
+		   race on the first call each resolve the expression, and all but the first to store it release their copy.
+		*/
+		template <typename Resolve>
+		wlr_expr CachedExpression(std::atomic<wlr_expr>& entry, Resolve&& resolve)
+		{
+			wlr_expr cached = entry.load(std::memory_order_acquire);
+
+			if(cached != nullptr)
+			{
+				return cached;
+			}
+
+			wlr_expr resolved = resolve();
+
+			if(wlr_ErrorQ(resolved))
+			{
+				return resolved;
+			}
+
+			resolved = Expr::Detach(resolved).Release();
+
+			if(entry.compare_exchange_strong(cached, resolved, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				return resolved;
+			}
+
+			Expr::Adopt(resolved).Reset();
+
+			return cached;
+		}
+	}
+
+	/**
+		Return the interned expression for a common System` symbol
+		@remarks The first call for each symbol calls wlr_SystemSymbol; later calls are an array load. Threads that
+	   race on the first call each resolve the symbol, and all but the first to store it release their copy.
+	*/
+	inline wlr_expr Symbol(SystemSymbol symbol)
+	{
+		static std::atomic<wlr_expr> table[static_cast<std::size_t>(SystemSymbol::Count)] = {};
+
+		return detail::CachedExpression(table[static_cast<std::size_t>(symbol)], [symbol] {
+			return wlr_SystemSymbol(detail::SystemSymbolNames[static_cast<std::size_t>(symbol)]);
+		});
+	}
+
+	/**
+		Return the interned expression for a symbol, resolved the way wlr_Symbol resolves symbolName
+		@remarks The first call for each name calls wlr_Symbol; later calls are a hash probe under a mutex. Interned
+	   symbols live for the lifetime of the process, so do not intern an unbounded set of names.
+	*/
+	inline wlr_expr Symbol(std::string_view symbolName)
+	{
+		return detail::InternSymbol(symbolName, [symbolName] { return wlr_Symbol(std::string(symbolName).c_str()); });
+	}
+
+	/**
+		Return the interned expression for symbolContext`baseSymbolName, resolved with wlr_ContextSymbol
+		@remarks symbolContext may be given with or without its trailing backquote.
+	*/
+	inline wlr_expr ContextSymbol(std::string_view symbolContext, std::string_view baseSymbolName)
+	{
+		std::string context(symbolContext);
+
+		if(context.empty() || context.back() != '`')
+		{
+			context.push_back('`');
+		}
+
+		const std::string baseName(baseSymbolName);
+
+		return detail::InternSymbol(context + baseName,
+									[&] { return wlr_ContextSymbol(context.c_str(), baseName.c_str()); });
+	}
+}
@@ -0,0 +1,550 @@
+/*
+	Columnar transfer of Tabular data between host buffers and the runtime
+
+	Building a table row by row costs one wlr_Association per row and one call per cell, and wlr_VariadicAssociation
+	stops at 25 pairs. The functions in this file move whole columns instead, in the layout used by Arrow:
+
+		wlr::TabularColumn      - describes one host column without copying it: fixed-width values (a typed buffer or
+								  an MNumericArray) or UTF-8 strings as offsets + data, with an optional validity bitmap
+		wlr::TabularExpression  - encodes the columns as WXF (wlr/Wxf.h) and builds one expression that deserializes
+								  them and calls ToTabular, so a table enters the runtime with a single evaluation
+		wlr::EvaluateToColumns  - evaluates an expression that gives a Tabular and reads every column back with one
+								  BinarySerialize; numeric columns are read in place, and each string column arrives as
+								  a single string plus byte offsets
+		wlr::TabularColumns     - the decoded columns, as views into the serialized bytes
+
+	WolframLibraryData has a tabularColumnLibraryFunctions table, but its type is only declared in the SDK headers, so
+	the columns go through the documented expression API instead. Rows that are not valid become Missing["NotAvailable"]
+	in the runtime, and Missing elements become cleared validity bits on the way back.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Expr.h"
+#include "ExpressionBuilder.h"
+#include "NumericArray.h"
+#include "Symbols.h"
+#include "Wxf.h"
+
+namespace wlr
+{
+	/**
+		One host column passed to TabularExpression
+		@remarks Nothing is copied until TabularExpression encodes the column. validity is a bitmap with one bit per row,
+	   least significant bit first, that is set for rows that hold a value; nullptr means every row is valid. The
+	   values of rows that are not valid are ignored.
+	*/
+	struct TabularColumn
+	{
+		/**
+			Column of rowCount fixed-width values of type T, one of the element types of MNumericArray
+		*/
+		template <typename T>
+		static TabularColumn Numeric(std::string_view name, const T* values, const std::uint8_t* validity = nullptr)
+		{
+			TabularColumn column;
+
+			column.name = name;
+			column.type = NumericArrayType<T>;
+			column.values = values;
+			column.validity = validity;
+
+			return column;
+		}
+
+		/**
+			Column holding the elements of an MNumericArray, which must have rowCount elements
+		*/
+		static TabularColumn Numeric(std::string_view name, MNumericArray values, const std::uint8_t* validity = nullptr)
+		{
+			TabularColumn column;
+
+			column.name = name;
+			column.type = wlr_MNumericArray_getType(values);
+			column.values = wlr_MNumericArray_getData(values);
+			column.length = wlr_MNumericArray_getFlattenedLength(values);
+			column.validity = validity;
+
+			return column;
+		}
+
+		/**
+			Column of UTF-8 strings; row i occupies bytes [offsets[i], offsets[i + 1]) of data
+		*/
+		static TabularColumn Strings(std::string_view name, const char* data, const mint* offsets,
+									 const std::uint8_t* validity = nullptr)
+		{
+			TabularColumn column;
+
+			column.name = name;
+			column.stringData = data;
+			column.stringOffsets = offsets;
+			column.validity = validity;
+
+			return column;
+		}
+
+		bool IsString() const noexcept
+		{
+			return stringOffsets != nullptr;
+		}
+
+		std::string_view name;
+
+		// Fixed-width columns
+		numericarray_data_t type = MNumericArray_Type_Undef;
+		const void* values = nullptr;
+		mint length = -1;
+
+		// String columns
+		const char* stringData = nullptr;
+		const mint* stringOffsets = nullptr;
+
+		const std::uint8_t* validity = nullptr;
+	};
+
+	/**
+		Kind of a column read by EvaluateToColumns
+	*/
+	enum class TabularColumnKind : std::uint8_t
+	{
+		Integer,
+		Real,
+		String
+	};
+
+	/**
+		One column of a TabularColumns, as views into its serialized bytes
+		@remarks Rows that are not valid hold 0 or an empty string. validity is a bitmap in the layout of
+	   TabularColumn::validity, or nullptr if every row is valid.
+	*/
+	struct TabularColumnView
+	{
+		std::string_view name;
+		TabularColumnKind kind;
+
+		/**
+			Integer: packed array of whichever signed integer type BinarySerialize chose, Integer8 to Integer64; read
+			integers instead. Real: packed array of Real64; read it with WxfView::ArrayData, or CopyArrayData when the data
+			is not aligned. A column with no rows is an empty List instead.
+		*/
+		WxfView values;
+
+		/**
+			Integer: the rows as mint, in place when the kernel wrote aligned Integer64 data and widened otherwise
+		*/
+		const mint* integers;
+
+		/**
+			String: the UTF-8 text of every row back to back, row i in bytes [stringOffsets[i], stringOffsets[i + 1])
+		*/
+		std::string_view stringData;
+		const mint* stringOffsets;
+
+		const std::uint8_t* validity;
+	};
+
+	namespace detail
+	{
+		/**
+			Function that turns the deserialized columns {{name, values, invalidPositions}, ...} into a Tabular
+			@remarks Parsed once it parses without error and kept detached for the lifetime of the process. NumericArray
+		   columns are made Normal first, so they arrive as packed arrays.
+		*/
+		inline wlr_expr ToTabularFunction()
+		{
+			static std::atomic<wlr_expr> function {nullptr};
+
+			return CachedExpression(function, [] {
+				return wlr_ParseExpression(
+					wlr_String("Function[columns, ToTabular[Association[Map[Function[column, column[[1]] -> "
+							   "ReplacePart[Normal[column[[2]]], Thread[column[[3]] -> Missing[\"NotAvailable\"]]]], "
+							   "columns]], \"Columns\"]]"));
+			});
+		}
+
+		/**
+			Function that maps a Tabular to {{name, kind, values, invalidPositions}, ...}
+			@remarks kind is 0 for machine integers, 1 for reals and 2 for anything else, which is sent as strings (in
+		   InputForm if they are not strings already) with the layout of StringArenaFunction. Missing elements are
+		   replaced by 0, 0. or "" and their positions listed in invalidPositions.
+			@remarks Cached like ToTabularFunction.
+		*/
+		inline wlr_expr FromTabularFunction()
+		{
+			static std::atomic<wlr_expr> function {nullptr};
+
+			return CachedExpression(function, [] {
+				return wlr_ParseExpression(
+					wlr_String("Function[tabular, Map[Function[key, Module[{values = Normal[tabular[All, key]], "
+							   "invalid, present, kind}, invalid = Developer`ToPackedArray[Flatten[Position[values, "
+							   "_Missing, {1}, Heads -> False]]]; present = DeleteCases[values, _Missing]; kind = "
+							   "Which[VectorQ[present, Developer`MachineIntegerQ], 0, VectorQ[present, Head[#] === "
+							   "Real &], 1, True, 2]; values = ReplacePart[values, Thread[invalid -> {0, 0., \"\"}[["
+							   "kind + 1]]]]; {ToString[key], kind, If[kind == 2, With[{strings = Replace[values, "
+							   "value : Except[_String] :> ToString[value, InputForm], {1}]}, {StringJoin[strings], "
+							   "Developer`ToPackedArray[Prepend[Accumulate[Length /@ ToCharacterCode[strings, "
+							   "\"UTF-8\"]], 0]]}], Developer`ToPackedArray[If[kind == 1, N[values], values]]], "
+							   "invalid}]], ColumnKeys[tabular]]]"));
+			});
+		}
+
+		/**
+			Append the 1-based positions of the cleared bits among the first rowCount bits of validity
+			@remarks Reads the bitmap eight bytes at a time and skips words with every bit set.
+		*/
+		inline void AppendInvalidPositions(const std::uint8_t* validity, mint rowCount,
+										   std::vector<std::int64_t>& positions)
+		{
+			const std::size_t rows = static_cast<std::size_t>(rowCount);
+
+			for(std::size_t base = 0; base < rows; base += 64)
+			{
+				std::uint64_t word = ~std::uint64_t(0);
+				const std::size_t bytes = rows - base >= 64 ? 8 : (rows - base + 7) / 8;
+
+				std::memcpy(&word, validity + base / 8, bytes);
+
+				if(rows - base < 64)
+				{
+					word |= ~std::uint64_t(0) << (rows - base);
+				}
+
+				for(std::uint64_t invalid = ~word; invalid != 0; invalid &= invalid - 1)
+				{
+					positions.push_back(static_cast<std::int64_t>(base + CountTrailingZeros(invalid)) + 1);
+				}
+			}
+		}
+	}
+
+	/**
+		Build the unevaluated expression ToTabular[<|name -> column, ...|>, "Columns"] for host columns of rowCount rows
+		@remarks Numeric columns are copied once into the WXF bytes and once into an MNumericArray; strings are written
+	   one after the other without any runtime calls. The expression deserializes the columns when it is evaluated, so
+	   it can be embedded in a larger input. Returns a WLR_OUT_OF_BOUNDS error expression if an MNumericArray column
+	   does not have rowCount elements, and a WLR_UNEXPECTED_TYPE one if a column has an element type with no WXF
+	   encoding (Real16, ComplexReal16).
+	*/
+	inline wlr_expr TabularExpression(const TabularColumn* columns, std::size_t columnCount, mint rowCount)
+	{
+		WxfWriter writer;
+		std::vector<std::int64_t> invalid;
+
+		writer.List(columnCount);
+
+		for(std::size_t index = 0; index < columnCount; ++index)
+		{
+			const TabularColumn& column = columns[index];
+
+			writer.List(3).String(column.name);
+
+			if(column.IsString())
+			{
+				writer.List(static_cast<std::size_t>(rowCount));
+
+				for(mint row = 0; row < rowCount; ++row)
+				{
+					const mint begin = column.stringOffsets[row];
+
+					writer.String(std::string_view(column.stringData + begin,
+												   static_cast<std::size_t>(column.stringOffsets[row + 1] - begin)));
+				}
+			}
+			else
+			{
+				WxfArrayType arrayType;
+
+				if(!detail::WxfArrayTypeOf(column.type, arrayType))
+				{
+					return wlr_Error(WLR_UNEXPECTED_TYPE);
+				}
+
+				if(column.length >= 0 && column.length != rowCount)
+				{
+					return wlr_Error(WLR_OUT_OF_BOUNDS);
+				}
+
+				writer.NumericArray(column.type, column.values, &rowCount, 1);
+			}
+
+			invalid.clear();
+
+			if(column.validity != nullptr)
+			{
+				detail::AppendInvalidPositions(column.validity, rowCount, invalid);
+			}
+
+			const mint invalidCount = static_cast<mint>(invalid.size());
+
+			if(invalid.empty())
+			{
+				writer.List(0);
+			}
+			else
+			{
+				writer.PackedArray(invalid.data(), &invalidCount, 1);
+			}
+		}
+
+		return E(detail::ToTabularFunction(), WxfExpression(writer.Bytes()));
+	}
+
+	inline wlr_expr TabularExpression(const std::vector<TabularColumn>& columns, mint rowCount)
+	{
+		return TabularExpression(columns.data(), columns.size(), rowCount);
+	}
+
+	/**
+		Columns of a Tabular, read with EvaluateToColumns
+		@remarks The columns are views into the serialized bytes, which the object keeps; they are invalidated when it is
+	   filled again, cleared, or destroyed.
+	*/
+	class TabularColumns
+	{
+	public:
+		std::size_t ColumnCount() const noexcept
+		{
+			return columns.size();
+		}
+
+		mint RowCount() const noexcept
+		{
+			return rowCount;
+		}
+
+		const TabularColumnView& operator[](std::size_t index) const noexcept
+		{
+			return columns[index];
+		}
+
+		/**
+			Index of the column with the given name, or ColumnCount() if there is none
+		*/
+		std::size_t Find(std::string_view name) const noexcept
+		{
+			std::size_t index = 0;
+
+			while(index < columns.size() && columns[index].name != name)
+			{
+				++index;
+			}
+
+			return index;
+		}
+
+		/**
+			Decode column data in the WXF form produced by the kernel side of EvaluateToColumns
+			@remarks The bytes must outlive the object. Returns WLR_UNEXPECTED_TYPE, leaving the object empty, if they do
+		   not have that form or the columns differ in length.
+		*/
+		wlr_err_t Parse(std::string_view bytes)
+		{
+			Clear();
+
+			const wlr_err_t error = document.Parse(bytes);
+
+			return error == WLR_SUCCESS ? Index() : error;
+		}
+
+		/**
+			Take ownership of a serialized byte array expression and decode it, as Parse does
+		*/
+		wlr_err_t ParseByteArray(wlr_expr byteArrayExpression)
+		{
+			Clear();
+
+			const wlr_err_t error = document.ParseByteArray(byteArrayExpression);
+
+			return error == WLR_SUCCESS ? Index() : error;
+		}
+
+		void Clear() noexcept
+		{
+			document.Clear();
+			columns.clear();
+			storage.clear();
+			rowCount = 0;
+		}
+
+	private:
+		static bool IsList(WxfView view, std::size_t length) noexcept
+		{
+			return view.Kind() == WxfKind::Function && view.Length() == length && view.Head().IsSymbol("List");
+		}
+
+		static bool IsVector(WxfView view, WxfArrayType type) noexcept
+		{
+			return view.Kind() == WxfKind::PackedArray && view.Rank() == 1 && view.ArrayType() == type;
+		}
+
+		/**
+			True for a packed vector of any signed integer type, since BinarySerialize narrows packed integers
+		*/
+		static bool IsIntegerVector(WxfView view) noexcept
+		{
+			return view.Kind() == WxfKind::PackedArray && view.Rank() == 1 && view.ArrayType() <= WxfArrayType::Integer64;
+		}
+
+		/**
+			Elements of an integer vector as aligned mint, widened or copied into copy unless they are in place already
+		*/
+		static const mint* Integers(WxfView vector, std::vector<mint>& copy)
+		{
+			if(const mint* data = vector.ArrayData<mint>())
+			{
+				return data;
+			}
+
+			copy.resize(vector.Length());
+			vector.CopyArrayData(copy.data());
+
+			return copy.data();
+		}
+
+		wlr_err_t Fail() noexcept
+		{
+			Clear();
+
+			return WLR_UNEXPECTED_TYPE;
+		}
+
+		wlr_err_t Index()
+		{
+			const WxfView root = document.Root();
+
+			if(root.Kind() != WxfKind::Function || !root.Head().IsSymbol("List"))
+			{
+				return Fail();
+			}
+
+			columns.reserve(root.Length());
+			storage.resize(root.Length());
+
+			std::size_t slot = 0;
+
+			for(WxfView column : root)
+			{
+				if(!IsList(column, 4) || column.Part(1).Kind() != WxfKind::String ||
+				   column.Part(2).Kind() != WxfKind::Integer)
+				{
+					return Fail();
+				}
+
+				TabularColumnView view{column.Part(1).Text(), TabularColumnKind::Integer, WxfView(), nullptr,
+									   std::string_view(), nullptr, nullptr};
+
+				const std::int64_t kind = column.Part(2).Integer();
+				const WxfView values = column.Part(3);
+				mint rows = 0;
+
+				if(kind == 0 || kind == 1)
+				{
+					view.kind = kind == 0 ? TabularColumnKind::Integer : TabularColumnKind::Real;
+					view.values = values;
+
+					if(kind == 0 && IsIntegerVector(values))
+					{
+						view.integers = Integers(values, storage[slot].integers);
+						rows = static_cast<mint>(values.Length());
+					}
+					else if(kind == 1 && IsVector(values, WxfArrayType::Real64))
+					{
+						rows = static_cast<mint>(values.Length());
+					}
+					else if(!IsList(values, 0))
+					{
+						return Fail();
+					}
+				}
+				else if(kind == 2 && IsList(values, 2) && values.Part(1).Kind() == WxfKind::String &&
+						IsIntegerVector(values.Part(2)))
+				{
+					view.kind = TabularColumnKind::String;
+					view.stringData = values.Part(1).Text();
+					view.stringOffsets = Integers(values.Part(2), storage[slot].offsets);
+
+					rows = static_cast<mint>(values.Part(2).Length()) - 1;
+				}
+				else
+				{
+					return Fail();
+				}
+
+				if(!columns.empty() && rows != rowCount)
+				{
+					return Fail();
+				}
+
+				rowCount = rows;
+
+				const WxfView invalid = column.Part(4);
+
+				if(IsIntegerVector(invalid) && invalid.Length() > 0)
+				{
+					std::vector<std::uint8_t>& validity = storage[slot].validity;
+
+					validity.assign((static_cast<std::size_t>(rows) + 7) / 8, 0xFF);
+
+					const mint* positions = Integers(invalid, scratch);
+
+					for(std::size_t index = 0; index < invalid.Length(); ++index)
+					{
+						if(positions[index] < 1 || positions[index] > rows)
+						{
+							return Fail();
+						}
+
+						const std::size_t row = static_cast<std::size_t>(positions[index] - 1);
+
+						validity[row / 8] &= static_cast<std::uint8_t>(~(1u << (row % 8)));
+					}
+
+					view.validity = validity.data();
+				}
+				else if(!IsList(invalid, 0))
+				{
+					return Fail();
+				}
+
+				columns.push_back(view);
+				++slot;
+			}
+
+			return WLR_SUCCESS;
+		}
+
+		struct Storage
+		{
+			std::vector<mint> integers;
+			std::vector<mint> offsets;
+			std::vector<std::uint8_t> validity;
+		};
+
+		WxfDocument document;
+		std::vector<TabularColumnView> columns;
+		std::vector<Storage> storage;
+		std::vector<mint> scratch;
+		mint rowCount = 0;
+	};
+
+	/**
+		Evaluate input, which should give a Tabular, and read all of its columns into result
+		@remarks One wlr_Eval for the evaluation, the column extraction and the serialization together. Returns the error
+	   of the evaluation, or WLR_UNEXPECTED_TYPE if the result was not a Tabular. Intermediate expressions are left in
+	   the current pool.
+	*/
+	inline wlr_err_t EvaluateToColumns(wlr_expr input, TabularColumns& result)
+	{
+		return result.ParseByteArray(wlr_Eval(detail::SerializedBytesExpression(E(detail::FromTabularFunction(), input))));
+	}
+}
@@ -0,0 +1,304 @@
+/*
+	Bulk marshaling of numeric tensors
+
+	Building a List with one wlr_Real per element, or reading it back with one wlr_Part per element, costs one call into
+	the runtime per element. The functions in this file move a whole tensor with a fixed number of calls:
+
+		host -> expression
+			rank 1, mint or mreal           - wlr_ExpressionFromIntegerArray / wlr_ExpressionFromRealArray
+			any other shape or element type - an MNumericArray filled with one memcpy, wrapped with
+											  wlr_ExpressionFromNumericArray and Normal
+
+		expression -> host
+			NumericArray                    - wlr_NumericArrayData, then one copy (or host-side conversion)
+			packed vector                   - wlr_IntegerArrayData / wlr_RealArrayData, then one copy
+			anything else                   - one wlr_Eval of NumericArray[expression, type], which packs the data
+											  inside the kernel, then as for a NumericArray
+
+	Higher-rank and complex data always travel as an MNumericArray, since the packed array functions only describe flat
+	vectors of mint and mreal.
+*/
+
+#pragma once
+
+#include <atomic>
+
+#include "Expr.h"
+#include "ExpressionBuilder.h"
+#include "NumericArray.h"
+#include "NumericArrayConvert.h"
+#include "RuntimeBuffer.h"
+#include "Symbols.h"
+
+namespace wlr
+{
+	namespace detail
+	{
+		/**
+			The NumericArray type string for a numericarray_data_t, or nullptr if there is none
+		*/
+		constexpr const char* NumericArrayTypeName(numericarray_data_t type) noexcept
+		{
+			switch(type)
+			{
+				case MNumericArray_Type_Bit8:
+					return "Integer8";
+				case MNumericArray_Type_UBit8:
+					return "UnsignedInteger8";
+				case MNumericArray_Type_Bit16:
+					return "Integer16";
+				case MNumericArray_Type_UBit16:
+					return "UnsignedInteger16";
+				case MNumericArray_Type_Bit32:
+					return "Integer32";
+				case MNumericArray_Type_UBit32:
+					return "UnsignedInteger32";
+				case MNumericArray_Type_Bit64:
+					return "Integer64";
+				case MNumericArray_Type_UBit64:
+					return "UnsignedInteger64";
+				case MNumericArray_Type_Real16:
+					return "Real16";
+				case MNumericArray_Type_Real32:
+					return "Real32";
+				case MNumericArray_Type_Real64:
+					return "Real64";
+				case MNumericArray_Type_Complex_Real16:
+					return "ComplexReal16";
+				case MNumericArray_Type_Complex_Real32:
+					return "ComplexReal32";
+				case MNumericArray_Type_Complex_Real64:
+					return "ComplexReal64";
+				default:
+					return nullptr;
+			}
+		}
+
+		/**
+			Function that packs its first argument into a NumericArray of the type named by its second argument, or
+			returns $Failed
+			@remarks Parsed on first use and kept detached for the lifetime of the process, unless parsing fails, in
+		   which case the error is returned and the next call parses again.
+		*/
+		inline wlr_expr PackFunction()
+		{
+			static std::atomic<wlr_expr> function {nullptr};
+
+			return CachedExpression(function, [] {
+				return wlr_ParseExpression(
+					wlr_String("Function[{expression, type}, Quiet[Check[NumericArray[expression, type], $Failed]]]"));
+			});
+		}
+
+		/**
+			Copy or convert an MNumericArray owned by an expression into result
+		*/
+		inline wlr_err_t CopyNumericArray(MNumericArray source, numericarray_data_t type, NumericArray& result)
+		{
+			errcode_t error;
+
+			if(wlr_MNumericArray_getType(source) == type)
+			{
+				MNumericArray copy = nullptr;
+
+				error = wlr_MNumericArray_clone(source, &copy);
+				result = NumericArray::Adopt(copy);
+			}
+			else
+			{
+				error = ConvertType(result, source, type, MNumericArray_Convert_Check, 0.0);
+			}
+
+			switch(error)
+			{
+				case LIBRARY_NO_ERROR:
+					return WLR_SUCCESS;
+				case LIBRARY_MEMORY_ERROR:
+					return WLR_ALLOCATION_ERROR;
+				default:
+					return WLR_UNEXPECTED_TYPE;
+			}
+		}
+
+		/**
+			True if the packed array expression has rank 1
+		*/
+		inline bool IsPackedVector(wlr_expr expression)
+		{
+			return wlr_Length(expression) == 0 || wlr_ExpressionType(wlr_Part(expression, 1)) == WLR_NUMBER;
+		}
+
+		template <typename T>
+		wlr_err_t CopyPackedVector(wlr_expr expression, NumericArray& result)
+		{
+			RuntimeBuffer<T> buffer;
+
+			wlr_err_t error;
+
+			if constexpr(std::is_same<T, mint>::value)
+			{
+				error = wlr_IntegerArrayData(expression, buffer.OutLength(), buffer.OutData());
+			}
+			else
+			{
+				error = wlr_RealArrayData(expression, buffer.OutLength(), buffer.OutData());
+			}
+
+			if(error != WLR_SUCCESS)
+			{
+				return error;
+			}
+
+			const mint length = static_cast<mint>(buffer.Size());
+
+			return NumericArray::FromBuffer(buffer.Data(), 1, &length, result) == LIBRARY_NO_ERROR ? WLR_SUCCESS
+																								   : WLR_ALLOCATION_ERROR;
+		}
+	}
+
+	/**
+		Build the NumericArray expression for an MNumericArray
+		@remarks The expression does not take ownership of numericArray.
+	*/
+	inline wlr_expr TensorExpression(const NumericArray& numericArray)
+	{
+		return wlr_ExpressionFromNumericArray(numericArray.Get(), Symbol(SystemSymbol::NumericArray));
+	}
+
+	/**
+		Build a packed List with the given row-major dimensions from host data, with a constant number of calls
+		@remarks Rank-1 mint and mreal data is passed straight to wlr_ExpressionFromIntegerArray or
+	   wlr_ExpressionFromRealArray. Everything else is copied into a temporary MNumericArray and returned as the
+	   unevaluated expression Normal[NumericArray[...]], which becomes the packed array when it is evaluated. Returns a
+	   WLR_ALLOCATION_ERROR error expression if the temporary cannot be allocated.
+	*/
+	template <typename T>
+	wlr_expr TensorExpression(const T* data, const mint* dimensions, mint rank)
+	{
+		static_assert(NumericArrayType<T> != MNumericArray_Type_Undef,
+					  "wlr::TensorExpression: T is not a numeric array element type");
+
+		if constexpr(std::is_same<T, mint>::value)
+		{
+			if(rank == 1)
+			{
+				return wlr_ExpressionFromIntegerArray(dimensions[0], data, Symbol(SystemSymbol::List));
+			}
+		}
+		else if constexpr(std::is_same<T, mreal>::value)
+		{
+			if(rank == 1)
+			{
+				return wlr_ExpressionFromRealArray(dimensions[0], data, Symbol(SystemSymbol::List));
+			}
+		}
+
+		NumericArray numericArray;
+
+		if(NumericArray::FromBuffer(data, rank, dimensions, numericArray) != LIBRARY_NO_ERROR)
+		{
+			return wlr_Error(WLR_ALLOCATION_ERROR);
+		}
+
+		return E(Symbol(SystemSymbol::Normal), TensorExpression(numericArray));
+	}
+
+	/**
+		Build a packed List from a view; a strided view is packed into a temporary MNumericArray first
+	*/
+	template <typename T, std::size_t Rank>
+	wlr_expr TensorExpression(const NumericArrayView<T, Rank>& view)
+	{
+		using Element = std::remove_const_t<T>;
+
+		if(view.Contiguous())
+		{
+			return TensorExpression<Element>(view.Data(), view.Dimensions(), view.RankOf());
+		}
+
+		NumericArray numericArray;
+
+		if(NumericArray::Create(NumericArrayType<Element>, view.RankOf(), view.Dimensions(), numericArray) !=
+		   LIBRARY_NO_ERROR)
+		{
+			return wlr_Error(WLR_ALLOCATION_ERROR);
+		}
+
+		view.CopyTo(static_cast<Element*>(wlr_MNumericArray_getData(numericArray.Get())));
+
+		return E(Symbol(SystemSymbol::Normal), TensorExpression(numericArray));
+	}
+
+	/**
+		Read a numeric tensor of any rank into a host-owned MNumericArray with the given element type
+		@remarks NumericArray expressions are copied once (and converted on the host if their element type differs).
+	   Packed vectors are read with wlr_IntegerArrayData or wlr_RealArrayData when the element type is mint or mreal.
+	   Any other expression, including unpacked lists, is packed inside the kernel by a single wlr_Eval. The call count
+	   does not depend on the number of elements.
+		@remarks Returns WLR_UNEXPECTED_TYPE if the expression is not a rectangular array of numbers that fit type.
+	   Intermediate expressions are left in the current expression pool.
+	*/
+	inline wlr_err_t TensorData(wlr_expr expression, numericarray_data_t type, NumericArray& result)
+	{
+		result.Reset();
+
+		const char* typeName = detail::NumericArrayTypeName(type);
+
+		if(typeName == nullptr)
+		{
+			return WLR_UNEXPECTED_TYPE;
+		}
+
+		const wlr_expr_t expressionType = wlr_ExpressionType(expression);
+
+		if(expressionType == WLR_PACKED_ARRAY && (type == NumericArrayType<mint> || type == NumericArrayType<mreal>) &&
+		   detail::IsPackedVector(expression))
+		{
+			const wlr_err_t error = type == NumericArrayType<mint> ? detail::CopyPackedVector<mint>(expression, result)
+																   : detail::CopyPackedVector<mreal>(expression, result);
+
+			// A packed vector of the other element type falls through to the kernel
+			if(error == WLR_SUCCESS)
+			{
+				return error;
+			}
+		}
+
+		wlr_expr numericArrayExpression = expression;
+
+		if(expressionType != WLR_NUMERIC_ARRAY)
+		{
+			numericArrayExpression = wlr_Eval(E(detail::PackFunction(), expression, wlr_String(typeName)));
+
+			if(wlr_ErrorQ(numericArrayExpression))
+			{
+				return wlr_ErrorType(numericArrayExpression);
+			}
+
+			if(wlr_ExpressionType(numericArrayExpression) != WLR_NUMERIC_ARRAY)
+			{
+				return WLR_UNEXPECTED_TYPE;
+			}
+		}
+
+		MNumericArray numericArray = nullptr;
+
+		const wlr_err_t error = wlr_NumericArrayData(numericArrayExpression, &numericArray);
+
+		if(error != WLR_SUCCESS)
+		{
+			return error;
+		}
+
+		return detail::CopyNumericArray(numericArray, type, result);
+	}
+
+	template <typename T>
+	wlr_err_t TensorData(wlr_expr expression, NumericArray& result)
+	{
+		static_assert(NumericArrayType<T> != MNumericArray_Type_Undef,
+					  "wlr::TensorData: T is not a numeric array element type");
+
+		return TensorData(expression, NumericArrayType<T>, result);
+	}
+}
@@ -0,0 +1,534 @@
+/*
+	Phase-level latency tracing
+
+	WLR_TRACE_SPAN("name") records the time from that statement to the end of the enclosing scope. WLR_TRACED("name",
+	expression) records the time taken to evaluate one expression and yields its value. Both compile to nothing unless
+	WLR_ENABLE_TRACING is defined.
+
+	When tracing is enabled, each span costs two timestamp reads (the TSC on x86-64, the virtual counter on AArch64) and
+	three relaxed stores into a ring buffer owned by the recording thread. Rings are written without locks and hold the
+	most recent WLR_TRACE_RING_CAPACITY spans of each thread; older spans are overwritten.
+
+	The recorded spans can be collected at any time from any thread and written as Chrome trace-event JSON (load it in
+	chrome://tracing or https://ui.perfetto.dev), written in a compact binary format, or summarized as per-phase
+	percentiles.
+
+	Binary format (little-endian):
+
+		char[8]   "WLRTRACE"
+		uint32    version (1)
+		uint32    name count
+		uint64    span count
+		per name: uint32 byte length, UTF-8 bytes
+		per span: uint32 name index, uint32 thread index, uint64 start (ns since the trace origin), uint64 duration (ns)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#ifndef WLR_TRACE_RING_CAPACITY
+#define WLR_TRACE_RING_CAPACITY 16384
+#endif
+
+namespace wlr
+{
+	namespace tracing
+	{
+		/**
+			Raw timestamp in clock ticks
+		*/
+		inline std::uint64_t Timestamp() noexcept
+		{
+#if defined(__x86_64__) || defined(_M_X64)
+			return __rdtsc();
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+			std::uint64_t ticks;
+			asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+			return ticks;
+#else
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+												  std::chrono::steady_clock::now().time_since_epoch())
+												  .count());
+#endif
+		}
+
+		namespace detail
+		{
+			/**
+				Pairs a tick count with a steady_clock reading so that ticks can be converted to nanoseconds
+			*/
+			struct ClockOrigin
+			{
+				std::uint64_t ticks = Timestamp();
+				std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+			};
+
+			inline const ClockOrigin& Origin() noexcept
+			{
+				static const ClockOrigin origin;
+
+				return origin;
+			}
+
+			/**
+				Nanoseconds per tick, measured against steady_clock since the origin
+				@remarks If less than 10 ms have passed since the origin, waits until they have.
+			*/
+			inline double NanosecondsPerTick()
+			{
+				const ClockOrigin& origin = Origin();
+
+				auto elapsed = std::chrono::steady_clock::now() - origin.time;
+
+				if(elapsed < std::chrono::milliseconds(10))
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(10) - elapsed);
+				}
+
+				const std::uint64_t ticks = Timestamp();
+
+				elapsed = std::chrono::steady_clock::now() - origin.time;
+
+				const double nanoseconds =
+					static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+				return ticks > origin.ticks ? nanoseconds / static_cast<double>(ticks - origin.ticks) : 1.0;
+			}
+
+			/**
+				Single-writer ring of spans
+				@remarks Only the owning thread writes. Readers copy the ring, then discard the slots the writer may have
+			   overwritten while they were copying. Every field is a relaxed atomic, so concurrent reads are well defined.
+			*/
+			class TraceRing
+			{
+			public:
+				static constexpr std::size_t Capacity = WLR_TRACE_RING_CAPACITY;
+
+				static_assert((Capacity & (Capacity - 1)) == 0, "WLR_TRACE_RING_CAPACITY must be a power of two");
+
+				explicit TraceRing(std::uint32_t threadIndex) : threadIndex(threadIndex), slots(new Slot[Capacity])
+				{
+				}
+
+				void Push(const char* name, std::uint64_t start, std::uint64_t end) noexcept
+				{
+					const std::uint64_t position = head.load(std::memory_order_relaxed);
+
+					Slot& slot = slots[position & (Capacity - 1)];
+
+					// A reader that sees any of the stores below also sees head at least at position
+					std::atomic_thread_fence(std::memory_order_release);
+
+					slot.name.store(name, std::memory_order_relaxed);
+					slot.start.store(start, std::memory_order_relaxed);
+					slot.end.store(end, std::memory_order_relaxed);
+
+					head.store(position + 1, std::memory_order_release);
+				}
+
+				template <typename Visitor>
+				void Visit(Visitor&& visitor) const
+				{
+					const std::uint64_t end = head.load(std::memory_order_acquire);
+					const std::uint64_t begin = end > Capacity ? end - Capacity : 0;
+
+					std::vector<std::pair<std::uint64_t, Span>> copied;
+
+					copied.reserve(static_cast<std::size_t>(end - begin));
+
+					for(std::uint64_t position = begin; position < end; ++position)
+					{
+						const Slot& slot = slots[position & (Capacity - 1)];
+
+						copied.emplace_back(position, Span {slot.name.load(std::memory_order_relaxed),
+															slot.start.load(std::memory_order_relaxed),
+															slot.end.load(std::memory_order_relaxed)});
+					}
+
+					std::atomic_thread_fence(std::memory_order_acquire);
+
+					// Slots below this position may have been overwritten during the copy; the slot of position current
+					// itself may be half written by a Push in progress, and it holds position current - Capacity
+					const std::uint64_t current = head.load(std::memory_order_relaxed);
+					const std::uint64_t firstIntact = current >= Capacity ? current - Capacity + 1 : 0;
+
+					for(const auto& entry : copied)
+					{
+						if(entry.first >= firstIntact)
+						{
+							visitor(entry.second);
+						}
+					}
+				}
+
+				void Clear() noexcept
+				{
+					head.store(0, std::memory_order_relaxed);
+				}
+
+				const std::uint32_t threadIndex;
+
+				struct Span
+				{
+					const char* name;
+					std::uint64_t start;
+					std::uint64_t end;
+				};
+
+			private:
+				struct Slot
+				{
+					std::atomic<const char*> name {nullptr};
+					std::atomic<std::uint64_t> start {0};
+					std::atomic<std::uint64_t> end {0};
+				};
+
+				std::atomic<std::uint64_t> head {0};
+				std::unique_ptr<Slot[]> slots;
+			};
+
+			struct RingRegistry
+			{
+				std::mutex mutex;
+				std::vector<std::shared_ptr<TraceRing>> rings;
+			};
+
+			/**
+				Every ring ever created; deliberately never destroyed so that spans of exited threads stay available
+			*/
+			inline RingRegistry& Rings()
+			{
+				static RingRegistry* const registry = new RingRegistry();
+
+				return *registry;
+			}
+
+			inline TraceRing& ThreadRing()
+			{
+				thread_local TraceRing* const ring = [] {
+					Origin();
+
+					RingRegistry& registry = Rings();
+
+					std::lock_guard<std::mutex> lock(registry.mutex);
+
+					registry.rings.push_back(std::make_shared<TraceRing>(static_cast<std::uint32_t>(registry.rings.size())));
+
+					return registry.rings.back().get();
+				}();
+
+				return *ring;
+			}
+		}
+
+		/**
+			Records the lifetime of a scope; use through WLR_TRACE_SPAN
+			@remarks name must point to a string that lives for the whole process, such as a literal.
+		*/
+		class ScopedSpan
+		{
+		public:
+			explicit ScopedSpan(const char* name) noexcept : name(name), start(Timestamp())
+			{
+			}
+
+			ScopedSpan(const ScopedSpan&) = delete;
+			ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+			~ScopedSpan()
+			{
+				detail::ThreadRing().Push(name, start, Timestamp());
+			}
+
+		private:
+			const char* name;
+			std::uint64_t start;
+		};
+
+		/**
+			A collected span, in nanoseconds since the trace origin
+		*/
+		struct SpanRecord
+		{
+			const char* name;
+			std::uint32_t threadIndex;
+			std::uint64_t startNanoseconds;
+			std::uint64_t durationNanoseconds;
+		};
+
+		/**
+			Copy the spans currently held by every thread's ring, ordered by start time
+			@remarks Safe to call from any thread while other threads keep recording.
+		*/
+		inline std::vector<SpanRecord> Collect()
+		{
+			const double nanosecondsPerTick = detail::NanosecondsPerTick();
+			const std::uint64_t originTicks = detail::Origin().ticks;
+
+			std::vector<std::shared_ptr<detail::TraceRing>> rings;
+
+			{
+				detail::RingRegistry& registry = detail::Rings();
+
+				std::lock_guard<std::mutex> lock(registry.mutex);
+
+				rings = registry.rings;
+			}
+
+			std::vector<SpanRecord> records;
+
+			for(const auto& ring : rings)
+			{
+				ring->Visit([&](const detail::TraceRing::Span& span) {
+					if(span.name == nullptr || span.end < span.start || span.start < originTicks)
+					{
+						return;
+					}
+
+					records.push_back(SpanRecord {
+						span.name, ring->threadIndex,
+						static_cast<std::uint64_t>(static_cast<double>(span.start - originTicks) * nanosecondsPerTick),
+						static_cast<std::uint64_t>(static_cast<double>(span.end - span.start) * nanosecondsPerTick)});
+				});
+			}
+
+			std::sort(records.begin(), records.end(), [](const SpanRecord& first, const SpanRecord& second) {
+				return first.startNanoseconds < second.startNanoseconds;
+			});
+
+			return records;
+		}
+
+		/**
+			Forget every recorded span
+			@remarks Spans being recorded concurrently may survive.
+		*/
+		inline void Clear()
+		{
+			detail::RingRegistry& registry = detail::Rings();
+
+			std::lock_guard<std::mutex> lock(registry.mutex);
+
+			for(const auto& ring : registry.rings)
+			{
+				ring->Clear();
+			}
+		}
+
+		/**
+			Write spans as Chrome trace-event JSON ("X" complete events, timestamps in microseconds)
+		*/
+		inline void WriteChromeTrace(std::FILE* stream, const std::vector<SpanRecord>& records)
+		{
+			std::fputs("{\"traceEvents\":[", stream);
+
+			bool first = true;
+
+			for(const SpanRecord& record : records)
+			{
+				std::fputs(first ? "\n{\"name\":\"" : ",\n{\"name\":\"", stream);
+
+				for(const char* character = record.name; *character != '\0'; ++character)
+				{
+					if(*character == '"' || *character == '\\')
+					{
+						std::fputc('\\', stream);
+					}
+
+					std::fputc(*character, stream);
+				}
+
+				std::fprintf(stream, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", record.threadIndex,
+							 static_cast<double>(record.startNanoseconds) / 1000.0,
+							 static_cast<double>(record.durationNanoseconds) / 1000.0);
+
+				first = false;
+			}
+
+			std::fputs("\n],\"displayTimeUnit\":\"ns\"}\n", stream);
+		}
+
+		inline void WriteChromeTrace(std::FILE* stream)
+		{
+			WriteChromeTrace(stream, Collect());
+		}
+
+		/**
+			Write spans in the binary format described at the top of this file
+		*/
+		inline void WriteBinaryTrace(std::FILE* stream, const std::vector<SpanRecord>& records)
+		{
+			std::vector<std::string_view> names;
+			std::unordered_map<std::string_view, std::uint32_t> nameIndices;
+			std::vector<std::uint32_t> spanNames;
+
+			spanNames.reserve(records.size());
+
+			for(const SpanRecord& record : records)
+			{
+				auto inserted = nameIndices.emplace(record.name, static_cast<std::uint32_t>(names.size()));
+
+				if(inserted.second)
+				{
+					names.push_back(record.name);
+				}
+
+				spanNames.push_back(inserted.first->second);
+			}
+
+			const std::uint32_t version = 1;
+			const std::uint32_t nameCount = static_cast<std::uint32_t>(names.size());
+			const std::uint64_t spanCount = records.size();
+
+			std::fwrite("WLRTRACE", 1, 8, stream);
+			std::fwrite(&version, sizeof(version), 1, stream);
+			std::fwrite(&nameCount, sizeof(nameCount), 1, stream);
+			std::fwrite(&spanCount, sizeof(spanCount), 1, stream);
+
+			for(std::string_view name : names)
+			{
+				const std::uint32_t length = static_cast<std::uint32_t>(name.size());
+
+				std::fwrite(&length, sizeof(length), 1, stream);
+				std::fwrite(name.data(), 1, name.size(), stream);
+			}
+
+			for(std::size_t index = 0; index < records.size(); ++index)
+			{
+				const SpanRecord& record = records[index];
+
+				std::fwrite(&spanNames[index], sizeof(std::uint32_t), 1, stream);
+				std::fwrite(&record.threadIndex, sizeof(record.threadIndex), 1, stream);
+				std::fwrite(&record.startNanoseconds, sizeof(record.startNanoseconds), 1, stream);
+				std::fwrite(&record.durationNanoseconds, sizeof(record.durationNanoseconds), 1, stream);
+			}
+		}
+
+		inline void WriteBinaryTrace(std::FILE* stream)
+		{
+			WriteBinaryTrace(stream, Collect());
+		}
+
+		/**
+			Latency percentiles of one phase
+		*/
+		struct PhaseSummary
+		{
+			std::string name;
+			std::size_t count;
+			std::uint64_t p50Nanoseconds;
+			std::uint64_t p99Nanoseconds;
+			std::uint64_t maximumNanoseconds;
+			std::uint64_t totalNanoseconds;
+		};
+
+		/**
+			Per-phase percentiles over the given spans, largest total time first
+		*/
+		inline std::vector<PhaseSummary> Summarize(const std::vector<SpanRecord>& records)
+		{
+			std::unordered_map<std::string_view, std::vector<std::uint64_t>> durations;
+
+			for(const SpanRecord& record : records)
+			{
+				durations[record.name].push_back(record.durationNanoseconds);
+			}
+
+			std::vector<PhaseSummary> summaries;
+
+			summaries.reserve(durations.size());
+
+			for(auto& phase : durations)
+			{
+				std::vector<std::uint64_t>& values = phase.second;
+
+				std::sort(values.begin(), values.end());
+
+				auto percentile = [&values](double fraction) {
+					return values[std::min(values.size() - 1, static_cast<std::size_t>(fraction * static_cast<double>(values.size())))];
+				};
+
+				std::uint64_t total = 0;
+
+				for(std::uint64_t value : values)
+				{
+					total += value;
+				}
+
+				summaries.push_back(
+					PhaseSummary {std::string(phase.first), values.size(), percentile(0.50), percentile(0.99), values.back(), total});
+			}
+
+			std::sort(summaries.begin(), summaries.end(), [](const PhaseSummary& first, const PhaseSummary& second) {
+				return first.totalNanoseconds > second.totalNanoseconds;
+			});
+
+			return summaries;
+		}
+
+		inline std::vector<PhaseSummary> Summarize()
+		{
+			return Summarize(Collect());
+		}
+
+		/**
+			Print one line per phase
+		*/
+		inline void WriteSummary(std::FILE* stream, const std::vector<PhaseSummary>& summaries)
+		{
+			for(const PhaseSummary& summary : summaries)
+			{
+				std::fprintf(stream, "%-32s %10zu spans  p50 %12.3f us  p99 %12.3f us  max %12.3f us  total %12.3f ms\n",
+							 summary.name.c_str(), summary.count, static_cast<double>(summary.p50Nanoseconds) / 1e3,
+							 static_cast<double>(summary.p99Nanoseconds) / 1e3,
+							 static_cast<double>(summary.maximumNanoseconds) / 1e3,
+							 static_cast<double>(summary.totalNanoseconds) / 1e6);
+			}
+		}
+
+		namespace detail
+		{
+			template <typename Expression>
+			decltype(auto) Traced(const char* name, Expression&& expression)
+			{
+				ScopedSpan span(name);
+
+				return expression();
+			}
+		}
+	}
+}
+
+#define WLR_TRACE_CONCATENATE_INNER(first, second) first##second
+#define WLR_TRACE_CONCATENATE(first, second) WLR_TRACE_CONCATENATE_INNER(first, second)
+
+#if defined(WLR_ENABLE_TRACING)
+#define WLR_TRACE_SPAN(name) ::wlr::tracing::ScopedSpan WLR_TRACE_CONCATENATE(wlrTraceSpan, __LINE__)(name)
+#define WLR_TRACED(name, expression) ::wlr::tracing::detail::Traced(name, [&]() -> decltype(auto) { return expression; })
+#else
+#define WLR_TRACE_SPAN(name) static_cast<void>(0)
+#define WLR_TRACED(name, expression) (expression)
+#endif
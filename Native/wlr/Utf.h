@@ -0,0 +1,1108 @@
+/*
+	Validating UTF-8 <-> UTF-16 transcoding for host string marshaling
+
+	The SDK's string functions (wlr_String, wlr_StringFromData, wlr_StringData) take and return UTF-8, while .NET and
+	Windows front ends hold UTF-16. The functions in this file validate and convert in a single pass, straight into
+	caller buffers or into the UTF-8 buffer passed to wlr_StringFromData, so no separate validation pass or intermediate
+	copy is needed.
+
+	Runs of ASCII, which make up most expression text and OutputForm results, are converted 16, 32 or 64 characters at a
+	time by SSE4.1, AVX2 or AVX-512 kernels chosen at run time (NEON on AArch64). Other characters are decoded by the
+	scalar code in the same pass, and the vector loop resumes at the next ASCII character.
+
+	Input is rejected with WLR_MALFORMED, rather than repaired with replacement characters: UTF-8 with overlong encodings,
+	surrogate code points, code points above U+10FFFF, stray continuation bytes or truncated sequences, and UTF-16 with
+	unpaired surrogates.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Simd.h"
+#include "Strings.h"
+#include "Symbols.h"
+
+namespace wlr
+{
+	/**
+		Outcome of a transcoding or validation call
+		@remarks On WLR_SUCCESS, read is the input length. On WLR_MALFORMED, read is the offset of the first invalid
+	   sequence; on WLR_OUT_OF_BOUNDS, it is the offset of the first character that did not fit. written is the number
+	   of output units written before that point.
+	*/
+	struct TranscodeResult
+	{
+		wlr_err_t error;
+		std::size_t read;
+		std::size_t written;
+	};
+
+	/**
+		Capacity in UTF-16 code units that is always enough for utf8Length bytes of UTF-8
+	*/
+	constexpr std::size_t MaximumUtf16Length(std::size_t utf8Length) noexcept
+	{
+		return utf8Length;
+	}
+
+	/**
+		Capacity in bytes that is always enough for utf16Length code units of UTF-16
+	*/
+	constexpr std::size_t MaximumUtf8Length(std::size_t utf16Length) noexcept
+	{
+		return 3 * utf16Length;
+	}
+
+	namespace detail
+	{
+		namespace utf
+		{
+			struct Cursor
+			{
+				std::size_t read;
+				std::size_t written;
+			};
+
+			inline unsigned CountTrailingZeros(std::uint64_t value) noexcept
+			{
+#if defined(_MSC_VER) && !defined(__clang__)
+				unsigned long index;
+				_BitScanForward64(&index, value);
+				return static_cast<unsigned>(index);
+#else
+				return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+			}
+
+			/**
+				Decode the UTF-8 character at the start of source
+				@remarks Returns its length in bytes, or 0 if it is malformed or truncated.
+			*/
+			WLR_FORCE_INLINE std::size_t DecodeUtf8(const unsigned char* source, std::size_t remaining,
+													std::uint32_t& codePoint) noexcept
+			{
+				const std::uint32_t lead = source[0];
+
+				if(lead < 0x80)
+				{
+					codePoint = lead;
+					return 1;
+				}
+
+				// 0x80-0xBF are continuation bytes, and 0xC0 and 0xC1 only start overlong encodings
+				if(lead < 0xC2 || lead > 0xF4)
+				{
+					return 0;
+				}
+
+				if(lead < 0xE0)
+				{
+					if(remaining < 2 || (source[1] & 0xC0) != 0x80)
+					{
+						return 0;
+					}
+
+					codePoint = ((lead & 0x1F) << 6) | (source[1] & 0x3F);
+					return 2;
+				}
+
+				// The second byte's range excludes overlong encodings, surrogates and code points above U+10FFFF
+				const std::uint32_t second = remaining < 2 ? 0 : source[1];
+				const std::uint32_t lower = lead == 0xE0 ? 0xA0 : lead == 0xF0 ? 0x90 : 0x80;
+				const std::uint32_t upper = lead == 0xED ? 0x9F : lead == 0xF4 ? 0x8F : 0xBF;
+
+				if(second < lower || second > upper)
+				{
+					return 0;
+				}
+
+				if(lead < 0xF0)
+				{
+					if(remaining < 3 || (source[2] & 0xC0) != 0x80)
+					{
+						return 0;
+					}
+
+					codePoint = ((lead & 0x0F) << 12) | ((second & 0x3F) << 6) | (source[2] & 0x3F);
+					return 3;
+				}
+
+				if(remaining < 4 || (source[2] & 0xC0) != 0x80 || (source[3] & 0xC0) != 0x80)
+				{
+					return 0;
+				}
+
+				codePoint = ((lead & 0x07) << 18) | ((second & 0x3F) << 12) | ((source[2] & 0x3F) << 6) | (source[3] & 0x3F);
+				return 4;
+			}
+
+			/**
+				Validate whole characters from cursor.read until at least limit
+			*/
+			WLR_FORCE_INLINE wlr_err_t ValidateUtf8Run(const unsigned char* source, std::size_t length, Cursor& cursor,
+													   std::size_t limit) noexcept
+			{
+				while(cursor.read < limit)
+				{
+					std::uint32_t codePoint;
+					const std::size_t size = DecodeUtf8(source + cursor.read, length - cursor.read, codePoint);
+
+					if(size == 0)
+					{
+						return WLR_MALFORMED;
+					}
+
+					cursor.read += size;
+				}
+
+				return WLR_SUCCESS;
+			}
+
+			/**
+				Transcode whole characters from cursor.read until at least limit
+			*/
+			WLR_FORCE_INLINE wlr_err_t Utf8ToUtf16Run(const unsigned char* source, std::size_t length,
+													  char16_t* destination, std::size_t capacity, Cursor& cursor,
+													  std::size_t limit) noexcept
+			{
+				while(cursor.read < limit)
+				{
+					std::uint32_t codePoint;
+					const std::size_t size = DecodeUtf8(source + cursor.read, length - cursor.read, codePoint);
+
+					if(size == 0)
+					{
+						return WLR_MALFORMED;
+					}
+
+					if(codePoint < 0x10000)
+					{
+						if(cursor.written == capacity)
+						{
+							return WLR_OUT_OF_BOUNDS;
+						}
+
+						destination[cursor.written++] = static_cast<char16_t>(codePoint);
+					}
+					else
+					{
+						if(capacity - cursor.written < 2)
+						{
+							return WLR_OUT_OF_BOUNDS;
+						}
+
+						codePoint -= 0x10000;
+						destination[cursor.written++] = static_cast<char16_t>(0xD800 + (codePoint >> 10));
+						destination[cursor.written++] = static_cast<char16_t>(0xDC00 + (codePoint & 0x3FF));
+					}
+
+					cursor.read += size;
+				}
+
+				return WLR_SUCCESS;
+			}
+
+			/**
+				Transcode whole characters from cursor.read until at least limit
+			*/
+			WLR_FORCE_INLINE wlr_err_t Utf16ToUtf8Run(const char16_t* source, std::size_t length,
+													  unsigned char* destination, std::size_t capacity, Cursor& cursor,
+													  std::size_t limit) noexcept
+			{
+				while(cursor.read < limit)
+				{
+					std::uint32_t codePoint = source[cursor.read];
+					std::size_t units = 1;
+
+					if(codePoint >= 0xD800 && codePoint <= 0xDFFF)
+					{
+						if(codePoint >= 0xDC00 || cursor.read + 1 == length || source[cursor.read + 1] < 0xDC00 ||
+						   source[cursor.read + 1] > 0xDFFF)
+						{
+							return WLR_MALFORMED;
+						}
+
+						codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (source[cursor.read + 1] - 0xDC00);
+						units = 2;
+					}
+
+					const std::size_t size = codePoint < 0x80 ? 1 : codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+
+					if(capacity - cursor.written < size)
+					{
+						return WLR_OUT_OF_BOUNDS;
+					}
+
+					unsigned char* output = destination + cursor.written;
+
+					switch(size)
+					{
+						case 1:
+							output[0] = static_cast<unsigned char>(codePoint);
+							break;
+						case 2:
+							output[0] = static_cast<unsigned char>(0xC0 | (codePoint >> 6));
+							output[1] = static_cast<unsigned char>(0x80 | (codePoint & 0x3F));
+							break;
+						case 3:
+							output[0] = static_cast<unsigned char>(0xE0 | (codePoint >> 12));
+							output[1] = static_cast<unsigned char>(0x80 | ((codePoint >> 6) & 0x3F));
+							output[2] = static_cast<unsigned char>(0x80 | (codePoint & 0x3F));
+							break;
+						default:
+							output[0] = static_cast<unsigned char>(0xF0 | (codePoint >> 18));
+							output[1] = static_cast<unsigned char>(0x80 | ((codePoint >> 12) & 0x3F));
+							output[2] = static_cast<unsigned char>(0x80 | ((codePoint >> 6) & 0x3F));
+							output[3] = static_cast<unsigned char>(0x80 | (codePoint & 0x3F));
+							break;
+					}
+
+					cursor.read += units;
+					cursor.written += size;
+				}
+
+				return WLR_SUCCESS;
+			}
+
+			/*
+				Scalar handling of a run of non-ASCII characters found by a vector kernel: decode characters until the
+				next ASCII one, where the vector loop resumes
+			*/
+
+			WLR_FORCE_INLINE wlr_err_t ValidateUtf8NonAscii(const unsigned char* source, std::size_t length,
+															Cursor& cursor) noexcept
+			{
+				wlr_err_t error;
+
+				do
+				{
+					error = ValidateUtf8Run(source, length, cursor, cursor.read + 1);
+				} while(error == WLR_SUCCESS && cursor.read < length && source[cursor.read] >= 0x80);
+
+				return error;
+			}
+
+			WLR_FORCE_INLINE wlr_err_t Utf8ToUtf16NonAscii(const unsigned char* source, std::size_t length,
+														   char16_t* destination, std::size_t capacity,
+														   Cursor& cursor) noexcept
+			{
+				wlr_err_t error;
+
+				do
+				{
+					error = Utf8ToUtf16Run(source, length, destination, capacity, cursor, cursor.read + 1);
+				} while(error == WLR_SUCCESS && cursor.read < length && source[cursor.read] >= 0x80);
+
+				return error;
+			}
+
+			WLR_FORCE_INLINE wlr_err_t Utf16ToUtf8NonAscii(const char16_t* source, std::size_t length,
+														   unsigned char* destination, std::size_t capacity,
+														   Cursor& cursor) noexcept
+			{
+				wlr_err_t error;
+
+				do
+				{
+					error = Utf16ToUtf8Run(source, length, destination, capacity, cursor, cursor.read + 1);
+				} while(error == WLR_SUCCESS && cursor.read < length && source[cursor.read] >= 0x80);
+
+				return error;
+			}
+
+			inline TranscodeResult Finish(wlr_err_t error, const Cursor& cursor) noexcept
+			{
+				return TranscodeResult {error, cursor.read, cursor.written};
+			}
+
+			/* Scalar kernels */
+
+			inline TranscodeResult ValidateUtf8Scalar(const unsigned char* source, std::size_t length) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				return Finish(ValidateUtf8Run(source, length, cursor, length), cursor);
+			}
+
+			inline TranscodeResult Utf8ToUtf16Scalar(const unsigned char* source, std::size_t length,
+													 char16_t* destination, std::size_t capacity) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				return Finish(Utf8ToUtf16Run(source, length, destination, capacity, cursor, length), cursor);
+			}
+
+			inline TranscodeResult Utf16ToUtf8Scalar(const char16_t* source, std::size_t length,
+													 unsigned char* destination, std::size_t capacity) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				return Finish(Utf16ToUtf8Run(source, length, destination, capacity, cursor, length), cursor);
+			}
+
+			/*
+				Vector kernels
+
+				Each iteration loads one block at the current position, which need not be aligned. If the block is all
+				ASCII, it is converted with vector instructions. Otherwise the ASCII prefix is kept from the vector
+				conversion (the rest of the block's output is overwritten later), and the scalar code converts the run of
+				non-ASCII characters that follows. Blocks are only converted with vector instructions while the whole
+				block's output fits, so the stores never go past capacity.
+			*/
+
+#if defined(WLR_SIMD_X86)
+			WLR_TARGET_SSE41 inline TranscodeResult ValidateUtf8Sse41(const unsigned char* source,
+																	  std::size_t length) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 16)
+				{
+					const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + cursor.read));
+					const unsigned nonAscii = static_cast<unsigned>(_mm_movemask_epi8(bytes));
+
+					if(nonAscii == 0)
+					{
+						cursor.read += 16;
+						continue;
+					}
+
+					cursor.read += CountTrailingZeros(nonAscii);
+
+					if(ValidateUtf8NonAscii(source, length, cursor) != WLR_SUCCESS)
+					{
+						return Finish(WLR_MALFORMED, cursor);
+					}
+				}
+
+				return Finish(ValidateUtf8Run(source, length, cursor, length), cursor);
+			}
+
+			WLR_TARGET_SSE41 inline TranscodeResult Utf8ToUtf16Sse41(const unsigned char* source, std::size_t length,
+																	 char16_t* destination, std::size_t capacity) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 16 && capacity - cursor.written >= 16)
+				{
+					const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + cursor.read));
+					__m128i* output = reinterpret_cast<__m128i*>(destination + cursor.written);
+
+					_mm_storeu_si128(output, _mm_cvtepu8_epi16(bytes));
+					_mm_storeu_si128(output + 1, _mm_cvtepu8_epi16(_mm_srli_si128(bytes, 8)));
+
+					const unsigned nonAscii = static_cast<unsigned>(_mm_movemask_epi8(bytes));
+
+					if(nonAscii == 0)
+					{
+						cursor.read += 16;
+						cursor.written += 16;
+						continue;
+					}
+
+					const unsigned prefix = CountTrailingZeros(nonAscii);
+
+					cursor.read += prefix;
+					cursor.written += prefix;
+
+					const wlr_err_t error = Utf8ToUtf16NonAscii(source, length, destination, capacity, cursor);
+
+					if(error != WLR_SUCCESS)
+					{
+						return Finish(error, cursor);
+					}
+				}
+
+				return Finish(Utf8ToUtf16Run(source, length, destination, capacity, cursor, length), cursor);
+			}
+
+			WLR_TARGET_SSE41 inline TranscodeResult Utf16ToUtf8Sse41(const char16_t* source, std::size_t length,
+																	 unsigned char* destination, std::size_t capacity) noexcept
+			{
+				const __m128i asciiMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 16 && capacity - cursor.written >= 16)
+				{
+					const __m128i* input = reinterpret_cast<const __m128i*>(source + cursor.read);
+					const __m128i low = _mm_loadu_si128(input);
+					const __m128i high = _mm_loadu_si128(input + 1);
+
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + cursor.written), _mm_packus_epi16(low, high));
+
+					if(_mm_testz_si128(_mm_or_si128(low, high), asciiMask))
+					{
+						cursor.read += 16;
+						cursor.written += 16;
+						continue;
+					}
+
+					// One bit per unit, set for units that are not ASCII
+					const __m128i ascii = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(low, asciiMask), _mm_setzero_si128()),
+														  _mm_cmpeq_epi16(_mm_and_si128(high, asciiMask), _mm_setzero_si128()));
+					const unsigned nonAscii = ~static_cast<unsigned>(_mm_movemask_epi8(ascii)) & 0xFFFFu;
+
+					const unsigned prefix = CountTrailingZeros(nonAscii);
+
+					cursor.read += prefix;
+					cursor.written += prefix;
+
+					const wlr_err_t error = Utf16ToUtf8NonAscii(source, length, destination, capacity, cursor);
+
+					if(error != WLR_SUCCESS)
+					{
+						return Finish(error, cursor);
+					}
+				}
+
+				return Finish(Utf16ToUtf8Run(source, length, destination, capacity, cursor, length), cursor);
+			}
+
+			WLR_TARGET_AVX2 inline TranscodeResult ValidateUtf8Avx2(const unsigned char* source,
+																	std::size_t length) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 32)
+				{
+					const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + cursor.read));
+					const unsigned nonAscii = static_cast<unsigned>(_mm256_movemask_epi8(bytes));
+
+					if(nonAscii == 0)
+					{
+						cursor.read += 32;
+						continue;
+					}
+
+					cursor.read += CountTrailingZeros(nonAscii);
+
+					if(ValidateUtf8NonAscii(source, length, cursor) != WLR_SUCCESS)
+					{
+						return Finish(WLR_MALFORMED, cursor);
+					}
+				}
+
+				return Finish(ValidateUtf8Run(source, length, cursor, length), cursor);
+			}
+
+			WLR_TARGET_AVX2 inline TranscodeResult Utf8ToUtf16Avx2(const unsigned char* source, std::size_t length,
+																   char16_t* destination, std::size_t capacity) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 32 && capacity - cursor.written >= 32)
+				{
+					const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + cursor.read));
+					__m256i* output = reinterpret_cast<__m256i*>(destination + cursor.written);
+
+					_mm256_storeu_si256(output, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+					_mm256_storeu_si256(output + 1, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+
+					const unsigned nonAscii = static_cast<unsigned>(_mm256_movemask_epi8(bytes));
+
+					if(nonAscii == 0)
+					{
+						cursor.read += 32;
+						cursor.written += 32;
+						continue;
+					}
+
+					const unsigned prefix = CountTrailingZeros(nonAscii);
+
+					cursor.read += prefix;
+					cursor.written += prefix;
+
+					const wlr_err_t error = Utf8ToUtf16NonAscii(source, length, destination, capacity, cursor);
+
+					if(error != WLR_SUCCESS)
+					{
+						return Finish(error, cursor);
+					}
+				}
+
+				return Finish(Utf8ToUtf16Run(source, length, destination, capacity, cursor, length), cursor);
+			}
+
+			WLR_TARGET_AVX2 inline TranscodeResult Utf16ToUtf8Avx2(const char16_t* source, std::size_t length,
+																   unsigned char* destination, std::size_t capacity) noexcept
+			{
+				const __m256i asciiMask = _mm256_set1_epi16(static_cast<short>(0xFF80));
+
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 32 && capacity - cursor.written >= 32)
+				{
+					const __m256i* input = reinterpret_cast<const __m256i*>(source + cursor.read);
+					const __m256i low = _mm256_loadu_si256(input);
+					const __m256i high = _mm256_loadu_si256(input + 1);
+
+					// The packs work per 128-bit lane, so the 64-bit quarters come out in the order 0, 2, 1, 3
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + cursor.written),
+										_mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8));
+
+					if(_mm256_testz_si256(_mm256_or_si256(low, high), asciiMask))
+					{
+						cursor.read += 32;
+						cursor.written += 32;
+						continue;
+					}
+
+					const __m256i ascii = _mm256_permute4x64_epi64(
+						_mm256_packs_epi16(_mm256_cmpeq_epi16(_mm256_and_si256(low, asciiMask), _mm256_setzero_si256()),
+										   _mm256_cmpeq_epi16(_mm256_and_si256(high, asciiMask), _mm256_setzero_si256())),
+						0xD8);
+					const unsigned nonAscii = ~static_cast<unsigned>(_mm256_movemask_epi8(ascii));
+
+					const unsigned prefix = CountTrailingZeros(nonAscii);
+
+					cursor.read += prefix;
+					cursor.written += prefix;
+
+					const wlr_err_t error = Utf16ToUtf8NonAscii(source, length, destination, capacity, cursor);
+
+					if(error != WLR_SUCCESS)
+					{
+						return Finish(error, cursor);
+					}
+				}
+
+				return Finish(Utf16ToUtf8Run(source, length, destination, capacity, cursor, length), cursor);
+			}
+
+			// Widening, narrowing and extracting go through the zero-masked intrinsics with every lane selected: they
+			// compile to the same instructions, and unlike the unmasked ones GCC 12 does not warn that their source is
+			// uninitialized
+			WLR_TARGET_AVX512 inline TranscodeResult ValidateUtf8Avx512(const unsigned char* source,
+																		std::size_t length) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 64)
+				{
+					const __m512i bytes = _mm512_loadu_si512(source + cursor.read);
+					const std::uint64_t nonAscii = _mm512_movepi8_mask(bytes);
+
+					if(nonAscii == 0)
+					{
+						cursor.read += 64;
+						continue;
+					}
+
+					cursor.read += CountTrailingZeros(nonAscii);
+
+					if(ValidateUtf8NonAscii(source, length, cursor) != WLR_SUCCESS)
+					{
+						return Finish(WLR_MALFORMED, cursor);
+					}
+				}
+
+				return Finish(ValidateUtf8Run(source, length, cursor, length), cursor);
+			}
+
+			WLR_TARGET_AVX512 inline TranscodeResult Utf8ToUtf16Avx512(const unsigned char* source, std::size_t length,
+																	   char16_t* destination, std::size_t capacity) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 64 && capacity - cursor.written >= 64)
+				{
+					const __m512i bytes = _mm512_loadu_si512(source + cursor.read);
+					char16_t* output = destination + cursor.written;
+
+					_mm512_storeu_si512(output,
+										_mm512_maskz_cvtepu8_epi16(~0u, _mm512_maskz_extracti64x4_epi64(0xF, bytes, 0)));
+					_mm512_storeu_si512(output + 32,
+										_mm512_maskz_cvtepu8_epi16(~0u, _mm512_maskz_extracti64x4_epi64(0xF, bytes, 1)));
+
+					const std::uint64_t nonAscii = _mm512_movepi8_mask(bytes);
+
+					if(nonAscii == 0)
+					{
+						cursor.read += 64;
+						cursor.written += 64;
+						continue;
+					}
+
+					const unsigned prefix = CountTrailingZeros(nonAscii);
+
+					cursor.read += prefix;
+					cursor.written += prefix;
+
+					const wlr_err_t error = Utf8ToUtf16NonAscii(source, length, destination, capacity, cursor);
+
+					if(error != WLR_SUCCESS)
+					{
+						return Finish(error, cursor);
+					}
+				}
+
+				return Finish(Utf8ToUtf16Run(source, length, destination, capacity, cursor, length), cursor);
+			}
+
+			WLR_TARGET_AVX512 inline TranscodeResult Utf16ToUtf8Avx512(const char16_t* source, std::size_t length,
+																	   unsigned char* destination, std::size_t capacity) noexcept
+			{
+				const __m512i asciiMask = _mm512_set1_epi16(static_cast<short>(0xFF80));
+
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 32 && capacity - cursor.written >= 32)
+				{
+					const __m512i units = _mm512_loadu_si512(source + cursor.read);
+
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + cursor.written),
+										_mm512_maskz_cvtepi16_epi8(~0u, units));
+
+					const std::uint32_t nonAscii = _mm512_test_epi16_mask(units, asciiMask);
+
+					if(nonAscii == 0)
+					{
+						cursor.read += 32;
+						cursor.written += 32;
+						continue;
+					}
+
+					const unsigned prefix = CountTrailingZeros(nonAscii);
+
+					cursor.read += prefix;
+					cursor.written += prefix;
+
+					const wlr_err_t error = Utf16ToUtf8NonAscii(source, length, destination, capacity, cursor);
+
+					if(error != WLR_SUCCESS)
+					{
+						return Finish(error, cursor);
+					}
+				}
+
+				return Finish(Utf16ToUtf8Run(source, length, destination, capacity, cursor, length), cursor);
+			}
+#elif defined(WLR_SIMD_NEON)
+			inline TranscodeResult ValidateUtf8Neon(const unsigned char* source, std::size_t length) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 16)
+				{
+					if(vmaxvq_u8(vld1q_u8(source + cursor.read)) < 0x80)
+					{
+						cursor.read += 16;
+						continue;
+					}
+
+					if(ValidateUtf8NonAscii(source, length, cursor) != WLR_SUCCESS)
+					{
+						return Finish(WLR_MALFORMED, cursor);
+					}
+				}
+
+				return Finish(ValidateUtf8Run(source, length, cursor, length), cursor);
+			}
+
+			inline TranscodeResult Utf8ToUtf16Neon(const unsigned char* source, std::size_t length,
+												   char16_t* destination, std::size_t capacity) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 16 && capacity - cursor.written >= 16)
+				{
+					const uint8x16_t bytes = vld1q_u8(source + cursor.read);
+
+					if(vmaxvq_u8(bytes) < 0x80)
+					{
+						std::uint16_t* output = reinterpret_cast<std::uint16_t*>(destination + cursor.written);
+
+						vst1q_u16(output, vmovl_u8(vget_low_u8(bytes)));
+						vst1q_u16(output + 8, vmovl_high_u8(bytes));
+
+						cursor.read += 16;
+						cursor.written += 16;
+						continue;
+					}
+
+					// Skip the ASCII prefix with the scalar code, then take the non-ASCII run
+					wlr_err_t error = WLR_SUCCESS;
+
+					while(error == WLR_SUCCESS && source[cursor.read] < 0x80)
+					{
+						error = Utf8ToUtf16Run(source, length, destination, capacity, cursor, cursor.read + 1);
+					}
+
+					if(error == WLR_SUCCESS)
+					{
+						error = Utf8ToUtf16NonAscii(source, length, destination, capacity, cursor);
+					}
+
+					if(error != WLR_SUCCESS)
+					{
+						return Finish(error, cursor);
+					}
+				}
+
+				return Finish(Utf8ToUtf16Run(source, length, destination, capacity, cursor, length), cursor);
+			}
+
+			inline TranscodeResult Utf16ToUtf8Neon(const char16_t* source, std::size_t length,
+												   unsigned char* destination, std::size_t capacity) noexcept
+			{
+				Cursor cursor {0, 0};
+
+				while(length - cursor.read >= 16 && capacity - cursor.written >= 16)
+				{
+					const std::uint16_t* input = reinterpret_cast<const std::uint16_t*>(source + cursor.read);
+					const uint16x8_t low = vld1q_u16(input);
+					const uint16x8_t high = vld1q_u16(input + 8);
+
+					if(vmaxvq_u16(vorrq_u16(low, high)) < 0x80)
+					{
+						vst1q_u8(destination + cursor.written, vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+
+						cursor.read += 16;
+						cursor.written += 16;
+						continue;
+					}
+
+					// Skip the ASCII prefix with the scalar code, then take the non-ASCII run
+					wlr_err_t error = WLR_SUCCESS;
+
+					while(error == WLR_SUCCESS && source[cursor.read] < 0x80)
+					{
+						error = Utf16ToUtf8Run(source, length, destination, capacity, cursor, cursor.read + 1);
+					}
+
+					if(error == WLR_SUCCESS)
+					{
+						error = Utf16ToUtf8NonAscii(source, length, destination, capacity, cursor);
+					}
+
+					if(error != WLR_SUCCESS)
+					{
+						return Finish(error, cursor);
+					}
+				}
+
+				return Finish(Utf16ToUtf8Run(source, length, destination, capacity, cursor, length), cursor);
+			}
+#endif
+		}
+	}
+
+	/**
+		Check that data is well-formed UTF-8
+		@remarks level must be supported by the CPU; the default is the best one that is.
+	*/
+	inline TranscodeResult ValidateUtf8(const char* data, std::size_t length,
+										SimdLevel level = ActiveSimdLevel()) noexcept
+	{
+		const unsigned char* source = reinterpret_cast<const unsigned char*>(data);
+
+		switch(level)
+		{
+#if defined(WLR_SIMD_X86)
+			case SimdLevel::AVX512:
+				return detail::utf::ValidateUtf8Avx512(source, length);
+			case SimdLevel::AVX2:
+				return detail::utf::ValidateUtf8Avx2(source, length);
+			case SimdLevel::SSE41:
+				return detail::utf::ValidateUtf8Sse41(source, length);
+#elif defined(WLR_SIMD_NEON)
+			case SimdLevel::NEON:
+				return detail::utf::ValidateUtf8Neon(source, length);
+#endif
+			default:
+				return detail::utf::ValidateUtf8Scalar(source, length);
+		}
+	}
+
+	/**
+		Validate UTF-8 and convert it to UTF-16 in one pass
+		@remarks At most capacity code units are written to destination; MaximumUtf16Length(length) is always enough.
+	*/
+	inline TranscodeResult Utf8ToUtf16(const char* source, std::size_t length, char16_t* destination,
+									   std::size_t capacity, SimdLevel level = ActiveSimdLevel()) noexcept
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(source);
+
+		switch(level)
+		{
+#if defined(WLR_SIMD_X86)
+			case SimdLevel::AVX512:
+				return detail::utf::Utf8ToUtf16Avx512(bytes, length, destination, capacity);
+			case SimdLevel::AVX2:
+				return detail::utf::Utf8ToUtf16Avx2(bytes, length, destination, capacity);
+			case SimdLevel::SSE41:
+				return detail::utf::Utf8ToUtf16Sse41(bytes, length, destination, capacity);
+#elif defined(WLR_SIMD_NEON)
+			case SimdLevel::NEON:
+				return detail::utf::Utf8ToUtf16Neon(bytes, length, destination, capacity);
+#endif
+			default:
+				return detail::utf::Utf8ToUtf16Scalar(bytes, length, destination, capacity);
+		}
+	}
+
+	/**
+		Validate UTF-16 and convert it to UTF-8 in one pass
+		@remarks At most capacity bytes are written to destination; MaximumUtf8Length(length) is always enough.
+	*/
+	inline TranscodeResult Utf16ToUtf8(const char16_t* source, std::size_t length, char* destination,
+									   std::size_t capacity, SimdLevel level = ActiveSimdLevel()) noexcept
+	{
+		unsigned char* bytes = reinterpret_cast<unsigned char*>(destination);
+
+		switch(level)
+		{
+#if defined(WLR_SIMD_X86)
+			case SimdLevel::AVX512:
+				return detail::utf::Utf16ToUtf8Avx512(source, length, bytes, capacity);
+			case SimdLevel::AVX2:
+				return detail::utf::Utf16ToUtf8Avx2(source, length, bytes, capacity);
+			case SimdLevel::SSE41:
+				return detail::utf::Utf16ToUtf8Sse41(source, length, bytes, capacity);
+#elif defined(WLR_SIMD_NEON)
+			case SimdLevel::NEON:
+				return detail::utf::Utf16ToUtf8Neon(source, length, bytes, capacity);
+#endif
+			default:
+				return detail::utf::Utf16ToUtf8Scalar(source, length, bytes, capacity);
+		}
+	}
+
+	/**
+		Number of UTF-16 code units needed for well-formed UTF-8
+		@remarks Malformed input gives an unspecified count, which is still at most MaximumUtf16Length(length).
+	*/
+	inline std::size_t Utf16LengthOfUtf8(const char* data, std::size_t length) noexcept
+	{
+		std::size_t units = 0;
+
+		// Every byte that is not a continuation byte starts a character, and 4-byte characters need a surrogate pair
+		for(std::size_t index = 0; index < length; ++index)
+		{
+			const unsigned char byte = static_cast<unsigned char>(data[index]);
+
+			units += static_cast<std::size_t>((byte & 0xC0) != 0x80) + static_cast<std::size_t>(byte >= 0xF0);
+		}
+
+		return units;
+	}
+
+	/**
+		Number of UTF-8 bytes needed for well-formed UTF-16
+	*/
+	inline std::size_t Utf8LengthOfUtf16(const char16_t* data, std::size_t length) noexcept
+	{
+		std::size_t bytes = 0;
+
+		// Each half of a surrogate pair accounts for 2 of the pair's 4 bytes
+		for(std::size_t index = 0; index < length; ++index)
+		{
+			const char16_t unit = data[index];
+
+			bytes += 1 + static_cast<std::size_t>(unit >= 0x80) +
+					 static_cast<std::size_t>(unit >= 0x800 && (unit < 0xD800 || unit > 0xDFFF));
+		}
+
+		return bytes;
+	}
+
+	/**
+		Convert UTF-8 to a std::u16string
+	*/
+	inline wlr_err_t Utf8ToUtf16(std::string_view text, std::u16string& result)
+	{
+		result.resize(MaximumUtf16Length(text.size()));
+
+		const TranscodeResult transcoded = Utf8ToUtf16(text.data(), text.size(), result.data(), result.size());
+
+		result.resize(transcoded.error == WLR_SUCCESS ? transcoded.written : 0);
+
+		return transcoded.error;
+	}
+
+	/**
+		Convert UTF-16 to a std::string
+	*/
+	inline wlr_err_t Utf16ToUtf8(std::u16string_view text, std::string& result)
+	{
+		result.resize(MaximumUtf8Length(text.size()));
+
+		const TranscodeResult transcoded = Utf16ToUtf8(text.data(), text.size(), result.data(), result.size());
+
+		result.resize(transcoded.error == WLR_SUCCESS ? transcoded.written : 0);
+
+		return transcoded.error;
+	}
+
+	namespace detail
+	{
+		namespace utf
+		{
+			/**
+				Per-thread UTF-8 buffer for building string expressions, grown as needed and never shrunk
+			*/
+			inline char* Scratch(std::size_t size)
+			{
+				thread_local std::vector<char> buffer;
+
+				if(buffer.size() < size)
+				{
+					buffer.resize(size);
+				}
+
+				return buffer.data();
+			}
+		}
+	}
+
+	/**
+		Create a string expression from UTF-16 text
+		@remarks The text is transcoded into a per-thread buffer and passed to wlr_StringFromData, so the only copy is
+	   the one the runtime makes. Returns WLR_MALFORMED, leaving result unchanged, if text has unpaired surrogates.
+	*/
+	inline wlr_err_t StringFromUtf16(std::u16string_view text, wlr_expr& result)
+	{
+		char* buffer = detail::utf::Scratch(MaximumUtf8Length(text.size()));
+
+		const TranscodeResult transcoded =
+			Utf16ToUtf8(text.data(), text.size(), buffer, MaximumUtf8Length(text.size()));
+
+		if(transcoded.error != WLR_SUCCESS)
+		{
+			return transcoded.error;
+		}
+
+		result = wlr_StringFromData(buffer, static_cast<mint>(transcoded.written));
+
+		return WLR_SUCCESS;
+	}
+
+	/**
+		Copy the contents of a string expression into a std::u16string
+	*/
+	inline wlr_err_t Utf16FromString(wlr_expr stringExpression, std::u16string& result)
+	{
+		const StringData data(stringExpression);
+
+		if(data.Error() != WLR_SUCCESS)
+		{
+			result.clear();
+
+			return data.Error();
+		}
+
+		return Utf8ToUtf16(data.View(), result);
+	}
+
+	/**
+		Convert count UTF-16 strings to UTF-8, stored back to back in bytes
+		@remarks String i is units [offsets[i], offsets[i + 1]) of units. Its UTF-8 form is bytes
+	   [byteOffsets[i], byteOffsets[i + 1]), the layout used by StringArena. On WLR_MALFORMED, read is the offset into
+	   units of the first invalid sequence.
+	*/
+	inline TranscodeResult Utf16StringsToUtf8(const char16_t* units, const std::size_t* offsets, std::size_t count,
+											  std::string& bytes, std::vector<mint>& byteOffsets)
+	{
+		bytes.resize(MaximumUtf8Length(count == 0 ? 0 : offsets[count] - offsets[0]));
+		byteOffsets.resize(count + 1);
+		byteOffsets[0] = 0;
+
+		std::size_t written = 0;
+
+		for(std::size_t index = 0; index < count; ++index)
+		{
+			const TranscodeResult transcoded = Utf16ToUtf8(units + offsets[index], offsets[index + 1] - offsets[index],
+														   bytes.data() + written, bytes.size() - written);
+
+			if(transcoded.error != WLR_SUCCESS)
+			{
+				bytes.clear();
+				byteOffsets.clear();
+
+				return TranscodeResult {transcoded.error, offsets[index] + transcoded.read, written + transcoded.written};
+			}
+
+			written += transcoded.written;
+			byteOffsets[index + 1] = static_cast<mint>(written);
+		}
+
+		bytes.resize(written);
+
+		return TranscodeResult {WLR_SUCCESS, count == 0 ? 0 : offsets[count], written};
+	}
+
+	/**
+		Create a list of string expressions from count UTF-16 strings laid out as for Utf16StringsToUtf8
+		@remarks Every string is validated before any expression is created.
+	*/
+	inline wlr_err_t StringListFromUtf16(const char16_t* units, const std::size_t* offsets, std::size_t count,
+										 wlr_expr& result)
+	{
+		thread_local std::string bytes;
+		thread_local std::vector<mint> byteOffsets;
+
+		const TranscodeResult transcoded = Utf16StringsToUtf8(units, offsets, count, bytes, byteOffsets);
+
+		if(transcoded.error != WLR_SUCCESS)
+		{
+			return transcoded.error;
+		}
+
+		wlr_exprbag bag = wlr_ExpressionBag();
+
+		for(std::size_t index = 0; index < count; ++index)
+		{
+			wlr_AddExpression(bag, wlr_StringFromData(bytes.data() + byteOffsets[index],
+													  byteOffsets[index + 1] - byteOffsets[index]));
+		}
+
+		result = wlr_ExpressionBagToExpression(bag, Symbol(SystemSymbol::List));
+		wlr_ReleaseExpressionBag(bag);
+
+		return WLR_SUCCESS;
+	}
+
+	/**
+		Convert every string in arena to UTF-16, stored back to back in units
+		@remarks String i is units [offsets[i], offsets[i + 1]).
+	*/
+	inline wlr_err_t Utf16FromStrings(const StringArena& arena, std::u16string& units, std::vector<std::size_t>& offsets)
+	{
+		const std::size_t count = arena.Size();
+
+		units.resize(MaximumUtf16Length(arena.Data().size()));
+		offsets.resize(count + 1);
+		offsets[0] = 0;
+
+		std::size_t written = 0;
+
+		for(std::size_t index = 0; index < count; ++index)
+		{
+			const std::string_view string = arena[index];
+
+			const TranscodeResult transcoded =
+				Utf8ToUtf16(string.data(), string.size(), units.data() + written, units.size() - written);
+
+			if(transcoded.error != WLR_SUCCESS)
+			{
+				units.clear();
+				offsets.clear();
+
+				return transcoded.error;
+			}
+
+			written += transcoded.written;
+			offsets[index + 1] = written;
+		}
+
+		units.resize(written);
+
+		return WLR_SUCCESS;
+	}
+}
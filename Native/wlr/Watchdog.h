@@ -0,0 +1,228 @@
+/*
+	Deadline-bounded evaluation
+
+	A wlr::EvaluationWatchdog owns one background thread that sleeps until the deadline of the evaluation currently
+	running on the kernel thread. If the evaluation is still running when the deadline passes, the watchdog calls
+	wlr_Abort. The kernel thread then sees wlr_Eval return, calls wlr_ClearAbort so that the next evaluation starts
+	clean, and reports EvaluationStatus::TimedOut instead of the text "$Aborted". The runtime process keeps running.
+
+	Only one evaluation may be armed at a time, which matches the runtime's single-threaded use. Deadlines are absolute,
+	so a request that has already spent its budget waiting in a queue times out without entering the kernel.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#include "Evaluate.h"
+
+namespace wlr
+{
+	/**
+		Counters published by an EvaluationWatchdog
+		@remarks armed counts evaluations started with a deadline. aborts counts calls to wlr_Abort. timeouts counts
+	   EvaluationStatus::TimedOut results, including requests whose deadline had passed before they started.
+	*/
+	struct WatchdogStatistics
+	{
+		std::uint64_t armed;
+		std::uint64_t aborts;
+		std::uint64_t timeouts;
+	};
+
+	/**
+		Background thread that aborts the armed evaluation when its deadline passes
+		@remarks Arm and Disarm must be called from the thread that evaluates. Statistics may be read from any thread.
+	*/
+	class EvaluationWatchdog
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		EvaluationWatchdog()
+		{
+			watchdogThread = std::thread([this] { Run(); });
+		}
+
+		EvaluationWatchdog(const EvaluationWatchdog&) = delete;
+		EvaluationWatchdog& operator=(const EvaluationWatchdog&) = delete;
+
+		~EvaluationWatchdog()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+
+			condition.notify_one();
+
+			watchdogThread.join();
+		}
+
+		/**
+			Watchdog shared by the EvaluateToOutputForm overloads that take a deadline
+		*/
+		static EvaluationWatchdog& Global()
+		{
+			static EvaluationWatchdog watchdog;
+
+			return watchdog;
+		}
+
+		/**
+			Start watching an evaluation that must finish by deadline, and return the ticket to pass to Disarm
+		*/
+		std::uint64_t Arm(Clock::time_point deadline)
+		{
+			std::uint64_t ticket;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				ticket = ++lastTicket;
+
+				armedTicket = ticket;
+				armedDeadline = deadline;
+				fired = false;
+			}
+
+			armed.fetch_add(1, std::memory_order_relaxed);
+
+			condition.notify_one();
+
+			return ticket;
+		}
+
+		/**
+			Stop watching the evaluation started with ticket
+			@remarks Returns true if wlr_Abort was called for it. The caller must then call wlr_ClearAbort before the next
+		   evaluation.
+		*/
+		bool Disarm(std::uint64_t ticket)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			const bool aborted = armedTicket == ticket && fired;
+
+			armedTicket = 0;
+			fired = false;
+
+			return aborted;
+		}
+
+		void CountTimeout() noexcept
+		{
+			timeouts.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		WatchdogStatistics Statistics() const noexcept
+		{
+			return WatchdogStatistics {armed.load(std::memory_order_relaxed), aborts.load(std::memory_order_relaxed),
+									   timeouts.load(std::memory_order_relaxed)};
+		}
+
+	private:
+		void Run()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			while(!stopping)
+			{
+				if(armedTicket == 0 || fired)
+				{
+					condition.wait(lock);
+					continue;
+				}
+
+				const std::uint64_t ticket = armedTicket;
+
+				if(condition.wait_until(lock, armedDeadline,
+										[this, ticket] { return stopping || armedTicket != ticket; }))
+				{
+					continue;
+				}
+
+				// Abort while holding the lock, so that Disarm either sees the abort or prevents it
+				fired = true;
+
+				aborts.fetch_add(1, std::memory_order_relaxed);
+
+				wlr_Abort();
+			}
+		}
+
+		std::mutex mutex;
+		std::condition_variable condition;
+
+		std::uint64_t lastTicket = 0;
+		std::uint64_t armedTicket = 0;
+		Clock::time_point armedDeadline;
+		bool fired = false;
+		bool stopping = false;
+
+		std::atomic<std::uint64_t> armed {0};
+		std::atomic<std::uint64_t> aborts {0};
+		std::atomic<std::uint64_t> timeouts {0};
+
+		std::thread watchdogThread;
+	};
+
+	/**
+		Evaluate an input string to OutputForm, aborting the evaluation if it has not finished by deadline
+		@remarks Returns EvaluationStatus::TimedOut, with empty output, if the deadline passed before the call or during
+	   parsing or evaluation. Intermediate expressions are left in the caller's current pool.
+	*/
+	inline EvaluationResult EvaluateToOutputForm(std::string_view input, EvaluationWatchdog::Clock::time_point deadline,
+												 EvaluationWatchdog& watchdog = EvaluationWatchdog::Global())
+	{
+		WLR_TRACE_SPAN("EvaluateToOutputForm");
+
+		if(EvaluationWatchdog::Clock::now() >= deadline)
+		{
+			watchdog.CountTimeout();
+
+			return EvaluationResult {EvaluationStatus::TimedOut, std::string()};
+		}
+
+		// Parsing a long input can itself take a while, so the deadline covers it as well as the evaluation
+		const std::uint64_t ticket = watchdog.Arm(deadline);
+
+		wlr_expr parsedExpression = WLR_TRACED("wlr_ParseExpression", wlr_ParseExpression(ToExpression(input)));
+
+		wlr_expr evaluatedExpression = WLR_TRACED(
+			"wlr_Eval + ToString",
+			wlr_Eval(E(Symbol(SystemSymbol::ToString), parsedExpression, Symbol(SystemSymbol::OutputForm))));
+
+		if(watchdog.Disarm(ticket))
+		{
+			// Even if the evaluation finished just as the abort arrived, the result cannot be trusted
+			wlr_ClearAbort();
+
+			watchdog.CountTimeout();
+
+			return EvaluationResult {EvaluationStatus::TimedOut, std::string()};
+		}
+
+		if(wlr_ExpressionType(evaluatedExpression) != WLR_STRING)
+		{
+			return EvaluationResult {EvaluationStatus::Failed, std::string()};
+		}
+
+		return EvaluationResult {EvaluationStatus::Success, StringFromExpression(evaluatedExpression)};
+	}
+
+	/**
+		Evaluate an input string to OutputForm with a time budget measured from now
+	*/
+	inline EvaluationResult EvaluateToOutputForm(std::string_view input, std::chrono::nanoseconds timeout,
+												 EvaluationWatchdog& watchdog = EvaluationWatchdog::Global())
+	{
+		return EvaluateToOutputForm(input, EvaluationWatchdog::Clock::now() + timeout, watchdog);
+	}
+}
@@ -0,0 +1,1276 @@
+/*
+	Multi-process runtime worker pool (Linux)
+
+	A process can run only one runtime, so kernel work in one process is limited to one core. A wlr::WorkerPool runs
+	several worker processes, each with its own runtime, and sends requests to them from the supervising process:
+
+		supervisor                            shared memory                          worker i
+		Evaluate / Apply  -- least loaded -->  request ring i   (SPSC, semaphore)  -->  EvaluateToOutputForm / f[tensor]
+		collector thread i  <--------------    response ring i  (SPSC, semaphore)  <--
+		AllocateTensor    ----------------->   tensor arena (written and read in place by both sides)
+
+	Workers are forked by a small helper process (the zygote) that the pool forks from its constructor, before it starts
+	any threads, so a restart never forks the multi-threaded supervisor. Each worker optionally pins itself to one CPU,
+	then calls startRuntime with its index, which is typically a lambda around wlr_sdk_StartRuntime with a per-worker
+	wlr_runtime_conf. A collector thread per worker delivers responses and watches the worker process: if it dies, its
+	outstanding requests fail and the zygote starts a replacement. A worker that dies before its runtime has started is
+	not restarted.
+
+	Tensor payloads never pass through the rings. The caller fills a SharedTensor in place, the worker builds the
+	runtime's MNumericArray straight from the shared memory (the one copy the SDK requires), and a tensor result is
+	written back into a caller-provided SharedTensor that the caller then reads in place.
+
+	Construct the pool early in main, before the process starts other threads or the runtime: the zygote is a fork of
+	the process at that point.
+*/
+
+#pragma once
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sched.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Evaluate.h"
+#include "NumericArray.h"
+#include "Tensor.h"
+
+namespace wlr
+{
+	struct WorkerPoolOptions
+	{
+		std::size_t workerCount = 0;	 // 0: one worker per available CPU
+		bool pinToCores = true;
+		std::size_t ringBytes = 1 << 20; // capacity of each request and response ring
+		std::size_t arenaBytes = 64 << 20;
+		std::size_t requestsPerPoolCycle = 64;
+	};
+
+	/**
+		Counters published by a WorkerPool
+		@remarks failed counts requests that completed with EvaluationStatus::Failed, including those lost with a crashed
+	   worker.
+	*/
+	struct WorkerPoolStatistics
+	{
+		std::uint64_t submitted;
+		std::uint64_t completed;
+		std::uint64_t failed;
+		std::uint64_t restarts;
+		std::size_t liveWorkers;
+	};
+
+	class WorkerPool;
+
+	namespace detail
+	{
+		constexpr std::uint64_t NoOffset = ~std::uint64_t(0);
+		constexpr std::size_t SharedTensorMaximumRank = 8;
+		constexpr std::size_t SharedAlignment = 64;
+
+		constexpr std::size_t AlignShared(std::size_t value) noexcept
+		{
+			return (value + SharedAlignment - 1) & ~(SharedAlignment - 1);
+		}
+
+		/**
+			Shape and element type at the start of each tensor in the arena; the elements follow at a 64-byte boundary
+		*/
+		struct SharedTensorHeader
+		{
+			numericarray_data_t type;
+			mint rank;
+			mint dimensions[SharedTensorMaximumRank];
+			std::uint64_t capacity;
+		};
+
+		constexpr std::size_t SharedTensorDataOffset = AlignShared(sizeof(SharedTensorHeader));
+
+		/**
+			Single-producer, single-consumer ring of length-prefixed messages in shared memory
+			@remarks head and tail count bytes written and read since the ring was reset; std::atomic<std::uint64_t> is
+		   lock-free and address-free on every Linux target, so it works across processes.
+		*/
+		struct RingHeader
+		{
+			alignas(SharedAlignment) std::atomic<std::uint64_t> head;
+			alignas(SharedAlignment) std::atomic<std::uint64_t> tail;
+		};
+
+		class MessageRing
+		{
+		public:
+			MessageRing() = default;
+
+			MessageRing(RingHeader* header, unsigned char* data, std::size_t capacity) noexcept
+				: header(header), data(data), capacity(capacity)
+			{
+			}
+
+			void Reset() noexcept
+			{
+				header->head.store(0, std::memory_order_relaxed);
+				header->tail.store(0, std::memory_order_relaxed);
+			}
+
+			/**
+				Whether a message of length bytes can ever fit
+			*/
+			bool Fits(std::size_t length) const noexcept
+			{
+				return sizeof(std::uint32_t) + length <= capacity;
+			}
+
+			/**
+				Append a message made of two parts, or return false if there is not enough free space right now
+			*/
+			bool TryPush(const void* first, std::size_t firstLength, const void* second, std::size_t secondLength) noexcept
+			{
+				const std::uint64_t head = header->head.load(std::memory_order_relaxed);
+				const std::uint64_t tail = header->tail.load(std::memory_order_acquire);
+
+				const std::uint32_t length = static_cast<std::uint32_t>(firstLength + secondLength);
+
+				if(head - tail + sizeof(length) + length > capacity)
+				{
+					return false;
+				}
+
+				Write(head, &length, sizeof(length));
+				Write(head + sizeof(length), first, firstLength);
+				Write(head + sizeof(length) + firstLength, second, secondLength);
+
+				header->head.store(head + sizeof(length) + length, std::memory_order_release);
+
+				return true;
+			}
+
+			/**
+				Remove the oldest message into message, or return false if the ring is empty
+			*/
+			bool TryPop(std::string& message)
+			{
+				const std::uint64_t tail = header->tail.load(std::memory_order_relaxed);
+				const std::uint64_t head = header->head.load(std::memory_order_acquire);
+
+				if(head == tail)
+				{
+					return false;
+				}
+
+				std::uint32_t length;
+
+				Read(tail, &length, sizeof(length));
+
+				message.resize(length);
+
+				Read(tail + sizeof(length), message.data(), length);
+
+				header->tail.store(tail + sizeof(length) + length, std::memory_order_release);
+
+				return true;
+			}
+
+		private:
+			void Write(std::uint64_t position, const void* source, std::size_t length) noexcept
+			{
+				if(length == 0)
+				{
+					return;
+				}
+
+				const std::size_t offset = static_cast<std::size_t>(position % capacity);
+				const std::size_t first = std::min(length, capacity - offset);
+
+				std::memcpy(data + offset, source, first);
+				std::memcpy(data, static_cast<const unsigned char*>(source) + first, length - first);
+			}
+
+			void Read(std::uint64_t position, void* destination, std::size_t length) const noexcept
+			{
+				if(length == 0)
+				{
+					return;
+				}
+
+				const std::size_t offset = static_cast<std::size_t>(position % capacity);
+				const std::size_t first = std::min(length, capacity - offset);
+
+				std::memcpy(destination, data + offset, first);
+				std::memcpy(static_cast<unsigned char*>(destination) + first, data, length - first);
+			}
+
+			RingHeader* header = nullptr;
+			unsigned char* data = nullptr;
+			std::size_t capacity = 0;
+		};
+
+		enum class WorkerState : std::uint32_t
+		{
+			Starting,
+			Ready
+		};
+
+		/**
+			Per-worker control block at the start of the worker's shared region
+		*/
+		struct ChannelHeader
+		{
+			sem_t requestsAvailable;
+			sem_t responsesAvailable;
+			std::atomic<WorkerState> state;
+			RingHeader requests;
+			RingHeader responses;
+		};
+
+		enum class RequestKind : std::uint32_t
+		{
+			Evaluate,
+			Apply,
+			Stop
+		};
+
+		struct RequestHeader
+		{
+			std::uint64_t id;
+			RequestKind kind;
+			std::uint32_t reserved;
+			std::uint64_t argumentOffset;
+			std::uint64_t resultOffset;
+		};
+
+		struct ResponseHeader
+		{
+			std::uint64_t id;
+			EvaluationStatus status;
+			std::uint32_t reserved;
+		};
+
+		inline void SemaphoreWait(sem_t* semaphore) noexcept
+		{
+			while(sem_wait(semaphore) != 0 && errno == EINTR)
+			{
+			}
+		}
+
+		/**
+			Wait up to timeout for semaphore; returns false on timeout
+		*/
+		inline bool SemaphoreWaitFor(sem_t* semaphore, std::chrono::milliseconds timeout) noexcept
+		{
+			timespec deadline;
+
+			clock_gettime(CLOCK_REALTIME, &deadline);
+
+			deadline.tv_nsec += static_cast<long>(timeout.count() % 1000) * 1000000;
+			deadline.tv_sec += static_cast<time_t>(timeout.count() / 1000) + deadline.tv_nsec / 1000000000;
+			deadline.tv_nsec %= 1000000000;
+
+			int result;
+
+			while((result = sem_timedwait(semaphore, &deadline)) != 0 && errno == EINTR)
+			{
+			}
+
+			return result == 0;
+		}
+
+		/**
+			First-fit allocator over the offsets of the tensor arena, used only by the supervisor
+		*/
+		class ArenaAllocator
+		{
+		public:
+			explicit ArenaAllocator(std::size_t size)
+			{
+				freeBlocks.emplace(0, size);
+			}
+
+			std::uint64_t Allocate(std::size_t size)
+			{
+				size = AlignShared(size);
+
+				std::lock_guard<std::mutex> lock(mutex);
+
+				for(auto block = freeBlocks.begin(); block != freeBlocks.end(); ++block)
+				{
+					if(block->second >= size)
+					{
+						const std::uint64_t offset = block->first;
+						const std::size_t remaining = block->second - size;
+
+						freeBlocks.erase(block);
+
+						if(remaining > 0)
+						{
+							freeBlocks.emplace(offset + size, remaining);
+						}
+
+						return offset;
+					}
+				}
+
+				return NoOffset;
+			}
+
+			void Free(std::uint64_t offset, std::size_t size)
+			{
+				size = AlignShared(size);
+
+				std::lock_guard<std::mutex> lock(mutex);
+
+				auto block = freeBlocks.emplace(offset, size).first;
+
+				auto next = std::next(block);
+
+				if(next != freeBlocks.end() && block->first + block->second == next->first)
+				{
+					block->second += next->second;
+					freeBlocks.erase(next);
+				}
+
+				if(block != freeBlocks.begin())
+				{
+					auto previous = std::prev(block);
+
+					if(previous->first + previous->second == block->first)
+					{
+						previous->second += block->second;
+						freeBlocks.erase(block);
+					}
+				}
+			}
+
+		private:
+			std::mutex mutex;
+			std::map<std::uint64_t, std::size_t> freeBlocks;
+		};
+	}
+
+	/**
+		Tensor in the pool's shared arena, written and read in place by the supervisor and the workers
+		@remarks Move-only; returns its memory to the arena when destroyed. A tensor passed to WorkerPool::Apply must
+	   stay alive until the returned future is ready.
+	*/
+	class SharedTensor
+	{
+	public:
+		SharedTensor() noexcept = default;
+
+		SharedTensor(SharedTensor&& other) noexcept
+			: arena(std::exchange(other.arena, nullptr)), base(std::exchange(other.base, nullptr)), offset(other.offset),
+			  size(other.size)
+		{
+		}
+
+		SharedTensor& operator=(SharedTensor&& other) noexcept
+		{
+			if(this != &other)
+			{
+				Reset();
+
+				arena = std::exchange(other.arena, nullptr);
+				base = std::exchange(other.base, nullptr);
+				offset = other.offset;
+				size = other.size;
+			}
+
+			return *this;
+		}
+
+		SharedTensor(const SharedTensor&) = delete;
+		SharedTensor& operator=(const SharedTensor&) = delete;
+
+		~SharedTensor()
+		{
+			Reset();
+		}
+
+		void Reset() noexcept
+		{
+			if(arena != nullptr)
+			{
+				arena->Free(offset, size);
+			}
+
+			arena = nullptr;
+			base = nullptr;
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return base != nullptr;
+		}
+
+		numericarray_data_t Type() const noexcept
+		{
+			return Header()->type;
+		}
+
+		mint Rank() const noexcept
+		{
+			return Header()->rank;
+		}
+
+		const mint* Dimensions() const noexcept
+		{
+			return Header()->dimensions;
+		}
+
+		mint FlattenedLength() const noexcept
+		{
+			mint length = 1;
+
+			for(mint axis = 0; axis < Rank(); ++axis)
+			{
+				length *= Dimensions()[axis];
+			}
+
+			return length;
+		}
+
+		/**
+			Number of bytes available for elements
+		*/
+		std::size_t Capacity() const noexcept
+		{
+			return static_cast<std::size_t>(Header()->capacity);
+		}
+
+		void* Data() const noexcept
+		{
+			return base + offset + detail::SharedTensorDataOffset;
+		}
+
+		template <typename T>
+		T* Data() const noexcept
+		{
+			return static_cast<T*>(Data());
+		}
+
+	private:
+		friend class WorkerPool;
+
+		detail::SharedTensorHeader* Header() const noexcept
+		{
+			return reinterpret_cast<detail::SharedTensorHeader*>(base + offset);
+		}
+
+		detail::ArenaAllocator* arena = nullptr;
+		unsigned char* base = nullptr;
+		std::uint64_t offset = 0;
+		std::size_t size = 0;
+	};
+
+	/**
+		Supervisor of a set of worker processes, each running its own runtime
+		@remarks Every member function may be called from any thread of the supervising process. Requests to the same
+	   worker run in submission order; requests to different workers run in parallel.
+		@remarks The destructor lets every worker finish the requests already sent to it, then stops the workers and the
+	   zygote. It must not run while another thread is still submitting.
+	*/
+	class WorkerPool
+	{
+	public:
+		WorkerPool(std::function<wlr_err_t(std::size_t workerIndex)> startRuntime,
+				   WorkerPoolOptions options = WorkerPoolOptions())
+			: startRuntime(std::move(startRuntime)), options(options)
+		{
+			if(this->options.workerCount == 0)
+			{
+				this->options.workerCount = std::max(1u, std::thread::hardware_concurrency());
+			}
+
+			channelBytes = detail::AlignShared(sizeof(detail::ChannelHeader)) + 2 * detail::AlignShared(this->options.ringBytes);
+			regionBytes = channelBytes * this->options.workerCount + this->options.arenaBytes;
+
+			void* mapping = mmap(nullptr, regionBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+			if(mapping == MAP_FAILED)
+			{
+				throw std::system_error(errno, std::generic_category(), "wlr::WorkerPool: mmap");
+			}
+
+			region = static_cast<unsigned char*>(mapping);
+			arenaBase = region + channelBytes * this->options.workerCount;
+			arena = std::make_unique<detail::ArenaAllocator>(this->options.arenaBytes);
+
+			workers = std::vector<Worker>(this->options.workerCount);
+
+			for(std::size_t index = 0; index < workers.size(); ++index)
+			{
+				detail::ChannelHeader* channel = Channel(index);
+
+				new(channel) detail::ChannelHeader();
+
+				sem_init(&channel->requestsAvailable, 1, 0);
+				sem_init(&channel->responsesAvailable, 1, 0);
+
+				unsigned char* rings = reinterpret_cast<unsigned char*>(channel) + detail::AlignShared(sizeof(detail::ChannelHeader));
+
+				workers[index].requests = detail::MessageRing(&channel->requests, rings, this->options.ringBytes);
+				workers[index].responses = detail::MessageRing(
+					&channel->responses, rings + detail::AlignShared(this->options.ringBytes), this->options.ringBytes);
+			}
+
+			StartZygote();
+
+			for(std::size_t index = 0; index < workers.size(); ++index)
+			{
+				workers[index].pid = Spawn(index);
+			}
+
+			for(std::size_t index = 0; index < workers.size(); ++index)
+			{
+				workers[index].collector = std::thread([this, index] { Collect(index); });
+			}
+		}
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		~WorkerPool()
+		{
+			stopping.store(true, std::memory_order_seq_cst);
+
+			for(std::size_t index = 0; index < workers.size(); ++index)
+			{
+				std::lock_guard<std::mutex> lock(workers[index].sendMutex);
+
+				if(!workers[index].failed)
+				{
+					const detail::RequestHeader header {0, detail::RequestKind::Stop, 0, detail::NoOffset, detail::NoOffset};
+
+					Send(index, header, std::string_view());
+				}
+			}
+
+			for(Worker& worker : workers)
+			{
+				worker.collector.join();
+			}
+
+			close(zygoteCommands);
+			close(zygoteReplies);
+
+			waitpid(zygote, nullptr, 0);
+
+			for(std::size_t index = 0; index < workers.size(); ++index)
+			{
+				sem_destroy(&Channel(index)->requestsAvailable);
+				sem_destroy(&Channel(index)->responsesAvailable);
+			}
+
+			munmap(region, regionBytes);
+		}
+
+		std::size_t WorkerCount() const noexcept
+		{
+			return workers.size();
+		}
+
+		/**
+			Allocate a tensor in the shared arena, to be filled in place and passed to Apply
+			@remarks Returns an empty SharedTensor if the arena is full or rank is out of range.
+		*/
+		SharedTensor AllocateTensor(numericarray_data_t type, mint rank, const mint* dimensions)
+		{
+			mint length = 1;
+
+			for(mint axis = 0; axis < rank; ++axis)
+			{
+				length *= dimensions[axis];
+			}
+
+			SharedTensor tensor = AllocateTensor(type, static_cast<std::size_t>(length) * NumericArrayElementSize(type));
+
+			if(tensor && rank >= 1 && rank <= static_cast<mint>(detail::SharedTensorMaximumRank))
+			{
+				tensor.Header()->rank = rank;
+				std::copy(dimensions, dimensions + rank, tensor.Header()->dimensions);
+			}
+			else
+			{
+				tensor.Reset();
+			}
+
+			return tensor;
+		}
+
+		/**
+			Allocate space for a tensor result of the given element type and at most capacity bytes of elements
+		*/
+		SharedTensor AllocateTensor(numericarray_data_t type, std::size_t capacity)
+		{
+			const std::size_t size = detail::SharedTensorDataOffset + capacity;
+			const std::uint64_t offset = arena->Allocate(size);
+
+			SharedTensor tensor;
+
+			if(offset == detail::NoOffset)
+			{
+				return tensor;
+			}
+
+			tensor.arena = arena.get();
+			tensor.base = arenaBase;
+			tensor.offset = offset;
+			tensor.size = size;
+
+			detail::SharedTensorHeader* header = tensor.Header();
+
+			header->type = type;
+			header->rank = 0;
+			header->capacity = capacity;
+
+			return tensor;
+		}
+
+		/**
+			Evaluate input to OutputForm on the least loaded worker
+			@remarks The status is EvaluationStatus::Failed if the input does not parse or its OutputForm is not a
+		   string, as well as when no worker can take the request.
+		*/
+		std::future<EvaluationResult> Evaluate(std::string_view input)
+		{
+			return Submit(detail::RequestKind::Evaluate, input, detail::NoOffset, detail::NoOffset);
+		}
+
+		/**
+			Evaluate function[argument] on the least loaded worker, where function is Wolfram Language input such as
+			"Total[#, 2] &"
+			@remarks If result is null, the output is the OutputForm text of the value. Otherwise the value, which must be
+		   a numeric tensor, is converted to the element type of result and written into it, and the output is empty. The
+		   request fails if the value does not fit within result's capacity, and without being sent if argument is empty
+		   or has rank 0 or result is empty.
+		*/
+		std::future<EvaluationResult> Apply(std::string_view function, const SharedTensor& argument,
+											SharedTensor* result = nullptr)
+		{
+			if(!argument || argument.Rank() == 0 || (result != nullptr && !*result))
+			{
+				submitted.fetch_add(1, std::memory_order_relaxed);
+
+				return Rejected();
+			}
+
+			return Submit(detail::RequestKind::Apply, function, argument.offset,
+						  result == nullptr ? detail::NoOffset : result->offset);
+		}
+
+		WorkerPoolStatistics Statistics() const noexcept
+		{
+			std::size_t liveWorkers = 0;
+
+			for(const Worker& worker : workers)
+			{
+				liveWorkers += worker.failed ? 0 : 1;
+			}
+
+			return WorkerPoolStatistics {submitted.load(std::memory_order_relaxed), completed.load(std::memory_order_relaxed),
+										 failed.load(std::memory_order_relaxed), restarts.load(std::memory_order_relaxed),
+										 liveWorkers};
+		}
+
+	private:
+		struct Worker
+		{
+			detail::MessageRing requests;
+			detail::MessageRing responses;
+
+			std::mutex sendMutex;
+			pid_t pid = -1;
+			std::atomic<bool> failed {false};
+			std::atomic<std::uint64_t> outstanding {0};
+
+			std::mutex pendingMutex;
+			std::unordered_map<std::uint64_t, std::promise<EvaluationResult>> pending;
+
+			std::thread collector;
+		};
+
+		detail::ChannelHeader* Channel(std::size_t index) const noexcept
+		{
+			return reinterpret_cast<detail::ChannelHeader*>(region + channelBytes * index);
+		}
+
+		/**
+			Index of the live worker with the fewest outstanding requests, or workers.size() if none is alive
+		*/
+		std::size_t LeastLoaded() noexcept
+		{
+			const std::size_t start = nextWorker.fetch_add(1, std::memory_order_relaxed);
+
+			std::size_t best = workers.size();
+			std::uint64_t bestLoad = ~std::uint64_t(0);
+
+			for(std::size_t step = 0; step < workers.size(); ++step)
+			{
+				const std::size_t index = (start + step) % workers.size();
+
+				if(workers[index].failed.load(std::memory_order_relaxed))
+				{
+					continue;
+				}
+
+				const std::uint64_t load = workers[index].outstanding.load(std::memory_order_relaxed);
+
+				if(load < bestLoad)
+				{
+					best = index;
+					bestLoad = load;
+				}
+			}
+
+			return best;
+		}
+
+		static std::future<EvaluationResult> Failed()
+		{
+			std::promise<EvaluationResult> result;
+
+			result.set_value(EvaluationResult {EvaluationStatus::Failed, std::string()});
+
+			return result.get_future();
+		}
+
+		/**
+			Count a submitted request as failed without sending it
+		*/
+		std::future<EvaluationResult> Rejected()
+		{
+			failed.fetch_add(1, std::memory_order_relaxed);
+			completed.fetch_add(1, std::memory_order_relaxed);
+
+			return Failed();
+		}
+
+		std::future<EvaluationResult> Submit(detail::RequestKind kind, std::string_view text, std::uint64_t argumentOffset,
+											 std::uint64_t resultOffset)
+		{
+			submitted.fetch_add(1, std::memory_order_relaxed);
+
+			const std::size_t index = LeastLoaded();
+
+			if(index == workers.size() || !workers[index].requests.Fits(sizeof(detail::RequestHeader) + text.size()))
+			{
+				return Rejected();
+			}
+
+			Worker& worker = workers[index];
+
+			const std::uint64_t id = nextRequest.fetch_add(1, std::memory_order_relaxed) + 1;
+
+			// The collector fails pending requests and restarts the worker under sendMutex, so a request registered here
+			// is either failed before it reaches the ring, or sent to the worker it was registered with
+			std::lock_guard<std::mutex> lock(worker.sendMutex);
+
+			if(worker.failed.load(std::memory_order_relaxed))
+			{
+				return Rejected();
+			}
+
+			std::future<EvaluationResult> result;
+
+			{
+				std::lock_guard<std::mutex> pendingLock(worker.pendingMutex);
+
+				result = worker.pending[id].get_future();
+			}
+
+			worker.outstanding.fetch_add(1, std::memory_order_relaxed);
+
+			Send(index, detail::RequestHeader {id, kind, 0, argumentOffset, resultOffset}, text);
+
+			return result;
+		}
+
+		/**
+			Push a request into a worker's ring, waiting for space if it is full
+			@remarks Called with the worker's sendMutex held. Gives up if the worker dies while the ring is full; the
+		   collector then fails the request.
+		*/
+		void Send(std::size_t index, const detail::RequestHeader& header, std::string_view text)
+		{
+			Worker& worker = workers[index];
+
+			while(!worker.requests.TryPush(&header, sizeof(header), text.data(), text.size()))
+			{
+				if(worker.failed.load(std::memory_order_relaxed) || !Alive(worker.pid))
+				{
+					return;
+				}
+
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+
+			sem_post(&Channel(index)->requestsAvailable);
+		}
+
+		/**
+			Collector thread: deliver responses from one worker and restart it if it dies
+		*/
+		void Collect(std::size_t index)
+		{
+			Worker& worker = workers[index];
+
+			detail::ChannelHeader* channel = Channel(index);
+
+			std::string message;
+
+			for(;;)
+			{
+				detail::SemaphoreWaitFor(&channel->responsesAvailable, std::chrono::milliseconds(20));
+
+				while(worker.responses.TryPop(message))
+				{
+					Deliver(worker, message);
+				}
+
+				if(Alive(worker.pid))
+				{
+					continue;
+				}
+
+				// The worker has exited; pick up anything it wrote before it did
+				while(worker.responses.TryPop(message))
+				{
+					Deliver(worker, message);
+				}
+
+				std::lock_guard<std::mutex> lock(worker.sendMutex);
+
+				FailPending(worker);
+
+				const bool neverStarted = channel->state.load(std::memory_order_acquire) != detail::WorkerState::Ready;
+
+				if(stopping.load(std::memory_order_seq_cst) || neverStarted)
+				{
+					worker.failed.store(true, std::memory_order_relaxed);
+					return;
+				}
+
+				worker.requests.Reset();
+				worker.responses.Reset();
+
+				sem_destroy(&channel->requestsAvailable);
+				sem_destroy(&channel->responsesAvailable);
+				sem_init(&channel->requestsAvailable, 1, 0);
+				sem_init(&channel->responsesAvailable, 1, 0);
+
+				restarts.fetch_add(1, std::memory_order_relaxed);
+
+				worker.pid = Spawn(index);
+
+				if(worker.pid <= 0)
+				{
+					worker.failed.store(true, std::memory_order_relaxed);
+					return;
+				}
+			}
+		}
+
+		static bool Alive(pid_t pid) noexcept
+		{
+			return pid > 0 && kill(pid, 0) == 0;
+		}
+
+		void Deliver(Worker& worker, const std::string& message)
+		{
+			detail::ResponseHeader header;
+
+			std::memcpy(&header, message.data(), sizeof(header));
+
+			std::promise<EvaluationResult> result;
+
+			{
+				std::lock_guard<std::mutex> lock(worker.pendingMutex);
+
+				auto found = worker.pending.find(header.id);
+
+				if(found == worker.pending.end())
+				{
+					return;
+				}
+
+				result = std::move(found->second);
+
+				worker.pending.erase(found);
+			}
+
+			worker.outstanding.fetch_sub(1, std::memory_order_relaxed);
+
+			if(header.status != EvaluationStatus::Success)
+			{
+				failed.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			completed.fetch_add(1, std::memory_order_relaxed);
+
+			result.set_value(EvaluationResult {header.status, message.substr(sizeof(header))});
+		}
+
+		void FailPending(Worker& worker)
+		{
+			std::lock_guard<std::mutex> lock(worker.pendingMutex);
+
+			for(auto& entry : worker.pending)
+			{
+				entry.second.set_value(EvaluationResult {EvaluationStatus::Failed, std::string()});
+			}
+
+			failed.fetch_add(worker.pending.size(), std::memory_order_relaxed);
+			completed.fetch_add(worker.pending.size(), std::memory_order_relaxed);
+
+			worker.outstanding.store(0, std::memory_order_relaxed);
+			worker.pending.clear();
+		}
+
+		/* Zygote */
+
+		void StartZygote()
+		{
+			int commands[2];
+			int replies[2];
+
+			if(pipe(commands) != 0 || pipe(replies) != 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "wlr::WorkerPool: pipe");
+			}
+
+			const pid_t supervisor = getpid();
+
+			zygote = fork();
+
+			if(zygote < 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "wlr::WorkerPool: fork");
+			}
+
+			if(zygote == 0)
+			{
+				close(commands[1]);
+				close(replies[0]);
+
+				prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+				if(getppid() != supervisor)
+				{
+					_exit(0);
+				}
+
+				RunZygote(commands[0], replies[1]);
+			}
+
+			close(commands[0]);
+			close(replies[1]);
+
+			zygoteCommands = commands[1];
+			zygoteReplies = replies[0];
+		}
+
+		/**
+			Zygote main loop: fork a worker for every index read from commands, until the supervisor closes the pipe
+		*/
+		[[noreturn]] void RunZygote(int commands, int replies)
+		{
+			// Exited workers are reaped automatically, and the supervisor notices through kill(pid, 0)
+			std::signal(SIGCHLD, SIG_IGN);
+
+			std::uint64_t index;
+
+			while(read(commands, &index, sizeof(index)) == static_cast<ssize_t>(sizeof(index)))
+			{
+				const pid_t zygotePid = getpid();
+				const pid_t worker = fork();
+
+				if(worker == 0)
+				{
+					close(commands);
+					close(replies);
+
+					prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+					if(getppid() != zygotePid)
+					{
+						_exit(0);
+					}
+
+					RunWorker(static_cast<std::size_t>(index));
+				}
+
+				if(write(replies, &worker, sizeof(worker)) != static_cast<ssize_t>(sizeof(worker)))
+				{
+					break;
+				}
+			}
+
+			_exit(0);
+		}
+
+		pid_t Spawn(std::size_t index)
+		{
+			std::lock_guard<std::mutex> lock(zygoteMutex);
+
+			Channel(index)->state.store(detail::WorkerState::Starting, std::memory_order_release);
+
+			const std::uint64_t command = index;
+
+			pid_t worker = -1;
+
+			if(write(zygoteCommands, &command, sizeof(command)) != static_cast<ssize_t>(sizeof(command)) ||
+			   read(zygoteReplies, &worker, sizeof(worker)) != static_cast<ssize_t>(sizeof(worker)))
+			{
+				return -1;
+			}
+
+			return worker;
+		}
+
+		/* Worker process */
+
+		void PinToCore(std::size_t index) noexcept
+		{
+			cpu_set_t allowed;
+
+			if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+			{
+				return;
+			}
+
+			std::size_t target = index % static_cast<std::size_t>(CPU_COUNT(&allowed));
+
+			for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			{
+				if(CPU_ISSET(cpu, &allowed) && target-- == 0)
+				{
+					cpu_set_t pinned;
+
+					CPU_ZERO(&pinned);
+					CPU_SET(cpu, &pinned);
+
+					sched_setaffinity(0, sizeof(pinned), &pinned);
+
+					return;
+				}
+			}
+		}
+
+		[[noreturn]] void RunWorker(std::size_t index)
+		{
+			std::signal(SIGCHLD, SIG_DFL);
+
+			if(options.pinToCores)
+			{
+				PinToCore(index);
+			}
+
+			detail::ChannelHeader* channel = Channel(index);
+
+			if(startRuntime(index) != WLR_SUCCESS)
+			{
+				_exit(2);
+			}
+
+			channel->state.store(detail::WorkerState::Ready, std::memory_order_release);
+
+			Worker& worker = workers[index];
+
+			RecyclingExpressionPool pool(options.requestsPerPoolCycle);
+
+			std::string message;
+
+			for(;;)
+			{
+				detail::SemaphoreWait(&channel->requestsAvailable);
+
+				while(worker.requests.TryPop(message))
+				{
+					detail::RequestHeader header;
+
+					std::memcpy(&header, message.data(), sizeof(header));
+
+					if(header.kind == detail::RequestKind::Stop)
+					{
+						_exit(0);
+					}
+
+					const std::string_view text = std::string_view(message).substr(sizeof(header));
+
+					const EvaluationResult result = header.kind == detail::RequestKind::Evaluate
+														? EvaluateInWorker(text)
+														: ApplyInWorker(text, header.argumentOffset, header.resultOffset);
+
+					pool.EndRequest();
+
+					const detail::ResponseHeader response {header.id,
+														   worker.responses.Fits(sizeof(detail::ResponseHeader) + result.output.size())
+															   ? result.status
+															   : EvaluationStatus::Failed,
+														   0};
+
+					const std::string_view output =
+						response.status == result.status ? std::string_view(result.output) : std::string_view();
+
+					while(!worker.responses.TryPush(&response, sizeof(response), output.data(), output.size()))
+					{
+						std::this_thread::sleep_for(std::chrono::microseconds(50));
+					}
+
+					sem_post(&channel->responsesAvailable);
+				}
+			}
+		}
+
+		/**
+			EvaluateToOutputForm, failing if the input does not parse or the result is not a string
+		*/
+		static EvaluationResult EvaluateInWorker(std::string_view input)
+		{
+			wlr_expr parsedExpression = wlr_ParseExpression(ToExpression(input));
+
+			if(wlr_ErrorQ(parsedExpression))
+			{
+				return EvaluationResult {EvaluationStatus::Failed, std::string()};
+			}
+
+			wlr_expr evaluatedExpression =
+				wlr_Eval(E(Symbol(SystemSymbol::ToString), parsedExpression, Symbol(SystemSymbol::OutputForm)));
+
+			if(wlr_ExpressionType(evaluatedExpression) != WLR_STRING)
+			{
+				return EvaluationResult {EvaluationStatus::Failed, std::string()};
+			}
+
+			return EvaluationResult {EvaluationStatus::Success, StringFromExpression(evaluatedExpression)};
+		}
+
+		EvaluationResult ApplyInWorker(std::string_view function, std::uint64_t argumentOffset, std::uint64_t resultOffset)
+		{
+			const EvaluationResult failure {EvaluationStatus::Failed, std::string()};
+
+			if(argumentOffset == detail::NoOffset)
+			{
+				return failure;
+			}
+
+			const auto* argument = reinterpret_cast<const detail::SharedTensorHeader*>(arenaBase + argumentOffset);
+
+			if(argument->rank < 1 || argument->rank > static_cast<mint>(detail::SharedTensorMaximumRank))
+			{
+				return failure;
+			}
+
+			NumericArray numericArray;
+
+			if(NumericArray::Create(argument->type, argument->rank, argument->dimensions, numericArray) != LIBRARY_NO_ERROR)
+			{
+				return failure;
+			}
+
+			std::memcpy(wlr_MNumericArray_getData(numericArray.Get()),
+						reinterpret_cast<const unsigned char*>(argument) + detail::SharedTensorDataOffset,
+						static_cast<std::size_t>(wlr_MNumericArray_getFlattenedLength(numericArray.Get())) *
+							NumericArrayElementSize(argument->type));
+
+			wlr_expr functionExpression = wlr_ParseExpression(ToExpression(function));
+
+			if(wlr_ErrorQ(functionExpression))
+			{
+				return failure;
+			}
+
+			wlr_expr call = E(functionExpression, E(Symbol(SystemSymbol::Normal), TensorExpression(numericArray)));
+
+			if(resultOffset == detail::NoOffset)
+			{
+				wlr_expr text = wlr_Eval(E(Symbol(SystemSymbol::ToString), call, Symbol(SystemSymbol::OutputForm)));
+
+				return wlr_ExpressionType(text) == WLR_STRING
+						   ? EvaluationResult {EvaluationStatus::Success, StringFromExpression(text)}
+						   : failure;
+			}
+
+			auto* result = reinterpret_cast<detail::SharedTensorHeader*>(arenaBase + resultOffset);
+
+			NumericArray value;
+
+			if(TensorData(wlr_Eval(call), result->type, value) != WLR_SUCCESS)
+			{
+				return failure;
+			}
+
+			const mint rank = wlr_MNumericArray_getRank(value.Get());
+			const std::size_t bytes = static_cast<std::size_t>(wlr_MNumericArray_getFlattenedLength(value.Get())) *
+									  NumericArrayElementSize(result->type);
+
+			if(rank > static_cast<mint>(detail::SharedTensorMaximumRank) || bytes > result->capacity)
+			{
+				return failure;
+			}
+
+			std::memcpy(reinterpret_cast<unsigned char*>(result) + detail::SharedTensorDataOffset,
+						wlr_MNumericArray_getData(value.Get()), bytes);
+
+			std::copy(wlr_MNumericArray_getDimensions(value.Get()), wlr_MNumericArray_getDimensions(value.Get()) + rank,
+					  result->dimensions);
+
+			result->rank = rank;
+
+			return EvaluationResult {EvaluationStatus::Success, std::string()};
+		}
+
+		std::function<wlr_err_t(std::size_t)> startRuntime;
+		WorkerPoolOptions options;
+
+		unsigned char* region = nullptr;
+		unsigned char* arenaBase = nullptr;
+		std::size_t channelBytes = 0;
+		std::size_t regionBytes = 0;
+
+		std::unique_ptr<detail::ArenaAllocator> arena;
+		std::vector<Worker> workers;
+
+		pid_t zygote = -1;
+		int zygoteCommands = -1;
+		int zygoteReplies = -1;
+		std::mutex zygoteMutex;
+
+		std::atomic<std::size_t> nextWorker {0};
+		std::atomic<std::uint64_t> nextRequest {0};
+		std::atomic<bool> stopping {false};
+
+		std::atomic<std::uint64_t> submitted {0};
+		std::atomic<std::uint64_t> completed {0};
+		std::atomic<std::uint64_t> failed {0};
+		std::atomic<std::uint64_t> restarts {0};
+	};
+}
+
+#endif
@@ -0,0 +1,1407 @@
+/*
+	Host-side WXF encoding and decoding for bulk expression transfer
+
+	Reading a large result with wlr_Head, wlr_Length, wlr_Part and wlr_StringData costs several calls into the runtime
+	per subexpression. With the functions in this file the kernel serializes the whole result once, with
+	BinarySerialize, into a single byte array, and the host decodes the Wolfram Exchange Format (WXF) itself:
+
+		wlr::EvaluateToWxf     - evaluate an expression and decode the serialized result into a wlr::WxfDocument
+		wlr::ExpressionToWxf   - the same for an expression that is already evaluated, without evaluating it again
+		wlr::WxfDocument       - decodes WXF bytes into a flat, pre-order array of nodes, walked with wlr::WxfView;
+								 strings, symbols and array data are views into the bytes, so packed and numeric array
+								 payloads are never copied
+		wlr::WxfWriter         - encodes host data as WXF; wlr::WxfExpression wraps the bytes in a single
+								 BinaryDeserialize, for bulk input
+
+	The bytes stay in the runtime's MNumericArray, which the document keeps alive, so a whole result crosses into the
+	host with one evaluation and two data calls. Only uncompressed WXF ("8:") is supported, and the functions above ask
+	BinarySerialize for it. Lengths and dimensions are varints; the decoder reads eight bytes at a time and finds the
+	end of a varint with one mask and a count of trailing zeros instead of looping byte by byte.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "Expr.h"
+#include "ExpressionBuilder.h"
+#include "NumericArray.h"
+#include "Symbols.h"
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "wlr/Wxf.h reads and writes WXF numbers in host byte order");
+#endif
+
+namespace wlr
+{
+	/**
+		Kind of a decoded WXF node
+		@remarks The four WXF machine integer widths all decode to Integer.
+	*/
+	enum class WxfKind : std::uint8_t
+	{
+		Function,
+		Integer,
+		Real,
+		BigInteger,
+		BigReal,
+		String,
+		Binary,
+		Symbol,
+		Association,
+		Rule,
+		RuleDelayed,
+		PackedArray,
+		NumericArray
+	};
+
+	/**
+		Element type codes of WXF packed and numeric arrays
+		@remarks Packed arrays only use the signed integer, real and complex types.
+	*/
+	enum class WxfArrayType : std::uint8_t
+	{
+		Integer8 = 0x00,
+		Integer16 = 0x01,
+		Integer32 = 0x02,
+		Integer64 = 0x03,
+		UnsignedInteger8 = 0x10,
+		UnsignedInteger16 = 0x11,
+		UnsignedInteger32 = 0x12,
+		UnsignedInteger64 = 0x13,
+		Real32 = 0x22,
+		Real64 = 0x23,
+		ComplexReal32 = 0x33,
+		ComplexReal64 = 0x34
+	};
+
+	namespace detail
+	{
+		namespace wxf
+		{
+			constexpr unsigned char Function = 'f';
+			constexpr unsigned char Integer8 = 'C';
+			constexpr unsigned char Integer16 = 'j';
+			constexpr unsigned char Integer32 = 'i';
+			constexpr unsigned char Integer64 = 'L';
+			constexpr unsigned char Real64 = 'r';
+			constexpr unsigned char BigInteger = 'I';
+			constexpr unsigned char BigReal = 'R';
+			constexpr unsigned char String = 'S';
+			constexpr unsigned char Binary = 'B';
+			constexpr unsigned char Symbol = 's';
+			constexpr unsigned char Association = 'A';
+			constexpr unsigned char Rule = '-';
+			constexpr unsigned char RuleDelayed = ':';
+			constexpr unsigned char PackedArray = 0xC1;
+			constexpr unsigned char NumericArray = 0xC2;
+		}
+
+		/**
+			The numericarray_data_t of a WXF array element type, or MNumericArray_Type_Undef if the code is not one
+		*/
+		constexpr numericarray_data_t NumericArrayTypeOf(WxfArrayType type) noexcept
+		{
+			switch(type)
+			{
+				case WxfArrayType::Integer8:
+					return MNumericArray_Type_Bit8;
+				case WxfArrayType::Integer16:
+					return MNumericArray_Type_Bit16;
+				case WxfArrayType::Integer32:
+					return MNumericArray_Type_Bit32;
+				case WxfArrayType::Integer64:
+					return MNumericArray_Type_Bit64;
+				case WxfArrayType::UnsignedInteger8:
+					return MNumericArray_Type_UBit8;
+				case WxfArrayType::UnsignedInteger16:
+					return MNumericArray_Type_UBit16;
+				case WxfArrayType::UnsignedInteger32:
+					return MNumericArray_Type_UBit32;
+				case WxfArrayType::UnsignedInteger64:
+					return MNumericArray_Type_UBit64;
+				case WxfArrayType::Real32:
+					return MNumericArray_Type_Real32;
+				case WxfArrayType::Real64:
+					return MNumericArray_Type_Real64;
+				case WxfArrayType::ComplexReal32:
+					return MNumericArray_Type_Complex_Real32;
+				case WxfArrayType::ComplexReal64:
+					return MNumericArray_Type_Complex_Real64;
+				default:
+					return MNumericArray_Type_Undef;
+			}
+		}
+
+		/**
+			The WXF array element type of a numericarray_data_t; false for Real16 and ComplexReal16, which WXF lacks
+		*/
+		constexpr bool WxfArrayTypeOf(numericarray_data_t type, WxfArrayType& result) noexcept
+		{
+			for(WxfArrayType candidate :
+				{WxfArrayType::Integer8, WxfArrayType::Integer16, WxfArrayType::Integer32, WxfArrayType::Integer64,
+				 WxfArrayType::UnsignedInteger8, WxfArrayType::UnsignedInteger16, WxfArrayType::UnsignedInteger32,
+				 WxfArrayType::UnsignedInteger64, WxfArrayType::Real32, WxfArrayType::Real64, WxfArrayType::ComplexReal32,
+				 WxfArrayType::ComplexReal64})
+			{
+				if(NumericArrayTypeOf(candidate) == type)
+				{
+					result = candidate;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		constexpr bool IsPackableArrayType(WxfArrayType type) noexcept
+		{
+			return type <= WxfArrayType::Integer64 || type == WxfArrayType::Real32 || type == WxfArrayType::Real64 ||
+				   type == WxfArrayType::ComplexReal32 || type == WxfArrayType::ComplexReal64;
+		}
+
+		inline unsigned CountTrailingZeros(std::uint64_t value) noexcept
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			unsigned long index;
+			_BitScanForward64(&index, value);
+			return static_cast<unsigned>(index);
+#else
+			return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+		}
+
+		/**
+			Gather the low seven bits of each byte of word into one integer, first byte lowest
+		*/
+		inline std::uint64_t CompactVarintGroups(std::uint64_t word) noexcept
+		{
+#if defined(__BMI2__)
+			return _pext_u64(word, 0x7F7F7F7F7F7F7F7Full);
+#else
+			word &= 0x7F7F7F7F7F7F7F7Full;
+			word = (word & 0x007F007F007F007Full) | ((word & 0x7F007F007F007F00ull) >> 1);
+			word = (word & 0x00003FFF00003FFFull) | ((word & 0x3FFF00003FFF0000ull) >> 2);
+			return (word & 0x000000000FFFFFFFull) | ((word & 0x0FFFFFFF00000000ull) >> 4);
+#endif
+		}
+
+		/**
+			Read one unsigned LEB128 varint and advance position past it
+			@remarks Single-byte varints, which most lengths are, take one comparison. Varints of up to eight bytes that
+		   are not at the very end of the data are decoded from one unaligned load. Returns false if the data ends inside
+		   the varint or its value does not fit in 63 bits.
+		*/
+		inline bool ReadVarint(const unsigned char*& position, const unsigned char* end, std::uint64_t& value) noexcept
+		{
+			if(position == end)
+			{
+				return false;
+			}
+
+			if(*position < 0x80)
+			{
+				value = *position++;
+				return true;
+			}
+
+			if(end - position >= 8)
+			{
+				std::uint64_t word;
+				std::memcpy(&word, position, sizeof(word));
+
+				const std::uint64_t lastBytes = ~word & 0x8080808080808080ull;
+
+				if(lastBytes != 0)
+				{
+					const unsigned length = (CountTrailingZeros(lastBytes) >> 3) + 1;
+
+					if(length < 8)
+					{
+						word &= (std::uint64_t(1) << (8 * length)) - 1;
+					}
+
+					value = CompactVarintGroups(word);
+					position += length;
+
+					return true;
+				}
+			}
+
+			// A nine-byte varint, or one that ends within the last eight bytes of the data
+			value = 0;
+
+			for(unsigned shift = 0; position != end && shift < 63; shift += 7)
+			{
+				const std::uint64_t group = *position++;
+
+				value |= (group & 0x7F) << shift;
+
+				if(group < 0x80)
+				{
+					return (value >> 63) == 0;
+				}
+			}
+
+			return false;
+		}
+
+		/**
+			One decoded WXF node
+			@remarks Nodes are stored in pre-order. next is the index of the node that follows the whole subtree, so
+		   siblings are found without walking their children. value holds the integer, the bits of the real, or the
+		   offset of the payload in the bytes.
+		*/
+		struct WxfNode
+		{
+			WxfKind kind;
+			WxfArrayType arrayType;
+			std::uint32_t rank;
+			std::uint32_t next;
+			std::uint32_t dimensions;
+			std::uint64_t length;
+			std::uint64_t value;
+		};
+
+		struct WxfTree
+		{
+			std::string_view bytes;
+			std::vector<WxfNode> nodes;
+			std::vector<mint> dimensions;
+		};
+	}
+
+	/**
+		Read-only cursor over one node of a WxfDocument
+		@remarks Views are invalidated when the document is parsed again, cleared, moved or destroyed. Accessors for the
+	   wrong kind of node assert in debug builds.
+	*/
+	class WxfView
+	{
+	public:
+		class Iterator
+		{
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = WxfView;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = WxfView;
+
+			Iterator(const detail::WxfTree* tree, std::uint32_t index) noexcept : tree(tree), index(index)
+			{
+			}
+
+			WxfView operator*() const noexcept
+			{
+				return WxfView(tree, index);
+			}
+
+			Iterator& operator++() noexcept
+			{
+				index = tree->nodes[index].next;
+				return *this;
+			}
+
+			Iterator operator++(int) noexcept
+			{
+				Iterator previous = *this;
+				++*this;
+				return previous;
+			}
+
+			bool operator==(const Iterator& other) const noexcept
+			{
+				return index == other.index;
+			}
+
+			bool operator!=(const Iterator& other) const noexcept
+			{
+				return index != other.index;
+			}
+
+		private:
+			const detail::WxfTree* tree;
+			std::uint32_t index;
+		};
+
+		WxfView() noexcept = default;
+
+		WxfView(const detail::WxfTree* tree, std::uint32_t index) noexcept : tree(tree), index(index)
+		{
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return tree != nullptr;
+		}
+
+		WxfKind Kind() const noexcept
+		{
+			return Node().kind;
+		}
+
+		/**
+			Number of arguments of a function, rules of an association, or elements of an array; 2 for a rule; payload
+			bytes for strings, symbols, big numbers and binary strings
+		*/
+		std::size_t Length() const noexcept
+		{
+			return static_cast<std::size_t>(Node().length);
+		}
+
+		std::int64_t Integer() const noexcept
+		{
+			assert(Kind() == WxfKind::Integer);
+
+			return static_cast<std::int64_t>(Node().value);
+		}
+
+		double Real() const noexcept
+		{
+			assert(Kind() == WxfKind::Real);
+
+			double real;
+			std::memcpy(&real, &Node().value, sizeof(real));
+
+			return real;
+		}
+
+		/**
+			UTF-8 text of a string or symbol, digits of a big number, or the bytes of a binary string
+			@remarks Symbols in the System` context are written without their context by BinarySerialize.
+		*/
+		std::string_view Text() const noexcept
+		{
+			assert(Kind() >= WxfKind::BigInteger && Kind() <= WxfKind::Symbol);
+
+			return Payload(Node().length);
+		}
+
+		/**
+			True if this is the symbol name, written with or without the System` context
+		*/
+		bool IsSymbol(std::string_view name) const noexcept
+		{
+			if(Kind() != WxfKind::Symbol)
+			{
+				return false;
+			}
+
+			const std::string_view text = Text();
+
+			return text == name || (text.size() == name.size() + 7 && text.compare(0, 7, "System`") == 0 &&
+									text.substr(7) == name);
+		}
+
+		/**
+			Head of a function
+		*/
+		WxfView Head() const noexcept
+		{
+			assert(Kind() == WxfKind::Function);
+
+			return WxfView(tree, index + 1);
+		}
+
+		/**
+			Part index, counted from 1, of a function, association or rule; Part(0) of a function is its head
+			@remarks Skips index - 1 siblings, each in constant time.
+		*/
+		WxfView Part(std::size_t part) const noexcept
+		{
+			assert(part <= Length() || (Kind() == WxfKind::Function && part == 0));
+
+			std::uint32_t child = index + 1;
+
+			if(Kind() != WxfKind::Function)
+			{
+				--part;
+			}
+
+			for(; part > 0; --part)
+			{
+				child = tree->nodes[child].next;
+			}
+
+			return WxfView(tree, child);
+		}
+
+		/**
+			First iterator over the arguments of a function, the rules of an association, or the sides of a rule
+		*/
+		Iterator begin() const noexcept
+		{
+			const std::uint32_t first = index + 1;
+
+			return Iterator(tree, Kind() == WxfKind::Function ? tree->nodes[first].next : first);
+		}
+
+		Iterator end() const noexcept
+		{
+			return Iterator(tree, Node().next);
+		}
+
+		/**
+			Value of the first rule in an association whose key is the string key, or an empty view
+		*/
+		WxfView Lookup(std::string_view key) const noexcept
+		{
+			assert(Kind() == WxfKind::Association);
+
+			for(WxfView rule : *this)
+			{
+				WxfView ruleKey = WxfView(tree, rule.index + 1);
+
+				if(ruleKey.Kind() == WxfKind::String && ruleKey.Text() == key)
+				{
+					return WxfView(tree, ruleKey.Node().next);
+				}
+			}
+
+			return WxfView();
+		}
+
+		WxfArrayType ArrayType() const noexcept
+		{
+			assert(Kind() == WxfKind::PackedArray || Kind() == WxfKind::NumericArray);
+
+			return Node().arrayType;
+		}
+
+		mint Rank() const noexcept
+		{
+			assert(Kind() == WxfKind::PackedArray || Kind() == WxfKind::NumericArray);
+
+			return static_cast<mint>(Node().rank);
+		}
+
+		const mint* Dimensions() const noexcept
+		{
+			assert(Kind() == WxfKind::PackedArray || Kind() == WxfKind::NumericArray);
+
+			return tree->dimensions.data() + Node().dimensions;
+		}
+
+		/**
+			Element data of a packed or numeric array, in row-major order, in place
+		*/
+		std::string_view ArrayBytes() const noexcept
+		{
+			assert(Kind() == WxfKind::PackedArray || Kind() == WxfKind::NumericArray);
+
+			return Payload(Node().length * NumericArrayElementSize(detail::NumericArrayTypeOf(Node().arrayType)));
+		}
+
+		/**
+			Typed pointer to the elements of a packed or numeric array, in place
+			@remarks Returns nullptr if the element type is not T, or if the data is not aligned for T; WXF does not align
+		   array data, so use CopyArrayData or ToNumericArray in that case. BinarySerialize writes packed integer arrays in
+		   the narrowest type that holds their elements, so an array of small integers is not an array of mint.
+		*/
+		template <typename T>
+		const T* ArrayData() const noexcept
+		{
+			if((Kind() != WxfKind::PackedArray && Kind() != WxfKind::NumericArray) ||
+			   detail::NumericArrayTypeOf(Node().arrayType) != NumericArrayType<T>)
+			{
+				return nullptr;
+			}
+
+			const char* data = ArrayBytes().data();
+
+			return reinterpret_cast<std::uintptr_t>(data) % alignof(T) == 0 ? reinterpret_cast<const T*>(data) : nullptr;
+		}
+
+		/**
+			Copy the elements of a packed or numeric array to destination, which holds Length() elements of type T
+			@remarks Elements of type T are copied with one memcpy. If T is a signed integer type, elements of a narrower
+		   signed integer type are widened, which reads the packed integer arrays that BinarySerialize narrows. Returns
+		   false, without copying, for any other element type.
+		*/
+		template <typename T>
+		bool CopyArrayData(T* destination) const noexcept
+		{
+			if(Kind() != WxfKind::PackedArray && Kind() != WxfKind::NumericArray)
+			{
+				return false;
+			}
+
+			if(detail::NumericArrayTypeOf(Node().arrayType) == NumericArrayType<T>)
+			{
+				const std::string_view bytes = ArrayBytes();
+
+				std::memcpy(destination, bytes.data(), bytes.size());
+
+				return true;
+			}
+
+			if constexpr(std::is_integral_v<T> && std::is_signed_v<T>)
+			{
+				switch(Node().arrayType)
+				{
+					case WxfArrayType::Integer8:
+						return WidenArrayData<std::int8_t>(destination);
+					case WxfArrayType::Integer16:
+						return WidenArrayData<std::int16_t>(destination);
+					case WxfArrayType::Integer32:
+						return WidenArrayData<std::int32_t>(destination);
+					default:
+						break;
+				}
+			}
+
+			return false;
+		}
+
+		/**
+			Copy a packed or numeric array into a host-owned MNumericArray of the same element type, with one memcpy
+		*/
+		errcode_t ToNumericArray(NumericArray& result) const noexcept
+		{
+			result.Reset();
+
+			if(Kind() != WxfKind::PackedArray && Kind() != WxfKind::NumericArray)
+			{
+				return LIBRARY_TYPE_ERROR;
+			}
+
+			return ToNumericArray(detail::NumericArrayTypeOf(Node().arrayType), result);
+		}
+
+		/**
+			Copy a packed or numeric array into a host-owned MNumericArray of element type type
+			@remarks type must be the element type of the array or, for signed integer arrays, a wider signed integer type,
+		   as CopyArrayData allows; e.g. MNumericArray_Type_Bit64 reads any packed integer array. Returns
+		   LIBRARY_TYPE_ERROR otherwise.
+		*/
+		errcode_t ToNumericArray(numericarray_data_t type, NumericArray& result) const noexcept
+		{
+			result.Reset();
+
+			if(Kind() != WxfKind::PackedArray && Kind() != WxfKind::NumericArray)
+			{
+				return LIBRARY_TYPE_ERROR;
+			}
+
+			const numericarray_data_t sourceType = detail::NumericArrayTypeOf(Node().arrayType);
+
+			if(type != sourceType && type != MNumericArray_Type_Bit16 && type != MNumericArray_Type_Bit32 &&
+			   type != MNumericArray_Type_Bit64)
+			{
+				return LIBRARY_TYPE_ERROR;
+			}
+
+			NumericArray copy;
+
+			errcode_t error = NumericArray::Create(type, Rank(), Dimensions(), copy);
+
+			if(error != LIBRARY_NO_ERROR)
+			{
+				return error;
+			}
+
+			void* data = wlr_MNumericArray_getData(copy.Get());
+
+			bool copied = false;
+
+			switch(type)
+			{
+				case MNumericArray_Type_Bit16:
+					copied = CopyArrayData(static_cast<std::int16_t*>(data));
+					break;
+				case MNumericArray_Type_Bit32:
+					copied = CopyArrayData(static_cast<std::int32_t*>(data));
+					break;
+				case MNumericArray_Type_Bit64:
+					copied = CopyArrayData(static_cast<std::int64_t*>(data));
+					break;
+				default:
+				{
+					const std::string_view bytes = ArrayBytes();
+
+					std::memcpy(data, bytes.data(), bytes.size());
+
+					copied = true;
+					break;
+				}
+			}
+
+			if(!copied)
+			{
+				return LIBRARY_TYPE_ERROR;
+			}
+
+			result = std::move(copy);
+
+			return LIBRARY_NO_ERROR;
+		}
+
+	private:
+		const detail::WxfNode& Node() const noexcept
+		{
+			assert(tree != nullptr);
+
+			return tree->nodes[index];
+		}
+
+		template <typename Source, typename T>
+		bool WidenArrayData(T* destination) const noexcept
+		{
+			if constexpr(sizeof(Source) > sizeof(T))
+			{
+				return false;
+			}
+			else
+			{
+				const char* data = ArrayBytes().data();
+				const std::size_t length = Length();
+
+				for(std::size_t element = 0; element < length; ++element)
+				{
+					Source value;
+					std::memcpy(&value, data + element * sizeof(Source), sizeof(Source));
+
+					destination[element] = static_cast<T>(value);
+				}
+
+				return true;
+			}
+		}
+
+		std::string_view Payload(std::uint64_t size) const noexcept
+		{
+			return tree->bytes.substr(static_cast<std::size_t>(Node().value), static_cast<std::size_t>(size));
+		}
+
+		const detail::WxfTree* tree = nullptr;
+		std::uint32_t index = 0;
+	};
+
+	/**
+		Decoded WXF data
+		@remarks The document refers to the bytes it was parsed from instead of copying them. Bytes passed to Parse must
+	   outlive the document; documents filled by EvaluateToWxf and ExpressionToWxf own the runtime's byte array.
+		@remarks Decoding does not recurse, so deeply nested data cannot overflow the stack. Parse keeps the capacity of
+	   its node arrays, so reusing one document for many results does not allocate once it has grown.
+	*/
+	class WxfDocument
+	{
+	public:
+		WxfDocument() = default;
+
+		WxfDocument(const WxfDocument&) = delete;
+		WxfDocument& operator=(const WxfDocument&) = delete;
+
+		WxfDocument(WxfDocument&&) = default;
+		WxfDocument& operator=(WxfDocument&&) = default;
+
+		/**
+			Decode uncompressed WXF bytes, including the "8:" header
+			@remarks Returns WLR_UNEXPECTED_TYPE, and leaves the document empty, if the bytes are not well-formed
+		   uncompressed WXF with exactly one expression.
+		*/
+		wlr_err_t Parse(std::string_view bytes)
+		{
+			source.Reset();
+
+			return Decode(bytes);
+		}
+
+		/**
+			Take ownership of a NumericArray or ByteArray expression of UnsignedInteger8 elements and decode it in place
+		*/
+		wlr_err_t ParseByteArray(wlr_expr byteArrayExpression)
+		{
+			Clear();
+
+			if(wlr_ErrorQ(byteArrayExpression))
+			{
+				return wlr_ErrorType(byteArrayExpression);
+			}
+
+			MNumericArray numericArray = nullptr;
+
+			const wlr_err_t error = wlr_NumericArrayData(byteArrayExpression, &numericArray);
+
+			if(error != WLR_SUCCESS)
+			{
+				return error;
+			}
+
+			if(wlr_MNumericArray_getType(numericArray) != MNumericArray_Type_UBit8 ||
+			   wlr_MNumericArray_getRank(numericArray) != 1)
+			{
+				return WLR_UNEXPECTED_TYPE;
+			}
+
+			source = Expr::Detach(byteArrayExpression);
+
+			return Decode(std::string_view(static_cast<const char*>(wlr_MNumericArray_getData(numericArray)),
+										   static_cast<std::size_t>(wlr_MNumericArray_getFlattenedLength(numericArray))));
+		}
+
+		void Clear() noexcept
+		{
+			source.Reset();
+
+			tree.bytes = std::string_view();
+			tree.nodes.clear();
+			tree.dimensions.clear();
+		}
+
+		bool Empty() const noexcept
+		{
+			return tree.nodes.empty();
+		}
+
+		/**
+			The decoded expression; the document must not be empty
+		*/
+		WxfView Root() const noexcept
+		{
+			assert(!Empty());
+
+			return WxfView(&tree, 0);
+		}
+
+		std::size_t NodeCount() const noexcept
+		{
+			return tree.nodes.size();
+		}
+
+		std::string_view Bytes() const noexcept
+		{
+			return tree.bytes;
+		}
+
+	private:
+		struct Pending
+		{
+			std::uint32_t node;
+			std::uint64_t remaining;
+		};
+
+		wlr_err_t Decode(std::string_view bytes)
+		{
+			tree.bytes = bytes;
+			tree.nodes.clear();
+			tree.dimensions.clear();
+			pending.clear();
+
+			const unsigned char* const begin = reinterpret_cast<const unsigned char*>(bytes.data());
+			const unsigned char* const end = begin + bytes.size();
+			const unsigned char* position = begin;
+
+			if(bytes.size() < 2 || begin[0] != '8' || begin[1] != ':')
+			{
+				return Fail();
+			}
+
+			position += 2;
+
+			auto remaining = [&] { return static_cast<std::uint64_t>(end - position); };
+
+			do
+			{
+				if(position == end || tree.nodes.size() >= std::numeric_limits<std::uint32_t>::max())
+				{
+					return Fail();
+				}
+
+				const std::uint32_t index = static_cast<std::uint32_t>(tree.nodes.size());
+
+				detail::WxfNode node {};
+				node.next = index + 1;
+
+				std::uint64_t children = 0;
+				std::uint64_t length;
+
+				switch(*position++)
+				{
+					case detail::wxf::Function:
+						if(!detail::ReadVarint(position, end, length) || length >= remaining())
+						{
+							return Fail();
+						}
+
+						node.kind = WxfKind::Function;
+						node.length = length;
+						children = length + 1;
+						break;
+					case detail::wxf::Association:
+						if(!detail::ReadVarint(position, end, length) || length > remaining())
+						{
+							return Fail();
+						}
+
+						node.kind = WxfKind::Association;
+						node.length = length;
+						children = length;
+						break;
+					case detail::wxf::Rule:
+					case detail::wxf::RuleDelayed:
+						node.kind = position[-1] == detail::wxf::Rule ? WxfKind::Rule : WxfKind::RuleDelayed;
+						node.length = 2;
+						children = 2;
+						break;
+					case detail::wxf::Integer8:
+						if(!ReadFixed<std::int8_t>(position, end, node))
+						{
+							return Fail();
+						}
+						break;
+					case detail::wxf::Integer16:
+						if(!ReadFixed<std::int16_t>(position, end, node))
+						{
+							return Fail();
+						}
+						break;
+					case detail::wxf::Integer32:
+						if(!ReadFixed<std::int32_t>(position, end, node))
+						{
+							return Fail();
+						}
+						break;
+					case detail::wxf::Integer64:
+						if(!ReadFixed<std::int64_t>(position, end, node))
+						{
+							return Fail();
+						}
+						break;
+					case detail::wxf::Real64:
+						if(!ReadFixed<double>(position, end, node))
+						{
+							return Fail();
+						}
+						break;
+					case detail::wxf::BigInteger:
+					case detail::wxf::BigReal:
+					case detail::wxf::String:
+					case detail::wxf::Binary:
+					case detail::wxf::Symbol:
+					{
+						const unsigned char token = position[-1];
+
+						if(!detail::ReadVarint(position, end, length) || length > remaining())
+						{
+							return Fail();
+						}
+
+						node.kind = token == detail::wxf::BigInteger ? WxfKind::BigInteger
+									: token == detail::wxf::BigReal  ? WxfKind::BigReal
+									: token == detail::wxf::String   ? WxfKind::String
+									: token == detail::wxf::Binary   ? WxfKind::Binary
+																	 : WxfKind::Symbol;
+						node.length = length;
+						node.value = static_cast<std::uint64_t>(position - begin);
+
+						position += length;
+						break;
+					}
+					case detail::wxf::PackedArray:
+					case detail::wxf::NumericArray:
+						if(!ReadArray(position, begin, end, node))
+						{
+							return Fail();
+						}
+						break;
+					default:
+						return Fail();
+				}
+
+				tree.nodes.push_back(node);
+
+				if(children > 0)
+				{
+					pending.push_back(Pending {index, children});
+					continue;
+				}
+
+				// Close every container whose last child this was
+				while(!pending.empty())
+				{
+					if(--pending.back().remaining > 0)
+					{
+						break;
+					}
+
+					tree.nodes[pending.back().node].next = static_cast<std::uint32_t>(tree.nodes.size());
+
+					pending.pop_back();
+				}
+			}
+			while(!pending.empty());
+
+			if(position != end)
+			{
+				return Fail();
+			}
+
+			return WLR_SUCCESS;
+		}
+
+		template <typename T>
+		static bool ReadFixed(const unsigned char*& position, const unsigned char* end, detail::WxfNode& node) noexcept
+		{
+			if(static_cast<std::size_t>(end - position) < sizeof(T))
+			{
+				return false;
+			}
+
+			T number;
+			std::memcpy(&number, position, sizeof(T));
+
+			position += sizeof(T);
+
+			if constexpr(std::is_same<T, double>::value)
+			{
+				node.kind = WxfKind::Real;
+				std::memcpy(&node.value, &number, sizeof(number));
+			}
+			else
+			{
+				node.kind = WxfKind::Integer;
+				node.value = static_cast<std::uint64_t>(static_cast<std::int64_t>(number));
+			}
+
+			return true;
+		}
+
+		bool ReadArray(const unsigned char*& position, const unsigned char* begin, const unsigned char* end,
+					   detail::WxfNode& node)
+		{
+			const bool packed = position[-1] == detail::wxf::PackedArray;
+
+			if(position == end)
+			{
+				return false;
+			}
+
+			const WxfArrayType type = static_cast<WxfArrayType>(*position++);
+			const std::size_t elementSize = NumericArrayElementSize(detail::NumericArrayTypeOf(type));
+
+			std::uint64_t rank;
+
+			if(elementSize == 0 || (packed && !detail::IsPackableArrayType(type)) ||
+			   !detail::ReadVarint(position, end, rank) || rank == 0 || rank > static_cast<std::uint64_t>(end - position) ||
+			   tree.dimensions.size() >= std::numeric_limits<std::uint32_t>::max() - rank)
+			{
+				return false;
+			}
+
+			node.kind = packed ? WxfKind::PackedArray : WxfKind::NumericArray;
+			node.arrayType = type;
+			node.rank = static_cast<std::uint32_t>(rank);
+			node.dimensions = static_cast<std::uint32_t>(tree.dimensions.size());
+
+			std::uint64_t flattenedLength = 1;
+
+			for(std::uint64_t axis = 0; axis < rank; ++axis)
+			{
+				std::uint64_t dimension;
+
+				if(!detail::ReadVarint(position, end, dimension))
+				{
+					return false;
+				}
+
+				// Reject shapes whose byte size would overflow before comparing it with the data that is left
+				if(dimension != 0 && flattenedLength > static_cast<std::uint64_t>(end - begin) / dimension)
+				{
+					flattenedLength = std::numeric_limits<std::uint64_t>::max();
+				}
+				else
+				{
+					flattenedLength *= dimension;
+				}
+
+				tree.dimensions.push_back(static_cast<mint>(dimension));
+			}
+
+			const std::uint64_t size = static_cast<std::uint64_t>(end - position);
+
+			if(flattenedLength > size / elementSize)
+			{
+				return false;
+			}
+
+			node.length = flattenedLength;
+			node.value = static_cast<std::uint64_t>(position - begin);
+
+			position += flattenedLength * elementSize;
+
+			return true;
+		}
+
+		wlr_err_t Fail() noexcept
+		{
+			source.Reset();
+
+			tree.bytes = std::string_view();
+			tree.nodes.clear();
+			tree.dimensions.clear();
+
+			return WLR_UNEXPECTED_TYPE;
+		}
+
+		Expr source;
+		detail::WxfTree tree;
+		std::vector<Pending> pending;
+	};
+
+	/**
+		Encoder for WXF data
+		@remarks Write expressions in prefix order: Function(n) is followed by the head and then n arguments,
+	   Association(n) by n Rule() or RuleDelayed() entries, and each rule by its key and value. The writer does not
+	   check that the counts match what follows.
+	*/
+	class WxfWriter
+	{
+	public:
+		WxfWriter()
+		{
+			Clear();
+		}
+
+		/**
+			Discard the encoded data and start a new "8:" header, keeping the capacity
+		*/
+		void Clear()
+		{
+			bytes.assign("8:", 2);
+		}
+
+		WxfWriter& Function(std::size_t length)
+		{
+			bytes.push_back(static_cast<char>(detail::wxf::Function));
+			WriteVarint(length);
+			return *this;
+		}
+
+		/**
+			Function(length) followed by the head List
+		*/
+		WxfWriter& List(std::size_t length)
+		{
+			return Function(length).Symbol("List");
+		}
+
+		WxfWriter& Association(std::size_t length)
+		{
+			bytes.push_back(static_cast<char>(detail::wxf::Association));
+			WriteVarint(length);
+			return *this;
+		}
+
+		WxfWriter& Rule()
+		{
+			bytes.push_back(static_cast<char>(detail::wxf::Rule));
+			return *this;
+		}
+
+		WxfWriter& RuleDelayed()
+		{
+			bytes.push_back(static_cast<char>(detail::wxf::RuleDelayed));
+			return *this;
+		}
+
+		/**
+			Symbol by name; System` symbols may omit the context
+		*/
+		WxfWriter& Symbol(std::string_view name)
+		{
+			return Counted(detail::wxf::Symbol, name);
+		}
+
+		/**
+			String from UTF-8 text
+		*/
+		WxfWriter& String(std::string_view text)
+		{
+			return Counted(detail::wxf::String, text);
+		}
+
+		/**
+			ByteArray of the given bytes
+		*/
+		WxfWriter& Binary(std::string_view data)
+		{
+			return Counted(detail::wxf::Binary, data);
+		}
+
+		/**
+			Integer that does not fit in 64 bits, as decimal digits with an optional leading minus sign
+		*/
+		WxfWriter& BigInteger(std::string_view digits)
+		{
+			return Counted(detail::wxf::BigInteger, digits);
+		}
+
+		/**
+			Machine integer, written in the narrowest of the four WXF widths that holds it
+		*/
+		WxfWriter& Integer(std::int64_t value)
+		{
+			if(value >= INT8_MIN && value <= INT8_MAX)
+			{
+				return Fixed(detail::wxf::Integer8, static_cast<std::int8_t>(value));
+			}
+
+			if(value >= INT16_MIN && value <= INT16_MAX)
+			{
+				return Fixed(detail::wxf::Integer16, static_cast<std::int16_t>(value));
+			}
+
+			if(value >= INT32_MIN && value <= INT32_MAX)
+			{
+				return Fixed(detail::wxf::Integer32, static_cast<std::int32_t>(value));
+			}
+
+			return Fixed(detail::wxf::Integer64, value);
+		}
+
+		WxfWriter& Real(double value)
+		{
+			return Fixed(detail::wxf::Real64, value);
+		}
+
+		/**
+			Packed List with the given row-major dimensions, with one copy of the data
+			@remarks T must be a signed integer, real or complex element type; packed arrays have no unsigned types.
+		*/
+		template <typename T>
+		WxfWriter& PackedArray(const T* data, const mint* dimensions, mint rank)
+		{
+			return Array(detail::wxf::PackedArray, NumericArrayType<T>, data, dimensions, rank);
+		}
+
+		/**
+			Packed integer List, written as BinarySerialize writes it: in the narrowest signed type that holds every element
+			@remarks Costs one pass over the data to find the range before the copy.
+		*/
+		WxfWriter& PackedIntegers(const std::int64_t* data, const mint* dimensions, mint rank)
+		{
+			std::size_t length = 1;
+
+			for(mint axis = 0; axis < rank; ++axis)
+			{
+				length *= static_cast<std::size_t>(dimensions[axis]);
+			}
+
+			std::int64_t minimum = 0;
+			std::int64_t maximum = 0;
+
+			for(std::size_t element = 0; element < length; ++element)
+			{
+				minimum = std::min(minimum, data[element]);
+				maximum = std::max(maximum, data[element]);
+			}
+
+			if(minimum >= INT8_MIN && maximum <= INT8_MAX)
+			{
+				return NarrowedPackedArray<std::int8_t>(data, length, dimensions, rank);
+			}
+
+			if(minimum >= INT16_MIN && maximum <= INT16_MAX)
+			{
+				return NarrowedPackedArray<std::int16_t>(data, length, dimensions, rank);
+			}
+
+			if(minimum >= INT32_MIN && maximum <= INT32_MAX)
+			{
+				return NarrowedPackedArray<std::int32_t>(data, length, dimensions, rank);
+			}
+
+			return PackedArray(data, dimensions, rank);
+		}
+
+		/**
+			NumericArray with the given row-major dimensions, with one copy of the data
+		*/
+		template <typename T>
+		WxfWriter& NumericArray(const T* data, const mint* dimensions, mint rank)
+		{
+			return Array(detail::wxf::NumericArray, NumericArrayType<T>, data, dimensions, rank);
+		}
+
+		/**
+			NumericArray of the given element type and row-major dimensions, with one copy of the data
+			@remarks Real16 and ComplexReal16 data have no WXF encoding and are written as $Failed.
+		*/
+		WxfWriter& NumericArray(numericarray_data_t type, const void* data, const mint* dimensions, mint rank)
+		{
+			return Array(detail::wxf::NumericArray, type, data, dimensions, rank);
+		}
+
+		/**
+			NumericArray with the element type, dimensions and data of an MNumericArray
+			@remarks Real16 and ComplexReal16 arrays have no WXF encoding and are written as $Failed.
+		*/
+		WxfWriter& NumericArray(MNumericArray numericArray)
+		{
+			return Array(detail::wxf::NumericArray, wlr_MNumericArray_getType(numericArray),
+						 wlr_MNumericArray_getData(numericArray), wlr_MNumericArray_getDimensions(numericArray),
+						 wlr_MNumericArray_getRank(numericArray));
+		}
+
+		/**
+			The encoded data, including the header
+		*/
+		std::string_view Bytes() const noexcept
+		{
+			return bytes;
+		}
+
+		void Reserve(std::size_t capacity)
+		{
+			bytes.reserve(capacity);
+		}
+
+	private:
+		void WriteVarint(std::uint64_t value)
+		{
+			while(value >= 0x80)
+			{
+				bytes.push_back(static_cast<char>((value & 0x7F) | 0x80));
+				value >>= 7;
+			}
+
+			bytes.push_back(static_cast<char>(value));
+		}
+
+		WxfWriter& Counted(unsigned char token, std::string_view payload)
+		{
+			bytes.push_back(static_cast<char>(token));
+			WriteVarint(payload.size());
+			bytes.append(payload.data(), payload.size());
+			return *this;
+		}
+
+		template <typename T>
+		WxfWriter& Fixed(unsigned char token, T value)
+		{
+			char buffer[sizeof(T)];
+			std::memcpy(buffer, &value, sizeof(T));
+
+			bytes.push_back(static_cast<char>(token));
+			bytes.append(buffer, sizeof(T));
+			return *this;
+		}
+
+		WxfWriter& Array(unsigned char token, numericarray_data_t type, const void* data, const mint* dimensions,
+						 mint rank)
+		{
+			WxfArrayType arrayType;
+
+			if(!detail::WxfArrayTypeOf(type, arrayType) || rank < 1 ||
+			   (token == detail::wxf::PackedArray && !detail::IsPackableArrayType(arrayType)))
+			{
+				assert(false && "wlr::WxfWriter: array element type has no WXF encoding");
+
+				return Symbol("$Failed");
+			}
+
+			bytes.push_back(static_cast<char>(token));
+			bytes.push_back(static_cast<char>(arrayType));
+			WriteVarint(static_cast<std::uint64_t>(rank));
+
+			std::size_t length = 1;
+
+			for(mint axis = 0; axis < rank; ++axis)
+			{
+				WriteVarint(static_cast<std::uint64_t>(dimensions[axis]));
+				length *= static_cast<std::size_t>(dimensions[axis]);
+			}
+
+			bytes.append(static_cast<const char*>(data), length * NumericArrayElementSize(type));
+			return *this;
+		}
+
+		template <typename T>
+		WxfWriter& NarrowedPackedArray(const std::int64_t* data, std::size_t length, const mint* dimensions, mint rank)
+		{
+			std::vector<T> narrowed(data, data + length);
+
+			return PackedArray(narrowed.data(), dimensions, rank);
+		}
+
+		std::string bytes;
+	};
+
+	namespace detail
+	{
+		/**
+			NumericArray[BinarySerialize[expression, PerformanceGoal -> "Speed"], "UnsignedInteger8"]
+			@remarks "Speed" selects uncompressed WXF. Converting the ByteArray to a NumericArray lets the host read its
+		   bytes in place with wlr_NumericArrayData.
+		*/
+		inline wlr_expr SerializedBytesExpression(wlr_expr expression)
+		{
+			return E(Symbol(SystemSymbol::NumericArray),
+					 E(Symbol("BinarySerialize"), expression,
+					   E(Symbol(SystemSymbol::Rule), Symbol("PerformanceGoal"), wlr_String("Speed"))),
+					 wlr_String("UnsignedInteger8"));
+		}
+	}
+
+	/**
+		Evaluate input in the kernel and decode its result, serialized as WXF, into result
+		@remarks One wlr_Eval for the evaluation and the serialization together. Returns the error of the evaluation, or
+	   WLR_UNEXPECTED_TYPE if the result could not be serialized. Intermediate expressions are left in the current pool;
+	   the byte array itself is detached and owned by result.
+	*/
+	inline wlr_err_t EvaluateToWxf(wlr_expr input, WxfDocument& result)
+	{
+		return result.ParseByteArray(wlr_Eval(detail::SerializedBytesExpression(input)));
+	}
+
+	/**
+		Serialize an expression that has already been evaluated as WXF, without evaluating it again, and decode it into
+		result
+	*/
+	inline wlr_err_t ExpressionToWxf(wlr_expr expression, WxfDocument& result)
+	{
+		return result.ParseByteArray(wlr_Eval(detail::SerializedBytesExpression(E(Symbol("Unevaluated"), expression))));
+	}
+
+	/**
+		Build the unevaluated expression BinaryDeserialize[ByteArray[...]] for WXF bytes, such as WxfWriter::Bytes()
+		@remarks The bytes are copied once into an MNumericArray. The expression becomes the encoded expression when it
+	   is evaluated, so it can be embedded in a larger input, e.g. as the argument of a function. Returns a
+	   WLR_ALLOCATION_ERROR error expression if the byte array cannot be allocated.
+	*/
+	inline wlr_expr WxfExpression(std::string_view bytes)
+	{
+		const mint length = static_cast<mint>(bytes.size());
+
+		NumericArray numericArray;
+
+		if(NumericArray::FromBuffer(reinterpret_cast<const std::uint8_t*>(bytes.data()), 1, &length, numericArray) !=
+		   LIBRARY_NO_ERROR)
+		{
+			return wlr_Error(WLR_ALLOCATION_ERROR);
+		}
+
+		return E(Symbol("BinaryDeserialize"),
+				 E(Symbol(SystemSymbol::ByteArray),
+				   wlr_ExpressionFromNumericArray(numericArray.Get(), Symbol(SystemSymbol::NumericArray))));
+	}
+}
@@ -95,7 +95,7 @@ unsafe class SampleProgram
 	{
 		sbyte *stringData;
 
-		int stringDataLength;
+		nint stringDataLength;
 
 		// Get unmanaged data corresponding to the string of a string expression
 		WLR.wlr_error_type error =
@@ -113,7 +113,7 @@ unsafe class SampleProgram
 			return "";
 		}
 
-		var memorySpan = new ReadOnlySpan<byte>(stringData, stringDataLength);
+		var memorySpan = new ReadOnlySpan<byte>(stringData, (int) stringDataLength);
 
 		// Get C# string from unmanaged data allocated by wlr_StringData
 		string result = Encoding.UTF8.GetString(memorySpan);
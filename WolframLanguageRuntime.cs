@@ -52,7 +52,7 @@ namespace WolframLanguageRuntime
 		public unsafe partial struct wlr_runtime_configuration
 		{
 			[NativeTypeName("mint")]
-			public int argumentCount;
+			public nint argumentCount;
 
 			[NativeTypeName("char **")]
 			public sbyte** arguments;
@@ -82,7 +82,7 @@ namespace WolframLanguageRuntime
 
 			[DllImport(sdkDynamicLibraryName, CallingConvention = CallingConvention.Cdecl, ExactSpelling = true)]
 			[return: NativeTypeName("wlr_err_t")]
-			public static extern wlr_error_type wlr_StringData([NativeTypeName("wlr_expr")] void* expression, [NativeTypeName("char **")] sbyte** resultData, [NativeTypeName("mint *")] int* resultLength);
+			public static extern wlr_error_type wlr_StringData([NativeTypeName("wlr_expr")] void* expression, [NativeTypeName("char **")] sbyte** resultData, [NativeTypeName("mint *")] nint* resultLength);
 
 			[DllImport(sdkDynamicLibraryName, CallingConvention = CallingConvention.Cdecl, ExactSpelling = true)]
 			[return: NativeTypeName("wlr_expr")]
@@ -90,7 +90,7 @@ namespace WolframLanguageRuntime
 
 			[DllImport(sdkDynamicLibraryName, CallingConvention = CallingConvention.Cdecl, ExactSpelling = true)]
 			[return: NativeTypeName("wlr_expr")]
-			public static extern void* wlr_VariadicE(void* expressionHead, [NativeTypeName("mint")] long childElementNumber, __arglist);
+			public static extern void* wlr_VariadicE(void* expressionHead, [NativeTypeName("mint")] nint childElementNumber, __arglist);
 
 			[DllImport(sdkDynamicLibraryName, CallingConvention = CallingConvention.Cdecl, ExactSpelling = true)]
 			[return: NativeTypeName("wlr_expr")]
@@ -0,0 +1,209 @@
+/*
+	Bindings for the native shim in Native/Shim/WolframLanguageRuntimeShim.h
+
+	The shim's entry points are called through unmanaged function pointers, so each call is a single blittable
+	transition: no __arglist, no marshaling stubs, and no managed allocations on the span overloads. Text can be passed
+	as UTF-8 bytes or as UTF-16 chars; UTF-16 is transcoded natively (Native/wlr/Utf.h). The shim library
+	(WolframLanguageRuntimeShim.dll) must be next to the executable, or its path must be passed to Load.
+*/
+
+using System.Runtime.InteropServices;
+using System.Text;
+using System;
+
+namespace WolframLanguageRuntime
+{
+	public static unsafe class WLRShim
+	{
+		private const string shimDynamicLibraryName = "WolframLanguageRuntimeShim";
+
+		private static delegate* unmanaged[Cdecl]<sbyte*, WLR.wlr_error_type> startRuntime;
+
+		private static delegate* unmanaged[Cdecl]<byte*, nint, byte*, nint, nint*, WLR.wlr_error_type> evaluateToOutputForm;
+
+		private static delegate* unmanaged[Cdecl]<byte*, nint*, nint, byte*, nint, nint*, WLR.wlr_error_type*, WLR.wlr_error_type> evaluateBatchToOutputForm;
+
+		private static delegate* unmanaged[Cdecl]<byte*, nint, nint*, WLR.wlr_error_type> copyPendingOutput;
+
+		private static delegate* unmanaged[Cdecl]<char*, nint, char*, nint, nint*, WLR.wlr_error_type> evaluateToOutputFormUtf16;
+
+		private static delegate* unmanaged[Cdecl]<char*, nint*, nint, char*, nint, nint*, WLR.wlr_error_type*, WLR.wlr_error_type> evaluateBatchToOutputFormUtf16;
+
+		private static delegate* unmanaged[Cdecl]<char*, nint, nint*, WLR.wlr_error_type> copyPendingOutputUtf16;
+
+		// Output buffer reused by the string overload of EvaluateToOutputForm on each thread
+		[ThreadStatic]
+		private static char[]? outputBuffer;
+
+		// Load the shim library and resolve its entry points. Pass null to search next to the executable.
+		public static void Load(string? libraryPath = null)
+		{
+			IntPtr library =
+				libraryPath == null ?
+					NativeLibrary.Load(shimDynamicLibraryName, typeof(WLRShim).Assembly, null) :
+					NativeLibrary.Load(libraryPath);
+
+			startRuntime = (delegate* unmanaged[Cdecl]<sbyte*, WLR.wlr_error_type>) NativeLibrary.GetExport(library, "wlrshim_StartRuntime");
+
+			evaluateToOutputForm = (delegate* unmanaged[Cdecl]<byte*, nint, byte*, nint, nint*, WLR.wlr_error_type>) NativeLibrary.GetExport(library, "wlrshim_EvaluateToOutputForm");
+
+			evaluateBatchToOutputForm = (delegate* unmanaged[Cdecl]<byte*, nint*, nint, byte*, nint, nint*, WLR.wlr_error_type*, WLR.wlr_error_type>) NativeLibrary.GetExport(library, "wlrshim_EvaluateBatchToOutputForm");
+
+			copyPendingOutput = (delegate* unmanaged[Cdecl]<byte*, nint, nint*, WLR.wlr_error_type>) NativeLibrary.GetExport(library, "wlrshim_CopyPendingOutput");
+
+			evaluateToOutputFormUtf16 = (delegate* unmanaged[Cdecl]<char*, nint, char*, nint, nint*, WLR.wlr_error_type>) NativeLibrary.GetExport(library, "wlrshim_EvaluateToOutputFormUtf16");
+
+			evaluateBatchToOutputFormUtf16 = (delegate* unmanaged[Cdecl]<char*, nint*, nint, char*, nint, nint*, WLR.wlr_error_type*, WLR.wlr_error_type>) NativeLibrary.GetExport(library, "wlrshim_EvaluateBatchToOutputFormUtf16");
+
+			copyPendingOutputUtf16 = (delegate* unmanaged[Cdecl]<char*, nint, nint*, WLR.wlr_error_type>) NativeLibrary.GetExport(library, "wlrshim_CopyPendingOutputUtf16");
+		}
+
+		// Start the kernel runtime with the given layout directory
+		public static WLR.wlr_error_type StartRuntime(string layoutDirectory)
+		{
+			// Null-terminated UTF-8 copy of the path
+			byte[] layoutDirectoryBytes = new byte[Encoding.UTF8.GetByteCount(layoutDirectory) + 1];
+
+			Encoding.UTF8.GetBytes(layoutDirectory, layoutDirectoryBytes);
+
+			fixed(byte* layoutDirectoryPointer = layoutDirectoryBytes)
+			{
+				return startRuntime((sbyte*) layoutDirectoryPointer);
+			}
+		}
+
+		// Evaluate UTF-8 input to OutputForm, writing UTF-8 output. bytesWritten receives the length of the result.
+		// Returns WLR_OUT_OF_BOUNDS if the result does not fit; it can then be fetched with CopyPendingOutput.
+		public static WLR.wlr_error_type EvaluateToOutputForm(ReadOnlySpan<byte> input, Span<byte> output, out int bytesWritten)
+		{
+			nint outputLength;
+
+			WLR.wlr_error_type error;
+
+			fixed(byte* inputPointer = input)
+			fixed(byte* outputPointer = output)
+			{
+				error = evaluateToOutputForm(inputPointer, input.Length, outputPointer, output.Length, &outputLength);
+			}
+
+			bytesWritten = (int) outputLength;
+
+			return error;
+		}
+
+		// Evaluate many UTF-8 inputs to OutputForm in one call. Input i is inputs[inputOffsets[i]..inputOffsets[i + 1]]
+		// and result i is output[outputOffsets[i]..outputOffsets[i + 1]]; statuses may be empty.
+		public static WLR.wlr_error_type EvaluateBatchToOutputForm(ReadOnlySpan<byte> inputs, ReadOnlySpan<nint> inputOffsets, Span<byte> output, Span<nint> outputOffsets, Span<WLR.wlr_error_type> statuses)
+		{
+			int inputCount = inputOffsets.Length - 1;
+
+			if(inputCount < 0 || outputOffsets.Length != inputOffsets.Length || (!statuses.IsEmpty && statuses.Length != inputCount))
+			{
+				throw new ArgumentException("inputOffsets and outputOffsets need one more element than there are inputs, and statuses one per input or none.");
+			}
+
+			fixed(byte* inputsPointer = inputs)
+			fixed(nint* inputOffsetsPointer = inputOffsets)
+			fixed(byte* outputPointer = output)
+			fixed(nint* outputOffsetsPointer = outputOffsets)
+			fixed(WLR.wlr_error_type* statusesPointer = statuses)
+			{
+				return evaluateBatchToOutputForm(inputsPointer, inputOffsetsPointer, inputCount, outputPointer, output.Length, outputOffsetsPointer, statusesPointer);
+			}
+		}
+
+		// Copy the output kept by the last call on this thread that returned WLR_OUT_OF_BOUNDS
+		public static WLR.wlr_error_type CopyPendingOutput(Span<byte> output, out int bytesWritten)
+		{
+			nint outputLength;
+
+			WLR.wlr_error_type error;
+
+			fixed(byte* outputPointer = output)
+			{
+				error = copyPendingOutput(outputPointer, output.Length, &outputLength);
+			}
+
+			bytesWritten = (int) outputLength;
+
+			return error;
+		}
+
+		// UTF-16 versions of the methods above. The native side validates and transcodes in one pass, so managed
+		// strings and char buffers are passed as they are, without Encoding.UTF8. Unpaired surrogates in the input give
+		// WLR_MALFORMED.
+		public static WLR.wlr_error_type EvaluateToOutputForm(ReadOnlySpan<char> input, Span<char> output, out int charsWritten)
+		{
+			nint outputLength;
+
+			WLR.wlr_error_type error;
+
+			fixed(char* inputPointer = input)
+			fixed(char* outputPointer = output)
+			{
+				error = evaluateToOutputFormUtf16(inputPointer, input.Length, outputPointer, output.Length, &outputLength);
+			}
+
+			charsWritten = (int) outputLength;
+
+			return error;
+		}
+
+		public static WLR.wlr_error_type EvaluateBatchToOutputForm(ReadOnlySpan<char> inputs, ReadOnlySpan<nint> inputOffsets, Span<char> output, Span<nint> outputOffsets, Span<WLR.wlr_error_type> statuses)
+		{
+			int inputCount = inputOffsets.Length - 1;
+
+			if(inputCount < 0 || outputOffsets.Length != inputOffsets.Length || (!statuses.IsEmpty && statuses.Length != inputCount))
+			{
+				throw new ArgumentException("inputOffsets and outputOffsets need one more element than there are inputs, and statuses one per input or none.");
+			}
+
+			fixed(char* inputsPointer = inputs)
+			fixed(nint* inputOffsetsPointer = inputOffsets)
+			fixed(char* outputPointer = output)
+			fixed(nint* outputOffsetsPointer = outputOffsets)
+			fixed(WLR.wlr_error_type* statusesPointer = statuses)
+			{
+				return evaluateBatchToOutputFormUtf16(inputsPointer, inputOffsetsPointer, inputCount, outputPointer, output.Length, outputOffsetsPointer, statusesPointer);
+			}
+		}
+
+		public static WLR.wlr_error_type CopyPendingOutput(Span<char> output, out int charsWritten)
+		{
+			nint outputLength;
+
+			WLR.wlr_error_type error;
+
+			fixed(char* outputPointer = output)
+			{
+				error = copyPendingOutputUtf16(outputPointer, output.Length, &outputLength);
+			}
+
+			charsWritten = (int) outputLength;
+
+			return error;
+		}
+
+		// Evaluate an input string, returning the result as a string in OutputForm. Return empty string on error.
+		public static string EvaluateToOutputForm(string input)
+		{
+			outputBuffer ??= new char[4096];
+
+			WLR.wlr_error_type error = EvaluateToOutputForm(input.AsSpan(), outputBuffer, out int charsWritten);
+
+			if(error == WLR.wlr_error_type.WLR_OUT_OF_BOUNDS)
+			{
+				outputBuffer = new char[Math.Max(charsWritten, 2 * outputBuffer.Length)];
+
+				error = CopyPendingOutput(outputBuffer, out charsWritten);
+			}
+
+			if(error != WLR.wlr_error_type.WLR_SUCCESS)
+			{
+				return "";
+			}
+
+			return new string(outputBuffer, 0, charsWritten);
+		}
+	}
+}